@@ -358,8 +358,8 @@ static void output_call16_function( ORDDEF *odp )
             output( "1:\tmovl wine_ldt_copy_ptr-1b(%%eax),%%esi\n" );
             needs_get_pc_thunk = 1;
         }
-        else
-            output( "\tmovl $%s,%%esi\n", asm_name("_imp__wine_ldt_copy") );
+        else  /* _imp__wine_ldt_copy is the import slot holding the address of wine_ldt_copy */
+            output( "\tmovl %s,%%esi\n", asm_name("_imp__wine_ldt_copy") );
     }
 
     /* preserve 16-byte stack alignment */
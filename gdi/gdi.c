@@ -34,6 +34,7 @@ WINE_DEFAULT_DEBUG_CHANNEL(gdi);
 //#define HGDIOBJ_16(handle32)    ((HGDIOBJ16)(ULONG_PTR)(handle32))
 __declspec(dllimport) HGDIOBJ16 K32HGDIOBJ_16(HGDIOBJ handle);
 __declspec(dllimport) HGDIOBJ K32HGDIOBJ_32(HGDIOBJ16 handle);
+__declspec(dllimport) void K32WOWHandle16Release(HANDLE handle);
 #define HGDIOBJ_32(handle16)    (K32HGDIOBJ_32(handle16))
 #define HGDIOBJ_16(handle32)    (K32HGDIOBJ_16(handle32))
 static BYTE fix_font_charset(BYTE charset);
@@ -1373,8 +1374,13 @@ BOOL16 WINAPI DeleteDC16( HDC16 hdc )
  */
 BOOL16 WINAPI DeleteObject16( HGDIOBJ16 obj )
 {
-    if (GetObjectType( HGDIOBJ_32(obj) ) == OBJ_BITMAP) free_segptr_bits( obj );
-    return DeleteObject( HGDIOBJ_32(obj) );
+    HGDIOBJ obj32 = HGDIOBJ_32(obj);
+    BOOL ret;
+    if (GetObjectType( obj32 ) == OBJ_BITMAP) free_segptr_bits( obj );
+    ret = DeleteObject( obj32 );
+    /* stock objects survive DeleteObject and keep their handle16 */
+    if (ret && !GetObjectType( obj32 )) K32WOWHandle16Release( obj32 );
+    return ret;
 }
 
 
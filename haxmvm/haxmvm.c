@@ -66,6 +66,18 @@ void dynamic__wine_call_int_handler(CONTEXT *context, BYTE intnum)
     }
     __wine_call_int_handler(context, intnum);
 }
+/* DirectRelay in otvdm.ini: call the argument conversion functions generated by convspec */
+BOOL direct_relay_enabled()
+{
+    static int enabled = -1;
+    if (enabled < 0)
+    {
+        DWORD(WINAPI *get_config_int)(LPCSTR, LPCSTR, INT) =
+            (DWORD(WINAPI *)(LPCSTR, LPCSTR, INT))GetProcAddress(LoadLibraryA(KRNL386), "krnl386_get_config_int");
+        enabled = get_config_int && get_config_int("otvdm", "DirectRelay", FALSE);
+    }
+    return enabled;
+}
 /***********************************************************************
 *           SELECTOR_SetEntries
 *
@@ -629,7 +641,10 @@ void relay(LPVOID relay_func, BOOL reg, struct vcpu_state_t *state)
     vm_debug_get_entry_point(module, func, &ordinal);
     fprintf(stderr, "call built-in func %s.%d: %s ESP %04X\n", module, ordinal, func, context.Esp);
     */
-    if ((DWORD)relay_func != relay)
+    /* relay is the argument conversion function generated by convspec for this signature,
+       or relay_call_from_16 (relay_func) when relay debugging is on.  The generated ones skip
+       the SYSLEVEL_CheckNotLevel(2) of relay_call_from_16, so they are only used with DirectRelay=1 */
+    if ((DWORD)relay_func != relay && !direct_relay_enabled())
     {
         fret = ((int(*)(void *entry_point, unsigned char *args16, CONTEXT *context))relay_func)((void*)entry, (unsigned char*)args, &context);
     }
@@ -274,6 +274,19 @@ void DOSVM_SendQueuedEvents( CONTEXT *context )
 }
 
 
+/***********************************************************************
+ *              vm86_send_queued_events
+ *
+ * Called by vm86.dll when it finds the VIP flag set while running in
+ * V86 mode.  Does what exception_handler does for EXCEPTION_VM86_STI,
+ * without going through exception dispatch for every interrupt.
+ */
+__declspec(dllexport) void vm86_send_queued_events( CONTEXT *context )
+{
+    DOSVM_SendQueuedEvents( context );
+}
+
+
 #ifdef MZ_SUPPORTED
 /***********************************************************************
  *		DOSVM_QueueEvent
@@ -313,7 +326,7 @@ void DOSVM_QueueEvent( INT irq, INT priority, DOSRELAY relay, LPVOID data)
       //ERR("kill(%d, %d)\n", dosvm_pid, 12);
       //see dlls/ntdll/signal_i386.c
       //get vm's thread teb
-      ((WINE_VM86_TEB_INFO*)dosvm_vm86_teb_info)->vm86_pending |= VIP_MASK;
+      InterlockedOr((LONG*)&((WINE_VM86_TEB_INFO*)dosvm_vm86_teb_info)->vm86_pending, VIP_MASK);
       //=> VM thread
       //kill(dosvm_pid,SIGUSR2);
 
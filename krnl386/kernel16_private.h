@@ -687,6 +687,24 @@ extern void SELECTOR_FreeBlock( WORD sel );
 /* relay16.c */
 extern int relay_call_from_16( void *entry_point, unsigned char *args16, CONTEXT *context );
 
+/* relaystats.c */
+typedef struct tagRELAY_STATS RELAY_STATS;
+extern BOOL RELAY16_InitStats(void);
+extern BOOL RELAY16_StatsEnabled(void);
+extern RELAY_STATS *RELAY16_GetStats( SEGPTR key );
+extern RELAY_STATS *RELAY16_AddStats( SEGPTR key, const char *module, WORD ordinal, const char *func );
+extern LONGLONG RELAY16_StatsTime(void);
+extern void RELAY16_AddCall( RELAY_STATS *stats, LONGLONG start );
+extern void RELAY16_DumpStats(void);
+
+/* relaytrace.c */
+extern BOOL RELAY16_TraceEnabled(void);
+extern void RELAY16_TraceEntry( SEGPTR key, const char *module, WORD ordinal, const char *func,
+                                const CALLFROM16 *call );
+extern void RELAY16_TraceCall( SEGPTR key, const CALLFROM16 *call, const unsigned char *args16,
+                               const STACK16FRAME *frame );
+extern void RELAY16_TraceReturn( SEGPTR key, const CALLFROM16 *call, int ret_val, const CONTEXT *context );
+
 /* snoop16.c */
 extern void SNOOP16_RegisterDLL(HMODULE16,LPCSTR);
 extern FARPROC16 SNOOP16_GetProcAddress16(HMODULE16,DWORD,FARPROC16);
@@ -196,6 +196,24 @@ typedef struct _LOCAL32HEADER
 
 #define LOCAL32_MAGIC    ((DWORD)('L' | ('H'<<8) | ('3'<<16) | ('2'<<24)))
 
+/* Size-class index of the free blocks of a local heap.
+ * It is kept outside of the segment, so the heap itself keeps the layout
+ * walked by toolhelp. hint[n] is a free arena whose size was in
+ * [2^n, 2^(n+1)) when it was noted; it is checked before use, since the
+ * block may have been allocated or merged since then. max_free is an upper
+ * bound of the largest free block, used to fail requests without a walk.
+ */
+#define LOCAL_NB_CLASSES  16
+
+typedef struct
+{
+    WORD heap;                      /* INSTANCEDATA.heap of the indexed heap, 0 if unused */
+    WORD max_free;                  /* no free block is larger than this */
+    WORD hint[LOCAL_NB_CLASSES];    /* free arena per size class, 0 if none */
+} LOCALFREEINDEX;
+
+static LOCALFREEINDEX local_free_index[8192];
+
 
 static inline BOOL16 call_notify_func( FARPROC16 proc, WORD msg, HLOCAL16 handle, WORD arg )
 {
@@ -237,6 +255,64 @@ static LOCALHEAPINFO *LOCAL_GetHeap( HANDLE16 ds )
 }
 
 
+/***********************************************************************
+ *           LOCAL_SizeClass
+ */
+static inline int LOCAL_SizeClass( WORD size )
+{
+    int class = 0;
+    while (size >>= 1) class++;
+    return class;
+}
+
+
+/***********************************************************************
+ *           LOCAL_GetFreeIndex
+ *
+ * Return the free block index of the heap in 'ds', resetting it if
+ * it was built for another heap.
+ */
+static LOCALFREEINDEX *LOCAL_GetFreeIndex( HANDLE16 ds, char *baseptr )
+{
+    LOCALFREEINDEX *index = &local_free_index[ds >> 3];
+    WORD heap = ((INSTANCEDATA *)baseptr)->heap;
+
+    if (index->heap != heap)
+    {
+        memset( index, 0, sizeof(*index) );
+        index->heap = heap;
+        index->max_free = 0xffff;
+    }
+    return index;
+}
+
+
+/***********************************************************************
+ *           LOCAL_ResetFreeIndex
+ *
+ * Forget everything known about the free blocks of the heap in 'ds'.
+ */
+static void LOCAL_ResetFreeIndex( HANDLE16 ds )
+{
+    local_free_index[ds >> 3].heap = 0;
+}
+
+
+/***********************************************************************
+ *           LOCAL_NoteFreeBlock
+ *
+ * Record a block that has just become free or grown in the free index.
+ */
+static void LOCAL_NoteFreeBlock( HANDLE16 ds, char *baseptr, WORD block )
+{
+    LOCALFREEINDEX *index = LOCAL_GetFreeIndex( ds, baseptr );
+    WORD size = ARENA_PTR( baseptr, block )->size;
+
+    if (size > index->max_free) index->max_free = size;
+    index->hint[LOCAL_SizeClass( size )] = block;
+}
+
+
 /***********************************************************************
  *           LOCAL_MakeBlockFree
  *
@@ -514,6 +590,7 @@ BOOL16 WINAPI LocalInit16( HANDLE16 selector, WORD start, WORD end )
       /* Store the local heap address in the instance data */
 
     ((INSTANCEDATA *)ptr)->heap = heapInfoArena + ARENA_HEADER_SIZE;
+    LOCAL_ResetFreeIndex( selector );
     LOCAL_PrintHeap( selector );
     ret = TRUE;
 
@@ -581,6 +658,7 @@ static BOOL16 LOCAL_GrowHeap( HANDLE16 ds )
         pHeapInfo->items--;
     }
 
+    LOCAL_ResetFreeIndex( ds );
     TRACE("Heap expanded\n" );
     LOCAL_PrintHeap( ds );
     return TRUE;
@@ -632,6 +710,7 @@ static HLOCAL16 LOCAL_FreeArena( WORD ds, WORD arena )
         LOCAL_RemoveBlock( ptr, pArena->next );
         pInfo->items--;
     }
+    LOCAL_NoteFreeBlock( ds, ptr, arena );
     return 0;
 }
 
@@ -877,7 +956,9 @@ static HLOCAL16 LOCAL_FindFreeBlock( HANDLE16 ds, WORD size )
     char *ptr = MapSL( MAKESEGPTR( ds, 0 ) );
     LOCALHEAPINFO *pInfo;
     LOCALARENA *pArena;
-    WORD arena;
+    LOCALFREEINDEX *index;
+    WORD arena, largest = 0;
+    int class;
 
     if (!(pInfo = LOCAL_GetHeap( ds )))
     {
@@ -886,14 +967,46 @@ static HLOCAL16 LOCAL_FindFreeBlock( HANDLE16 ds, WORD size )
 	return 0;
     }
 
+    index = LOCAL_GetFreeIndex( ds, ptr );
+    if (size > index->max_free)
+    {
+        TRACE("not enough space (largest free block %04x)\n", index->max_free );
+        return 0;
+    }
+
+      /* Try the smallest size class that may hold the block, then larger ones */
+
+    for (class = LOCAL_SizeClass( size ); class < LOCAL_NB_CLASSES; class++)
+    {
+        arena = index->hint[class];
+        if (!arena) continue;
+        pArena = ARENA_PTR( ptr, arena );
+        if (arena > pInfo->first && arena < pInfo->last && !(arena & 3) &&
+            (pArena->prev & 3) == LOCAL_ARENA_FREE &&
+            pArena->next > arena && pArena->next <= pInfo->last &&
+            ARENA_PREV( ptr, pArena->next ) == arena &&
+            pArena->free_prev >= pInfo->first && pArena->free_prev < arena &&
+            ARENA_PTR( ptr, pArena->free_prev )->free_next == arena)
+        {
+            if (pArena->size >= size) return arena;
+        }
+        else index->hint[class] = 0;  /* no longer free */
+    }
+
+      /* Walk the free list, refilling the empty size classes on the way */
+
     arena = pInfo->first;
     pArena = ARENA_PTR( ptr, arena );
     for (;;) {
         arena = pArena->free_next;
         pArena = ARENA_PTR( ptr, arena );
 	if (arena == pArena->free_next) break;
+        class = LOCAL_SizeClass( pArena->size );
+        if (!index->hint[class]) index->hint[class] = arena;
         if (pArena->size >= size) return arena;
+        if (pArena->size > largest) largest = pArena->size;
     }
+    index->max_free = largest;
     TRACE("not enough space\n" );
     LOCAL_PrintHeap(ds);
     return 0;
@@ -1407,9 +1520,11 @@ HLOCAL16 WINAPI LocalReAlloc16( HLOCAL16 handle, WORD size, UINT16 flags )
         if (!buffer) return 0;
         memcpy( buffer, ptr + arena + ARENA_HEADER_SIZE, oldsize );
         LOCAL_FreeArena( ds, arena );
-        if (!(hmem = LOCAL_GetBlock( ds, size, flags )))
+        /* Don't compact again: the handle still points to the freed */
+        /* block, and other blocks could be moved into its space */
+        if (!(hmem = LOCAL_GetBlock( ds, size, flags | LMEM_NOCOMPACT )))
         {
-            if (!(hmem = LOCAL_GetBlock( ds, oldsize, flags )))
+            if (!(hmem = LOCAL_GetBlock( ds, oldsize, flags | LMEM_NOCOMPACT )))
             {
                 ERR("Can't restore saved block\n" );
                 HeapFree( GetProcessHeap(), 0, buffer );
@@ -100,7 +100,8 @@ static inline void patch_code_segment( NE_MODULE *pModule )
         call[i].flatcs = wine_get_cs();
     }
 
-    if (TRACE_ON(relay))  /* patch relay functions to all point to relay_call_from_16 */
+    /* patch relay functions to all point to relay_call_from_16 */
+    if (TRACE_ON(relay) || RELAY16_StatsEnabled() || RELAY16_TraceEnabled())
         for (i = 0; call[i].pushl == 0x68; i++) call[i].relay = relay_call_from_16;
 }
 
@@ -355,6 +356,36 @@ __declspec(dllexport) void NE_DumpAllModules(void)
     }
 }
 
+/***********************************************************************
+ *           vm_debug_get_segment_name
+ *
+ * Find the module and segment number a selector belongs to (used by the
+ * vm86 profiler).
+ */
+__declspec(dllexport) BOOL vm_debug_get_segment_name(WORD sel, char *module, int size, WORD *segnum)
+{
+    HMODULE16 hModule = hFirstModule;
+    while (hModule)
+    {
+        NE_MODULE *pModule = NE_GetPtr(hModule);
+        SEGTABLEENTRY *pSeg;
+        int i;
+        if (!pModule) break;
+        pSeg = NE_SEG_TABLE(pModule);
+        for (i = 0; i < pModule->ne_cseg; i++, pSeg++)
+        {
+            if (!pSeg->hSeg || (GlobalHandleToSel16(pSeg->hSeg) | 7) != (sel | 7))
+                continue;
+            snprintf(module, size, "%.*s", *((char *)pModule + pModule->ne_restab),
+                     (char *)pModule + pModule->ne_restab + 1);
+            *segnum = i + 1;
+            return TRUE;
+        }
+        hModule = pModule->next;
+    }
+    return FALSE;
+}
+
 /***********************************************************************
  *           NE_InitResourceHandler
  *
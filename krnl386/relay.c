@@ -303,6 +303,7 @@ static const CALLFROM16 *get_entry_point( STACK16FRAME *frame, LPSTR module, LPS
     /* p now points to lret, get the start of CALLFROM16 structure */
     return (CALLFROM16 *)(p - FIELD_OFFSET( CALLFROM16, ret ));
 }
+#ifdef _MSC_VER
 extern int call_entry_point(void *func, int nb_args, const int *args)
 {
 	//ERR("call_entry_point(%p, %d, %p)", func, nb_args, args);
@@ -331,7 +332,7 @@ extern int call_entry_point(void *func, int nb_args, const int *args)
 	//((int(WINAPI*)(void))func)();
 	return ret;
 }
-/*
+#else
 extern int call_entry_point( void *func, int nb_args, const int *args );
 __ASM_GLOBAL_FUNC( call_entry_point,
                    "pushl %ebp\n\t"
@@ -363,7 +364,7 @@ __ASM_GLOBAL_FUNC( call_entry_point,
                    __ASM_CFI(".cfi_def_cfa %esp,4\n\t")
                    __ASM_CFI(".cfi_same_value %ebp\n\t")
                    "ret" )
-				   */
+#endif
 
 
 /***********************************************************************
@@ -460,6 +461,58 @@ static int relay_call_from_16_no_debug( void *entry_point, unsigned char *args16
 }
 
 
+/***********************************************************************
+ *           relay_record_stats
+ *
+ * Find the statistics of an entry point.  The first time it is called
+ * it is looked up by name, added to them and named in the binary relay
+ * trace.
+ */
+static RELAY_STATS *relay_record_stats( SEGPTR key, STACK16FRAME *frame, const CALLFROM16 *call )
+{
+    RELAY_STATS *stats;
+
+    if (!(stats = RELAY16_GetStats( key )))
+    {
+        char module[10], func[64];
+        WORD ordinal;
+
+        get_entry_point( frame, module, func, &ordinal );
+        stats = RELAY16_AddStats( key, module, ordinal, func );
+        if (RELAY16_TraceEnabled()) RELAY16_TraceEntry( key, module, ordinal, func, call );
+    }
+    return stats;
+}
+
+
+/***********************************************************************
+ *           relay_call_from_16_record
+ *
+ * Same as relay_call_from_16_no_debug but counts the call in the relay
+ * statistics and writes it to the binary relay trace, whichever are on.
+ */
+static int relay_call_from_16_record( void *entry_point, unsigned char *args16, CONTEXT *context,
+                                      STACK16FRAME *frame )
+{
+    SEGPTR key = MAKESEGPTR( frame->module_cs, frame->callfrom_ip );
+    const CALLFROM16 *call;
+    RELAY_STATS *stats;
+    LONGLONG start;
+    int ret_val;
+
+    /* key points to lret, get the start of CALLFROM16 structure */
+    call = (const CALLFROM16 *)((BYTE *)MapSL( key ) - FIELD_OFFSET( CALLFROM16, ret ));
+    stats = relay_record_stats( key, frame, call );
+
+    if (RELAY16_TraceEnabled()) RELAY16_TraceCall( key, call, args16, frame );
+    start = RELAY16_StatsTime();
+    ret_val = relay_call_from_16_no_debug( entry_point, args16, context, call );
+    if (RELAY16_StatsEnabled()) RELAY16_AddCall( stats, start );
+    if (RELAY16_TraceEnabled()) RELAY16_TraceReturn( key, call, ret_val, context );
+    return ret_val;
+}
+
+
 __declspec(dllexport) void vm_debug_get_entry_point(char *module, char *func, WORD *ordinal)
 {
     STACK16FRAME *frame;
@@ -471,7 +524,9 @@ __declspec(dllexport) void vm_debug_get_entry_point(char *module, char *func, WO
 /***********************************************************************
  *           relay_call_from_16
  *
- * Replacement for the 16-bit relay functions when relay debugging is on.
+ * Replacement for the 16-bit relay functions when relay debugging, the
+ * relay statistics or the binary relay trace are on.  The calls relay
+ * debugging shows are counted and traced as well.
  */
 int relay_call_from_16( void *entry_point, unsigned char *args16, CONTEXT *context )
 {
@@ -481,11 +536,27 @@ int relay_call_from_16( void *entry_point, unsigned char *args16, CONTEXT *conte
     int ret_val, args32[20];
     char module[10], func[64];
     const CALLFROM16 *call;
+    BOOL record = RELAY16_StatsEnabled() || RELAY16_TraceEnabled();
+    SEGPTR key = 0;
+    RELAY_STATS *stats = NULL;
+    LONGLONG start = 0;
 
     frame = CURRENT_STACK16;
+    if (!TRACE_ON(relay) && record)
+        return relay_call_from_16_record( entry_point, args16, context, frame );
     call = get_entry_point( frame, module, func, &ordinal );
     if (!TRACE_ON(relay) || !RELAY_ShowDebugmsgRelay( module, ordinal, func ))
+    {
+        if (record) return relay_call_from_16_record( entry_point, args16, context, frame );
         return relay_call_from_16_no_debug( entry_point, args16, context, call );
+    }
+
+    if (record)
+    {
+        key = MAKESEGPTR( frame->module_cs, frame->callfrom_ip );
+        stats = relay_record_stats( key, frame, call );
+        if (RELAY16_TraceEnabled()) RELAY16_TraceCall( key, call, args16, frame );
+    }
 
     DPRINTF( "%04x:Call %s.%d: %s(",GetCurrentThreadId(), module, ordinal, func );
 
@@ -611,7 +682,10 @@ int relay_call_from_16( void *entry_point, unsigned char *args16, CONTEXT *conte
 
     SYSLEVEL_CheckNotLevel( 2 );
 
+    if (record) start = RELAY16_StatsTime();
     ret_val = call_entry_point( entry_point, nb_args, args32 );
+    if (record && RELAY16_StatsEnabled()) RELAY16_AddCall( stats, start );
+    if (record && RELAY16_TraceEnabled()) RELAY16_TraceReturn( key, call, ret_val, context );
 
     SYSLEVEL_CheckNotLevel( 2 );
 
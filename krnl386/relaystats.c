@@ -0,0 +1,248 @@
+/*
+ * Relay call statistics (RelayStats in otvdm.ini)
+ *
+ * Counts the calls from 16-bit code into each built-in entry point, with
+ * the total and maximum time spent in them and a log2 histogram of the
+ * call times.  Unlike relay tracing this is cheap enough to leave on for
+ * a whole session.  Times include everything the entry point does, so
+ * they also cover the 16-bit callbacks and nested calls made from it.
+ *
+ * Entries are looked up without locking; they are only added, under
+ * relay_stats_section, and an entry is visible once its key is set.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "windef.h"
+#include "winbase.h"
+#include "wine/winbase16.h"
+#include "winternl.h"
+#include "kernel16_private.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(relay);
+
+DWORD WINAPI krnl386_get_config_string(LPCSTR appname, LPCSTR keyname, LPCSTR def, LPSTR ret, DWORD size);
+DWORD WINAPI krnl386_get_config_int(LPCSTR appname, LPCSTR keyname, INT def);
+
+#define RELAY_STATS_SIZE    8192    /* hash table slots, a power of two */
+#define RELAY_STATS_BUCKETS 24      /* < 1us, < 2us, < 4us, ... < 2^22us, the rest */
+
+struct tagRELAY_STATS
+{
+    SEGPTR    key;          /* CALLFROM16 entry of the entry point, 0 if the slot is free */
+    WORD      ordinal;
+    char      module[10];
+    char      func[64];
+    LONGLONG  calls;
+    LONGLONG  total;        /* QueryPerformanceCounter ticks */
+    LONGLONG  max;
+    LONG      histogram[RELAY_STATS_BUCKETS];
+};
+
+static RELAY_STATS *relay_stats;
+static RELAY_STATS relay_stats_other = { 0, 0, "", "(table full)" };
+static int relay_stats_count;
+static LONGLONG relay_stats_frequency;
+static char relay_stats_file[MAX_PATH];
+static CRITICAL_SECTION relay_stats_section;
+
+static inline RELAY_STATS *relay_stats_slot( SEGPTR key )
+{
+    return &relay_stats[(key * 2654435761u) >> (32 - 13) & (RELAY_STATS_SIZE - 1)];
+}
+
+/***********************************************************************
+ *           RELAY16_GetStats
+ *
+ * Find the statistics of an entry point, NULL if it has not been called yet.
+ */
+RELAY_STATS *RELAY16_GetStats( SEGPTR key )
+{
+    RELAY_STATS *stats = relay_stats_slot( key );
+
+    while (stats->key != key)
+    {
+        if (!stats->key) return NULL;
+        if (++stats == relay_stats + RELAY_STATS_SIZE) stats = relay_stats;
+    }
+    return stats;
+}
+
+/***********************************************************************
+ *           RELAY16_AddStats
+ *
+ * Add an entry point to the statistics, or find it if another thread did.
+ */
+RELAY_STATS *RELAY16_AddStats( SEGPTR key, const char *module, WORD ordinal, const char *func )
+{
+    RELAY_STATS *stats;
+
+    EnterCriticalSection( &relay_stats_section );
+    stats = relay_stats_slot( key );
+    while (stats->key && stats->key != key)
+        if (++stats == relay_stats + RELAY_STATS_SIZE) stats = relay_stats;
+    if (!stats->key)
+    {
+        /* keep half of the table free so that lookups stay short and always end */
+        if (relay_stats_count >= RELAY_STATS_SIZE / 2)
+            stats = &relay_stats_other;
+        else
+        {
+            lstrcpynA( stats->module, module, sizeof(stats->module) );
+            lstrcpynA( stats->func, func, sizeof(stats->func) );
+            stats->ordinal = ordinal;
+            relay_stats_count++;
+            InterlockedExchange( (LONG *)&stats->key, key );
+        }
+    }
+    LeaveCriticalSection( &relay_stats_section );
+    return stats;
+}
+
+/***********************************************************************
+ *           RELAY16_StatsTime
+ */
+LONGLONG RELAY16_StatsTime(void)
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter( &counter );
+    return counter.QuadPart;
+}
+
+/***********************************************************************
+ *           RELAY16_AddCall
+ *
+ * Count a call to an entry point that started at RELAY16_StatsTime() 'start'.
+ */
+void RELAY16_AddCall( RELAY_STATS *stats, LONGLONG start )
+{
+    LONGLONG ticks = RELAY16_StatsTime() - start;
+    ULONGLONG us = ticks * 1000000 / relay_stats_frequency;
+    LONGLONG max;
+    int bucket = 0;
+
+    InterlockedIncrement64( &stats->calls );
+    InterlockedExchangeAdd64( &stats->total, ticks );
+    while (ticks > (max = stats->max) && InterlockedCompareExchange64( &stats->max, ticks, max ) != max)
+        ;
+    while (us && bucket < RELAY_STATS_BUCKETS - 1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+    InterlockedIncrement( &stats->histogram[bucket] );
+}
+
+static int relay_stats_compare( const void *a, const void *b )
+{
+    LONGLONG ta = (*(const RELAY_STATS **)a)->total;
+    LONGLONG tb = (*(const RELAY_STATS **)b)->total;
+    return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+static double relay_stats_us( LONGLONG ticks )
+{
+    return (double)ticks * 1000000.0 / relay_stats_frequency;
+}
+
+/***********************************************************************
+ *           RELAY16_DumpStats
+ *
+ * Write the statistics as CSV, the entry points taking the most time first.
+ */
+void RELAY16_DumpStats(void)
+{
+    RELAY_STATS **sorted;
+    FILE *file;
+    int i, j, count = 0;
+
+    if (!relay_stats) return;
+    if (!(sorted = HeapAlloc( GetProcessHeap(), 0, (RELAY_STATS_SIZE + 1) * sizeof(*sorted) ))) return;
+    EnterCriticalSection( &relay_stats_section );
+    for (i = 0; i < RELAY_STATS_SIZE; i++)
+        if (relay_stats[i].key) sorted[count++] = &relay_stats[i];
+    if (relay_stats_other.calls) sorted[count++] = &relay_stats_other;
+    qsort( sorted, count, sizeof(*sorted), relay_stats_compare );
+
+    if (!(file = fopen( relay_stats_file, "w" )))
+        ERR( "cannot write relay statistics to %s\n", relay_stats_file );
+    else
+    {
+        fprintf( file, "module,ordinal,function,calls,total_us,mean_us,max_us" );
+        for (j = 0; j < RELAY_STATS_BUCKETS - 1; j++)
+            fprintf( file, ",<%uus", 1u << j );
+        fprintf( file, ",>=%uus\n", 1u << (RELAY_STATS_BUCKETS - 2) );
+        for (i = 0; i < count; i++)
+        {
+            RELAY_STATS *stats = sorted[i];
+            if (!stats->calls) continue;
+            fprintf( file, "%s,%u,%s,%I64d,%.1f,%.2f,%.1f", stats->module, stats->ordinal, stats->func,
+                     stats->calls, relay_stats_us( stats->total ),
+                     relay_stats_us( stats->total ) / stats->calls, relay_stats_us( stats->max ) );
+            for (j = 0; j < RELAY_STATS_BUCKETS; j++)
+                fprintf( file, ",%d", stats->histogram[j] );
+            fprintf( file, "\n" );
+        }
+        fclose( file );
+    }
+    LeaveCriticalSection( &relay_stats_section );
+    HeapFree( GetProcessHeap(), 0, sorted );
+}
+
+static DWORD WINAPI relay_stats_thread( LPVOID event )
+{
+    while (WaitForSingleObject( event, INFINITE ) == WAIT_OBJECT_0)
+        RELAY16_DumpStats();
+    return 0;
+}
+
+/***********************************************************************
+ *           RELAY16_InitStats
+ *
+ * Allocate the table of entry points.  The relay trace uses it as well,
+ * to write the name of each entry point once.
+ */
+BOOL RELAY16_InitStats(void)
+{
+    LARGE_INTEGER frequency;
+
+    if (relay_stats) return TRUE;
+    if (!QueryPerformanceFrequency( &frequency )) return FALSE;
+    if (!(relay_stats = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, RELAY_STATS_SIZE * sizeof(*relay_stats) )))
+        return FALSE;
+    relay_stats_frequency = frequency.QuadPart;
+    InitializeCriticalSection( &relay_stats_section );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           RELAY16_StatsEnabled
+ *
+ * Read the configuration the first time it is called.
+ */
+BOOL RELAY16_StatsEnabled(void)
+{
+    static int enabled = -1;
+    char name[MAX_PATH];
+    HANDLE event;
+
+    if (enabled >= 0) return enabled;
+    enabled = 0;
+    if (!krnl386_get_config_int( "otvdm", "RelayStats", FALSE )) return FALSE;
+    if (!RELAY16_InitStats()) return FALSE;
+    krnl386_get_config_string( "otvdm", "RelayStatsFile", "otvdm_relay.csv", relay_stats_file, sizeof(relay_stats_file) );
+    /* the statistics can also be written while running, by setting the named event */
+    krnl386_get_config_string( "otvdm", "RelayStatsEvent", "", name, sizeof(name) );
+    if (name[0] && (event = CreateEventA( NULL, FALSE, FALSE, name )))
+        CloseHandle( CreateThread( NULL, 0, relay_stats_thread, event, 0, NULL ) );
+    atexit( RELAY16_DumpStats );
+    enabled = 1;
+    return TRUE;
+}
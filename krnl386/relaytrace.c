@@ -0,0 +1,182 @@
+/*
+ * Binary relay trace writer (RelayTrace in otvdm.ini)
+ *
+ * Writes each call from 16-bit code into a built-in entry point as fixed
+ * size records instead of formatting it as text like relay debugging does.
+ * The records go through a large stdio buffer, so tracing mostly costs a
+ * copy per call.  The buffer is flushed once RelayTraceFlush milliseconds
+ * have passed since it last was, so that a trace of a process that hangs
+ * or crashes has all but its last records.  See relaytrace.h for the
+ * format and relaytrace/main.c for the decoder.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "windef.h"
+#include "winbase.h"
+#include "wine/winbase16.h"
+#include "winternl.h"
+#include "kernel16_private.h"
+#include "relaytrace.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(relay);
+
+DWORD WINAPI krnl386_get_config_string(LPCSTR appname, LPCSTR keyname, LPCSTR def, LPSTR ret, DWORD size);
+DWORD WINAPI krnl386_get_config_int(LPCSTR appname, LPCSTR keyname, INT def);
+
+static FILE *relay_trace_file;
+static LONGLONG relay_trace_flush_interval;     /* QueryPerformanceCounter ticks */
+static LONGLONG relay_trace_flush_time;         /* when the trace was last flushed */
+
+/* index of the return sequence in call->ret, 0 for register functions */
+static unsigned int relay_trace_ret_index( const CALLFROM16 *call )
+{
+    unsigned int j;
+
+    for (j = 0; j < sizeof(call->ret)/sizeof(call->ret[0]); j++)
+        if (call->ret[j] == 0xca66 || call->ret[j] == 0xcb66) break;
+    return j;
+}
+
+static void relay_trace_write( RELAYTRACE_RECORD *rec, BYTE type, SEGPTR key )
+{
+    LARGE_INTEGER counter;
+
+    QueryPerformanceCounter( &counter );
+    rec->type = type;
+    rec->thread = GetCurrentThreadId();
+    rec->time = counter.QuadPart;
+    rec->key = key;
+    fwrite( rec, sizeof(*rec), 1, relay_trace_file );
+    /* racing threads may both flush, which does no harm */
+    if (counter.QuadPart - relay_trace_flush_time >= relay_trace_flush_interval)
+    {
+        relay_trace_flush_time = counter.QuadPart;
+        fflush( relay_trace_file );
+    }
+}
+
+/***********************************************************************
+ *           RELAY16_TraceEntry
+ *
+ * Write the name and the argument types of an entry point.
+ */
+void RELAY16_TraceEntry( SEGPTR key, const char *module, WORD ordinal, const char *func,
+                         const CALLFROM16 *call )
+{
+    RELAYTRACE_RECORD rec = { 0 };
+    unsigned int j = relay_trace_ret_index( call );
+
+    rec.u.entry.ordinal = ordinal;
+    if (call->ret[j] == 0xcb66) rec.u.entry.flags |= RELAYTRACE_CDECL;
+    if (!j) rec.u.entry.flags |= RELAYTRACE_REGISTER;
+    if (j == 1) rec.u.entry.flags |= RELAYTRACE_RET16;
+    rec.u.entry.arg_types[0] = call->arg_types[0];
+    rec.u.entry.arg_types[1] = call->arg_types[1];
+    lstrcpynA( rec.u.entry.module, module, sizeof(rec.u.entry.module) );
+    lstrcpynA( rec.u.entry.func, func, sizeof(rec.u.entry.func) );
+    relay_trace_write( &rec, RELAYTRACE_ENTRY, key );
+}
+
+/***********************************************************************
+ *           RELAY16_TraceCall
+ *
+ * Write a call with a copy of its arguments on the 16-bit stack.
+ */
+void RELAY16_TraceCall( SEGPTR key, const CALLFROM16 *call, const unsigned char *args16,
+                        const STACK16FRAME *frame )
+{
+    RELAYTRACE_RECORD rec;
+    unsigned int i, j = relay_trace_ret_index( call ), size = 0;
+
+    if (call->ret[j] == 0xcb66)  /* cdecl, add up the argument sizes */
+    {
+        for (i = 0; i < 20; i++)
+        {
+            int type = (call->arg_types[i / 10] >> (3 * (i % 10))) & 7;
+
+            if (type == ARG_NONE || type == ARG_VARARG) break;
+            size += (type == ARG_WORD || type == ARG_SWORD) ? sizeof(WORD) : sizeof(SEGPTR);
+        }
+        rec.u.call.size = size;
+        memcpy( rec.u.call.args, args16, min( size, RELAYTRACE_ARGS ) );
+    }
+    else  /* the first argument is the last one on the stack */
+    {
+        size = call->ret[j + 1];
+        rec.u.call.size = size;
+        if (size > RELAYTRACE_ARGS)
+        {
+            args16 += size - RELAYTRACE_ARGS;
+            size = RELAYTRACE_ARGS;
+        }
+        memcpy( rec.u.call.args, args16, size );
+    }
+    if (size < RELAYTRACE_ARGS)
+        memset( rec.u.call.args + size, 0, RELAYTRACE_ARGS - size );
+    memset( rec.reserved, 0, sizeof(rec.reserved) );
+    rec.u.call.cs = frame->cs;
+    rec.u.call.ip = frame->ip;
+    rec.u.call.ds = frame->ds;
+    relay_trace_write( &rec, RELAYTRACE_CALL, key );
+}
+
+/***********************************************************************
+ *           RELAY16_TraceReturn
+ */
+void RELAY16_TraceReturn( SEGPTR key, const CALLFROM16 *call, int ret_val, const CONTEXT *context )
+{
+    RELAYTRACE_RECORD rec = { 0 };
+
+    /* register functions return their results in the context */
+    rec.u.ret.value = relay_trace_ret_index( call ) ? ret_val : context->Eax;
+    relay_trace_write( &rec, RELAYTRACE_RETURN, key );
+}
+
+static void relay_trace_close(void)
+{
+    if (relay_trace_file)
+        fclose( relay_trace_file );
+    relay_trace_file = NULL;
+}
+
+/***********************************************************************
+ *           RELAY16_TraceEnabled
+ *
+ * Read the configuration and open the trace the first time it is called.
+ */
+BOOL RELAY16_TraceEnabled(void)
+{
+    static int enabled = -1;
+    char path[MAX_PATH];
+    RELAYTRACE_FILE header = { RELAYTRACE_MAGIC, RELAYTRACE_VERSION, 0 };
+    LARGE_INTEGER frequency, counter;
+
+    if (enabled >= 0) return enabled;
+    enabled = 0;
+    krnl386_get_config_string( "otvdm", "RelayTrace", "", path, sizeof(path) );
+    if (!path[0]) return FALSE;
+    /* the trace names each entry point once, using the table of the relay statistics */
+    if (!QueryPerformanceFrequency( &frequency ) || !RELAY16_InitStats()) return FALSE;
+    if (!(relay_trace_file = fopen( path, "wb" )))
+    {
+        ERR( "cannot write relay trace to %s\n", path );
+        return FALSE;
+    }
+    setvbuf( relay_trace_file, NULL, _IOFBF, 0x100000 );
+    relay_trace_flush_interval = frequency.QuadPart * krnl386_get_config_int( "otvdm", "RelayTraceFlush", 1000 ) / 1000;
+    QueryPerformanceCounter( &counter );
+    relay_trace_flush_time = counter.QuadPart;
+    header.frequency = frequency.QuadPart;
+    fwrite( &header, sizeof(header), 1, relay_trace_file );
+    atexit( relay_trace_close );
+    enabled = 1;
+    return TRUE;
+}
@@ -0,0 +1,84 @@
+/*
+ * Binary relay trace format (RelayTrace in otvdm.ini)
+ *
+ * The trace starts with a RELAYTRACE_FILE header followed by fixed-size
+ * RELAYTRACE_RECORDs.  Entry points are identified by 'key', the 16:16
+ * address of their CALLFROM16 relay code.  The first call to an entry
+ * point is preceded by a RELAYTRACE_ENTRY record with its name and the
+ * argument types convspec generated for it, so the arguments saved in the
+ * RELAYTRACE_CALL records can be decoded later (see relaytrace/main.c).
+ *
+ * Calls nest when built-in functions call back into 16-bit code, so each
+ * RELAYTRACE_RETURN belongs to the last unfinished RELAYTRACE_CALL of the
+ * same thread.  Times are in units of 'frequency' per second.  All values
+ * are little-endian.
+ */
+
+#ifndef __RELAYTRACE_H__
+#define __RELAYTRACE_H__
+
+#include <stdint.h>
+
+#define RELAYTRACE_MAGIC   "RELAYTRC"
+#define RELAYTRACE_VERSION 1
+#define RELAYTRACE_ARGS    52   /* bytes of arguments saved with each call */
+
+enum
+{
+    RELAYTRACE_ENTRY = 1,   /* name and argument types of an entry point */
+    RELAYTRACE_CALL,        /* call from 16-bit code, with its arguments */
+    RELAYTRACE_RETURN,      /* return to 16-bit code, with the return value */
+};
+
+/* RELAYTRACE_ENTRY flags */
+#define RELAYTRACE_CDECL    0x01    /* arguments are in cdecl order, else pascal */
+#define RELAYTRACE_REGISTER 0x02    /* register function, 'value' is the returned EAX */
+#define RELAYTRACE_RET16    0x04    /* returns a word in AX, else a long in DX:AX */
+
+#pragma pack(push, 1)
+typedef struct
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t frequency;
+} RELAYTRACE_FILE;
+
+typedef struct
+{
+    uint8_t  type;
+    uint8_t  reserved[3];
+    uint32_t thread;
+    uint64_t time;
+    uint32_t key;
+    union
+    {
+        struct
+        {
+            uint16_t ordinal;
+            uint8_t  flags;
+            uint8_t  reserved;
+            uint32_t arg_types[2];  /* 3 bits per argument, see enum arg_types in wine/winbase16.h */
+            char     module[10];
+            char     func[38];
+        } entry;
+        struct
+        {
+            uint16_t cs;            /* return address in 16-bit code */
+            uint16_t ip;
+            uint16_t ds;
+            uint16_t size;          /* bytes of arguments on the 16-bit stack */
+            /* the first 'size' bytes for cdecl, the last 'size' bytes for pascal,
+             * at most RELAYTRACE_ARGS of them */
+            uint8_t  args[RELAYTRACE_ARGS];
+        } call;
+        struct
+        {
+            uint32_t value;
+            uint8_t  reserved[56];
+        } ret;
+    } u;
+} RELAYTRACE_RECORD;
+#pragma pack(pop)
+
+#endif /* __RELAYTRACE_H__ */
@@ -23,6 +23,8 @@ handle16 <-> wow64 handle32
 
 WINE_DEFAULT_DEBUG_CHANNEL(thunk);
 #define HANDLE_RESERVED 32
+/* open-addressing index from handle32 to slot, twice the number of slots */
+#define HANDLE_HASH_SIZE 0x20000
 typedef struct
 {
 	HANDLE handle32;
@@ -32,6 +34,16 @@ typedef struct
     HMENU16 hMenu16;
 } HANDLE_DATA;
 HANDLE_DATA handle_hwnd[65536];
+/*
+ * handle_hash maps handle32 to its slot in handle_hwnd (0 = empty) with
+ * linear probing, so 32->16 conversions no longer scan the whole table.
+ * Slots released by K32WOWHandle16Release go to a FIFO free list and
+ * are reused as late as possible, after the never used slots.
+ */
+static WORD handle_hash[HANDLE_HASH_SIZE];
+static WORD handle_free[65536];
+static DWORD handle_free_head, handle_free_tail;
+static DWORD handle_next_unused = HANDLE_RESERVED;
 WORD get_handle16_data(HANDLE h, HANDLE_DATA handles[], HANDLE_DATA **o);
 BOOL is_reserved_handle32(HANDLE h)
 {
@@ -51,11 +63,56 @@ BOOL is_reserved_handle16(HANDLE16 h)
     }
     return FALSE;
 }
+static DWORD handle_hash_index(HANDLE h)
+{
+    /* handles are usually multiples of 4 */
+    return (((DWORD)(ULONG_PTR)h >> 2) * 0x9e3779b1) >> 15;
+}
+/* returns the hash position holding h, or the empty position where it belongs */
+static DWORD handle_hash_find(HANDLE h, HANDLE_DATA handles[])
+{
+    DWORD i = handle_hash_index(h);
+    while (handle_hash[i] && handles[handle_hash[i]].handle32 != h)
+    {
+        i = (i + 1) & (HANDLE_HASH_SIZE - 1);
+    }
+    return i;
+}
+static void handle_hash_remove(HANDLE h, HANDLE_DATA handles[])
+{
+    DWORD i = handle_hash_find(h, handles), j = i, k;
+    if (!handle_hash[i])
+        return;
+    /* shift the following entries of the probe sequence back into the hole */
+    for (;;)
+    {
+        j = (j + 1) & (HANDLE_HASH_SIZE - 1);
+        if (!handle_hash[j])
+            break;
+        k = handle_hash_index(handles[handle_hash[j]].handle32);
+        if (i <= j ? (k <= i || k > j) : (k <= i && k > j))
+        {
+            handle_hash[i] = handle_hash[j];
+            i = j;
+        }
+    }
+    handle_hash[i] = 0;
+}
+/* 0xffe1-0xffff are the small negative handles, see is_reserved_handle16 */
+#define HANDLE_SLOTS_END (0x10000 - HANDLE_RESERVED + 1)
+static WORD handle_alloc_slot(void)
+{
+    if (handle_next_unused < HANDLE_SLOTS_END)
+        return handle_next_unused++;
+    if (handle_free_head != handle_free_tail)
+        return handle_free[handle_free_head++ & 0xffff];
+    return 0;
+}
 WORD get_handle16(HANDLE h, HANDLE_DATA handles[])
 {
 	if (is_reserved_handle32(h))
 	{
-		return h;
+		return (WORD)(size_t)h;
 	}
 	HANDLE_DATA *hd;
 	int hnd16 = get_handle16_data(h, handles, &hd);
@@ -68,29 +125,46 @@ WORD get_handle16_data(HANDLE h, HANDLE_DATA handles[], HANDLE_DATA **o)
 	if (is_reserved_handle32(h))
 	{
 		*o = &handles[(size_t)h];
-		return h;
+		return (WORD)(size_t)h;
 	}
-	WORD fhandle = 0;
-	for (WORD i = HANDLE_RESERVED; i; i++)
+	DWORD pos = handle_hash_find(h, handles);
+	WORD fhandle = handle_hash[pos];
+	if (fhandle)
 	{
-		if (!handles[i].handle32 && !fhandle)
-		{
-			fhandle = i;
-		}
-		if (handles[i].handle32 == h)
-		{
-			*o = &handles[i];
-			return i;
-		}
+		*o = &handles[fhandle];
+		return fhandle;
 	}
+	fhandle = handle_alloc_slot();
 	if (!fhandle)
 	{
 		ERR("Could not allocate a handle.\n");
 	}
 	*o = &handles[fhandle];
     memset(*o, 0, sizeof(HANDLE_DATA));
+	if (fhandle)
+	{
+		(*o)->handle32 = h;
+		handle_hash[pos] = fhandle;
+	}
 	return fhandle;
 }
+/* Forget a destroyed 32-bit object so its handle16 can be reused */
+__declspec(dllexport) void K32WOWHandle16Release(HANDLE handle)
+{
+    HANDLE_DATA *handles = handle_hwnd;
+    DWORD pos;
+    WORD h16;
+    if (is_reserved_handle32(handle))
+        return;
+    pos = handle_hash_find(handle, handles);
+    h16 = handle_hash[pos];
+    if (!h16)
+        return;
+    TRACE("release handle32 0x%X handle16 0x%04X\n", handle, h16);
+    handle_hash_remove(handle, handles);
+    memset(&handles[h16], 0, sizeof(HANDLE_DATA));
+    handle_free[handle_free_tail++ & 0xffff] = h16;
+}
 BOOL get_handle32_data(WORD h, HANDLE_DATA handles[], HANDLE_DATA **o)
 {
     if (!h)
@@ -101,7 +175,7 @@ BOOL get_handle32_data(WORD h, HANDLE_DATA handles[], HANDLE_DATA **o)
     if (is_reserved_handle16(h))
 	{
 		*o = &handles[(size_t)h];
-		(*o)->handle32 = h;
+		(*o)->handle32 = (HANDLE)(size_t)h;
 		return TRUE;
 	}
 	*o = &handles[h];
@@ -111,9 +185,9 @@ HANDLE get_handle32(WORD h, HANDLE_DATA handles[])
 {
 	if (is_reserved_handle16(h))
 	{
-		return (INT16)h;
+		return (HANDLE)(size_t)(INT16)h;
 	}
-	return handles[h].handle32 ? handles[h].handle32 : h;
+	return handles[h].handle32 ? handles[h].handle32 : (HANDLE)(size_t)h;
 }
 //handle16 -> wow64 handle32
 HANDLE WINAPI K32WOWHandle32HWND(WORD handle)
@@ -0,0 +1,302 @@
+/*
+ * Decoder for the binary relay trace (RelayTrace in otvdm.ini)
+ *
+ * relaytrace [-s] [-m module] [-f function] [-t thread] trace
+ *
+ * Prints the calls in the trace like relay debugging does, decoding the
+ * arguments with the argument types convspec generated for each entry
+ * point, or with -s a summary of the calls and the time spent in each
+ * entry point, the most expensive first.  The format is described in
+ * krnl386/relaytrace.h.  Only standard C is used, so the decoder also
+ * builds on other hosts.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "../krnl386/relaytrace.h"
+
+/* enum arg_types in wine/winbase16.h */
+enum
+{
+	ARG_NONE,
+	ARG_WORD,
+	ARG_SWORD,
+	ARG_LONG,
+	ARG_PTR,
+	ARG_STR,
+	ARG_SEGSTR,
+	ARG_VARARG
+};
+
+#define MAX_ENTRIES 0x10000     /* a power of two */
+#define MAX_THREADS 256
+#define MAX_DEPTH   256
+
+typedef struct
+{
+	uint32_t key;
+	uint16_t ordinal;
+	uint8_t flags;
+	uint32_t arg_types[2];
+	char module[sizeof(((RELAYTRACE_RECORD *)0)->u.entry.module) + 1];
+	char func[sizeof(((RELAYTRACE_RECORD *)0)->u.entry.func) + 1];
+	int shown;
+	uint64_t calls;
+	uint64_t total;             /* including the calls made from it */
+	uint64_t max;
+} entry;
+
+typedef struct
+{
+	uint32_t id;
+	int depth;
+	entry *calls[MAX_DEPTH];
+	uint64_t start[MAX_DEPTH];
+} thread;
+
+static entry entries[MAX_ENTRIES];
+static thread threads[MAX_THREADS];
+static int thread_count;
+static uint64_t frequency;
+static uint64_t first_time;
+
+static int match(const char *a, const char *b)
+{
+	while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b))
+	{
+		a++;
+		b++;
+	}
+	return !*a && !*b;
+}
+
+static entry *find_entry(uint32_t key)
+{
+	uint32_t i = (key * 2654435761u) & (MAX_ENTRIES - 1);
+	while (entries[i].key && entries[i].key != key)
+		i = (i + 1) & (MAX_ENTRIES - 1);
+	return &entries[i];
+}
+
+static thread *find_thread(uint32_t id)
+{
+	int i;
+	for (i = 0; i < thread_count; i++)
+		if (threads[i].id == id)
+			return &threads[i];
+	if (thread_count == MAX_THREADS)
+		return NULL;
+	threads[thread_count].id = id;
+	return &threads[thread_count++];
+}
+
+static double microseconds(uint64_t time)
+{
+	return (double)time * 1000000.0 / frequency;
+}
+
+static void print_args(const entry *e, const RELAYTRACE_RECORD *rec)
+{
+	int is_cdecl = e->flags & RELAYTRACE_CDECL;
+	int avail = rec->u.call.size < RELAYTRACE_ARGS ? rec->u.call.size : RELAYTRACE_ARGS;
+	/* pascal arguments are saved from the end of the block, the first argument last */
+	int pos = is_cdecl ? 0 : avail;
+	int i;
+
+	for (i = 0; i < 20; i++)
+	{
+		int type = (e->arg_types[i / 10] >> (3 * (i % 10))) & 7;
+		int size = (type == ARG_WORD || type == ARG_SWORD) ? 2 : 4;
+		const uint8_t *p;
+		uint32_t value;
+
+		if (type == ARG_NONE)
+			break;
+		if (i)
+			printf(",");
+		if (type == ARG_VARARG)
+		{
+			printf("...");
+			break;
+		}
+		if (is_cdecl ? pos + size > avail : pos < size)
+		{
+			printf("?");
+			break;
+		}
+		if (!is_cdecl)
+			pos -= size;
+		p = rec->u.call.args + pos;
+		if (is_cdecl)
+			pos += size;
+		value = p[0] | p[1] << 8;
+		if (size == 4)
+			value |= p[2] << 16 | (uint32_t)p[3] << 24;
+		switch (type)
+		{
+		case ARG_WORD:
+		case ARG_SWORD:
+			printf("%04x", value);
+			break;
+		case ARG_LONG:
+			printf("%08x", value);
+			break;
+		default:    /* pointers are passed as 16:16 */
+			printf("%04x:%04x", value >> 16, value & 0xffff);
+			break;
+		}
+	}
+}
+
+static int compare_total(const void *a, const void *b)
+{
+	const entry *ea = *(const entry **)a, *eb = *(const entry **)b;
+	return ea->total < eb->total ? 1 : ea->total > eb->total ? -1 : 0;
+}
+
+static void print_summary(void)
+{
+	entry **sorted = malloc(MAX_ENTRIES * sizeof(*sorted));
+	int i, count = 0;
+
+	if (!sorted)
+		return;
+	for (i = 0; i < MAX_ENTRIES; i++)
+		if (entries[i].key && entries[i].shown && entries[i].calls)
+			sorted[count++] = &entries[i];
+	qsort(sorted, count, sizeof(*sorted), compare_total);
+	printf("%12s %14s %12s %12s  %s\n", "calls", "total(us)", "mean(us)", "max(us)", "function");
+	for (i = 0; i < count; i++)
+	{
+		entry *e = sorted[i];
+		printf("%12llu %14.1f %12.2f %12.1f  %s.%d: %s\n", (unsigned long long)e->calls,
+			microseconds(e->total), microseconds(e->total) / e->calls, microseconds(e->max),
+			e->module, e->ordinal, e->func);
+	}
+	free(sorted);
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: relaytrace [-s] [-m module] [-f function] [-t thread] trace\n"
+		"  -s  print the calls and the time spent in each function instead of the calls\n"
+		"  -m  only functions of this module\n"
+		"  -f  only functions of this name\n"
+		"  -t  only calls made by this thread (hexadecimal id)\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *module = NULL, *func = NULL, *path = NULL;
+	int summary = 0, i;
+	uint32_t only_thread = 0;
+	RELAYTRACE_FILE header;
+	RELAYTRACE_RECORD rec;
+	FILE *fp;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-s"))
+			summary = 1;
+		else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+			module = argv[++i];
+		else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+			func = argv[++i];
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+			only_thread = strtoul(argv[++i], NULL, 16);
+		else if (argv[i][0] == '-' || path)
+			usage();
+		else
+			path = argv[i];
+	}
+	if (!path)
+		usage();
+	if (!(fp = fopen(path, "rb")))
+	{
+		fprintf(stderr, "relaytrace: cannot open %s\n", path);
+		return 1;
+	}
+	if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, RELAYTRACE_MAGIC, sizeof(header.magic)) ||
+		header.version != RELAYTRACE_VERSION || !header.frequency)
+	{
+		fprintf(stderr, "relaytrace: %s is not a relay trace\n", path);
+		return 1;
+	}
+	frequency = header.frequency;
+	if (fread(&rec, sizeof(rec), 1, fp) == 1)
+	{
+		/* times are printed from the first record */
+		first_time = rec.time;
+		fseek(fp, sizeof(header), SEEK_SET);
+	}
+
+	while (fread(&rec, sizeof(rec), 1, fp) == 1)
+	{
+		entry *e = find_entry(rec.key);
+		thread *t;
+
+		if (rec.type == RELAYTRACE_ENTRY)
+		{
+			e->key = rec.key;
+			e->ordinal = rec.u.entry.ordinal;
+			e->flags = rec.u.entry.flags;
+			e->arg_types[0] = rec.u.entry.arg_types[0];
+			e->arg_types[1] = rec.u.entry.arg_types[1];
+			memcpy(e->module, rec.u.entry.module, sizeof(rec.u.entry.module));
+			memcpy(e->func, rec.u.entry.func, sizeof(rec.u.entry.func));
+			e->shown = (!module || match(module, e->module)) && (!func || match(func, e->func));
+			continue;
+		}
+		if (!e->key || !(t = find_thread(rec.thread)))
+			continue;
+		if (rec.type == RELAYTRACE_CALL)
+		{
+			if (t->depth < MAX_DEPTH)
+			{
+				t->calls[t->depth] = e;
+				t->start[t->depth] = rec.time;
+			}
+			t->depth++;
+			if (!summary && e->shown && (!only_thread || rec.thread == only_thread))
+			{
+				printf("%14.3f %04x:Call %s.%d: %s(", microseconds(rec.time - first_time), rec.thread, e->module, e->ordinal, e->func);
+				print_args(e, &rec);
+				printf(") ret=%04x:%04x ds=%04x\n", rec.u.call.cs, rec.u.call.ip, rec.u.call.ds);
+			}
+		}
+		else if (rec.type == RELAYTRACE_RETURN && t->depth > 0)
+		{
+			uint64_t time = 0;
+
+			/* the return belongs to the last call still running on the thread */
+			if (--t->depth < MAX_DEPTH && t->calls[t->depth] == e)
+			{
+				time = rec.time - t->start[t->depth];
+				if (!only_thread || rec.thread == only_thread)
+				{
+					e->calls++;
+					e->total += time;
+					if (time > e->max)
+						e->max = time;
+				}
+			}
+			if (!summary && e->shown && (!only_thread || rec.thread == only_thread))
+			{
+				printf("%14.3f %04x:Ret  %s.%d: %s() ", microseconds(rec.time - first_time), rec.thread, e->module, e->ordinal, e->func);
+				if (e->flags & RELAYTRACE_REGISTER)
+					printf("retval=none AX=%04x", rec.u.ret.value & 0xffff);
+				else if (e->flags & RELAYTRACE_RET16)
+					printf("retval=%04x", rec.u.ret.value & 0xffff);
+				else
+					printf("retval=%08x", rec.u.ret.value);
+				printf(" time=%.1fus\n", microseconds(time));
+			}
+		}
+	}
+	fclose(fp);
+	if (summary)
+		print_summary();
+	return 0;
+}
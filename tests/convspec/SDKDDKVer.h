@@ -0,0 +1 @@
+/* targetver.h includes it; convspec uses none of it */
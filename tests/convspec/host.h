@@ -0,0 +1,33 @@
+/*
+	Host environment for building convspec on Linux
+
+	The Makefile includes this before every convspec source.  It stands in
+	for config.h, wine/port.h and the MSVC runtime; tchar.h and
+	SDKDDKVer.h here stand in for the headers stdafx.h includes.  The
+	getopt declarations of unistd.h are left out, as convspec.c has its
+	own.
+*/
+
+#ifndef CONVSPEC_HOST_H
+#define CONVSPEC_HOST_H
+
+#define __WINE_CONFIG_H
+#define __WINE_WINE_PORT_H
+#define _GETOPT_CORE_H
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define PACKAGE_VERSION "otvdm"
+#define EXEEXT ""
+#define O_BINARY 0
+#define _P_WAIT 0
+
+/* convspec only runs the assembler and linker for modes the tests do not use */
+static inline int _spawnvp(int mode, const char *name, const char *const *argv)
+{
+	return -1;
+}
+
+#endif
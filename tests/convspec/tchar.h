@@ -0,0 +1 @@
+/* stdafx.h includes it; convspec uses none of it */
@@ -0,0 +1,38 @@
+/*
+	The block cache against single-stepping
+
+	Every kernel is run once an instruction at a time through CPU_EXECUTE
+	and once through i386_block_execute, in each mode it supports; the
+	instructions run, the registers, the flags and the memory must end up
+	the same.
+*/
+
+static void test_block()
+{
+	for (const KERNEL *k = kernels; k < kernels + ARRAY_LENGTH(kernels); k++)
+	{
+		UINT32 size;
+		UINT8 *code = load_kernel(k->name, &size);
+
+		FOR_EACH_MODE(k, mode)
+		{
+			UINT64 insns[2];
+			UINT32 hash[2], eip[2], flags[2];
+
+			for (int blocks = 0; blocks < 2; blocks++)
+			{
+				cpu_setup(mode, code, size);
+				insns[blocks] = cpu_run(blocks != 0);
+				hash[blocks] = cpu_hash();
+				eip[blocks] = m_eip;
+				flags[blocks] = get_flags();
+			}
+			if (!insns[0] || !insns[1])
+				fail("%s %s: did not finish (step %llu, block %llu instructions)\n", k->name, mode_name[mode], insns[0], insns[1]);
+			else if (insns[0] != insns[1] || hash[0] != hash[1] || eip[0] != eip[1] || flags[0] != flags[1])
+				fail("%s %s: step %llu insns eip %08x flags %08x hash %08x, block %llu insns eip %08x flags %08x hash %08x\n",
+					k->name, mode_name[mode], insns[0], eip[0], flags[0], hash[0], insns[1], eip[1], flags[1], hash[1]);
+		}
+		free(code);
+	}
+}
@@ -0,0 +1,309 @@
+/*
+	The vm86 CPU core built for the tests, and helpers to run code on it
+
+	Code is loaded at CODE_BASE and run in one of four modes:
+	  MODE_REAL   real mode, CS=1000 DS=2000 ES=3000 SS=4000
+	  MODE_V86    the same segments in virtual-8086 mode, CPL 3, IOPL 3
+	  MODE_PM16   16-bit protected mode, with descriptors for the same
+	              bases (CS=08 DS=10 ES=18 SS=20)
+	  MODE_PM32   32-bit protected mode, flat CS=28 DS=ES=SS=30, code at
+	              linear CODE_BASE and data at absolute addresses
+	so 16-bit code that does not load segment registers gives the same
+	results in the first three.  Code ends with hlt.
+
+	Every exception vector points at a hlt of its own at HANDLER_BASE +
+	vector, through the IVT in real mode and 32-bit interrupt gates to
+	SEL_CODE32 otherwise (on the TSS stack from virtual-8086 mode, where
+	the final hlt itself raises #GP).  cpu_vector() tells which one was
+	taken and cpu_frame() reads what it pushed.
+*/
+
+#ifndef CORE_H
+#define CORE_H
+
+#include "host.h"
+#include "vm86cpu.cpp"
+
+#define GDT_BASE    0x01000
+#define IDT_BASE    0x01800
+#define TSS_BASE    0x02000
+#define RING0_STACK 0x08000     // top of the stack exceptions from V86 mode switch to
+#define HANDLER_BASE 0x08000
+#define CODE_BASE   0x10000
+#define DATA_BASE   0x20000
+#define EXTRA_BASE  0x30000
+#define STACK_BASE  0x40000
+#define STATE_END   0x50000     // the memory hashed by cpu_hash
+
+#define SEL_CODE16  0x08
+#define SEL_DATA16  0x10
+#define SEL_EXTRA16 0x18
+#define SEL_STACK16 0x20
+#define SEL_CODE32  0x28
+#define SEL_DATA32  0x30
+#define SEL_ALIAS16 0x38        // writable data alias of SEL_CODE16
+
+enum { MODE_REAL, MODE_V86, MODE_PM16, MODE_PM32 };
+
+static const char *const mode_name[] = { "real", "v86", "pm16", "pm32" };
+
+UINT get_segment_descriptor_wine(int sreg) { return 0; }
+void load_segment_descriptor_wine(int sreg) {}
+void msdos_syscall(unsigned num) {}
+int pic_ack() { return 0; }
+UINT8 read_io_byte(offs_t addr) { return 0xff; }
+UINT16 read_io_word(offs_t addr) { return 0xffff; }
+UINT32 read_io_dword(offs_t addr) { return 0xffffffff; }
+void write_io_byte(offs_t addr, UINT8 data) {}
+void write_io_word(offs_t addr, UINT16 data) {}
+void write_io_dword(offs_t addr, UINT32 data) {}
+
+static void set_descriptor(UINT16 sel, UINT32 base, UINT32 limit, UINT8 access, UINT8 flags)
+{
+	UINT8 *d = mem + GDT_BASE + (sel & ~7);
+
+	if (limit > 0xfffff)
+	{
+		limit >>= 12;
+		flags |= 0x08;  // G
+	}
+	d[0] = limit;
+	d[1] = limit >> 8;
+	d[2] = base;
+	d[3] = base >> 8;
+	d[4] = base >> 16;
+	d[5] = access;
+	d[6] = ((limit >> 16) & 0x0f) | (flags << 4);
+	d[7] = base >> 24;
+}
+
+static void load_segment(int sreg, UINT16 selector)
+{
+	m_sreg[sreg].selector = selector;
+	i386_load_segment_descriptor(sreg);
+}
+
+/* Reset the CPU, clear the memory and load 'size' bytes of code in 'mode' */
+static void cpu_setup(int mode, const void *code, UINT32 size)
+{
+	if (!mem)
+	{
+		mem = (UINT8 *)calloc(MAX_MEM + 16, 1);
+		CPU_INIT_CALL(CPU_MODEL);
+		build_x87_opcode_table();
+		build_opcode_table(OP_I386 | OP_FPU | OP_I486 | OP_PENTIUM | OP_MMX);
+	}
+	else
+	{
+		// the tests keep to the first megabyte
+		memset(mem, 0, 0x100000);
+	}
+	CPU_RESET_CALL(CPU_MODEL);
+	m_a20_mask = ~0;
+	m_performed_intersegment_jump = 1;
+	memcpy(mem + CODE_BASE, code, size);
+	i386_block_flush();
+
+	set_descriptor(SEL_CODE16, CODE_BASE, 0xffff, 0x9a, 0);
+	set_descriptor(SEL_DATA16, DATA_BASE, 0xffff, 0x92, 0);
+	set_descriptor(SEL_EXTRA16, EXTRA_BASE, 0xffff, 0x92, 0);
+	set_descriptor(SEL_STACK16, STACK_BASE, 0xffff, 0x92, 0);
+	set_descriptor(SEL_CODE32, 0, 0xffffffff, 0x9a, 0x04);
+	set_descriptor(SEL_DATA32, 0, 0xffffffff, 0x92, 0x04);
+	set_descriptor(SEL_ALIAS16, CODE_BASE, 0xffff, 0x92, 0);
+	m_gdtr.base = GDT_BASE;
+	m_gdtr.limit = 0xff;
+	for (int v = 0; v < 256; v++)
+	{
+		UINT8 *gate = mem + IDT_BASE + v * 8;
+		UINT32 handler = HANDLER_BASE + v;
+
+		mem[handler] = 0xf4;    // hlt
+		if (mode == MODE_REAL)
+		{
+			mem[v * 4] = v;
+			mem[v * 4 + 3] = HANDLER_BASE >> 12;
+			continue;
+		}
+		gate[0] = handler;
+		gate[1] = handler >> 8;
+		gate[2] = SEL_CODE32;
+		gate[5] = 0x8e;         // present, DPL 0, 32-bit interrupt gate
+		gate[6] = handler >> 16;
+		gate[7] = handler >> 24;
+	}
+	m_idtr.base = mode == MODE_REAL ? 0 : IDT_BASE;
+	m_idtr.limit = mode == MODE_REAL ? 0x3ff : 0x7ff;
+	// 386 TSS with SS0:ESP0 only
+	*(UINT32 *)(mem + TSS_BASE + 4) = RING0_STACK;
+	*(UINT32 *)(mem + TSS_BASE + 8) = SEL_DATA32;
+	m_task.base = TSS_BASE;
+	m_task.limit = 0x67;
+	m_task.flags = 0x89;
+
+	switch (mode)
+	{
+	case MODE_REAL:
+	case MODE_V86:
+		if (mode == MODE_V86)
+		{
+			m_cr[0] |= 1;
+			set_flags(get_flags() | 0x23000);   // VM, IOPL 3
+			m_CPL = 3;
+		}
+		load_segment(CS, CODE_BASE >> 4);
+		load_segment(DS, DATA_BASE >> 4);
+		load_segment(ES, EXTRA_BASE >> 4);
+		load_segment(SS, STACK_BASE >> 4);
+		REG32(ESP) = 0xfffe;
+		m_eip = 0;
+		break;
+	case MODE_PM16:
+		m_cr[0] |= 1;
+		m_CPL = 0;
+		load_segment(CS, SEL_CODE16);
+		load_segment(DS, SEL_DATA16);
+		load_segment(ES, SEL_EXTRA16);
+		load_segment(SS, SEL_STACK16);
+		REG32(ESP) = 0xfffe;
+		m_eip = 0;
+		break;
+	case MODE_PM32:
+		m_cr[0] |= 1;
+		m_CPL = 0;
+		load_segment(CS, SEL_CODE32);
+		load_segment(DS, SEL_DATA32);
+		load_segment(ES, SEL_DATA32);
+		load_segment(SS, SEL_DATA32);
+		REG32(ESP) = STATE_END;
+		m_eip = CODE_BASE;
+		break;
+	}
+	CHANGE_PC(m_eip);
+}
+
+/*
+	Run until a hlt, one instruction at a time like vm86main with the
+	disassembler on, or through the block cache.  Returns the
+	instructions run, 0 if the code did not halt.
+*/
+static UINT64 cpu_run(bool blocks, UINT64 limit = 1000000000)
+{
+	UINT64 start = m_insn_count;
+
+	m_count_insns = true;
+	CHANGE_PC(m_eip);
+	while (!m_halted)
+	{
+		if (m_insn_count - start > limit)
+			return 0;
+		if (blocks)
+		{
+			i386_block_execute();
+		}
+		else
+		{
+			m_cycles = 1;
+			CPU_EXECUTE_CALL(i386);
+		}
+	}
+	return m_insn_count - start;
+}
+
+/* The exception vector whose handler halted the CPU, -1 for the hlt of the code */
+static int cpu_vector()
+{
+	if (m_pc <= HANDLER_BASE || m_pc > HANDLER_BASE + 256)
+		return -1;
+	return m_pc - HANDLER_BASE - 1;
+}
+
+/* The n-th dword (word in real mode) of the exception frame, 0 is the top */
+static UINT32 cpu_frame(int n)
+{
+	UINT32 sp = m_sreg[SS].d ? REG32(ESP) : REG16(SP);
+
+	if (!PROTECTED_MODE)
+		return read_word(m_sreg[SS].base + ((sp + n * 2) & 0xffff));
+	return read_dword(m_sreg[SS].base + sp + n * 4);
+}
+
+/* xorshift32, for tests that generate their cases */
+static UINT32 random32(UINT32 *seed)
+{
+	UINT32 x = *seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *seed = x;
+}
+
+static UINT32 fnv(UINT32 hash, const void *data, size_t size)
+{
+	const UINT8 *p = (const UINT8 *)data;
+	while (size--)
+		hash = (hash ^ *p++) * 16777619u;
+	return hash;
+}
+
+/* Hash of the general registers, the status flags and the data, extra and stack memory */
+static UINT32 cpu_hash()
+{
+	UINT32 hash = 2166136261u;
+	UINT32 flags = get_flags() & 0xcd5;
+
+	for (int i = 0; i < 8; i++)
+		hash = fnv(hash, &REG32(i), 4);
+	hash = fnv(hash, &flags, 4);
+	return fnv(hash, mem + DATA_BASE, STATE_END - DATA_BASE);
+}
+
+/* Read a kernel assembled by the Makefile into kernels/<name>.bin */
+static UINT8 *load_kernel(const char *name, UINT32 *size)
+{
+	char path[256];
+	FILE *fp;
+	UINT8 *code;
+	long len;
+
+	snprintf(path, sizeof(path), "%s/%s.bin", KERNEL_DIR, name);
+	if (!(fp = fopen(path, "rb")))
+	{
+		fprintf(stderr, "cannot open %s\n", path);
+		exit(1);
+	}
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	code = (UINT8 *)malloc(len);
+	if (fread(code, 1, len, fp) != (size_t)len)
+		len = 0;
+	fclose(fp);
+	*size = len;
+	return code;
+}
+
+/* The kernels in kernels/, 16-bit ones run in every 16-bit mode */
+struct KERNEL {
+	const char *name;
+	int bits;
+};
+
+static const KERNEL kernels[] = {
+	{ "alu16", 16 },
+	{ "str16", 16 },
+	{ "fpu16", 16 },
+	{ "mmx16", 16 },
+	{ "prefix16", 16 },
+	{ "branch16", 16 },
+	{ "smc16", 16 },
+	{ "far16", 16 },
+	{ "alu32", 32 },
+	{ "str32", 32 },
+	{ "int32", 32 },
+};
+
+#define FOR_EACH_MODE(k, mode) \
+	for (int mode = (k)->bits == 32 ? MODE_PM32 : MODE_REAL; mode <= ((k)->bits == 32 ? MODE_PM32 : MODE_PM16); mode++)
+
+#endif
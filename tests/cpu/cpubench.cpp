@@ -0,0 +1,155 @@
+/*
+	Throughput and conformance of the vm86 CPU core on the kernels
+
+	cpubench [-g] [-r runs] [kernel...]
+
+	Runs the named kernels, or all of them, in each mode they support,
+	stepping and through the block cache, the best of 'runs' times (3 by
+	default), and prints the instructions run and the instructions per
+	second of each.  The instructions run and the hashes of the registers
+	and of the memory must match the golden values below with both, so a
+	change that makes the core faster must also leave it computing the
+	same.  -g prints the table for the kernels run, for when a kernel is
+	added or changed on purpose.  Exits with the number of mismatches.
+
+	Kernels doing x87 arithmetic run a second time with m_x87_fast set,
+	the FastFPU option, on a row of their own.  It must give the same
+	values; only the double precision part of such a kernel can be any
+	faster, as FINIT leaves the FPU in extended precision.
+*/
+
+#include "core.h"
+
+static const struct {
+	const char *name;
+	int mode;
+	UINT64 insns;
+	UINT32 regs;
+	UINT32 memory;
+} golden[] = {
+#include "golden.h"
+};
+
+/* fnv of the general registers and the status flags */
+static UINT32 bench_regs()
+{
+	UINT32 hash = 2166136261u;
+	UINT32 flags = get_flags() & 0xcd5;
+
+	for (int i = 0; i < 8; i++)
+		hash = fnv(hash, &REG32(i), 4);
+	return fnv(hash, &flags, 4);
+}
+
+/* The kernels doing x87 arithmetic, for the FastFPU row */
+static bool bench_x87(const KERNEL *k)
+{
+	return !strcmp(k->name, "fpu16");
+}
+
+static double bench_seconds()
+{
+	LARGE_INTEGER now, frequency;
+
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&frequency);
+	return (double)now.QuadPart / frequency.QuadPart;
+}
+
+int main(int argc, char **argv)
+{
+	bool print_golden = false;
+	int runs = 3, failures = 0;
+
+	freopen("/dev/null", "w", stderr);
+	for (; argc > 1 && argv[1][0] == '-'; argc--, argv++)
+	{
+		if (!strcmp(argv[1], "-g"))
+			print_golden = true;
+		else if (!strcmp(argv[1], "-r") && argc > 2 && (runs = atoi(argv[2])) > 0)
+			argc--, argv++;
+		else
+		{
+			printf("usage: cpubench [-g] [-r runs] [kernel...]\n");
+			return 2;
+		}
+	}
+	for (const KERNEL *k = kernels; k < kernels + ARRAY_LENGTH(kernels); k++)
+	{
+		bool run = argc < 2;
+		UINT32 size;
+		UINT8 *code;
+
+		for (int j = 1; j < argc; j++)
+			run |= !strcmp(argv[j], k->name);
+		if (!run)
+			continue;
+		code = load_kernel(k->name, &size);
+		FOR_EACH_MODE(k, mode)
+		for (int fast = 0; fast < (bench_x87(k) ? 2 : 1); fast++)
+		{
+			UINT64 insns[2];
+			UINT32 regs[2], memory[2];
+			double rate[2];
+			char name[32];
+			size_t g;
+
+			m_x87_fast = fast != 0;
+			for (int blocks = 0; blocks < 2; blocks++)
+			{
+				double best = 0;
+
+				for (int r = 0; r < runs; r++)
+				{
+					cpu_setup(mode, code, size);
+					double start = bench_seconds();
+					insns[blocks] = cpu_run(blocks != 0);
+					double seconds = bench_seconds() - start;
+					if (!r || seconds < best)
+						best = seconds;
+				}
+				regs[blocks] = bench_regs();
+				memory[blocks] = fnv(2166136261u, mem + DATA_BASE, STATE_END - DATA_BASE);
+				rate[blocks] = best > 0 ? insns[blocks] / best / 1e6 : 0;
+			}
+			m_x87_fast = false;
+			if (print_golden)
+			{
+				// the FastFPU row has the same values
+				if (fast)
+					continue;
+				printf("\t{ \"%s\", MODE_%s, %llu, 0x%08x, 0x%08x },\n", k->name, mode == MODE_REAL ? "REAL" :
+					mode == MODE_V86 ? "V86" : mode == MODE_PM16 ? "PM16" : "PM32", insns[1], regs[1], memory[1]);
+				continue;
+			}
+			for (g = 0; g < ARRAY_LENGTH(golden); g++)
+			{
+				if (!strcmp(golden[g].name, k->name) && golden[g].mode == mode)
+					break;
+			}
+			snprintf(name, sizeof(name), fast ? "%s fast" : "%s", k->name);
+			printf("%-10s %-5s %10llu insns  step %7.1f M/s  block %7.1f M/s", name, mode_name[mode], insns[1],
+				rate[0], rate[1]);
+			if (g == ARRAY_LENGTH(golden))
+			{
+				printf("  no golden values\n");
+				failures++;
+				continue;
+			}
+			bool ok = true;
+			for (int blocks = 0; blocks < 2; blocks++)
+			{
+				if (insns[blocks] == golden[g].insns && regs[blocks] == golden[g].regs && memory[blocks] == golden[g].memory)
+					continue;
+				printf("\n  %s: %llu insns, registers %08x, memory %08x, expected %llu, %08x, %08x",
+					blocks ? "block" : "step", insns[blocks], regs[blocks], memory[blocks], golden[g].insns, golden[g].regs,
+					golden[g].memory);
+				ok = false;
+			}
+			printf("%s\n", ok ? "" : "\nFAILED");
+			failures += !ok;
+		}
+		free(code);
+	}
+	return failures;
+}
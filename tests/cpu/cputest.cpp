@@ -0,0 +1,90 @@
+/*
+	Tests of the vm86 CPU core
+
+	cputest [-v] [test...]
+
+	Runs the named tests, or all of them, and exits with the number of
+	failures.  The core logs faults and other oddities to stderr, which
+	the tests cause on purpose; -v shows them.
+*/
+
+#include "core.h"
+
+static int failures;
+
+static void fail(const char *format, ...)
+{
+	va_list arg;
+
+	va_start(arg, format);
+	vprintf(format, arg);
+	va_end(arg);
+	failures++;
+}
+
+#include "block.cpp"
+#include "rep.cpp"
+#include "prefix.cpp"
+#include "jcc.cpp"
+#include "smc.cpp"
+#include "window.cpp"
+#include "record.cpp"
+#include "segments.cpp"
+#include "exports.cpp"
+#include "irq.cpp"
+#include "trap.cpp"
+#include "dasm.cpp"
+#include "fault.cpp"
+#include "mmx.cpp"
+#include "flags.cpp"
+#include "x87.cpp"
+#include "profile.cpp"
+#include "relay16.cpp"
+
+static const struct {
+	const char *name;
+	void (*run)();
+} tests[] = {
+	{ "block", test_block },
+	{ "rep", test_rep },
+	{ "prefix", test_prefix },
+	{ "jcc", test_jcc },
+	{ "smc", test_smc },
+	{ "window", test_window },
+	{ "record", test_record },
+	{ "segments", test_segments },
+	{ "exports", test_exports },
+	{ "irq", test_irq },
+	{ "trap", test_trap },
+	{ "dasm", test_dasm },
+	{ "fault", test_fault },
+	{ "mmx", test_mmx },
+	{ "flags", test_flags },
+	{ "x87", test_x87 },
+	{ "profile", test_profile },
+	{ "relay16", test_relay16 },
+};
+
+int main(int argc, char **argv)
+{
+	if (argc > 1 && !strcmp(argv[1], "-v"))
+	{
+		argc--;
+		argv++;
+	}
+	else
+		freopen("/dev/null", "w", stderr);
+	for (size_t i = 0; i < ARRAY_LENGTH(tests); i++)
+	{
+		int before = failures;
+		bool run = argc < 2;
+
+		for (int j = 1; j < argc; j++)
+			run |= !strcmp(argv[j], tests[i].name);
+		if (!run)
+			continue;
+		tests[i].run();
+		printf("%s: %s\n", tests[i].name, failures == before ? "ok" : "FAILED");
+	}
+	return failures;
+}
@@ -0,0 +1,124 @@
+/*
+	Trace ring buffer (vm86/vm86trace.cpp)
+
+	Every one-byte and 0f opcode, with random ModRM, SIB, displacement and
+	immediate bytes and random prefixes in front, is put in the buffer as
+	a raw record with 16 and 32-bit operand size, between text entries,
+	and the dump must print what disassembling it on the spot and
+	formatting it the way the buffer did before gives.  dasm_is_call must
+	find the calls the disassembler shows once the prefixes are taken off.
+	The ring is filled past its size, so the dump starts at the oldest
+	entry left.
+*/
+
+#include <string>
+
+#define min(a, b) ((a) < (b) ? (a) : (b))     // from the Windows headers
+#include "vm86trace.cpp"
+#undef min
+
+#define DASM_RING 509
+#define DASM_ENTRIES 16384     // the whole corpus
+
+/* Dump the buffer and compare it with the entries from 'first' on */
+static void dasm_compare(struct dasm_buffer *buffer, const std::vector<std::string> &expected, size_t first)
+{
+	char *dump, *p;
+	size_t dump_size;
+	int shown = 0;
+	FILE *fp = open_memstream(&dump, &dump_size);
+
+	buffer->dump(fp);
+	fclose(fp);
+	p = dump;
+	for (size_t i = first; i < expected.size() && shown < 10; i++)
+	{
+		size_t length = strcspn(p, "\n") + 1;
+
+		if (length != expected[i].size() || memcmp(p, expected[i].c_str(), length))
+		{
+			fail("entry %u of %u: dumped %.*s  expected %s", (unsigned)i, (unsigned)expected.size(), (int)length, p,
+				expected[i].c_str());
+			shown++;
+		}
+		p += length;
+	}
+	if (!shown && *p)
+		fail("dumped more than %u entries\n", (unsigned)(expected.size() - first));
+	free(dump);
+}
+
+/* The line the trace put in the buffer for an instruction, 0 if it is too long to keep */
+static int dasm_line(char *line, UINT16 cs, UINT32 eip, bool op32, const UINT8 *oprom)
+{
+	char buffer[256];
+	int length, n = sprintf(line, "%04x:%04x", cs, (unsigned)eip);
+
+	if (op32)
+		length = CPU_DISASSEMBLE_CALL(x86_32);
+	else
+		length = i386_dasm_one_ex(buffer, eip, oprom, 16);
+	sprintf(line + n, "\t%s\n", buffer);
+	return (length & 0xff) <= 15;
+}
+
+static void test_dasm()
+{
+	static const UINT8 prefixes[] = { 0x26, 0x2e, 0x36, 0x3e, 0x64, 0x65, 0x66, 0x67, 0xf0, 0xf2, 0xf3 };
+	struct dasm_buffer ring(DASM_RING), whole(DASM_ENTRIES);
+	std::vector<std::string> expected;
+	UINT32 seed = 0xda5b0f0f, calls = 0;
+	char line[512];
+	int shown = 0;
+
+	for (int opcode = 0; opcode < 0x200; opcode++)
+	{
+		for (int n = 0; n < 24; n++)
+		{
+			UINT8 oprom[32];
+			int prefix_count = n < 8 ? 0 : random32(&seed) % 4, size = 0;
+			UINT16 cs = random32(&seed);
+			UINT32 eip = n & 1 ? random32(&seed) : random32(&seed) & 0xffff;
+			bool op32 = (n >> 1) & 1;
+
+			for (int i = 0; i < prefix_count; i++)
+				oprom[size++] = prefixes[random32(&seed) % ARRAY_LENGTH(prefixes)];
+			if (opcode >= 0x100)
+				oprom[size++] = 0x0f;
+			oprom[size++] = opcode;
+			while (size < (int)sizeof(oprom))
+				oprom[size++] = random32(&seed);
+			if (!dasm_line(line, cs, eip, op32, oprom))
+				continue;
+
+			// the disassembler shows prefixes it does not apply apart, so ask it about what follows them
+			int skip = 0;
+			while (memchr(prefixes, oprom[skip], sizeof(prefixes)))
+				skip++;
+			char text[256];
+			dasm_line(text, cs, eip, op32, oprom + skip);
+			bool call = !memcmp(strchr(text, '\t') + 1, "call", 4);
+			if (dasm_is_call(oprom) != call && shown++ < 10)
+				fail("%sdasm_is_call is %d", line, !call);
+			calls += call;
+
+			// a text entry now and then, as vm86main and the relay write them
+			if (random32(&seed) % 4 == 0)
+			{
+				sprintf(text, "text %u\n", (unsigned)expected.size());
+				strcpy(ring.get_current(), text);
+				strcpy(whole.get_current(), text);
+				expected.push_back(text);
+			}
+			ring.add_insn(cs, eip, op32, oprom, sizeof(oprom));
+			whole.add_insn(cs, eip, op32, oprom, sizeof(oprom));
+			expected.push_back(line);
+		}
+	}
+	if (calls < 40)
+		fail("only %u calls in the corpus\n", calls);
+	if (expected.size() > DASM_ENTRIES)
+		fail("%u entries do not fit\n", (unsigned)expected.size());
+	dasm_compare(&whole, expected, 0);
+	dasm_compare(&ring, expected, expected.size() - DASM_RING);
+}
@@ -0,0 +1,68 @@
+/*
+	krnl386 exports resolved once, and WOW32Reserved in the TEB (vm86/vm86ctx.cpp)
+
+	resolve_krnl386_exports() must look every export up once, and V86
+	code calling INT 21h a thousand times, with an INT3 after each, must
+	then run under the vm86main stand-in without another lookup, with
+	getGdiTebBatch called once per run rather than per instruction, with
+	the interrupts handled by the fake handler and VIP handed to
+	vm86_send_queued_events once.  save_context must leave SS:SP in the
+	TLS slot krnl386's getWOW32Reserved reads, and dynamic_getWOW32Reserved
+	must read it back.
+*/
+
+#include "v86.h"
+
+static const UINT8 exports_code[] = {
+	0xb9, 0xe8, 0x03,       // 00 mov cx,1000
+	0x31, 0xff,             // 03 xor di,di
+	0x89, 0xc8,             // 05 mov ax,cx
+	0xcd, 0x21,             // 07 int 21h
+	0xcc,                   // 09 int3
+	0x89, 0x85, 0x00, 0x01, // 0a mov [di+100],ax
+	0x83, 0xc7, 0x02,       // 0e add di,2
+	0x81, 0xe7, 0xfe, 0x07, // 11 and di,7feh
+	0xe2, 0xee,             // 15 loop 05
+	0xf4,                   // 17 hlt
+};
+
+static void test_exports()
+{
+	UINT16 expected[0x400];
+
+	memset(&v86_calls, 0, sizeof(v86_calls));
+	resolve_krnl386_exports();
+	if (v86_calls.lookups != 4 || !krnl386_exports.getGdiTebBatch || !krnl386_exports.__wine_call_int_handler ||
+		!krnl386_exports.vm_debug_get_entry_point || !krnl386_exports.vm86_send_queued_events)
+		fail("%d lookups, not all exports resolved\n", v86_calls.lookups);
+	memset(expected, 0, sizeof(expected));
+	for (int cx = 1000, di = 0; cx; cx--, di = (di + 2) & 0x7fe)
+		expected[di / 2] = cx * 3 + 0x21;
+	for (int blocks = 0; blocks < 2; blocks++)
+	{
+		const char *how = blocks ? "block" : "step";
+
+		memset(&v86_calls, 0, sizeof(v86_calls));
+		cpu_setup(MODE_V86, exports_code, sizeof(exports_code));
+		v86_teb_info.vm86_pending = 0x100000;       // VIP
+		v86_run(blocks != 0, 100000);
+		// the hlt raises #GP in V86 mode
+		if (cpu_vector() != 13 || cpu_frame(1) != 0x17)
+			fail("%s: did not end at the hlt, vector %d at %04x\n", how, cpu_vector(), cpu_frame(1));
+		if (memcmp(mem + DATA_BASE + 0x100, expected, sizeof(expected)))
+			fail("%s: wrong results of the interrupts\n", how);
+		if (v86_calls.lookups || v86_calls.teb_info != 1)
+			fail("%s: %d lookups and %d getGdiTebBatch calls while running\n", how, v86_calls.lookups, v86_calls.teb_info);
+		if (v86_calls.ints != 1000 || v86_calls.last_int != 0x21 || v86_calls.int_cs != CODE_BASE >> 4 || v86_calls.int_ip != 7)
+			fail("%s: %d interrupts, the last int %02x at %04x:%04x\n", how, v86_calls.ints, v86_calls.last_int,
+				v86_calls.int_cs, v86_calls.int_ip);
+		if (v86_calls.events != 1 || v86_teb_info.vm86_pending)
+			fail("%s: %d calls to vm86_send_queued_events, pending %x\n", how, v86_calls.events, v86_teb_info.vm86_pending);
+
+		// SS:SP with CS:IP of the INT pushed, in TlsSlots (at 0xe10 of the TEB)
+		PVOID wow32 = (PVOID)(ULONG_PTR)((STACK_BASE >> 4) << 16 | 0xfffa);
+		PVOID *slot = (PVOID *)(v86_teb + 0xe10 + WOW32RESERVED_TLS_INDEX * sizeof(PVOID));
+		if (*slot != wow32 || dynamic_getWOW32Reserved() != wow32)
+			fail("%s: WOW32Reserved %p, read back %p, expected %p\n", how, *slot, dynamic_getWOW32Reserved(), wow32);
+	}
+}
@@ -0,0 +1,192 @@
+/*
+	Fault delivery
+
+	Each case runs a few instructions that fault, stepping and through the
+	block cache, and checks the vector taken, the error code, CR2 and the
+	return address pushed: the first byte of the instruction, prefixes
+	included, for faults and the next instruction for traps.  Both runs
+	must leave the same state.  Cases with a repair function then fix what
+	made the instruction fault, return to the pushed address and run to
+	the end, which must give the same result as running with the repair
+	made from the start; REP instructions restart with the elements left.
+*/
+
+#define PAGE_DIR     0x60000
+#define PAGE_TABLE   0x61000
+#define MISSING_PAGE 0x71000    // not present when paging is on
+
+#define NO_ERROR_CODE 0xffffffff
+#define ANY           0xffffffff
+
+struct FAULT_CASE {
+	const char *name;
+	int mode;
+	UINT8 code[16];
+	int size;
+	void (*setup)();
+	int vector;
+	UINT32 error;           // NO_ERROR_CODE if the vector pushes none
+	UINT32 eip;             // pushed return offset
+	UINT32 cr2;             // ANY unless the case pages
+	UINT32 ecx;             // ANY unless the case repeats
+	void (*repair)();
+};
+
+/* Identity map the first 4MB with 'flags' in every PTE, except MISSING_PAGE */
+static void fault_paging(UINT32 flags)
+{
+	*(UINT32 *)(mem + PAGE_DIR) = PAGE_TABLE | 7;
+	for (UINT32 i = 0; i < 1024; i++)
+		*(UINT32 *)(mem + PAGE_TABLE + i * 4) = i << 12 | flags;
+	*(UINT32 *)(mem + PAGE_TABLE + (MISSING_PAGE >> 12) * 4) = 0;
+	m_cr[3] = PAGE_DIR;
+	m_cr[0] |= 0x80000000;
+	vtlb_flush_dynamic(m_vtlb);
+}
+
+static void fault_map(UINT32 page, UINT32 flags)
+{
+	*(UINT32 *)(mem + PAGE_TABLE + (page >> 12) * 4) = page | flags;
+	vtlb_flush_dynamic(m_vtlb);
+}
+
+static void fault_limit(int sreg, UINT16 sel, UINT32 base, UINT32 limit)
+{
+	set_descriptor(sel, base, limit, 0x92, 0);
+	load_segment(sreg, sel);
+}
+
+static void setup_es_small() { fault_limit(ES, SEL_EXTRA16, EXTRA_BASE, 0x0fff); REG16(BX) = 0x1000; }
+static void repair_es() { fault_limit(ES, SEL_EXTRA16, EXTRA_BASE, 0xffff); }
+static void setup_ss_small() { fault_limit(SS, SEL_STACK16, STACK_BASE, 0x0fff); REG16(SP) = 0x0ffe; REG16(BX) = 0x1000; }
+static void repair_ss() { fault_limit(SS, SEL_STACK16, STACK_BASE, 0xffff); }
+static void setup_paging() { fault_paging(3); }
+static void repair_paging() { fault_map(MISSING_PAGE, 3); }
+static void setup_user_page() { fault_paging(7); fault_map(DATA_BASE, 3); REG16(BX) = 0x0100; }
+static void setup_rep_limit() { setup_es_small(); REG16(SI) = 0; REG16(DI) = 0x0ff8; REG16(CX) = 10; }
+static void setup_rep_lods() { setup_es_small(); REG16(SI) = 0x0ff0; REG16(CX) = 0x20; }
+static void setup_rep_paging() { fault_paging(3); REG32(ESI) = DATA_BASE; REG32(EDI) = MISSING_PAGE - 8; REG32(ECX) = 10; }
+
+static const FAULT_CASE fault_cases[] = {
+	// mov eax,es:[bx] past the limit, after two nops in the same block
+	{ "gp limit", MODE_PM16, { 0x90, 0x90, 0x26, 0x66, 0x8b, 0x07, 0xf4 }, 7, setup_es_small, 13, 0, 2, ANY, ANY, repair_es },
+	// mov ax,ss:[bx]
+	{ "ss limit", MODE_PM16, { 0x90, 0x36, 0x8b, 0x07, 0xf4 }, 5, setup_ss_small, 12, 0, 1, ANY, ANY, repair_ss },
+	// int 21h through a DPL 0 gate, #GP with the IDT entry
+	{ "gp gate v86", MODE_V86, { 0x90, 0xcd, 0x21, 0xf4 }, 4, NULL, 13, 0x21 * 8 + 2, 1, ANY, ANY, NULL },
+	// mov eax,[MISSING_PAGE+234h]
+	{ "pf read", MODE_PM32, { 0x8b, 0x05, 0x34, 0x12, 0x07, 0x00, 0xf4 }, 7, setup_paging, 14, 0, CODE_BASE, 0x71234, ANY, repair_paging },
+	// mov dword [MISSING_PAGE+234h],12345678h
+	{ "pf write", MODE_PM32, { 0x90, 0xc7, 0x05, 0x34, 0x12, 0x07, 0x00, 0x78, 0x56, 0x34, 0x12, 0xf4 }, 12, setup_paging, 14, 2,
+		CODE_BASE + 1, 0x71234, ANY, repair_paging },
+	// mov ax,[bx] from a supervisor page
+	{ "pf user", MODE_V86, { 0x8b, 0x07, 0xf4 }, 3, setup_user_page, 14, 5, 0, DATA_BASE + 0x100, ANY, NULL },
+	// rep movsw running into the limit after four elements
+	{ "rep limit", MODE_PM16, { 0x90, 0xf3, 0xa5, 0xf4 }, 4, setup_rep_limit, 13, 0, 1, ANY, 6, repair_es },
+	// es: rep lodsd, the prefixes in the other order
+	{ "rep prefixes", MODE_PM16, { 0x26, 0xf3, 0x66, 0xad, 0xf4 }, 5, setup_rep_lods, 13, 0, 0, ANY, 0x1c, repair_es },
+	// rep movsd into the missing page after two elements
+	{ "rep paging", MODE_PM32, { 0xf3, 0xa5, 0xf4 }, 3, setup_rep_paging, 14, 2, CODE_BASE, MISSING_PAGE, 8, repair_paging },
+	// div cx/ecx by 0
+	{ "divide real", MODE_REAL, { 0x90, 0x31, 0xc9, 0xf7, 0xf1, 0xf4 }, 6, NULL, 0, NO_ERROR_CODE, 3, ANY, ANY, NULL },
+	{ "divide", MODE_PM32, { 0x31, 0xc9, 0xf7, 0xf1, 0xf4 }, 5, NULL, 0, NO_ERROR_CODE, CODE_BASE + 2, ANY, ANY, NULL },
+	// traps return after the instruction
+	{ "int3", MODE_PM32, { 0x90, 0xcc, 0xf4 }, 3, NULL, 3, NO_ERROR_CODE, CODE_BASE + 2, ANY, ANY, NULL },
+	// mov al,7fh; add al,1; into
+	{ "into", MODE_PM32, { 0xb0, 0x7f, 0x04, 0x01, 0xce, 0xf4 }, 6, NULL, 4, NO_ERROR_CODE, CODE_BASE + 5, ANY, ANY, NULL },
+	{ "int 21h", MODE_PM16, { 0x90, 0xcd, 0x21, 0xf4 }, 4, NULL, 0x21, NO_ERROR_CODE, 3, ANY, ANY, NULL },
+};
+
+/* The registers and the memory the cases write, not the stack with the frames */
+static UINT32 fault_hash()
+{
+	UINT32 hash = 2166136261u;
+	UINT32 flags = get_flags() & 0xcd5;
+
+	for (int i = 0; i < 8; i++)
+		hash = fnv(hash, &REG32(i), 4);
+	hash = fnv(hash, &flags, 4);
+	hash = fnv(hash, mem + DATA_BASE, STACK_BASE - DATA_BASE);
+	return fnv(hash, mem + MISSING_PAGE - 0x1000, 0x2000);
+}
+
+static void fault_start(const FAULT_CASE *c, bool repaired)
+{
+	cpu_setup(c->mode, c->code, c->size);
+	if (c->setup)
+		c->setup();
+	if (repaired)
+		c->repair();
+	CHANGE_PC(m_eip);
+}
+
+/* Return from the exception frame of a fault at the same privilege */
+static void fault_return(bool error)
+{
+	int n = error ? 1 : 0;
+	UINT32 eip = cpu_frame(n), cs = cpu_frame(n + 1), flags = cpu_frame(n + 2);
+
+	if (!PROTECTED_MODE)
+		REG16(SP) += 6;
+	else if (m_sreg[SS].d)
+		REG32(ESP) += (n + 3) * 4;
+	else
+		REG16(SP) += (n + 3) * 4;
+	load_segment(CS, cs);
+	set_flags(flags);
+	m_eip = eip;
+	m_halted = 0;
+	CHANGE_PC(m_eip);
+}
+
+static void test_fault()
+{
+	for (const FAULT_CASE *c = fault_cases; c < fault_cases + ARRAY_LENGTH(fault_cases); c++)
+	{
+		UINT32 hash[2] = { 0, 0 };
+		UINT16 cs = c->mode == MODE_PM16 ? SEL_CODE16 : c->mode == MODE_PM32 ? SEL_CODE32 : CODE_BASE >> 4;
+		int n = c->error == NO_ERROR_CODE ? 0 : 1;
+
+		for (int blocks = 0; blocks < 2; blocks++)
+		{
+			const char *how = blocks ? "block" : "step";
+
+			fault_start(c, false);
+			if (!cpu_run(blocks != 0))
+			{
+				fail("%s %s: did not halt\n", c->name, how);
+				continue;
+			}
+			hash[blocks] = fault_hash();
+			if (cpu_vector() != c->vector)
+			{
+				fail("%s %s: vector %d, expected %d\n", c->name, how, cpu_vector(), c->vector);
+				continue;
+			}
+			if (n && cpu_frame(0) != c->error)
+				fail("%s %s: error code %04x, expected %04x\n", c->name, how, cpu_frame(0), c->error);
+			if (cpu_frame(n) != c->eip || cpu_frame(n + 1) != cs)
+				fail("%s %s: returns to %04x:%08x, expected %04x:%08x\n", c->name, how, cpu_frame(n + 1), cpu_frame(n), cs, c->eip);
+			if (c->cr2 != ANY && m_cr[2] != c->cr2)
+				fail("%s %s: cr2 %08x, expected %08x\n", c->name, how, m_cr[2], c->cr2);
+			if (c->ecx != ANY && REG32(ECX) != c->ecx)
+				fail("%s %s: ecx %08x, expected %08x\n", c->name, how, REG32(ECX), c->ecx);
+			if (!c->repair)
+				continue;
+
+			UINT32 expected;
+
+			fault_start(c, true);
+			cpu_run(blocks != 0);
+			expected = fault_hash();
+			fault_start(c, false);
+			cpu_run(blocks != 0);
+			c->repair();
+			fault_return(n != 0);
+			if (!cpu_run(blocks != 0) || cpu_vector() >= 0 || fault_hash() != expected)
+				fail("%s %s: restarted, vector %d hash %08x, expected hash %08x\n", c->name, how, cpu_vector(), fault_hash(), expected);
+		}
+		if (hash[0] != hash[1])
+			fail("%s: step hash %08x, block hash %08x\n", c->name, hash[0], hash[1]);
+	}
+}
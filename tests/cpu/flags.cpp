@@ -0,0 +1,206 @@
+/*
+	Lazy PF and AF against eager flags
+
+	The core keeps the last result byte for PF and the carry vector for AF
+	and works the flags out where they are read.  This computes them the
+	way the core did before, eagerly, and compares:
+	  - every 8-bit operand pair of the arithmetic and logic helpers, with
+	    either carry in and either AF before, and random 16/32-bit ones,
+	    read back through get_flags()
+	  - set_flags/get_flags round trips of the status flags
+	  - the instructions that read PF and AF (SETP, SETNP, JP, LAHF, DAA,
+	    DAS, AAA, AAS) run after ADD or SUB, for every AL and BL
+*/
+
+enum { FLAGS_ADC, FLAGS_SBB, FLAGS_OR, FLAGS_AND, FLAGS_XOR, FLAGS_INC, FLAGS_DEC, FLAGS_OPS };
+
+static const char *const flags_op_name[] = { "adc", "sbb", "or", "and", "xor", "inc", "dec" };
+
+static int parity(UINT32 x)
+{
+	x &= 0xff;
+	x ^= x >> 4;
+	x ^= x >> 2;
+	x ^= x >> 1;
+	return !(x & 1);
+}
+
+/* Run one helper and return the result; 'size' is 8, 16 or 32 */
+static UINT32 flags_helper(int op, int size, UINT32 dst, UINT32 src, int carry)
+{
+	switch (op)
+	{
+	case FLAGS_ADC: return size == 8 ? ADC8(dst, src, carry) : size == 16 ? ADC16(dst, src, carry) : ADC32(dst, src, carry);
+	case FLAGS_SBB: return size == 8 ? SBB8(dst, src, carry) : size == 16 ? SBB16(dst, src, carry) : SBB32(dst, src, carry);
+	case FLAGS_OR: return size == 8 ? OR8(dst, src) : size == 16 ? OR16(dst, src) : OR32(dst, src);
+	case FLAGS_AND: return size == 8 ? AND8(dst, src) : size == 16 ? AND16(dst, src) : AND32(dst, src);
+	case FLAGS_XOR: return size == 8 ? XOR8(dst, src) : size == 16 ? XOR16(dst, src) : XOR32(dst, src);
+	case FLAGS_INC: return size == 8 ? INC8(dst) : size == 16 ? INC16(dst) : INC32(dst);
+	default: return size == 8 ? DEC8(dst) : size == 16 ? DEC16(dst) : DEC32(dst);
+	}
+}
+
+static bool flags_check_helper(int op, int size, UINT32 dst, UINT32 src, int carry, int af)
+{
+	UINT32 res, expected, flags, a = src, c = carry;
+
+	set_flags(0x2 | (af ? 0x10 : 0) | (af ? 0 : 0x4));
+	res = flags_helper(op, size, dst, src, carry);
+	flags = get_flags();
+	if (op == FLAGS_INC || op == FLAGS_DEC)
+	{
+		a = 1;
+		c = 0;
+	}
+	// the logic operations leave AF alone
+	if (op == FLAGS_ADC || op == FLAGS_INC)
+		af = (((dst + a + c) ^ a ^ dst) >> 4) & 1;
+	else if (op == FLAGS_SBB || op == FLAGS_DEC)
+		af = (((dst - a - c) ^ a ^ dst) >> 4) & 1;
+	expected = (parity(res) ? 0x4 : 0) | (af ? 0x10 : 0);
+	if ((flags & 0x14) == expected)
+		return true;
+	fail("%s%d %x, %x, carry %d: pf/af %02x, expected %02x\n", flags_op_name[op], size, dst, src, carry, flags & 0x14, expected);
+	return false;
+}
+
+/* The core's DAA/DAS, AAA and AAS with the flags kept in variables */
+struct EAGER_FLAGS {
+	int cf, pf, af, zf, sf;
+};
+
+static UINT8 eager_lahf(const EAGER_FLAGS *f)
+{
+	return f->sf << 7 | f->zf << 6 | f->af << 4 | f->pf << 2 | 2 | f->cf;
+}
+
+static void eager_szp(EAGER_FLAGS *f, UINT8 value)
+{
+	f->sf = value >> 7;
+	f->zf = value == 0;
+	f->pf = parity(value);
+}
+
+static void eager_decimal_adjust(EAGER_FLAGS *f, UINT16 *ax, int direction)
+{
+	UINT8 al = *ax, tmp_al = al, tmp_cf = f->cf;
+
+	if (f->af || (al & 0xf) > 9)
+	{
+		UINT16 t = al + direction * 6;
+		al = t;
+		f->af = 1;
+		if (t & 0x100)
+			f->cf = 1;
+		if (direction > 0)
+			tmp_al = al;
+	}
+	if (tmp_cf || tmp_al > 0x99)
+	{
+		al += direction * 0x60;
+		f->cf = 1;
+	}
+	eager_szp(f, al);
+	*ax = (*ax & 0xff00) | al;
+}
+
+static void eager_ascii_adjust(EAGER_FLAGS *f, UINT16 *ax, int direction)
+{
+	if ((*ax & 0x0f) > 9 || f->af)
+	{
+		*ax += direction * 6;
+		*ax += direction * 0x100;
+		f->af = f->cf = 1;
+	}
+	else
+		f->af = f->cf = 0;
+	*ax &= 0xff0f;
+}
+
+static void flags_readers()
+{
+	// add/sub al,bl; setp cl; setnp ch; jp $+4; mov dl,1; lahf; mov dh,ah; <adjust>; hlt
+	UINT8 code[] = { 0x00, 0xd8, 0x0f, 0x9a, 0xc1, 0x0f, 0x9b, 0xc5, 0x7a, 0x02, 0xb2, 0x01, 0x9f, 0x88, 0xe6, 0x27, 0xf4 };
+	static const UINT8 adjust[] = { 0x27, 0x2f, 0x37, 0x3f };   // daa, das, aaa, aas
+	int shown = 0;
+
+	cpu_setup(MODE_REAL, code, sizeof(code));
+	for (int i = 0; i < 4; i++)
+	{
+		bool sub = adjust[i] & 0x08;
+
+		mem[CODE_BASE] = sub ? 0x28 : 0x00;
+		mem[CODE_BASE + 15] = adjust[i];
+		for (UINT32 n = 0; n < 0x10000; n++)
+		{
+			UINT8 al = n, bl = n >> 8;
+			UINT16 res = sub ? al - bl : al + bl, ax;
+			EAGER_FLAGS f;
+			UINT32 cx, dx, flags;
+
+			f.cf = (res >> 8) & 1;
+			f.af = ((res ^ al ^ bl) >> 4) & 1;
+			eager_szp(&f, res);
+			cx = (!f.pf << 8) | f.pf;
+			dx = eager_lahf(&f) << 8 | !f.pf;
+			ax = eager_lahf(&f) << 8 | (res & 0xff);
+			if (i < 2)
+				eager_decimal_adjust(&f, &ax, sub ? -1 : 1);
+			else
+				eager_ascii_adjust(&f, &ax, sub ? -1 : 1);
+
+			REG32(EAX) = al;
+			REG32(EBX) = bl;
+			REG32(ECX) = REG32(EDX) = 0;
+			set_flags(0x2);
+			m_eip = 0;
+			m_halted = 0;
+			cpu_run(false);
+			flags = get_flags() & 0xd5;
+			if (REG16(AX) == ax && REG16(CX) == cx && REG16(DX) == dx && flags == (eager_lahf(&f) & 0xd5))
+				continue;
+			fail("%02x %s %02x, %02x: ax %04x cx %04x dx %04x flags %02x, expected %04x %04x %04x %02x\n",
+				al, sub ? "sub" : "add", bl, adjust[i], REG16(AX), REG16(CX), REG16(DX), flags, ax, cx, dx, eager_lahf(&f) & 0xd5);
+			if (++shown == 10)
+				return;
+		}
+	}
+}
+
+static void test_flags()
+{
+	UINT32 seed = 0x5a17c3e1;
+	int shown = 0;
+
+	// get_flags() needs the parity table and the flags mask of the CPU
+	cpu_setup(MODE_REAL, NULL, 0);
+	for (int op = 0; op < FLAGS_OPS && shown < 10; op++)
+	{
+		for (UINT32 n = 0; n < 0x40000 && shown < 10; n++)
+			if (!flags_check_helper(op, 8, n & 0xff, (n >> 8) & 0xff, (n >> 16) & 1, (n >> 17) & 1))
+				shown++;
+		for (int size = 16; size <= 32; size += 16)
+		{
+			for (int n = 0; n < 0x40000 && shown < 10; n++)
+			{
+				UINT32 dst = random32(&seed), src = random32(&seed);
+				if (size == 16)
+				{
+					dst &= 0xffff;
+					src &= 0xffff;
+				}
+				if (!flags_check_helper(op, size, dst, src, n & 1, (n >> 1) & 1))
+					shown++;
+			}
+		}
+	}
+	for (UINT32 f = 0; f < 0x40; f++)
+	{
+		// CF, PF, AF, ZF, SF and OF
+		UINT32 flags = 0x2 | (f & 1) | (f & 2) << 1 | (f & 4) << 2 | (f & 0x18) << 3 | (f & 0x20) << 6;
+		set_flags(flags);
+		if ((get_flags() & 0x8d7) != flags)
+			fail("set_flags %03x, get_flags %03x\n", flags, get_flags() & 0x8d7);
+	}
+	flags_readers();
+}
@@ -0,0 +1,28 @@
+/* Written by cpubench -g: kernel, mode, instructions, register and memory hashes */
+	{ "alu16", MODE_REAL, 153008, 0xdfed2e53, 0xa57860f5 },
+	{ "alu16", MODE_V86, 153009, 0x0f3c25e1, 0x6bc9f935 },
+	{ "alu16", MODE_PM16, 153008, 0xdfed2e53, 0xa57860f5 },
+	{ "str16", MODE_REAL, 196748, 0x1b11234e, 0x0a753000 },
+	{ "str16", MODE_V86, 196749, 0x2177e494, 0x75a3d660 },
+	{ "str16", MODE_PM16, 196748, 0x1b11234e, 0xaeef8498 },
+	{ "fpu16", MODE_REAL, 22522, 0x98fe9863, 0x627f74da },
+	{ "fpu16", MODE_V86, 22523, 0x346a62e1, 0x627f74da },
+	{ "fpu16", MODE_PM16, 22522, 0x98fe9863, 0x627f74da },
+	{ "mmx16", MODE_REAL, 7063, 0xced0a87a, 0x3a992f8d },
+	{ "mmx16", MODE_V86, 7064, 0xb04337f4, 0x3a992f8d },
+	{ "mmx16", MODE_PM16, 7063, 0xced0a87a, 0x3a992f8d },
+	{ "prefix16", MODE_REAL, 57348, 0xfcff0776, 0x6c71463d },
+	{ "prefix16", MODE_V86, 57349, 0x21e96d30, 0x6c71463d },
+	{ "prefix16", MODE_PM16, 57348, 0xfcff0776, 0x6c71463d },
+	{ "branch16", MODE_REAL, 231665, 0x7fa1f0bf, 0x0c9dfb3c },
+	{ "branch16", MODE_V86, 231666, 0xa4b911fd, 0x0c9dfb3c },
+	{ "branch16", MODE_PM16, 231665, 0x7fa1f0bf, 0x0c9dfb3c },
+	{ "smc16", MODE_REAL, 17368, 0x48c5676a, 0x96b7b0de },
+	{ "smc16", MODE_V86, 17369, 0xb0888774, 0x96b7b0de },
+	{ "smc16", MODE_PM16, 17369, 0x48c5676a, 0x96b7b0de },
+	{ "far16", MODE_REAL, 117310, 0xc7859cc3, 0xb7a837a1 },
+	{ "far16", MODE_V86, 117311, 0xa6723cdd, 0xb7a837a1 },
+	{ "far16", MODE_PM16, 117310, 0x493122c3, 0x0371cf21 },
+	{ "alu32", MODE_PM32, 190008, 0x9288accb, 0xd8887552 },
+	{ "str32", MODE_PM32, 65572, 0x59d4ce5b, 0x492d5000 },
+	{ "int32", MODE_PM32, 100010, 0xe9afdd3a, 0x175ca8bf },
@@ -0,0 +1,82 @@
+/*
+	Host environment for building the vm86 CPU core on Linux
+
+	vm86/vm86cpu.cpp holds the MAME i386 core with its glue (memory
+	accessors, code page tracking, CPU interface macros), which msdos.cpp
+	includes after msdos.h.  This header supplies what msdos.h and the
+	Windows headers provide to it, and core.h the few functions the core
+	calls back into msdos.cpp.
+
+	Guest memory is a 16 MB buffer at 'mem' (MAX_MEM, vm86replay takes
+	more), so linear addresses are offsets into it and descriptor tables
+	can be built there.
+*/
+
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <assert.h>
+#include <time.h>
+
+typedef unsigned char UINT8;
+typedef unsigned short UINT16;
+typedef unsigned int UINT32;
+typedef unsigned long long UINT64;
+typedef signed char INT8;
+typedef signed short INT16;
+typedef signed int INT32;
+typedef signed long long INT64;
+typedef unsigned int UINT;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int BOOL;
+
+#define TRUE 1
+#define FALSE 0
+#define __declspec(x)
+
+typedef union
+{
+	struct { DWORD LowPart; INT32 HighPart; } u;
+	INT64 QuadPart;
+} LARGE_INTEGER;
+
+static inline BOOL QueryPerformanceCounter(LARGE_INTEGER *counter)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	counter->QuadPart = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	return TRUE;
+}
+
+static inline BOOL QueryPerformanceFrequency(LARGE_INTEGER *frequency)
+{
+	frequency->QuadPart = 1000000000LL;
+	return TRUE;
+}
+
+#ifndef MAX_MEM
+#define MAX_MEM 0x1000000
+#endif
+UINT8 *mem;
+
+#define HAS_I386
+#define SUPPORT_FPU
+#define fatalerror(...) { fprintf(stderr, __VA_ARGS__); exit(1); }
+
+// not used by the core outside of vm86main
+#define IRET_TOP 0
+#define IRET_SIZE 0
+
+void msdos_syscall(unsigned num);
+int pic_ack();
+
+#endif
@@ -0,0 +1,132 @@
+/*
+	IRQs queued while V86 code runs (vm86_merge_pending in vm86/vm86ctx.cpp)
+
+	The guest of v86.h runs under the vm86main stand-in while IRQ 0 is
+	queued every few instructions on the VM thread, and then from another
+	thread as fast as it goes.  Every IRQ must reach the handler once,
+	the ones queued while another is in service after its EOI, and soon
+	after it was queued; and the guest must compute what it does without
+	them.  Last, an IRQ queued while the loop of the guest is chained by
+	the block cache must end the chain after the pass it was queued in.
+*/
+
+#include "v86.h"
+
+#define IRQ_LOOPS   4
+/*
+	An IRQ every instruction would starve the guest, and the handler
+	acknowledges before its iret, so the next may nest in it: 5000 frames
+	keep within the stack.
+*/
+#define IRQ_MAX     5000
+
+struct irq_state
+{
+	UINT32 regs[9];
+	UINT8 words[0x800];
+};
+
+static void irq_save(irq_state *state)
+{
+	for (int i = 0; i < 8; i++)
+		state->regs[i] = REG32(i);
+	state->regs[8] = get_flags() & 0xcd5;
+	memcpy(state->words, mem + DATA_BASE + 0x100, sizeof(state->words));
+}
+
+static void *irq_producer(void *arg)
+{
+	for (int i = 0; i < *(int *)arg; i++)
+	{
+		v86_queue_irq(0);
+		if (i % 16 == 0)
+			sched_yield();
+	}
+	return NULL;
+}
+
+/* The loop at 05 is a single block: without an IRQ it is chained, with one it stops after a pass */
+static void test_irq_chain()
+{
+	UINT64 start;
+
+	v86_irq_setup(1);
+	i386_block_set_event(vm86_block_event);
+	vm86_block_teb = &v86_teb_info;
+	m_count_insns = true;
+	m_eip = 0x05;
+	REG16(CX) = 0x1000;
+	start = m_insn_count;
+	i386_block_execute();
+	if (m_insn_count - start != 7 * I386_BLOCK_MAX_CHAIN)
+		fail("chain: %llu instructions run, expected %d\n", m_insn_count - start, 7 * I386_BLOCK_MAX_CHAIN);
+	v86_queue_irq(0, m_insn_count);
+	start = m_insn_count;
+	i386_block_execute();
+	if (m_insn_count - start != 7)
+		fail("chain: %llu instructions run with an IRQ queued, expected 7\n", m_insn_count - start);
+	i386_block_set_event(NULL);
+	v86_events_reset();
+	v86_teb_info.vm86_pending = 0;
+}
+
+static void test_irq()
+{
+	static const int periods[] = { 1, 3, 37, 1000 };
+	irq_state expected, state;
+
+	v86_irq_setup(IRQ_LOOPS);
+	v86_run(false);
+	irq_save(&expected);
+	for (int blocks = 0; blocks < 2; blocks++)
+	{
+		const char *how = blocks ? "block" : "step";
+
+		for (size_t p = 0; p < ARRAY_LENGTH(periods); p++)
+		{
+			v86_irq_setup(IRQ_LOOPS);
+			while (!m_halted)
+			{
+				v86_run(blocks != 0, periods[p]);
+				// until the hlt faults out of V86 mode, as many as may wait for the one in service
+				if (V8086_MODE && v86_events.queued < IRQ_MAX && v86_events.queued - v86_events.delivered < 16)
+					v86_queue_irq(0, m_insn_count);
+			}
+			irq_save(&state);
+			if (cpu_vector() != 13 || cpu_frame(1) != 0x1c)
+				fail("%s, every %d: did not end at the hlt, vector %d at %04x\n", how, periods[p], cpu_vector(), cpu_frame(1));
+			if (memcmp(&state, &expected, sizeof(state)))
+				fail("%s, every %d: the IRQs changed what the guest computed\n", how, periods[p]);
+			if (*(WORD *)(mem + DATA_BASE + V86_IRQ_COUNT) != (WORD)v86_events.queued ||
+				v86_events.delivered != v86_events.queued || v86_events.acknowledged != v86_events.queued)
+				fail("%s, every %d: %llu IRQs queued, %llu delivered, %llu acknowledged, %d handled\n", how, periods[p],
+					v86_events.queued, v86_events.delivered, v86_events.acknowledged, *(WORD *)(mem + DATA_BASE + V86_IRQ_COUNT));
+			// at the next instruction or block, or after the EOI of the one in service
+			if (v86_events.max_insn_latency > 8)
+				fail("%s, every %d: an IRQ %llu instructions late\n", how, periods[p], v86_events.max_insn_latency);
+		}
+
+		// from another thread, with VIP set while the VM thread clears it
+		int count = IRQ_MAX;
+		pthread_t thread;
+		UINT64 insns = 0;
+
+		v86_irq_setup(0);
+		pthread_create(&thread, NULL, irq_producer, &count);
+		for (;;)
+		{
+			pthread_mutex_lock(&v86_events.lock);
+			bool done = v86_events.acknowledged == (UINT64)count;
+			pthread_mutex_unlock(&v86_events.lock);
+			if (done || m_halted || insns > 1000000000)
+				break;
+			insns += v86_run(blocks != 0, 10000);
+		}
+		pthread_join(thread, NULL);
+		if (*(WORD *)(mem + DATA_BASE + V86_IRQ_COUNT) != (WORD)count || v86_events.delivered != (UINT64)count ||
+			v86_events.acknowledged != (UINT64)count)
+			fail("%s, threaded: %d IRQs queued, %llu delivered, %llu acknowledged, %d handled\n", how, count,
+				v86_events.delivered, v86_events.acknowledged, *(WORD *)(mem + DATA_BASE + V86_IRQ_COUNT));
+	}
+	test_irq_chain();
+}
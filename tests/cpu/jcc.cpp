@@ -0,0 +1,192 @@
+/*
+	jcc rel8 folded into blocks, and loops chained by i386_block_execute
+
+	Each of the 16 conditions is run on all 32 combinations of OF, SF, ZF,
+	PF and CF, stepping and from a block it was recorded in; it must take
+	the branch when its handler does.  Random loops of flag-setting
+	instructions, each followed by a random jcc over an instruction that
+	counts in memory, and some by a second jcc that a taken branch starts
+	a block with, are run stepping and through the block cache in real,
+	V86 and 16-bit protected mode.  The instructions run, the registers,
+	the flags and the memory must end up the same.  Last, an interrupt
+	that turns pending in a loop that is a single block must be taken on
+	the next pass, not after I386_BLOCK_MAX_CHAIN of them.
+*/
+
+// 16-bit register, register forms: ax, cx, dx, bx and di, bp counts the passes and si points at the counters
+static const UINT8 jcc_regs[] = { 0, 1, 2, 3, 7 };
+
+static const struct {
+	UINT8 opcode;
+	UINT8 reg;          // 0xff: a register operand, otherwise the /reg of a one-operand form
+	bool imm;
+} jcc_ops[] = {
+	{ 0x01, 0xff }, { 0x09, 0xff }, { 0x11, 0xff }, { 0x19, 0xff }, // add, or, adc, sbb
+	{ 0x21, 0xff }, { 0x29, 0xff }, { 0x31, 0xff }, { 0x39, 0xff }, // and, sub, xor, cmp
+	{ 0x85, 0xff },                                                 // test
+	{ 0xf7, 3 }, { 0xff, 0 }, { 0xff, 1 },                          // neg, inc, dec
+	{ 0xd1, 4 }, { 0xd1, 7 }, { 0xd1, 2 },                          // shl, sar, rcl
+	{ 0x83, 0, true }, { 0x83, 5, true }, { 0x83, 7, true },        // add, sub, cmp imm8
+};
+
+#define JCC_INSNS 10
+#define JCC_LOOPS 20
+
+static UINT8 jcc_reg(UINT32 *seed)
+{
+	return jcc_regs[random32(seed) % ARRAY_LENGTH(jcc_regs)];
+}
+
+/* Returns the size of the code: JCC_INSNS tests and branches run JCC_LOOPS times */
+static UINT32 jcc_generate(UINT8 *code, UINT32 *seed)
+{
+	UINT32 size = 0, top;
+
+	// mov bp,JCC_LOOPS
+	code[size++] = 0xbd;
+	code[size++] = JCC_LOOPS;
+	code[size++] = 0;
+	top = size;
+	for (int i = 0; i < JCC_INSNS; i++)
+	{
+		UINT32 r = random32(seed);
+		int op = r % ARRAY_LENGTH(jcc_ops);
+
+		// now and then none, so a jcc follows the inc of the one before
+		if (r >> 8 & 7)
+		{
+			code[size++] = jcc_ops[op].opcode;
+			if (jcc_ops[op].reg == 0xff)
+				code[size++] = 0xc0 | jcc_reg(seed) << 3 | jcc_reg(seed);
+			else
+				code[size++] = 0xc0 | jcc_ops[op].reg << 3 | jcc_reg(seed);
+			if (jcc_ops[op].imm)
+				code[size++] = random32(seed);
+		}
+		// jcc over the inc, sometimes through a second jcc a taken branch starts a block with
+		code[size++] = 0x70 | (r >> 12 & 15);
+		if (r >> 16 & 3)
+		{
+			code[size++] = 3;
+		}
+		else
+		{
+			code[size++] = 2;
+			code[size++] = 0x70 | (r >> 20 & 15);
+			code[size++] = 3;
+		}
+		// inc word [si+2*i]
+		code[size++] = 0xff;
+		code[size++] = 0x44;
+		code[size++] = i * 2;
+	}
+	// dec bp; jnz top; hlt
+	code[size++] = 0x4d;
+	code[size++] = 0x75;
+	code[size] = top - (size + 1);
+	size++;
+	code[size++] = 0xf4;
+	return size;
+}
+
+/* Flags with OF, SF, ZF, PF and CF from the bits of 'n' */
+static UINT32 jcc_flags(int n)
+{
+	return 0x0002 | (n & 1 ? 0x0001 : 0) | (n & 2 ? 0x0004 : 0) | (n & 4 ? 0x0040 : 0) | (n & 8 ? 0x0080 : 0) | (n & 16 ? 0x0800 : 0);
+}
+
+/* nop; jcc +1; hlt; hlt with the flags of 'n', true if it took the branch */
+static bool jcc_taken(int n, bool blocks)
+{
+	m_eip = 0;
+	m_halted = 0;
+	set_flags((get_flags() & ~0xfff) | jcc_flags(n));
+	cpu_run(blocks);
+	return m_eip == 5;
+}
+
+static void test_jcc_conditions()
+{
+	UINT8 code[] = { 0x90, 0x70, 0x01, 0xf4, 0xf4 };
+
+	for (int cc = 0; cc < 16; cc++)
+	{
+		code[1] = 0x70 | cc;
+		cpu_setup(MODE_REAL, code, sizeof(code));
+		// the first run records the block, the others replay it
+		for (int n = 0; n < 32; n++)
+		{
+			bool step = jcc_taken(n, false), block = jcc_taken(n, true);
+
+			if (step != block)
+				fail("jcc %02x flags %03x: taken stepping %d, from a block %d\n", code[1], jcc_flags(n), step, block);
+		}
+	}
+}
+
+static void test_jcc_loops()
+{
+	UINT32 seed = 0x7c0f7eb5;
+	UINT8 code[JCC_INSNS * 10 + 16];
+	int shown = 0;
+
+	for (UINT32 n = 0; n < 2000 && shown < 10; n++)
+	{
+		UINT32 size = jcc_generate(code, &seed), regs[5], flags = random32(&seed) & 0x8d5;
+
+		for (int i = 0; i < 5; i++)
+			regs[i] = random32(&seed);
+		for (int mode = MODE_REAL; mode <= MODE_PM16; mode++)
+		{
+			UINT64 insns[2];
+			UINT32 hash[2], eip[2];
+
+			for (int blocks = 0; blocks < 2; blocks++)
+			{
+				cpu_setup(mode, code, size);
+				for (int i = 0; i < 5; i++)
+					REG32(jcc_regs[i]) = regs[i];
+				REG32(ESI) = 0x100;
+				set_flags(get_flags() | flags);
+				insns[blocks] = cpu_run(blocks != 0, 10000);
+				hash[blocks] = cpu_hash();
+				eip[blocks] = m_eip;
+			}
+			if (insns[0] && insns[0] == insns[1] && hash[0] == hash[1] && eip[0] == eip[1])
+				continue;
+			fail("case %u %s: step %llu insns eip %08x hash %08x, block %llu insns eip %08x hash %08x\n  code",
+				n, mode_name[mode], insns[0], eip[0], hash[0], insns[1], eip[1], hash[1]);
+			for (UINT32 i = 0; i < size; i++)
+				printf(" %02x", code[i]);
+			printf("\n");
+			shown++;
+		}
+	}
+}
+
+static void test_jcc_interrupt()
+{
+	static const UINT8 code[] = {
+		0xfb,       // 00 sti
+		0x40,       // 01 inc ax
+		0x49,       // 02 dec cx
+		0x75, 0xfb, // 03 jnz 00
+		0xf4,       // 05 hlt
+	};
+
+	// the interrupt is pending from the start and can be taken once the sti has run
+	cpu_setup(MODE_REAL, code, sizeof(code));
+	REG16(CX) = 1000;
+	m_irq_state = ASSERT_LINE;
+	cpu_run(true);
+	if (cpu_vector() != 0 || REG16(AX) != 1 || cpu_frame(0) != 0)
+		fail("interrupt: vector %d after %u passes, return to %04x\n", cpu_vector(), REG16(AX), cpu_frame(0));
+	m_irq_state = CLEAR_LINE;
+}
+
+static void test_jcc()
+{
+	test_jcc_conditions();
+	test_jcc_loops();
+	test_jcc_interrupt();
+}
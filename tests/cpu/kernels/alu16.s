@@ -0,0 +1,62 @@
+# Arithmetic, logic and flag results stored to DS at every iteration
+	.code16
+	xor %di,%di
+	mov $0x1234,%ax
+	mov $0x5678,%bx
+	mov $3000,%cx
+	xor %dx,%dx
+	xor %si,%si
+	xor %bp,%bp
+1:	add %cx,%ax
+	adc $0,%dx
+	xor %ax,%bx
+	rol $3,%bx
+	sub %bx,%si
+	sbb %cx,%bp
+	inc %si
+	pushf
+	popw 0x100(%di)
+	lahf
+	mov %ah,0x200(%di)
+	seta %al
+	setp %ah
+	setle 0x300(%di)
+	mov %ax,0x400(%di)
+	daa
+	aaa
+	das
+	aas
+	mov %ax,0x500(%di)
+	jp 2f
+	add $7,%dx
+2:	jo 3f
+	inc %dx
+3:	neg %bp
+	imul %bx
+	mov %ax,0x600(%di)
+	mov %dx,0x700(%di)
+	and $0x7fff,%dx
+	or $1,%bx
+	push %dx
+	mov %cx,%ax
+	xor %dx,%dx
+	div %bx
+	pop %dx
+	mov %ax,0x800(%di)
+	shr $1,%ax
+	rcl $1,%si
+	sar %cl,%bp
+	cmp %ax,%si
+	setl 0x900(%di)
+	test %si,%bp
+	sets 0xa00(%di)
+	movl $0x12345678,%eax
+	addl %ecx,%eax
+	imul %ecx,%eax
+	shld $5,%eax,%ebx
+	bsf %eax,%edx
+	add $2,%di
+	and $0xff,%di
+	dec %cx
+	jnz 1b
+	hlt
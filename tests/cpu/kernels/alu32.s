@@ -0,0 +1,48 @@
+# 32-bit arithmetic, logic and flag results stored at 0x20000
+	.code32
+	mov $0x20000,%edi
+	mov $0x12345678,%eax
+	mov $0x9abcdef0,%ebx
+	mov $5000,%ecx
+	xor %edx,%edx
+	xor %esi,%esi
+	xor %ebp,%ebp
+1:	add %ecx,%eax
+	adc $0,%edx
+	xor %eax,%ebx
+	rol $7,%ebx
+	sub %ebx,%esi
+	sbb %ecx,%ebp
+	pushf
+	popl 0x1000(%edi)
+	setbe %al
+	setnp %ah
+	mov %eax,0x2000(%edi)
+	imul %ebx
+	mov %eax,0x3000(%edi)
+	mov %edx,0x4000(%edi)
+	and $0x7fffffff,%edx
+	or $1,%ebx
+	push %edx
+	mov %ecx,%eax
+	xor %edx,%edx
+	div %ebx
+	pop %edx
+	mov %eax,0x5000(%edi)
+	shrd %cl,%esi,%ebp
+	rcr $1,%esi
+	bswap %eax
+	movzbw %al,%ax
+	movsbl %ah,%eax
+	cmpxchg %ebx,0x6000(%edi)
+	xadd %esi,0x7000(%edi)
+	bt %ecx,0x28000
+	btcl $3,0x28004
+	bts %esi,%ebp
+	lea 3(%eax,%ebx,4),%esi
+	mov %esi,0x9000(%edi)
+	add $4,%edi
+	and $0x20fff,%edi
+	dec %ecx
+	jnz 1b
+	hlt
@@ -0,0 +1,58 @@
+# Conditional branches, loops that are a single block, calls and
+# near indirect jumps
+	.code16
+	xor %di,%di
+	mov $0x9e37,%ax
+	mov $2000,%bp
+1:	imul $0x4f1b,%ax
+	add $0x3d,%ax
+	mov %ax,%bx
+	xor %dx,%dx
+	mov $16,%cx
+2:	shr $1,%bx
+	adc $0,%dx
+	loop 2b
+	mov %dx,0x100(%di)
+	mov %ax,%cx
+	and $0x1f,%cx
+	jcxz 3f
+4:	dec %cx
+	jnz 4b
+3:	cmp $0x8000,%ax
+	jb 5f
+	ja 6f
+5:	call sub1
+	jmp 7f
+6:	mov %ax,%bx
+	and $2,%bx
+	call *%cs:table(%bx)
+7:	test $0x40,%al
+	jz 8f
+	jns 8f
+	jpe 9f
+	jpo 8f
+9:	incw 0x300(%di)
+8:	cmp %dx,%bx
+	jl 10f
+	jg 11f
+	jle 12f
+10:	incw 0x302(%di)
+11:	jge 12f
+	incw 0x304(%di)
+12:	mov %ax,%cx
+	and $7,%cx
+	inc %cx
+13:	loopnz 13b
+	mov %cx,0x306(%di)
+	add $8,%di
+	and $0xff,%di
+	dec %bp
+	jnz 1b
+	hlt
+sub1:	mov %ax,%bx
+	and $2,%bx
+	rol $1,%ax
+	ret
+sub2:	xor $0x5a5a,%ax
+	ret
+table:	.word sub1, sub2
@@ -0,0 +1,48 @@
+# Far calls and returns through memory and the stack, and segment loads
+# with mov, pop, lds and les.  Far pointers are built from the CS and DS
+# the code runs with, so it runs the same in every 16-bit mode.
+	.code16
+	mov %cs,0x202
+	movw $sub1,0x200
+	mov %cs,0x206
+	movw $sub2,0x204
+	mov %ds,0x20a
+	movw $0x300,0x208
+	xor %di,%di
+	mov $0x5a5a,%bx
+	mov $3000,%bp
+1:	lcall *0x200
+	push %cs
+	call sub2
+	mov %bx,%si
+	and $4,%si
+	lcall *0x200(%si)
+	push %ds
+	pop %es
+	lds 0x208,%si
+	les 0x208,%ax
+	mov %es,%dx
+	add %di,%si
+	mov %ax,(%si)
+	mov %ds,%ax
+	mov %ax,%fs
+	mov %ax,%gs
+	mov %fs:0x300(%di),%cx
+	add %cx,%bx
+	mov %gs,%ax
+	mov %ax,%ss:0x1000(%di)
+	add $2,%di
+	and $0xfe,%di
+	dec %bp
+	jnz 1b
+	hlt
+sub1:	imul $0x4f1b,%bx
+	add $0x3d,%bx
+	lret
+sub2:	push %bp
+	mov %sp,%bp
+	xor %bx,0x100(%di)
+	rol $5,%bx
+	mov %bx,0x100(%di)
+	pop %bp
+	lret
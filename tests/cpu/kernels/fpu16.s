@@ -0,0 +1,50 @@
+# x87 arithmetic in extended and double precision
+	.code16
+	finit
+	movw $3,0x10
+	movw $7,0x12
+	mov $1000,%cx
+	xor %di,%di
+	fldz
+1:	filds 0x10
+	filds 0x12
+	fdivrp
+	faddp
+	fld %st(0)
+	fsqrt
+	fmul %st(0),%st(0)
+	fstpl 0x100(%di)
+	fld1
+	fadd %st(1),%st(0)
+	fdiv %st(1),%st(0)
+	fstpt 0x400(%di)
+	incw 0x12
+	add $8,%di
+	and $0xff,%di
+	loop 1b
+	fstpl 0x20
+	fstsw 0x30
+	fnstcw 0x32
+	movw $0x027f,0x34
+	fldcw 0x34
+	mov $500,%cx
+	movw $1,0x36
+2:	fldpi
+	filds 0x36
+	fdivrp
+	fld1
+	faddp
+	fldl2e
+	fmulp
+	fsubl 0x20
+	fstpl 0x800(%di)
+	incw 0x36
+	add $8,%di
+	and $0xff,%di
+	loop 2b
+	fld1
+	fldz
+	fdivrp
+	fstpl 0x48
+	fstsw 0x50
+	hlt
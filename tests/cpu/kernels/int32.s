@@ -0,0 +1,37 @@
+# Software interrupts to a handler the kernel installs in the IDT, with
+# pushf/popf and cli/sti around them, and interrupts returning to a
+# changed EIP and flags.
+	.code32
+	.set base, 0x10000              # CODE_BASE, where the code runs
+	mov $handler+base,%eax
+	mov %ax,0x1800+0x60*8           # IDT_BASE, gate 60h
+	movw $0x28,0x1800+0x60*8+2      # SEL_CODE32
+	movw $0x8e00,0x1800+0x60*8+4    # present, DPL 0, 32-bit interrupt gate
+	shr $16,%eax
+	mov %ax,0x1800+0x60*8+6
+	mov $0x20000,%edi
+	mov $0x13579bdf,%ebx
+	mov $4000,%ecx
+1:	mov %ebx,%eax
+	int $0x60
+	pushf
+	popl 0x1000(%edi)
+	mov %eax,(%edi)
+	cli
+	int $0x60
+	sti
+	add %eax,%ebx
+	rol $3,%ebx
+	add $4,%edi
+	and $0x20fff,%edi
+	loop 1b
+	hlt
+handler:
+	imul $0x9e3779b1,%eax
+	xor %ecx,%eax
+	test $1,%al
+	jz 2f
+	orl $0x801,8(%esp)              # OF and CF in the returned flags
+	iret
+2:	andl $~0x801,8(%esp)
+	iret
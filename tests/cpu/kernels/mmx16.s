@@ -0,0 +1,107 @@
+# MMX lane operations on pseudo-random data
+	.code16
+	xor %si,%si
+	mov $256,%cx
+1:	mov %si,%ax
+	imul $0x9e37,%ax
+	xor %si,%ax
+	mov %ax,(%si)
+	add $2,%si
+	loop 1b
+	xor %si,%si
+	mov $0x800,%di
+	mov $60,%cx
+2:	movq (%si),%mm0
+	movq 8(%si),%mm1
+	movq %mm0,%mm2
+	paddb %mm1,%mm2
+	movq %mm2,(%di)
+	movq %mm0,%mm2
+	paddsw %mm1,%mm2
+	movq %mm2,8(%di)
+	movq %mm0,%mm2
+	psubusb %mm1,%mm2
+	movq %mm2,16(%di)
+	movq %mm0,%mm2
+	pmullw %mm1,%mm2
+	movq %mm2,24(%di)
+	movq %mm0,%mm2
+	pmulhw %mm1,%mm2
+	movq %mm2,32(%di)
+	movq %mm0,%mm2
+	pmaddwd %mm1,%mm2
+	movq %mm2,40(%di)
+	movq %mm0,%mm2
+	packuswb %mm1,%mm2
+	movq %mm2,48(%di)
+	movq %mm0,%mm2
+	packsswb %mm1,%mm2
+	movq %mm2,56(%di)
+	movq %mm0,%mm2
+	packssdw %mm1,%mm2
+	movq %mm2,64(%di)
+	movq %mm0,%mm2
+	punpcklbw %mm1,%mm2
+	movq %mm2,72(%di)
+	movq %mm0,%mm2
+	punpckhwd %mm1,%mm2
+	movq %mm2,80(%di)
+	movq %mm0,%mm2
+	pcmpgtw %mm1,%mm2
+	movq %mm2,88(%di)
+	movq %mm0,%mm2
+	pcmpeqb %mm1,%mm2
+	movq %mm2,96(%di)
+	movq %mm0,%mm2
+	psrlq $7,%mm2
+	movq %mm2,104(%di)
+	movq %mm0,%mm2
+	psraw $3,%mm2
+	movq %mm2,112(%di)
+	movq %mm0,%mm2
+	psllw %mm1,%mm2
+	movq %mm2,120(%di)
+	movq %mm0,%mm2
+	pandn %mm1,%mm2
+	pxor %mm0,%mm2
+	por %mm1,%mm2
+	pand %mm0,%mm2
+	movq %mm2,128(%di)
+	movq %mm0,%mm2
+	psubsw %mm1,%mm2
+	paddusw %mm1,%mm2
+	psubd %mm1,%mm2
+	paddd %mm0,%mm2
+	psubw %mm0,%mm2
+	paddw %mm1,%mm2
+	psubb %mm1,%mm2
+	paddsb %mm0,%mm2
+	psubsb %mm1,%mm2
+	paddusb %mm0,%mm2
+	psubusw %mm1,%mm2
+	movq %mm2,136(%di)
+	movq %mm0,%mm2
+	punpckhbw %mm1,%mm2
+	punpcklwd %mm0,%mm2
+	punpckldq %mm1,%mm2
+	punpckhdq %mm0,%mm2
+	pcmpeqw %mm1,%mm2
+	pcmpeqd %mm0,%mm2
+	pcmpgtb %mm1,%mm2
+	pcmpgtd %mm0,%mm2
+	movq %mm2,144(%di)
+	movq %mm0,%mm2
+	psrlw $2,%mm2
+	psrld $1,%mm2
+	pslld $3,%mm2
+	psllq $9,%mm2
+	psrad $1,%mm2
+	movq %mm2,152(%di)
+	movd %mm0,%eax
+	mov %eax,160(%di)
+	add $16,%si
+	add $2,%di
+	dec %cx
+	jnz 2b
+	emms
+	hlt
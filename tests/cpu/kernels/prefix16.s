@@ -0,0 +1,37 @@
+# Operand size, address size, segment override, lock and 0f escape
+# prefixes in every order the block cache resolves when recording
+	.code16
+	mov $0x800,%cx
+	xor %bx,%bx
+	mov $0x1111,%ax
+1:	mov %bx,%si
+	and $0x1ff,%si
+	addl $0x01010101,(%si)
+	addr32 add %ax,0x200(%esi)
+	es addw %cx,0x400(%si)
+	ss movw %cx,0x800(%si)
+	mov %ss:0x800(%si),%dx
+	# data32 es addr32 add %ecx,0x600(%esi)
+	.byte 0x66,0x26,0x67,0x01,0x8e,0x00,0x06,0x00,0x00
+	# addr32 data32 es adc %edx,0x600(%esi)
+	.byte 0x67,0x66,0x26,0x11,0x96,0x00,0x06,0x00,0x00
+	cs mov 0(%bx),%al
+	movzbl %al,%eax
+	movsx %al,%dx
+	movzwl %dx,%eax
+	es mov %eax,0x1000(%si)
+	imul $0x1234,%ax,%dx
+	imul $0x12345678,%eax,%edx
+	es mov %edx,0x1400(%si)
+	lock incw 0x1800(%si)
+	lock es xaddw %ax,0x1a00(%si)
+	bts %cx,0x1c00
+	setc %dl
+	es shld $3,%eax,0x1e00(%si)
+	seto %dh
+	mov %dx,0x2000(%si)
+	rep nop
+	inc %bx
+	dec %cx
+	jnz 1b
+	hlt
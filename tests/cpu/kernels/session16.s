@@ -0,0 +1,63 @@
+# A 16-bit program for the record test: relay calls into the 32-bit
+# side, software interrupts, divide faults and a callback from the
+# 32-bit side, and work on what they return.  The 32-bit side calls it
+# far at 0 and calls back at 2.
+	.code16
+	.set FLAT, 0x2f             # flat 32-bit code, with the relay trap
+	.set FROM16, 0x9000
+	jmp main
+	jmp callback
+main:	mov $300,%bp
+	xor %di,%di
+1:	xor %ax,%ax
+	lcalll $FLAT,$FROM16        # 0: random ax and dx
+	add %ax,0x100(%di)
+	xor %dx,0x102(%di)
+	mov %ax,%si
+	and $0x3fe,%si              # the 32-bit side writes apart from the
+	or $0x1000,%si              # sums, so the log cannot put them right
+	mov $1,%ax
+	mov $0x1f,%cx
+	push %di
+	lea 0x800(%di),%di
+	lcalll $FLAT,$FROM16        # 1: cx random bytes at es:di
+	mov %di,%bx
+	xor %ax,%ax
+	xor %dx,%dx
+2:	mov (%bx),%dl
+	add %dx,%ax
+	inc %bx
+	loop 2b
+	pop %di
+	add %ax,0x104(%di)
+	int $0x21                   # random ax, and a random word at ds:si
+	add (%si),%ax
+	mov %bp,%cx
+	and $3,%cl
+	div %cl                     # divide error on zero and on overflow
+	mov %ax,0x106(%di)
+	test $7,%bp
+	jnz 3f
+	mov $2,%ax
+	lcalll $FLAT,$FROM16        # 2: a new segment in ax
+	mov %ax,%fs
+	mov %fs:0x10,%ax
+	add %ax,0x108(%di)
+	mov $3,%ax
+	lcalll $FLAT,$FROM16        # 3: a callback, with a random ax
+	add %ax,0x10a(%di)
+3:	add $0x10,%di
+	and $0x3ff,%di
+	dec %bp
+	jnz 1b
+	lret
+callback:
+	mov %ax,%bx
+	imul $0x4f1b,%bx
+	xor %ax,%ax
+	lcalll $FLAT,$FROM16
+	add %bx,%ax
+	mov $0x40,%si
+	int $0x21
+	xor %bx,%ax
+	lret
@@ -0,0 +1,58 @@
+# Self-modifying code: a loop that rewrites an opcode it runs later in
+# the same block, calls to code it rewrites on the same page (the
+# displacement of a jcc the block cache keeps) and on another page, and
+# a counter kept between the instructions.  Handlers fetch their own
+# operands, so it is the opcodes and the jcc displacement that have to
+# change.  The writes go through ES, which is CS in real and V86 mode and
+# SEL_ALIAS16, the writable alias of CS, in 16-bit protected mode.
+	.code16
+	mov %cs,%ax
+	cmp $8,%ax                  # SEL_CODE16
+	jne 1f
+	mov $0x38,%ax               # SEL_ALIAS16
+1:	mov %ax,%es
+	xor %di,%di
+	mov $0x1234,%bx
+	mov $500,%bp
+2:	mov %bp,%si
+	and $3,%si
+	mov %es:ops16(%si),%al
+	mov %al,%es:3f
+	mov %bp,%cx
+	imul $0x4f1b,%cx
+3:	add %cx,%bx                 # add, sub, xor or and
+	mov %bx,0x100(%di)
+	mov %bl,%al
+	and $1,%al
+	mov %al,%es:4f+1
+	mov %bx,%ax
+	call 6f
+	mov %ax,0x102(%di)
+	mov %es:ops8(%si),%al
+	mov %al,%es:5f
+	mov %bx,%ax
+	call 7f
+	mov %ax,0x104(%di)
+	incw %es:counter
+	mov %es:counter,%ax
+	add %ax,0x106(%di)
+	rol $3,%bx
+	add $8,%di
+	and $0x1ff,%di
+	dec %bp
+	jnz 2b
+	hlt
+ops16:	.byte 0x01, 0x29, 0x31, 0x21
+ops8:	.byte 0x00, 0x28, 0x30, 0x20
+counter:
+	.word 0
+6:	test $2,%ax
+4:	jz 8f                       # to the inc or past it
+8:	inc %ax
+	ret
+
+	.org 0x1800                 # on the next page
+7:	mov %bp,%dx
+5:	add %dl,%al                 # add, sub, xor or and
+	adc %dh,%ah
+	ret
@@ -0,0 +1,150 @@
+# String instructions with and without REP, both directions, overlapping
+# and at the ends of segments.  DS is pointed at ES with push/pop so that
+# the code runs the same in every 16-bit mode.
+	.code16
+	cld
+	xor %si,%si
+	mov $0x8000,%cx
+1:	mov %si,%ax
+	imul $0x3d,%ax
+	xor %ah,%al
+	mov %al,(%si)
+	inc %si
+	loop 1b
+	xor %si,%si
+	xor %di,%di
+	mov $1000,%cx
+	rep movsb
+	mov $0x100,%si
+	mov $0x2000,%di
+	mov $300,%cx
+	rep movsw
+	mov $0x10,%si
+	mov $0x4000,%di
+	mov $123,%cx
+	rep movsl
+	std
+	mov $0x3fff,%si
+	mov $0x5fff,%di
+	mov $777,%cx
+	rep movsb
+	mov $0x900,%si
+	mov $0x800,%di
+	mov $0x300,%cx
+	rep movsw
+	cld
+	push %ds
+	push %es
+	pop %ds
+	mov $0x100,%si
+	mov $0x101,%di
+	mov $500,%cx
+	rep movsb
+	mov $0x200,%si
+	mov $0x100,%di
+	mov $200,%cx
+	rep movsw
+	mov $0x4000,%si
+	mov $0x4003,%di
+	mov $0x100,%cx
+	rep movsl
+	std
+	mov $0x800,%si
+	mov $0x802,%di
+	mov $0x300,%cx
+	rep movsl
+	cld
+	pop %ds
+	mov $0xab,%al
+	mov $0x6000,%di
+	mov $4000,%cx
+	rep stosb
+	mov $0xbeef,%ax
+	mov $0x8000,%di
+	mov $1001,%cx
+	rep stosw
+	mov $0xdeadbeef,%eax
+	mov $0xa000,%di
+	mov $99,%cx
+	rep stosl
+	std
+	mov $0xc000,%di
+	mov $77,%cx
+	rep stosw
+	cld
+	xor %di,%di
+	mov $0x37,%al
+	mov $1000,%cx
+	repne scasb
+	mov %cx,%es:0xe000
+	mov %di,%es:0xe002
+	pushf
+	popw %es:0xe004
+	mov $0x6000,%di
+	mov $0xab,%al
+	mov $5000,%cx
+	repe scasb
+	mov %cx,%es:0xe006
+	mov %di,%es:0xe008
+	xor %si,%si
+	xor %di,%di
+	mov $2000,%cx
+	repe cmpsb
+	mov %cx,%es:0xe00a
+	mov %si,%es:0xe00c
+	pushf
+	popw %es:0xe00e
+	mov $5,%si
+	mov $0x100,%di
+	mov $50,%cx
+	repne cmpsw
+	mov %cx,%es:0xe010
+	std
+	mov $0x7ffe,%si
+	mov $0x7ffe,%di
+	mov $0x100,%cx
+	repe cmpsw
+	mov %cx,%es:0xe012
+	pushf
+	popw %es:0xe014
+	cld
+	mov $0x100,%si
+	mov $0x100,%di
+	mov $0x400,%cx
+	repe cmpsl
+	mov %cx,%es:0xe016
+	xor %si,%si
+	mov $33,%cx
+	rep lodsb
+	mov %ax,%es:0xe018
+	mov %si,%es:0xe01a
+	addr32 mov $0x1000,%esi
+	addr32 mov $0xd000,%edi
+	mov $100,%ecx
+	addr32 rep movsb
+	mov %ecx,%es:0xe01c
+	mov %esi,%es:0xe020
+	mov $0xfff0,%si
+	mov $0xf000,%di
+	mov $40,%cx
+	rep movsb
+	mov %si,%es:0xe024
+	mov %di,%es:0xe026
+	mov $0xfffe,%di
+	mov $0x55,%al
+	mov $20,%cx
+	rep stosb
+	mov %di,%es:0xe028
+	mov $0xfff0,%si
+	mov $40,%cx
+	rep lodsw
+	mov %ax,%es:0xe02a
+	mov %si,%es:0xe02c
+	xor %cx,%cx
+	rep movsb
+	mov $0x10,%si
+	mov $0x20,%di
+	mov $0x400,%cx
+	repne cmpsb
+	mov %cx,%es:0xe02e
+	hlt
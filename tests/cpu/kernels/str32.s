@@ -0,0 +1,42 @@
+# 32-bit string instructions over flat segments
+	.code32
+	cld
+	mov $0x20000,%edi
+	mov $0x4000,%ecx
+	mov $0x01234567,%eax
+1:	stosl
+	imul $0x9e3779b1,%eax
+	add %ecx,%eax
+	loop 1b
+	mov $0x20000,%esi
+	mov $0x30000,%edi
+	mov $0x2345,%ecx
+	rep movsb
+	mov $0x20003,%esi
+	mov $0x20001,%edi
+	mov $0x1000,%ecx
+	rep movsl
+	std
+	mov $0x2fffc,%esi
+	mov $0x2fffe,%edi
+	mov $0x800,%ecx
+	rep movsw
+	cld
+	mov $0x20000,%esi
+	mov $0x30000,%edi
+	mov $0x4000,%ecx
+	repe cmpsl
+	mov %ecx,0x3f000
+	pushf
+	popl 0x3f004
+	mov $0x33,%al
+	mov $0x20000,%edi
+	mov $0x10000,%ecx
+	repne scasb
+	mov %ecx,0x3f008
+	mov %edi,0x3f00c
+	mov $0x12345678,%eax
+	mov $0x38000,%edi
+	mov $0x777,%ecx
+	rep stosl
+	hlt
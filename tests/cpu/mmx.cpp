@@ -0,0 +1,86 @@
+/*
+	MMX lane operations (mmxlanes.h)
+
+	The lane operations are built a second time for each path, with SSE2
+	and with MMX_NO_SSE2, and run on random operands and on operands at
+	the edges the saturating, compare and pack operations turn on:
+	0x7f/0x80 bytes, 0x7fff/0x8000 words and shift counts around the lane
+	widths.  Both paths must give the same result.  The core uses the
+	SSE2 one on x86 hosts; the mmx16 kernel covers the handlers around
+	them in the block test.
+*/
+
+#include <emmintrin.h>
+
+#undef MMX_SSE2
+#undef MMX_LANE_OP
+namespace mmx_sse2 {
+#include "mame/emu/cpu/i386/mmxlanes.h"
+}
+
+#define MMX_NO_SSE2
+#undef MMX_SSE2
+#undef MMX_LANE_OP
+namespace mmx_scalar {
+#include "mame/emu/cpu/i386/mmxlanes.h"
+}
+
+#define MMX_OP(name) { #name, mmx_sse2::mmx_##name, mmx_scalar::mmx_##name }
+
+static const struct {
+	const char *name;
+	UINT64 (*sse2)(UINT64, UINT64);
+	UINT64 (*scalar)(UINT64, UINT64);
+} mmx_ops[] = {
+	MMX_OP(paddb), MMX_OP(paddw), MMX_OP(paddd), MMX_OP(psubb), MMX_OP(psubw), MMX_OP(psubd),
+	MMX_OP(paddsb), MMX_OP(paddsw), MMX_OP(paddusb), MMX_OP(paddusw),
+	MMX_OP(psubsb), MMX_OP(psubsw), MMX_OP(psubusb), MMX_OP(psubusw),
+	MMX_OP(pmullw), MMX_OP(pmulhw), MMX_OP(pmaddwd),
+	MMX_OP(pcmpeqb), MMX_OP(pcmpeqw), MMX_OP(pcmpeqd), MMX_OP(pcmpgtb), MMX_OP(pcmpgtw), MMX_OP(pcmpgtd),
+	MMX_OP(packsswb), MMX_OP(packssdw), MMX_OP(packuswb),
+	MMX_OP(punpcklbw), MMX_OP(punpcklwd), MMX_OP(punpckldq), MMX_OP(punpckhbw), MMX_OP(punpckhwd), MMX_OP(punpckhdq),
+	MMX_OP(psllw), MMX_OP(pslld), MMX_OP(psllq), MMX_OP(psrlw), MMX_OP(psrld), MMX_OP(psrlq),
+	MMX_OP(psraw), MMX_OP(psrad),
+};
+
+static UINT64 mmx_operand(UINT32 *seed, int kind)
+{
+	static const UINT16 edges[] = { 0, 1, 0x7f, 0x80, 0xff, 0x7fff, 0x8000, 0x8001, 0xff7f, 0xff80, 0xffff };
+	UINT64 value = 0;
+
+	switch (kind)
+	{
+	case 0:
+		// a shift count around the lane widths, or a huge one
+		value = random32(seed) % 80;
+		if (random32(seed) % 8 == 0)
+			value |= (UINT64)random32(seed) << 32;
+		return value;
+	case 1:
+		for (int i = 0; i < 4; i++)
+			value |= (UINT64)edges[random32(seed) % ARRAY_LENGTH(edges)] << (i * 16);
+		return value;
+	default:
+		return (UINT64)random32(seed) << 32 | random32(seed);
+	}
+}
+
+static void test_mmx()
+{
+	UINT32 seed = 0x3b3b77a5;
+
+	for (size_t op = 0; op < ARRAY_LENGTH(mmx_ops); op++)
+	{
+		for (int n = 0; n < 100000; n++)
+		{
+			UINT64 a = mmx_operand(&seed, 1 + n % 2);
+			UINT64 b = mmx_operand(&seed, n % 3);
+			UINT64 sse2 = mmx_ops[op].sse2(a, b), scalar = mmx_ops[op].scalar(a, b);
+
+			if (sse2 == scalar)
+				continue;
+			fail("%s %016llx, %016llx: sse2 %016llx, scalar %016llx\n", mmx_ops[op].name, a, b, sse2, scalar);
+			break;
+		}
+	}
+}
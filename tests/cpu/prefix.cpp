@@ -0,0 +1,147 @@
+/*
+	Prefixes resolved by the block cache
+
+	Random runs of instructions with random operand size, address size,
+	segment override, lock and rep prefixes in front of them, some longer
+	than the 15 bytes an instruction may take, are run in a loop stepping
+	and through the block cache, which records the prefixes on the first
+	pass and replays them on the others, in real, V86 and 16-bit protected
+	mode.  The instructions run, the registers, the flags and the memory
+	must end up the same.
+*/
+
+struct PREFIX_TEMPLATE {
+	UINT8 size;
+	UINT8 bytes[4];
+	bool rep;           // takes f2/f3, the core stops on REP before other opcodes
+	bool lock;          // takes f0, which makes the others invalid opcodes of their first byte
+};
+
+// [bx] with 16-bit addressing, [edi] with 32-bit; no immediates wider than a byte
+static const PREFIX_TEMPLATE prefix_templates[] = {
+	{ 2, { 0x01, 0x07 }, false, true },             // add [bx],ax
+	{ 2, { 0x8b, 0x07 } },                          // mov ax,[bx]
+	{ 3, { 0x83, 0x07, 0x81 }, false, true },       // add word [bx],-7fh
+	{ 2, { 0xd1, 0x27 } },                          // shl word [bx],1
+	{ 2, { 0xf7, 0x17 }, false, true },             // not word [bx]
+	{ 2, { 0x87, 0x07 }, false, true },             // xchg [bx],ax
+	{ 1, { 0xa5 }, true },                          // movsw
+	{ 1, { 0xad }, true },                          // lodsw
+	{ 1, { 0xa7 }, true },                          // cmpsw
+	{ 1, { 0x40 } },                                // inc ax
+	{ 1, { 0x90 }, true },                          // nop
+	{ 2, { 0x8c, 0xc0 } },                          // mov ax,es
+	{ 3, { 0x0f, 0xb6, 0x07 } },                    // movzx ax,byte [bx]
+	{ 3, { 0x0f, 0xaf, 0x07 } },                    // imul ax,[bx]
+	{ 3, { 0x0f, 0xa3, 0x07 } },                    // bt [bx],ax
+	{ 4, { 0x0f, 0xba, 0x2f, 0x05 }, false, true }, // bts word [bx],5
+	{ 3, { 0x0f, 0xc1, 0x07 }, false, true },       // xadd [bx],ax
+	{ 3, { 0x0f, 0x90, 0x07 } },                    // seto [bx]
+	{ 4, { 0x0f, 0xa4, 0x07, 0x03 } },              // shld [bx],ax,3
+};
+
+static const UINT8 prefix_bytes[] = { 0x66, 0x67, 0x26, 0x2e, 0x36, 0x3e, 0x64, 0x65, 0x66, 0x67, 0xf0 };
+
+#define PREFIX_INSNS 8
+#define PREFIX_LOOPS 3
+
+/* Returns the size of the code: PREFIX_INSNS instructions run PREFIX_LOOPS times */
+static UINT32 prefix_generate(UINT8 *code, UINT32 *seed)
+{
+	UINT32 size = 0;
+
+	// mov bp,PREFIX_LOOPS
+	code[size++] = 0xbd;
+	code[size++] = PREFIX_LOOPS;
+	code[size++] = 0;
+	for (int i = 0; i < PREFIX_INSNS; i++)
+	{
+		const PREFIX_TEMPLATE *t = &prefix_templates[random32(seed) % ARRAY_LENGTH(prefix_templates)];
+		UINT32 r = random32(seed);
+		int count = r % 8 == 0 ? 12 + (r >> 8) % 6 : (r >> 8) % 4;
+		int rep = t->rep && (r & 0x10000) ? (r >> 17) % (count + 1) : -1;
+
+		for (int j = 0; j <= count; j++)
+		{
+			if (j == rep)
+				code[size++] = r & 0x100000 ? 0xf3 : 0xf2;
+			if (j == count)
+				break;
+			// lock now and then, and never after a rep
+			UINT32 p = random32(seed) % ARRAY_LENGTH(prefix_bytes);
+			if (prefix_bytes[p] == 0xf0 && (!t->lock || random32(seed) % 2 || (rep >= 0 && j > rep)))
+				p = 0;
+			code[size++] = prefix_bytes[p];
+		}
+		memcpy(code + size, t->bytes, t->size);
+		size += t->size;
+	}
+	// dec bp; jnz start; hlt
+	code[size++] = 0x4d;
+	code[size++] = 0x75;
+	code[size] = 3 - (size + 1);
+	size++;
+	code[size++] = 0xf4;
+	return size;
+}
+
+static void prefix_start(int mode, const UINT8 *code, UINT32 size, UINT32 n)
+{
+	cpu_setup(mode, code, size);
+	if (mode == MODE_PM16)
+	{
+		load_segment(FS, SEL_EXTRA16);
+		load_segment(GS, SEL_DATA16);
+	}
+	else
+	{
+		load_segment(FS, EXTRA_BASE >> 4);
+		load_segment(GS, DATA_BASE >> 4);
+	}
+	for (UINT32 i = 0; i < 0x2000; i++)
+	{
+		mem[DATA_BASE + i] = i * 7 + n;
+		mem[EXTRA_BASE + i] = i * 13 + n;
+		mem[STACK_BASE + i] = i * 5 + n;
+	}
+	REG32(EAX) = 0x12345678 + n;
+	REG32(EBX) = 0x400;
+	REG32(ECX) = 3;
+	REG32(EDX) = 0x9abcdef0;
+	REG32(ESI) = 0x600;
+	REG32(EDI) = 0x800;
+}
+
+static void test_prefix()
+{
+	UINT32 seed = 0x3e66f367;
+	UINT8 code[PREFIX_INSNS * 24 + 16];
+	int shown = 0;
+
+	for (UINT32 n = 0; n < 3000 && shown < 10; n++)
+	{
+		UINT32 size = prefix_generate(code, &seed);
+
+		for (int mode = MODE_REAL; mode <= MODE_PM16; mode++)
+		{
+			UINT64 insns[2];
+			UINT32 hash[2], eip[2];
+
+			for (int blocks = 0; blocks < 2; blocks++)
+			{
+				prefix_start(mode, code, size, n);
+				insns[blocks] = cpu_run(blocks != 0, 10000);
+				hash[blocks] = cpu_hash();
+				eip[blocks] = m_eip;
+			}
+			if (insns[0] == insns[1] && hash[0] == hash[1] && eip[0] == eip[1])
+				continue;
+			fail("case %u %s: step %llu insns eip %08x hash %08x, block %llu insns eip %08x hash %08x\n  code",
+				n, mode_name[mode], insns[0], eip[0], hash[0], insns[1], eip[1], hash[1]);
+			for (UINT32 i = 0; i < size; i++)
+				printf(" %02x", code[i]);
+			printf("\n");
+			shown++;
+		}
+	}
+}
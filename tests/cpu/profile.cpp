@@ -0,0 +1,95 @@
+/*
+	Instruction counts of the execution profiler (i386prof.c)
+
+	Every kernel is run with m_profile set, once an instruction at a time
+	and once through the block cache, entering the core the way vm86main
+	does and reporting each entry to i386_profile_block.  The instructions
+	counted for all CS:IPs, and those counted for all opcodes, must each
+	add up to the instructions the core ran, and both ways of running must
+	count every opcode the same number of times.
+*/
+
+/* Empty the counters, as i386_profile_init found them at startup */
+static void profile_reset()
+{
+	free(m_profile_spot);
+	free(m_profile_thunk);
+	m_profile_spot = NULL;
+	m_profile_thunk = NULL;
+	m_profile_spot_used = m_profile_thunk_used = 0;
+	m_profile_spot_other = m_profile_thunk_other = 0;
+	memset(m_profile_opcode, 0, sizeof(m_profile_opcode));
+	m_profile = false;
+}
+
+/* cpu_run with the profiler, returning the instructions counted for the CS:IPs in 'spots' */
+static UINT64 profile_run(bool blocks, UINT64 *spots)
+{
+	UINT64 start = m_insn_count;
+
+	CHANGE_PC(m_eip);
+	while (!m_halted && m_insn_count - start < 1000000000)
+	{
+		UINT64 insns = m_insn_count;
+		UINT16 cs = SREG(CS);
+		UINT32 eip = m_eip;
+		bool pm = PROTECTED_MODE && !V8086_MODE;
+
+		if (blocks)
+		{
+			i386_block_execute();
+		}
+		else
+		{
+			m_cycles = 1;
+			CPU_EXECUTE_CALL(i386);
+		}
+		i386_profile_block(cs, eip, pm, m_insn_count - insns);
+	}
+	*spots = m_profile_spot_other;
+	for (UINT32 i = 0; i < I386_PROFILE_SPOT_SIZE; i++)
+		*spots += m_profile_spot[i].count;
+	return m_insn_count - start;
+}
+
+static void test_profile()
+{
+	static UINT64 opcodes[2][2][256];
+
+	for (const KERNEL *k = kernels; k < kernels + ARRAY_LENGTH(kernels); k++)
+	{
+		UINT32 size;
+		UINT8 *code = load_kernel(k->name, &size);
+
+		FOR_EACH_MODE(k, mode)
+		{
+			for (int blocks = 0; blocks < 2; blocks++)
+			{
+				const char *how = blocks ? "block" : "step";
+				UINT64 insns, spots, counted = 0;
+
+				cpu_setup(mode, code, size);
+				i386_profile_init("profile", NULL);
+				insns = profile_run(blocks != 0, &spots);
+				for (int i = 0; i < 512; i++)
+					counted += m_profile_opcode[i >> 8][i & 0xff];
+				if (!insns || spots != insns || counted != insns)
+					fail("%s %s %s: %llu instructions, %llu counted by CS:IP, %llu by opcode\n", k->name,
+						mode_name[mode], how, insns, spots, counted);
+				memcpy(opcodes[blocks], m_profile_opcode, sizeof(m_profile_opcode));
+				profile_reset();
+			}
+			for (int i = 0; i < 512; i++)
+			{
+				if (opcodes[0][i >> 8][i & 0xff] != opcodes[1][i >> 8][i & 0xff])
+				{
+					fail("%s %s: opcode %s%02x counted %llu times stepping, %llu with blocks\n", k->name,
+						mode_name[mode], i >> 8 ? "0f " : "", i & 0xff, opcodes[0][i >> 8][i & 0xff],
+						opcodes[1][i >> 8][i & 0xff]);
+					break;
+				}
+			}
+		}
+		free(code);
+	}
+}
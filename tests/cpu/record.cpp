@@ -0,0 +1,369 @@
+/*
+	Record and replay (vm86/vm86rec.cpp, replay.h)
+
+	The session16 kernel runs in 16-bit protected mode under a small
+	stand-in for vm86main, with the recorder on.  Its 32-bit side answers
+	relay calls and interrupts with random values, random memory and new
+	LDT entries, handles divide errors and calls back into 16-bit code,
+	the way krnl386 does.  The log is then replayed on cleared memory,
+	stepping and through the block cache, and the replay must pass every
+	hand-off where the recording did and leave the same memory.  A log
+	with one value the 32-bit side returned changed must not replay.
+*/
+
+#include <vector>
+#include <unistd.h>
+
+/* What vm86rec.cpp takes from the Windows headers, and wine/library.h for the LDT */
+typedef uintptr_t ULONG_PTR;
+typedef const void *LPCVOID;
+typedef unsigned short WCHAR;
+typedef struct _IMAGE_NT_HEADERS IMAGE_NT_HEADERS;
+#define _declspec(x)
+#define DECLSPEC_NORETURN __attribute__((noreturn))
+#define FORCEINLINE inline __attribute__((always_inline))
+
+typedef struct _LDT_ENTRY {
+	WORD LimitLow;
+	WORD BaseLow;
+	union {
+		struct {
+			BYTE BaseMid;
+			BYTE Flags1;
+			BYTE Flags2;
+			BYTE BaseHi;
+		} Bytes;
+		struct {
+			unsigned BaseMid : 8;
+			unsigned Type : 5;
+			unsigned Dpl : 2;
+			unsigned Pres : 1;
+			unsigned LimitHi : 4;
+			unsigned Sys : 1;
+			unsigned Reserved_0 : 1;
+			unsigned Default_Big : 1;
+			unsigned Granularity : 1;
+			unsigned BaseHi : 8;
+		} Bits;
+	} HighWord;
+} LDT_ENTRY;
+
+// the types above stand in for windef.h and winbase.h, and the LDT part of library.h is for i386 only
+#define _WINDEF_
+#define __WINE_WINBASE_H
+#define __i386__
+#include "wine/library.h"
+#undef __i386__
+
+#define MEM_COMMIT 0x1000
+#define PAGE_NOACCESS 0x01
+#define PAGE_GUARD 0x100
+#define EXCEPTION_EXECUTE_HANDLER 1
+#pragma push_macro("__try")
+#pragma push_macro("__except")
+#undef __try
+#define __try if (1)
+#define __except(filter) else
+
+typedef struct
+{
+	DWORD State;
+	DWORD Protect;
+} MEMORY_BASIC_INFORMATION;
+
+static size_t VirtualQuery(LPCVOID address, MEMORY_BASIC_INFORMATION *mbi, size_t size)
+{
+	mbi->State = (const UINT8 *)address < mem + MAX_MEM ? MEM_COMMIT : 0;
+	mbi->Protect = 0;
+	return sizeof(*mbi);
+}
+
+/* The LDT, which is also the GDT as in init_vm86 */
+#define SESSION_LDT 0x100000
+#define wine_ldt ((LDT_ENTRY *)(mem + SESSION_LDT))
+
+#include "vm86rec.cpp"
+#include "replay.h"
+#pragma pop_macro("__try")
+#pragma pop_macro("__except")
+
+#define SEL_SESSION_CODE  0x0f
+#define SEL_SESSION_DATA  0x17
+#define SEL_SESSION_STACK 0x1f
+#define SEL_SESSION_IRET  0x27      // the interrupt gates lead to its offset 'vector'
+#define SEL_SESSION_FLAT  0x2f      // flat 32-bit code, the relay trap is at SESSION_FROM16
+#define SEL_SESSION_RET   0x37      // 16-bit code returns here to the 32-bit side
+#define SESSION_DYNAMIC   7         // the first LDT entry of those allocated by relay call 2
+#define SESSION_FROM16    0x9000
+#define SESSION_RET_BASE  0x9100
+#define SESSION_SEGMENTS  0x200000  // memory of the allocated segments, a page each
+
+#define SESSION_MAIN      0
+#define SESSION_CALLBACK  2
+
+static UINT32 session_seed;
+static int session_segments, session_handoffs;
+static bool session_blocks;
+
+static void session_descriptor(int index, UINT32 base, UINT32 limit, unsigned char flags)
+{
+	LDT_ENTRY *entry = &wine_ldt[index];
+
+	memset(entry, 0, sizeof(*entry));
+	wine_ldt_set_base(entry, (void *)(ULONG_PTR)base);
+	wine_ldt_set_limit(entry, limit);
+	wine_ldt_set_flags(entry, flags);
+}
+
+/* The protected mode set up by init_vm86 */
+static void session_setup(const UINT8 *code, UINT32 size)
+{
+	cpu_setup(MODE_PM16, NULL, 0);
+	memset(mem, 0, MAX_MEM);
+	memcpy(mem + CODE_BASE, code, size);
+	session_descriptor(1, CODE_BASE, 0xffff, WINE_LDT_FLAGS_CODE);
+	session_descriptor(2, DATA_BASE, 0xffff, WINE_LDT_FLAGS_DATA);
+	session_descriptor(3, STACK_BASE, 0xffff, WINE_LDT_FLAGS_DATA);
+	session_descriptor(4, HANDLER_BASE, 0xff, WINE_LDT_FLAGS_CODE);
+	session_descriptor(5, 0, 0xffffffff, WINE_LDT_FLAGS_CODE | WINE_LDT_FLAGS_32BIT);
+	session_descriptor(6, SESSION_RET_BASE, 0xf, WINE_LDT_FLAGS_CODE);
+	memset(mem + HANDLER_BASE, 0xcf, 256);      // iret
+	for (int v = 0; v < 256; v++)
+	{
+		UINT8 *gate = mem + IDT_BASE + v * 8;
+
+		memset(gate, 0, 8);
+		gate[0] = v;
+		gate[2] = SEL_SESSION_IRET;
+		gate[5] = 0x66 | 0x80;                   // present, DPL 3, 16-bit interrupt gate
+	}
+	m_gdtr.base = m_ldtr.base = SESSION_LDT;
+	m_gdtr.limit = m_ldtr.limit = 0xffff;
+	m_CPL = 3;
+	load_segment(CS, SEL_SESSION_CODE);
+	load_segment(DS, SEL_SESSION_DATA);
+	load_segment(ES, SEL_SESSION_DATA);
+	load_segment(SS, SEL_SESSION_STACK);
+	load_segment(FS, 0);
+	load_segment(GS, 0);
+	REG32(ESP) = 0xfff0;
+	i386_block_flush();
+}
+
+static void session_run();
+
+/* Call 16-bit code at cs:ip the way wine_call_to_16 does, with the return trap on the stack */
+static void session_call16(UINT16 cs, UINT16 ip)
+{
+	PUSH16(SEL_SESSION_RET);
+	PUSH16(0);
+	load_segment(CS, cs);
+	m_eip = ip;
+	CHANGE_PC(m_eip);
+	vm86_record_resume(VM86REC_ENTER);
+	session_run();
+	vm86_record_leave();
+	session_handoffs++;
+}
+
+/* A relay call, with the function number in ax */
+static void session_relay()
+{
+	UINT32 sp = m_sreg[SS].base + REG16(SP);
+	UINT32 ip = read_dword(sp), cs = read_dword(sp + 4) & 0xffff;
+	int function = REG16(AX);
+
+	vm86_record_call(function, cs, ip);
+	session_handoffs++;
+	REG16(SP) += 8;
+	switch (function)
+	{
+	case 0:
+		REG16(AX) = random32(&session_seed);
+		REG16(DX) = random32(&session_seed);
+		break;
+	case 1:
+		for (UINT32 i = 0; i < REG16(CX); i++)
+			mem[m_sreg[ES].base + ((REG16(DI) + i) & 0xffff)] = random32(&session_seed);
+		break;
+	case 2:
+	{
+		int index = SESSION_DYNAMIC + session_segments % 32;
+		UINT32 base = SESSION_SEGMENTS + (session_segments % 32) * 0x1000;
+
+		for (int i = 0; i < 0x1000; i++)
+			mem[base + i] = random32(&session_seed);
+		session_descriptor(index, base, 0xfff, WINE_LDT_FLAGS_DATA);
+		session_segments++;
+		REG16(AX) = (index << 3) | 7;
+		break;
+	}
+	case 3:
+	{
+		UINT32 regs[8], eflags = get_flags();
+		UINT16 sregs[6] = { SREG(ES), SREG(CS), SREG(SS), SREG(DS), SREG(FS), SREG(GS) };
+		static const int order[] = { ES, CS, SS, DS, FS, GS };
+		UINT16 result;
+
+		for (int i = 0; i < 8; i++)
+			regs[i] = REG32(i);
+		REG16(AX) = random32(&session_seed);
+		session_call16(SEL_SESSION_CODE, SESSION_CALLBACK);
+		result = REG16(AX);
+		for (int i = 0; i < 8; i++)
+			REG32(i) = regs[i];
+		set_flags(eflags);
+		for (int i = 0; i < 6; i++)
+			load_segment(order[i], sregs[i]);
+		REG16(AX) = result ^ 0x5555;
+		break;
+	}
+	}
+	load_segment(CS, cs);
+	m_eip = ip;
+	CHANGE_PC(m_eip);
+	vm86_record_resume(VM86REC_RETURN);
+}
+
+/* An interrupt or exception, at its iret */
+static void session_interrupt()
+{
+	UINT32 sp = m_sreg[SS].base + REG16(SP);
+	int num = m_eip;
+
+	vm86_record_int(num);
+	session_handoffs++;
+	if (num == 0)
+	{
+		// divide error: skip the div and give a result
+		write_word(sp, read_word(sp) + 2);
+		REG16(AX) = random32(&session_seed);
+	}
+	else if (num == 0x21)
+	{
+		REG16(AX) = random32(&session_seed);
+		write_word(m_sreg[DS].base + REG16(SI), random32(&session_seed));
+	}
+	vm86_record_resume(VM86REC_RETURN);
+}
+
+/* The loop of vm86main: run until the return trap, handing relay calls and interrupts to the 32-bit side */
+static void session_run()
+{
+	UINT64 start = m_insn_count;
+	bool interrupted = false;
+
+	while (SREG(CS) != SEL_SESSION_RET)
+	{
+		if (m_halted || m_insn_count - start > 10000000)
+		{
+			fail("session stopped at %04x:%08x\n", SREG(CS), m_eip);
+			return;
+		}
+		if (SREG(CS) == SEL_SESSION_IRET && !interrupted)
+		{
+			// vm86main runs the iret itself once the interrupt is handled
+			session_interrupt();
+			interrupted = true;
+			continue;
+		}
+		interrupted = false;
+		if (SREG(CS) == SEL_SESSION_FLAT && m_eip == SESSION_FROM16)
+			session_relay();
+		else if (session_blocks)
+			i386_block_execute();
+		else
+		{
+			m_cycles = 1;
+			CPU_EXECUTE_CALL(i386);
+		}
+	}
+}
+
+/* The memory the session uses */
+static UINT32 session_hash()
+{
+	UINT32 hash = fnv(2166136261u, mem + DATA_BASE, STATE_END - DATA_BASE);
+	return fnv(hash, mem + SESSION_SEGMENTS, 32 * 0x1000);
+}
+
+static bool session_replay(FILE *fp, bool blocks, UINT32 *hash, REPLAY_STATS *stats)
+{
+	bool ok;
+
+	memset(mem, 0, MAX_MEM);
+	rewind(fp);
+	ok = replay_log(fp, blocks, stats);
+	*hash = session_hash();
+	return ok;
+}
+
+static void test_record()
+{
+	char path[] = "/tmp/cputest-recordXXXXXX";
+	UINT32 size, hash, replayed;
+	UINT8 *code = load_kernel("session16", &size);
+	REPLAY_STATS stats;
+	std::vector<UINT8> log;
+	int fd = mkstemp(path);
+	FILE *fp;
+
+	if (fd < 0)
+	{
+		fail("cannot create %s\n", path);
+		return;
+	}
+	close(fd);
+	session_setup(code, size);
+	session_seed = 0x5e55104e;
+	session_blocks = true;
+	vm86_record_init(path);
+	session_call16(SEL_SESSION_CODE, SESSION_MAIN);
+	vm86_record_close();
+	hash = session_hash();
+	free(code);
+
+	fp = fopen(path, "rb");
+	unlink(path);
+	for (int blocks = 0; blocks < 2 && fp; blocks++)
+	{
+		if (!session_replay(fp, blocks != 0, &replayed, &stats))
+			fail("%s: the replay differs after %llu instructions\n", blocks ? "blocks" : "step", stats.insns);
+		else if (replayed != hash)
+			fail("%s: memory hash %08x, recorded %08x\n", blocks ? "blocks" : "step", replayed, hash);
+		else if (stats.handoffs != (UINT32)session_handoffs)
+			fail("%s: %u hand-offs, recorded %d\n", blocks ? "blocks" : "step", stats.handoffs, session_handoffs);
+	}
+	if (!fp)
+	{
+		fail("cannot read %s\n", path);
+		return;
+	}
+
+	// the ax the first relay call of main returns, some way into the log
+	rewind(fp);
+	log.resize(64 << 20);
+	log.resize(fread(&log[0], 1, log.size(), fp));
+	fclose(fp);
+	for (size_t offset = sizeof(VM86REC_FILE), calls = 0, ip = 0; offset + sizeof(VM86REC_HEADER) <= log.size(); )
+	{
+		VM86REC_HEADER *header = (VM86REC_HEADER *)&log[offset];
+		VM86REC_CALL_INFO *call = (VM86REC_CALL_INFO *)(header + 1);
+
+		if (header->type == VM86REC_CALL && (!ip || call->ip == ip))
+		{
+			ip = call->ip;
+			calls++;
+		}
+		else if (header->type == VM86REC_RETURN && calls == 100)
+		{
+			((VM86REC_STATE *)(header + 1))->eax ^= 0x100;
+			break;
+		}
+		offset += sizeof(*header) + header->size;
+	}
+	fp = fmemopen(&log[0], log.size(), "rb");
+	if (session_replay(fp, false, &replayed, &stats) && replayed == hash)
+		fail("a changed log replays the same\n");
+	fclose(fp);
+}
@@ -0,0 +1,125 @@
+/*
+	The relays convspec generates against relay_call_from_16_no_debug (krnl386/relay.c)
+
+	convspec, built for the host, writes the module of cpu/relay16.spec,
+	whose entry points take every argument type in every calling
+	convention, and the Makefile links its code and data at CODE_BASE
+	into kernels/relay16.bin.  vm86main calls the relay a CALLFROM16
+	entry names instead of relay_call_from_16 with DirectRelay=1.  Each
+	one runs here on random STACK16FRAMEs, with random arguments after
+	them and a random LDT copy, up to the hlt it calls as the entry point:
+	it must have pushed the arguments relay_call_from_16_no_debug passes
+	for the same frame, and must then return with the stack and the
+	registers it saves as they were.
+*/
+
+extern "C" int relay16_reference(UINT8 *mem, const UINT32 *ldt, UINT32 frame, UINT32 context, int *args);
+
+#define RELAY16_LDT     DATA_BASE               // wine_ldt_copy.base[]
+#define RELAY16_IMP     (DATA_BASE + 0x8000)    // _imp__wine_ldt_copy, as linked by the Makefile
+#define RELAY16_FRAME   (EXTRA_BASE + 0x100)
+#define RELAY16_CONTEXT (EXTRA_BASE + 0x1000)
+#define RELAY16_ENTRY   (EXTRA_BASE + 0x2000)   // hlt; ret
+#define RELAY16_RETURN  (EXTRA_BASE + 0x2002)   // hlt
+#define RELAY16_CODE_SEL 0x1007
+#define RELAY16_FRAMES  100
+
+/* CALLFROM16 of kernel16_private.h: pushl $relay; lcall $0,$0; the return sequence; movl arg_types */
+#define CALLFROM16_RELAY    1
+#define CALLFROM16_RET      12
+#define CALLFROM16_MOVL     22
+#define CALLFROM16_SIZE     32
+
+static bool is_callfrom16(const UINT8 *p)
+{
+	static const UINT8 lcall[] = { 0x9a, 0, 0, 0, 0, 0, 0 };
+
+	return p[0] == 0x68 && !memcmp(p + 5, lcall, sizeof(lcall)) && *(UINT16 *)(p + CALLFROM16_MOVL) == 0x86c7;
+}
+
+static void test_relay16()
+{
+	static const int saved_regs[] = { EBX, EBP, ESI, EDI };
+	UINT32 size, seed = 0x7e1a916, found = 0;
+	UINT8 *module = load_kernel("relay16", &size);
+
+	for (UINT32 callfrom = 0; callfrom + CALLFROM16_SIZE <= size; callfrom++)
+	{
+		UINT32 relay = *(UINT32 *)(module + callfrom + CALLFROM16_RELAY);
+
+		if (!is_callfrom16(module + callfrom))
+			continue;
+		found++;
+		for (int blocks = 0; blocks < 2; blocks++)
+		{
+			const char *how = blocks ? "block" : "step";
+
+			for (int n = 0; n < RELAY16_FRAMES; n++)
+			{
+				UINT32 *ldt, esp, saved[4];
+				int expected[20], nb_args;
+				UINT8 *frame;
+
+				cpu_setup(MODE_PM32, module, size);
+				ldt = (UINT32 *)(mem + RELAY16_LDT);
+				frame = mem + RELAY16_FRAME;
+				for (int i = 0; i < 8192; i++)
+					ldt[i] = random32(&seed) & 0x7fffffff;
+				ldt[RELAY16_CODE_SEL >> 3] = CODE_BASE;
+				*(UINT32 *)(mem + RELAY16_IMP) = RELAY16_LDT;
+				for (int i = 0; i < 0x30 + 64; i += 4)
+					*(UINT32 *)(frame + i) = random32(&seed);
+				*(UINT32 *)(frame + 0x18) = callfrom + CALLFROM16_RET;    // callfrom_ip
+				*(UINT32 *)(frame + 0x1c) = RELAY16_CODE_SEL;             // module_cs
+				*(UINT32 *)(frame + 0x20) = relay;                        // relay
+				*(UINT32 *)(frame + 0x26) = RELAY16_ENTRY;                // entry_point
+				mem[RELAY16_ENTRY] = 0xf4;
+				mem[RELAY16_ENTRY + 1] = 0xc3;
+				mem[RELAY16_RETURN] = 0xf4;
+				if ((nb_args = relay16_reference(mem, ldt, RELAY16_FRAME, RELAY16_CONTEXT, expected)) < 0)
+				{
+					fail("relay %05x: relay_call_from_16_no_debug called nothing\n", relay);
+					break;
+				}
+
+				// relay(entry_point, args16, context), called from RELAY16_RETURN
+				esp = STATE_END - 16;
+				*(UINT32 *)(mem + esp) = RELAY16_RETURN;
+				*(UINT32 *)(mem + esp + 4) = RELAY16_ENTRY;
+				*(UINT32 *)(mem + esp + 8) = RELAY16_FRAME + 0x30;
+				*(UINT32 *)(mem + esp + 12) = RELAY16_CONTEXT;
+				REG32(ESP) = esp;
+				for (int i = 0; i < 4; i++)
+					saved[i] = REG32(saved_regs[i]) = random32(&seed);
+				m_eip = relay;
+				CHANGE_PC(m_eip);
+				if (!cpu_run(blocks != 0, 10000) || m_eip != RELAY16_ENTRY + 1)
+				{
+					fail("relay %05x %s: did not call the entry point, stopped at %05x\n", relay, how, m_eip);
+					break;
+				}
+				for (int i = 0; i < nb_args; i++)
+				{
+					UINT32 arg = *(UINT32 *)(mem + REG32(ESP) + 4 + i * 4);
+
+					if (arg != (UINT32)expected[i])
+					{
+						fail("relay %05x %s frame %d: argument %d is %08x, expected %08x\n", relay, how, n, i, arg,
+							expected[i]);
+						break;
+					}
+				}
+				m_halted = 0;
+				if (!cpu_run(blocks != 0, 10000) || m_eip != RELAY16_RETURN + 1 || REG32(ESP) != esp + 4)
+					fail("relay %05x %s: did not return, stopped at %05x, esp %05x\n", relay, how, m_eip, REG32(ESP));
+				for (int i = 0; i < 4; i++)
+					if (REG32(saved_regs[i]) != saved[i])
+						fail("relay %05x %s: register %d not saved\n", relay, how, saved_regs[i]);
+			}
+		}
+	}
+	// one for each entry point of relay16.spec, all of different types
+	if (found != 16)
+		fail("%d CALLFROM16 entries in relay16.bin, expected 16\n", found);
+	free(module);
+}
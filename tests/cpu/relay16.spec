@@ -0,0 +1,17 @@
+# Entry points with every argument type and calling convention, for the relay16 test
+1 pascal -ret16 PascalWord(word s_word long ptr str segstr segptr wstr) PascalWord
+2 pascal PascalLong(long word ptr) PascalLong
+3 cdecl CdeclLong(word s_word long ptr str segstr segptr wstr) CdeclLong
+4 cdecl -ret16 CdeclWord(ptr word) CdeclWord
+5 varargs Varargs(str word) Varargs
+6 varargs NoFixedArgs() NoFixedArgs
+7 pascal -register PascalRegs(word long ptr) PascalRegs
+8 pascal -register NoArgsRegs() NoArgsRegs
+9 cdecl -register CdeclRegs(s_word ptr) CdeclRegs
+10 pascal NoArgs() NoArgs
+11 cdecl CdeclNoArgs() CdeclNoArgs
+12 pascal Wide(double int64 word float int128) Wide
+13 cdecl CdeclWide(word double int64 float) CdeclWide
+14 pascal Many(long word long word long word long word long word ptr word str s_word) Many
+15 cdecl CdeclMany(long word long word long word long word long word ptr word str s_word) CdeclMany
+16 varargs VarargsMany(long word long word long word long word long word) VarargsMany
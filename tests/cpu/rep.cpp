@@ -0,0 +1,245 @@
+/*
+	REP string instructions against their single-element form
+
+	I386OP(repeat) runs most of a REP MOVS/STOS/LODS/SCAS/CMPS with host
+	loops (i386_rep_fast) and only the rest one element at a time.  Each
+	generated case runs a REP instruction, once stepping and once through
+	the block cache, and compares the result with running the same
+	instruction without REP once per element, decrementing the count and
+	testing ZF between elements like the CPU does.  The cases mix prefixes
+	in both orders, both directions, both address and operand sizes,
+	overlapping MOVS, offsets that wrap at 64K and 16-bit protected mode
+	segments with small limits, where the run faults part of the way.
+
+	The core checks SI and DI against the limits before the first element
+	even for a zero count (as MAME does), so zero counts start in bounds.
+*/
+
+struct REP_CASE {
+	int mode;
+	UINT8 code[8];          // prefixes, the opcode and hlt
+	int length;
+	int opcode_pos;         // index of the REP prefix in code
+	UINT32 ds_limit, es_limit;
+	UINT32 esi, edi, ecx, eax;
+	bool df;
+	UINT32 fill;            // seed of the memory contents
+};
+
+static const UINT8 rep_opcodes[] = { 0xa4, 0xa5, 0xa6, 0xa7, 0xaa, 0xab, 0xac, 0xad, 0xae, 0xaf };
+static const UINT8 rep_segments[] = { 0x26, 0x2e, 0x36, 0x3e };
+
+static UINT32 rep_offset(UINT32 *seed, UINT32 other, int size, bool addr32, UINT32 limit)
+{
+	switch (random32(seed) % 5)
+	{
+	case 0:
+		return random32(seed) % 64;
+	case 1:
+		return (limit - random32(seed) % 64) & (addr32 ? 0xffffffff : 0xffff);
+	case 2:     // overlapping the other operand
+		return other + ((int)(random32(seed) % 9) - 4) * size;
+	default:
+		return random32(seed) % (limit + 1);
+	}
+}
+
+static void rep_generate(REP_CASE *c, UINT32 *seed)
+{
+	bool data32, addr32, rep_first;
+	UINT8 opcode = rep_opcodes[random32(seed) % ARRAY_LENGTH(rep_opcodes)];
+	int size, n = 0;
+	UINT32 limit;
+
+	memset(c, 0, sizeof(*c));
+	c->mode = (random32(seed) % 4 == 0) ? MODE_REAL : MODE_PM16;
+	data32 = random32(seed) % 3 == 0;
+	addr32 = random32(seed) % 4 == 0;
+	rep_first = random32(seed) & 1;
+	size = (opcode & 1) ? (data32 ? 4 : 2) : 1;
+
+	c->ds_limit = c->es_limit = 0xffff;
+	if (c->mode == MODE_PM16 && random32(seed) % 3 == 0)
+	{
+		c->ds_limit = 0x100 + random32(seed) % 0xff00;
+		c->es_limit = 0x100 + random32(seed) % 0xff00;
+	}
+	if (rep_first)
+		c->code[n++] = (random32(seed) % 3) ? 0xf3 : 0xf2;
+	if (random32(seed) % 3 == 0)
+		c->code[n++] = rep_segments[random32(seed) % ARRAY_LENGTH(rep_segments)];
+	if (data32)
+		c->code[n++] = 0x66;
+	if (addr32)
+		c->code[n++] = 0x67;
+	if (!rep_first)
+	{
+		c->opcode_pos = n;
+		c->code[n++] = (random32(seed) % 3) ? 0xf3 : 0xf2;
+	}
+	c->code[n++] = opcode;
+	c->code[n++] = 0xf4;
+	c->length = n;
+
+	limit = c->ds_limit < c->es_limit ? c->ds_limit : c->es_limit;
+	c->df = random32(seed) & 1;
+	switch (random32(seed) % 4)
+	{
+	case 0: c->ecx = random32(seed) % 4; break;
+	case 1: c->ecx = random32(seed) % 40; break;
+	case 2: c->ecx = random32(seed) % 600; break;
+	default: c->ecx = random32(seed) % 0x4000; break;
+	}
+	if (!addr32)
+		c->ecx |= random32(seed) & 0xffff0000;  // not part of the count
+	c->esi = rep_offset(seed, 0, size, addr32, limit);
+	c->edi = rep_offset(seed, c->esi, size, addr32, limit);
+	if (!addr32)
+	{
+		c->esi = (c->esi & 0xffff) | (random32(seed) & 0xffff0000);
+		c->edi = (c->edi & 0xffff) | (random32(seed) & 0xffff0000);
+	}
+	if ((addr32 ? c->ecx : c->ecx & 0xffff) == 0)
+	{
+		c->esi &= addr32 ? limit : 0xffff0000 | limit;
+		c->edi &= addr32 ? limit : 0xffff0000 | limit;
+	}
+	c->eax = random32(seed) % 4 * 0x01010101;
+	c->fill = random32(seed) | 1;
+}
+
+#define REP_AT      0x100     // where the REP instruction is
+#define ELEMENT_AT  0x180     // and the same without the REP prefix
+
+/* Set up a case to run from 'at'; both forms of the instruction are in
+   the code segment in either case, since CS may be the source */
+static void rep_prepare(const REP_CASE *c, UINT32 at)
+{
+	UINT32 seed = c->fill;
+	int pos = c->opcode_pos;
+
+	cpu_setup(c->mode, NULL, 0);
+	memcpy(mem + CODE_BASE + REP_AT, c->code, c->length);
+	memcpy(mem + CODE_BASE + ELEMENT_AT, c->code, pos);
+	memcpy(mem + CODE_BASE + ELEMENT_AT + pos, c->code + pos + 1, c->length - pos - 1);
+	// few different values, so that SCAS and CMPS stop now and then
+	for (UINT32 a = DATA_BASE; a < STACK_BASE; a += 4)
+	{
+		UINT32 r = random32(&seed);
+		*(UINT32 *)(mem + a) = (r & 0x0f0f0f0f) < 0x0c0c0c0c ? 0 : r & 0x03030303;
+	}
+	if (c->mode == MODE_PM16)
+	{
+		set_descriptor(SEL_DATA16, DATA_BASE, c->ds_limit, 0x92, 0);
+		set_descriptor(SEL_EXTRA16, EXTRA_BASE, c->es_limit, 0x92, 0);
+		load_segment(DS, SEL_DATA16);
+		load_segment(ES, SEL_EXTRA16);
+	}
+	REG32(ESI) = c->esi;
+	REG32(EDI) = c->edi;
+	REG32(ECX) = c->ecx;
+	REG32(EAX) = c->eax;
+	m_DF = c->df;
+	m_eip = at;
+	CHANGE_PC(m_eip);
+}
+
+struct REP_RESULT {
+	UINT32 reg[8];
+	UINT32 flags;
+	int vector;
+	UINT32 error;
+	UINT32 hash;
+};
+
+static void rep_result(REP_RESULT *r)
+{
+	for (int i = 0; i < 8; i++)
+		r->reg[i] = REG32(i);
+	r->flags = get_flags() & 0xcd5;
+	r->vector = cpu_vector();
+	// #GP and #SS push an error code
+	r->error = (r->vector == 12 || r->vector == 13) ? cpu_frame(0) : 0;
+	r->hash = fnv(2166136261u, mem + DATA_BASE, STACK_BASE - DATA_BASE);
+}
+
+static void rep_run(const REP_CASE *c, bool blocks, REP_RESULT *r)
+{
+	rep_prepare(c, REP_AT);
+	cpu_run(blocks);
+	rep_result(r);
+}
+
+/* The same case, with the element instruction run once per count */
+static void rep_reference(const REP_CASE *c, REP_RESULT *r)
+{
+	UINT8 rep = c->code[c->opcode_pos];
+	UINT8 opcode = c->code[c->length - 2];
+	bool addr32 = memchr(c->code, 0x67, c->length) != NULL;
+
+	rep_prepare(c, ELEMENT_AT);
+	while (addr32 ? REG32(ECX) : REG16(CX))
+	{
+		m_eip = ELEMENT_AT;
+		CHANGE_PC(m_eip);
+		cpu_run(false);
+		if (cpu_vector() >= 0)
+			break;
+		m_halted = 0;
+		if (addr32)
+			REG32(ECX)--;
+		else
+			REG16(CX)--;
+		if ((opcode & 0xf6) == 0xa6 && (rep == 0xf3 ? !m_ZF : m_ZF))
+			break;
+	}
+	if (cpu_vector() < 0)
+	{
+		// end at the hlt like the REP run does
+		m_halted = 0;
+		m_eip = ELEMENT_AT + c->length - 2;
+		CHANGE_PC(m_eip);
+		cpu_run(false);
+	}
+	rep_result(r);
+}
+
+static bool rep_compare(const REP_RESULT *a, const REP_RESULT *b)
+{
+	return !memcmp(a->reg, b->reg, sizeof(a->reg)) && a->flags == b->flags && a->vector == b->vector &&
+		a->error == b->error && a->hash == b->hash;
+}
+
+static void rep_print(const char *name, const REP_RESULT *r)
+{
+	printf("  %-9s eax %08x ecx %08x esi %08x edi %08x flags %03x vector %d error %04x hash %08x\n",
+		name, r->reg[EAX], r->reg[ECX], r->reg[ESI], r->reg[EDI], r->flags, r->vector, r->error, r->hash);
+}
+
+static void test_rep()
+{
+	UINT32 seed = 0x2e9a1c57;
+	int shown = 0;
+
+	for (int i = 0; i < 20000; i++)
+	{
+		REP_CASE c;
+		REP_RESULT ref, step, block;
+
+		rep_generate(&c, &seed);
+		rep_reference(&c, &ref);
+		rep_run(&c, false, &step);
+		rep_run(&c, true, &block);
+		if (rep_compare(&ref, &step) && rep_compare(&ref, &block))
+			continue;
+		fail("case %d, %s, ds limit %04x, es limit %04x, df %d, code", i, mode_name[c.mode], c.ds_limit, c.es_limit, c.df);
+		for (int j = 0; j < c.length; j++)
+			printf(" %02x", c.code[j]);
+		printf("\n  start     eax %08x ecx %08x esi %08x edi %08x\n", c.eax, c.ecx, c.esi, c.edi);
+		rep_print("elements", &ref);
+		rep_print("step", &step);
+		rep_print("block", &block);
+		if (++shown == 10)
+			break;
+	}
+}
@@ -0,0 +1,233 @@
+/*
+	Headless replay of a vm86 recording (Record in otvdm.ini, the format
+	is described in vm86/vm86rec.h)
+
+	The core is put in protected mode with the descriptor tables, the LDT
+	and the memory the log starts with, and run from each VM86REC_ENTER
+	or VM86REC_RETURN state up to the position of the next hand-off to
+	the 32-bit side.  What the 32-bit side changed in the LDT and in
+	memory and the state it resumes with are then loaded from the log.
+	At each hand-off the core must be where it was when recording: a
+	relay call with its return address on the stack, an interrupt at the
+	CS:IP it was delivered to, and all the registers when it leaves
+	vm86main.
+
+	Used by vm86replay and by the record test.
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <vector>
+#include "vm86rec.h"
+
+struct REPLAY_STATS {
+	UINT64 insns;           // instructions run
+	UINT32 records;
+	UINT32 handoffs;        // VM86REC_CALL, VM86REC_INT and VM86REC_LEAVE records
+};
+
+static void replay_load_state(const VM86REC_STATE *state)
+{
+	static const int sregs[] = { ES, CS, SS, DS, FS, GS };
+	const UINT16 *selector = &state->es;
+
+	REG32(EAX) = state->eax;
+	REG32(ECX) = state->ecx;
+	REG32(EDX) = state->edx;
+	REG32(EBX) = state->ebx;
+	REG32(ESP) = state->esp;
+	REG32(EBP) = state->ebp;
+	REG32(ESI) = state->esi;
+	REG32(EDI) = state->edi;
+	set_flags(state->eflags);
+	for (int i = 0; i < 6; i++)
+		load_segment(sregs[i], selector[i]);
+	m_eip = state->eip;
+	CHANGE_PC(m_eip);
+}
+
+static bool replay_check_state(const VM86REC_STATE *state, UINT64 position)
+{
+	VM86REC_STATE core;
+
+	core.eax = REG32(EAX);
+	core.ecx = REG32(ECX);
+	core.edx = REG32(EDX);
+	core.ebx = REG32(EBX);
+	core.esp = REG32(ESP);
+	core.ebp = REG32(EBP);
+	core.esi = REG32(ESI);
+	core.edi = REG32(EDI);
+	core.eip = m_eip;
+	core.eflags = get_flags();
+	core.es = SREG(ES);
+	core.cs = SREG(CS);
+	core.ss = SREG(SS);
+	core.ds = SREG(DS);
+	core.fs = SREG(FS);
+	core.gs = SREG(GS);
+	if (!memcmp(&core, state, sizeof(core)))
+		return true;
+	fprintf(stderr, "%llu: left with %04x:%08x eax %08x ebx %08x ecx %08x edx %08x esi %08x edi %08x esp %08x flags %08x,\n"
+		"  recorded %04x:%08x eax %08x ebx %08x ecx %08x edx %08x esi %08x edi %08x esp %08x flags %08x\n",
+		position, core.cs, core.eip, core.eax, core.ebx, core.ecx, core.edx, core.esi, core.edi, core.esp, core.eflags,
+		state->cs, state->eip, state->eax, state->ebx, state->ecx, state->edx, state->esi, state->edi, state->esp, state->eflags);
+	return false;
+}
+
+/* Run the core until it has retired the instructions up to 'position' */
+static bool replay_run(UINT64 position, bool blocks)
+{
+	CHANGE_PC(m_eip);
+	while (m_insn_count < position && !m_halted)
+	{
+		if (blocks)
+		{
+			i386_block_execute();
+		}
+		else
+		{
+			m_cycles = 1;
+			CPU_EXECUTE_CALL(i386);
+		}
+	}
+	if (m_insn_count == position)
+		return true;
+	fprintf(stderr, "%llu: the core %s at %llu, %04x:%08x\n", position, m_halted ? "halted" : "went on", m_insn_count, SREG(CS), m_eip);
+	return false;
+}
+
+static bool replay_memory(UINT32 address, const UINT8 *data, UINT32 size)
+{
+	if (address >= MAX_MEM || size > MAX_MEM - address)
+	{
+		fprintf(stderr, "memory at %08x is outside the %08x bytes replayed\n", address, MAX_MEM);
+		return false;
+	}
+	memcpy(mem + address, data, size);
+	i386_block_flush();
+	return true;
+}
+
+/* Replay the log from its start, false on the first difference */
+static bool replay_log(FILE *fp, bool blocks, REPLAY_STATS *stats)
+{
+	VM86REC_FILE file;
+	VM86REC_HEADER header;
+	VM86REC_TABLES_INFO tables;
+	std::vector<UINT8> payload;
+	bool entered = false;
+	UINT64 start = 0;
+
+	memset(stats, 0, sizeof(*stats));
+	if (fread(&file, sizeof(file), 1, fp) != 1 || memcmp(file.magic, VM86REC_MAGIC, sizeof(VM86REC_MAGIC)))
+	{
+		fprintf(stderr, "not a vm86 recording\n");
+		return false;
+	}
+	if (file.version != VM86REC_VERSION)
+	{
+		fprintf(stderr, "version %u, only %u is replayed\n", file.version, VM86REC_VERSION);
+		return false;
+	}
+	cpu_setup(MODE_REAL, NULL, 0);
+	memset(mem, 0, 0x100000);
+	m_count_insns = true;
+	while (fread(&header, sizeof(header), 1, fp) == 1)
+	{
+		payload.resize(header.size + 1);
+		if (header.size && fread(&payload[0], header.size, 1, fp) != 1)
+		{
+			fprintf(stderr, "%llu: record cut short\n", header.position);
+			return false;
+		}
+		stats->records++;
+		if (!entered && header.type != VM86REC_TABLES && header.type != VM86REC_LDT && header.type != VM86REC_MEMORY &&
+			header.type != VM86REC_ENTER)
+		{
+			fprintf(stderr, "%llu: record %u before the core is entered\n", header.position, header.type);
+			return false;
+		}
+		switch (header.type)
+		{
+		case VM86REC_TABLES:
+			memcpy(&tables, &payload[0], sizeof(tables));
+			m_gdtr.base = tables.gdt_base;
+			m_gdtr.limit = tables.gdt_limit;
+			m_idtr.base = tables.idt_base;
+			m_idtr.limit = tables.idt_limit;
+			m_ldtr.base = tables.ldt_base;
+			m_ldtr.limit = tables.ldt_limit;
+			m_CPL = tables.cpl;
+			m_cr[0] = tables.cr0;
+			break;
+		case VM86REC_LDT:
+		{
+			const VM86REC_LDT_INFO *info = (const VM86REC_LDT_INFO *)&payload[0];
+			if (!replay_memory(m_ldtr.base + info->index * 8, &payload[sizeof(*info)], info->count * 8))
+				return false;
+			break;
+		}
+		case VM86REC_MEMORY:
+		{
+			const VM86REC_MEMORY_INFO *info = (const VM86REC_MEMORY_INFO *)&payload[0];
+			if (!replay_memory(info->address, &payload[sizeof(*info)], header.size - sizeof(*info)))
+				return false;
+			break;
+		}
+		case VM86REC_ENTER:
+		case VM86REC_RETURN:
+			if (!entered)
+				m_insn_count = start = header.position;
+			entered = true;
+			replay_load_state((const VM86REC_STATE *)&payload[0]);
+			break;
+		case VM86REC_CALL:
+		{
+			const VM86REC_CALL_INFO *info = (const VM86REC_CALL_INFO *)&payload[0];
+			UINT32 sp;
+
+			stats->handoffs++;
+			if (!replay_run(header.position, blocks))
+				return false;
+			// the relay thunk called the trap far with 32-bit operands
+			sp = m_sreg[SS].base + REG16(SP);
+			if (read_dword(sp) != info->ip || (UINT16)read_dword(sp + 4) != info->cs)
+			{
+				fprintf(stderr, "%llu: call to %08x from %04x:%04x, the stack returns to %04x:%04x\n", header.position, info->entry,
+					info->cs, info->ip, read_dword(sp + 4) & 0xffff, read_dword(sp));
+				return false;
+			}
+			break;
+		}
+		case VM86REC_INT:
+		{
+			const VM86REC_INT_INFO *info = (const VM86REC_INT_INFO *)&payload[0];
+
+			stats->handoffs++;
+			if (!replay_run(header.position, blocks))
+				return false;
+			if (SREG(CS) != info->cs || m_eip != info->ip)
+			{
+				fprintf(stderr, "%llu: interrupt %02x at %04x:%04x, the core is at %04x:%08x\n", header.position, info->num,
+					info->cs, info->ip, SREG(CS), m_eip);
+				return false;
+			}
+			break;
+		}
+		case VM86REC_LEAVE:
+			stats->handoffs++;
+			if (!replay_run(header.position, blocks) || !replay_check_state((const VM86REC_STATE *)&payload[0], header.position))
+				return false;
+			break;
+		default:
+			fprintf(stderr, "%llu: unknown record %u\n", header.position, header.type);
+			return false;
+		}
+		stats->insns = m_insn_count - start;
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,147 @@
+/*
+	Segment registers after a relay call (vm86/vm86seg.cpp)
+
+	Relay calls are simulated in the protected mode of the record test:
+	the segment registers are saved as vm86main does before the call, the
+	32-bit side changes nothing, returns other selectors, moves or resizes
+	segments, loaded ones among them, or calls back into 16-bit code that
+	loads other segments and leaves their descriptors in the core, and the
+	selectors of the returned CONTEXT are reloaded the way vm86main does.
+	The segment registers must end up as if all six had been loaded, and
+	only the ones that changed may be loaded.
+*/
+
+static int segment_loads;
+
+#define i386_load_segment_descriptor(sreg) (segment_loads++, i386_load_segment_descriptor(sreg))
+#define i386_jmp_far(selector, address) (segment_loads++, i386_jmp_far(selector, address))
+#include "vm86seg.cpp"
+#undef i386_load_segment_descriptor
+#undef i386_jmp_far
+
+#define SEGMENT_FIRST   8           // LDT entries the calls set up, with SESSION_SEGMENTS memory
+#define SEGMENT_COUNT   8
+
+static bool segment_same(const I386_SREG *a, const I386_SREG *b)
+{
+	return a->selector == b->selector && a->flags == b->flags && a->base == b->base && a->limit == b->limit &&
+		a->d == b->d && a->valid == b->valid && a->win_lo == b->win_lo && a->win_span == b->win_span && a->win_rw == b->win_rw;
+}
+
+/* A data selector: null, the session ones or those set up by the calls */
+static UINT16 segment_data(UINT32 *seed)
+{
+	int n = random32(seed) % (SEGMENT_COUNT + 3);
+
+	if (n == 0)
+		return 0;
+	if (n == 1)
+		return SEL_SESSION_DATA;
+	if (n == 2)
+		return SEL_SESSION_STACK;
+	return (SEGMENT_FIRST + n - 3) << 3 | 7;
+}
+
+static void segment_entry(int index, UINT32 *seed)
+{
+	int n = index - SEGMENT_FIRST;
+
+	session_descriptor(index, SESSION_SEGMENTS + n * 0x1000 + (random32(seed) & 0xff0), 0xfff - (random32(seed) & 0xff),
+		WINE_LDT_FLAGS_DATA);
+}
+
+static void test_segments()
+{
+	static const UINT8 code[] = { 0xf4 };
+	static const int order[] = { ES, CS, SS, DS, FS, GS };
+	UINT32 seed = 0x5e65e6a5;
+	int calls = 0, loads = 0, shown = 0;
+
+	session_setup(code, sizeof(code));
+	for (int i = SEGMENT_FIRST; i < SEGMENT_FIRST + SEGMENT_COUNT; i++)
+		segment_entry(i, &seed);
+	// code on the same memory to return to
+	session_descriptor(SEGMENT_FIRST + SEGMENT_COUNT, CODE_BASE, 0xfff, WINE_LDT_FLAGS_CODE);
+	for (int n = 0; n < 20000 && shown < 10; n++, calls++)
+	{
+		segment_snapshot snapshot;
+		UINT16 selector[6];
+		I386_SREG loaded[6];
+		UINT32 eip = random32(&seed) & 0xffe, pc;
+		int changed = 0;
+
+		// the 16-bit code loads its segments, then calls the 32-bit side
+		load_segment(DS, segment_data(&seed));
+		load_segment(ES, segment_data(&seed));
+		load_segment(FS, segment_data(&seed));
+		load_segment(GS, segment_data(&seed));
+		save_segments(&snapshot);
+		for (int i = 0; i < 6; i++)
+			selector[i] = SREG(i);
+		switch (random32(&seed) % 8)
+		{
+		case 0:
+			// returns other selectors in the CONTEXT
+			selector[DS] = segment_data(&seed);
+			selector[ES] = segment_data(&seed);
+			if (random32(&seed) % 2)
+				selector[CS] = (SEGMENT_FIRST + SEGMENT_COUNT) << 3 | 7;
+			break;
+		case 1:
+		case 2:
+			// moves or resizes a segment, maybe the one in DS
+			if (random32(&seed) % 2 && SREG(DS) >> 3 >= SEGMENT_FIRST)
+				segment_entry(SREG(DS) >> 3, &seed);
+			else
+				segment_entry(SEGMENT_FIRST + random32(&seed) % SEGMENT_COUNT, &seed);
+			break;
+		case 3:
+			// calls back into 16-bit code, which loads its own segments
+			load_segment(DS, segment_data(&seed));
+			load_segment(ES, segment_data(&seed));
+			load_segment(FS, segment_data(&seed));
+			if (random32(&seed) % 2)
+				load_segment(CS, (SEGMENT_FIRST + SEGMENT_COUNT) << 3 | 7);
+			break;
+		}
+		// the return path of vm86main
+		for (int i = 0; i < 6; i++)
+			SREG(i) = selector[i];
+		// a register changed if what the core holds is not what loading it gives, or its selector or entry was set again
+		for (int i = 0; i < 6; i++)
+		{
+			I386_SREG current = m_sreg[i];
+
+			i386_load_protected_mode_segment(&current, NULL);
+			changed += !segment_same(&m_sreg[i], &current) || snapshot.sreg[i].selector != selector[i] ||
+				memcmp(&snapshot.entry[i], &wine_ldt[selector[i] >> 3], sizeof(LDT_ENTRY));
+		}
+		segment_loads = 0;
+		reload_segments(&snapshot, eip);
+		loads += segment_loads;
+		memcpy(loaded, m_sreg, sizeof(loaded));
+		pc = m_pc;
+		// against loading all six
+		for (int i = 0; i < 6; i++)
+		{
+			if (order[i] != CS)
+				load_segment(order[i], selector[order[i]]);
+		}
+		m_eip = eip;
+		i386_protected_mode_jump(selector[CS], eip, 1, m_operand_size);
+		for (int i = 0; i < 6; i++)
+		{
+			if (segment_same(&loaded[i], &m_sreg[i]) || shown++ >= 10)
+				continue;
+			fail("call %d: sreg %d %04x loaded base %08x limit %08x flags %04x, expected base %08x limit %08x flags %04x\n", n, i,
+				selector[i], loaded[i].base, loaded[i].limit, loaded[i].flags, m_sreg[i].base, m_sreg[i].limit, m_sreg[i].flags);
+		}
+		if (pc != m_pc && shown++ < 10)
+			fail("call %d: pc %08x, expected %08x\n", n, pc, m_pc);
+		if (segment_loads > changed && shown++ < 10)
+			fail("call %d: %d descriptor loads for %d changed segment registers\n", n, segment_loads, changed);
+	}
+	// most calls change nothing
+	if (loads > calls * 3)
+		fail("%d descriptor loads in %d calls\n", loads, calls);
+}
@@ -0,0 +1,60 @@
+/*
+	Block invalidation by the bytes written
+
+	A call records a block on the third code page and a loop on the first
+	one writes to the second page, which holds no code, and then into the
+	block on the third.  Next the code rewrites the first byte of the block
+	the call returned to, and writes data on the first page past all of
+	the code.  Only the two blocks written into may be invalidated: the
+	loop and the block doing the writes stay valid.  Whether code running
+	after such writes is right is checked by the smc16 kernel in the block
+	test.
+*/
+
+static const UINT8 smc_code[] = {
+	0x8c, 0xc8,                         // 00 mov ax,cs
+	0x83, 0xf8, 0x08,                   // 02 cmp ax,SEL_CODE16
+	0x75, 0x03,                         // 05 jne 0a
+	0xb8, 0x38, 0x00,                   // 07 mov ax,SEL_ALIAS16
+	0x8e, 0xc0,                         // 0a mov es,ax
+	0xe8, 0xf1, 0x1f,                   // 0c call 2000
+	0xbd, 0x64, 0x00,                   // 0f mov bp,100
+	0x26, 0x89, 0x84, 0x00, 0x10,       // 12 mov es:[si+1000],ax
+	0x46,                               // 17 inc si
+	0x4d,                               // 18 dec bp
+	0x75, 0xf7,                         // 19 jnz 12
+	0x26, 0xc6, 0x06, 0x01, 0x20, 0xcc, // 1b mov byte es:[2001],cc
+	0x26, 0xc6, 0x06, 0x0f, 0x00, 0xbd, // 21 mov byte es:[000f],bd
+	0x26, 0xa3, 0x00, 0x01,             // 27 mov es:[0100],ax
+	0xf4,                               // 2b hlt
+};
+
+/* True if the block for the code at CODE_BASE + offset is cached and valid */
+static bool smc_valid(UINT32 offset)
+{
+	UINT32 pc = CODE_BASE + offset;
+	const I386_BLOCK *block = &m_block_cache[(pc ^ (pc >> 11)) & (I386_BLOCK_CACHE_SIZE - 1)];
+
+	return block->pc == pc && block->generation == m_block_generation;
+}
+
+static void test_smc()
+{
+	UINT8 code[0x2002];
+
+	memset(code, 0x90, sizeof(code));
+	memcpy(code, smc_code, sizeof(smc_code));
+	code[0x2000] = 0xc3;    // ret
+	for (int mode = MODE_REAL; mode <= MODE_PM16; mode++)
+	{
+		cpu_setup(mode, code, sizeof(code));
+		cpu_run(true);
+		if (mem[CODE_BASE + 0x2001] != 0xcc || *(UINT16 *)&mem[CODE_BASE + 0x1000 + 99] != (mode == MODE_PM16 ? SEL_ALIAS16 : CODE_BASE >> 4))
+			fail("%s: did not run to the end, eip %08x\n", mode_name[mode], m_eip);
+		else if (smc_valid(0x2000) || smc_valid(0x0f))
+			fail("%s: a written block is still valid (%d %d)\n", mode_name[mode], smc_valid(0x2000), smc_valid(0x0f));
+		else if (!smc_valid(0x12) || !smc_valid(0x1b))
+			fail("%s: blocks that were not written were invalidated (%d %d)\n", mode_name[mode],
+				smc_valid(0x12), smc_valid(0x1b));
+	}
+}
@@ -0,0 +1,79 @@
+/*
+	Trap pages of vm86main (vm86/vm86trap.cpp)
+
+	V86 code far calls a thunk a thousand times, and near calls a function
+	on the same page after each.  The thunk is on a page marked with
+	vm86_set_trap and holds a hlt: the vm86main stand-in must intercept
+	every call to it, while the function next to it runs as any other
+	code.  The function is a loop the block cache would chain, which on a
+	trap page must stop after each pass for vm86main to see where it is.
+*/
+
+#include "v86.h"
+
+#define TRAP_THUNK  0xe000
+#define TRAP_NEAR   0xe010
+#define TRAP_LOOP   0xe013
+#define TRAP_CALLS  1000
+
+static const UINT8 trap_code[] = {
+	0xb9, 0xe8, 0x03,                   // 00 mov cx,1000
+	0x9a, 0x00, 0xe0, 0x00, 0x10,       // 03 call 1000:e000
+	0xe8, 0x05, 0xe0,                   // 08 call e010
+	0x42,                               // 0b inc dx
+	0xe2, 0xf5,                         // 0c loop 03
+	0xf4,                               // 0e hlt
+};
+
+static const UINT8 trap_near[] = {
+	0xbe, 0x03, 0x00,                   // e010 mov si,3
+	0x43,                               // e013 inc bx
+	0x4e,                               // e014 dec si
+	0x75, 0xfc,                         // e015 jnz e013
+	0xc3,                               // e017 ret
+};
+
+static void test_trap()
+{
+	static UINT8 code[TRAP_NEAR + sizeof(trap_near)];
+	UINT64 start;
+
+	memcpy(code, trap_code, sizeof(trap_code));
+	code[TRAP_THUNK] = 0xf4;        // hlt, never run
+	memcpy(code + TRAP_NEAR, trap_near, sizeof(trap_near));
+	resolve_krnl386_exports();
+	vm86_set_trap(CODE_BASE + TRAP_THUNK);
+	v86_thunk = CODE_BASE + TRAP_THUNK;
+	for (int blocks = 0; blocks < 2; blocks++)
+	{
+		const char *how = blocks ? "block" : "step";
+
+		memset(&v86_calls, 0, sizeof(v86_calls));
+		cpu_setup(MODE_V86, code, sizeof(code));
+		REG16(BX) = REG16(DX) = 0;
+		v86_run(blocks != 0, 100000);
+		// the hlt raises #GP in V86 mode
+		if (cpu_vector() != 13 || cpu_frame(1) != 0x0e)
+			fail("%s: did not end at the hlt, vector %d at %04x\n", how, cpu_vector(), cpu_frame(1));
+		if (v86_calls.thunks != TRAP_CALLS)
+			fail("%s: %d calls to the thunk intercepted, expected %d\n", how, v86_calls.thunks, TRAP_CALLS);
+		if (REG16(BX) != 3 * TRAP_CALLS || REG16(DX) != TRAP_CALLS)
+			fail("%s: bx %04x dx %04x, expected %04x %04x\n", how, REG16(BX), REG16(DX), 3 * TRAP_CALLS, TRAP_CALLS);
+	}
+	v86_thunk = 0;
+
+	// the loop on the trap page is not chained
+	cpu_setup(MODE_V86, code, sizeof(code));
+	i386_block_set_event(vm86_block_event);
+	vm86_block_teb = &v86_teb_info;
+	v86_teb_info.vm86_pending = 0;
+	m_count_insns = true;
+	m_eip = TRAP_LOOP;
+	CHANGE_PC(m_eip);
+	REG16(SI) = 0x1000;
+	start = m_insn_count;
+	i386_block_execute();
+	if (m_insn_count - start != 3)
+		fail("%llu instructions run by a loop on a trap page, expected 3\n", m_insn_count - start);
+	i386_block_set_event(NULL);
+}
@@ -0,0 +1,321 @@
+/*
+	V86 mode under a stand-in for vm86main, with fake krnl386 exports
+
+	vm86ctx.cpp resolves the krnl386 exports and wraps them, and holds
+	save_context, load_context and the V86 event and interrupt handling
+	built on them.  LoadLibraryA and
+	GetProcAddress below hand out the fakes, which count their calls, and
+	NtCurrentTeb a TEB of this thread.  v86_run() steps the core the way
+	vm86main does in V86 mode, with the trap pages of vm86trap.cpp: a far
+	call to v86_thunk, on a page marked with vm86_set_trap, is counted in
+	v86_calls.thunks and returned from as vm86main returns from a from16
+	thunk.
+
+	v86_queue_irq() and the fake vm86_send_queued_events stand in for the
+	DOS event queue of krnl386/dosvm.c: DOSVM_QueueEvent, which may run on
+	any thread and sets VIP with InterlockedOr, and DOSVM_SendQueuedEvents
+	with DOSVM_HardwareInterruptRM, which reflect one IRQ at a time to its
+	real-mode vector.  The handler ends it with INT V86_EOI, which stands
+	for the out 20h,20h krnl386 would see.
+*/
+
+#ifndef V86_H
+#define V86_H
+
+#include <pthread.h>
+
+typedef void *PVOID;
+typedef void *HMODULE;
+
+struct CONTEXT
+{
+	DWORD Eax, Ecx, Edx, Ebx, Esp, Ebp, Esi, Edi, Eip, EFlags;
+	DWORD SegCs, SegDs, SegEs, SegFs, SegGs, SegSs;
+};
+
+/* kernel16_private.h */
+#define WOW32RESERVED_TLS_INDEX 0x20
+
+typedef struct
+{
+	DWORD        dpmi_vif;
+	DWORD        vm86_pending;
+} WINE_VM86_TEB_INFO;
+
+static struct
+{
+	int lookups;            // GetProcAddress
+	int teb_info;           // getGdiTebBatch
+	int ints;               // __wine_call_int_handler
+	int events;             // vm86_send_queued_events
+	int thunks;             // far calls v86_run intercepted at v86_thunk
+	BYTE last_int;
+	WORD int_cs, int_ip;    // where the last INT was, as the handler saw it
+} v86_calls;
+
+static WINE_VM86_TEB_INFO v86_teb_info;
+static thread_local BYTE v86_teb[0x1000];
+
+#define V86_EOI     0x7f
+#define V86_QUEUE   0x10000
+
+static struct
+{
+	pthread_mutex_t lock;       // qcrit
+	UINT64 queued, delivered, acknowledged;
+	bool in_service;            // current_event
+	BYTE irq[V86_QUEUE];
+	LARGE_INTEGER time[V86_QUEUE];
+	UINT64 insns[V86_QUEUE];    // m_insn_count when queued on the VM thread, else 0
+	double latency, max_latency;            // seconds from queueing to the vector, summed
+	UINT64 insn_latency, max_insn_latency;  // instructions, of the IRQs queued on the VM thread
+} v86_events = { PTHREAD_MUTEX_INITIALIZER };
+
+static void v86_events_reset()
+{
+	pthread_mutex_lock(&v86_events.lock);
+	v86_events.queued = v86_events.delivered = v86_events.acknowledged = 0;
+	v86_events.in_service = false;
+	v86_events.latency = v86_events.max_latency = 0;
+	v86_events.insn_latency = v86_events.max_insn_latency = 0;
+	pthread_mutex_unlock(&v86_events.lock);
+}
+
+/* DOSVM_HasPendingEvents: all IRQs have the same priority */
+static bool v86_events_pending()
+{
+	return v86_events.delivered != v86_events.queued && !v86_events.in_service;
+}
+
+/* DOSVM_QueueEvent for an IRQ; 'insns' is m_insn_count on the VM thread, 0 on others */
+static void v86_queue_irq(int irq, UINT64 insns = 0)
+{
+	pthread_mutex_lock(&v86_events.lock);
+	while (v86_events.queued - v86_events.delivered == V86_QUEUE)
+	{
+		pthread_mutex_unlock(&v86_events.lock);
+		sched_yield();
+		pthread_mutex_lock(&v86_events.lock);
+	}
+	bool old_pending = v86_events_pending();
+	int n = v86_events.queued++ % V86_QUEUE;
+	v86_events.irq[n] = irq;
+	v86_events.insns[n] = insns;
+	QueryPerformanceCounter(&v86_events.time[n]);
+	if (!old_pending && v86_events_pending())
+		__atomic_fetch_or(&v86_teb_info.vm86_pending, 0x100000, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&v86_events.lock);
+}
+
+/* DOSVM_SendQueuedEvents */
+static void v86_send_queued_events(CONTEXT *context)
+{
+	DWORD old_cs = context->SegCs;
+	DWORD old_ip = context->Eip;
+	LARGE_INTEGER now, frequency;
+
+	pthread_mutex_lock(&v86_events.lock);
+	while (context->SegCs == old_cs && context->Eip == old_ip && v86_events_pending())
+	{
+		int n = v86_events.delivered++ % V86_QUEUE;
+		BYTE intnum = v86_events.irq[n] < 8 ? v86_events.irq[n] + 8 : v86_events.irq[n] - 8 + 0x70;
+		UINT8 *stack = mem + (context->SegSs << 4);
+		WORD sp = context->Esp;
+
+		v86_events.in_service = true;
+		// DOSVM_HardwareInterruptRM for a hooked vector
+		sp -= 2, *(WORD *)(stack + sp) = context->EFlags;
+		sp -= 2, *(WORD *)(stack + sp) = context->SegCs;
+		sp -= 2, *(WORD *)(stack + sp) = context->Eip;
+		context->Esp = (context->Esp & ~0xffff) | sp;
+		context->SegCs = *(WORD *)(mem + intnum * 4 + 2);
+		context->Eip = *(WORD *)(mem + intnum * 4);
+		context->EFlags &= ~0x80100;    // VIF, TF
+
+		QueryPerformanceCounter(&now);
+		QueryPerformanceFrequency(&frequency);
+		double latency = (double)(now.QuadPart - v86_events.time[n].QuadPart) / frequency.QuadPart;
+		v86_events.latency += latency;
+		if (latency > v86_events.max_latency)
+			v86_events.max_latency = latency;
+		if (v86_events.insns[n])
+		{
+			UINT64 insns = m_insn_count - v86_events.insns[n];
+			v86_events.insn_latency += insns;
+			if (insns > v86_events.max_insn_latency)
+				v86_events.max_insn_latency = insns;
+		}
+		v86_teb_info.vm86_pending = 0;
+	}
+	if (v86_events_pending())
+		v86_teb_info.vm86_pending |= 0x100000;
+	pthread_mutex_unlock(&v86_events.lock);
+}
+
+/* The EOI of DOSVM_PIC_ioport_out */
+static void v86_acknowledge_irq()
+{
+	pthread_mutex_lock(&v86_events.lock);
+	if (v86_events.in_service)
+	{
+		v86_events.in_service = false;
+		v86_events.acknowledged++;
+		if (v86_events_pending())
+			__atomic_fetch_or(&v86_teb_info.vm86_pending, 0x100000, __ATOMIC_SEQ_CST);
+	}
+	pthread_mutex_unlock(&v86_events.lock);
+}
+
+static WINE_VM86_TEB_INFO *fake_getGdiTebBatch()
+{
+	v86_calls.teb_info++;
+	return &v86_teb_info;
+}
+
+/* An INT 21h style handler: the result in AX depends on AX and on the vector */
+static void fake_wine_call_int_handler(CONTEXT *context, BYTE intnum)
+{
+	if (intnum == V86_EOI)
+	{
+		v86_acknowledge_irq();
+		return;
+	}
+	v86_calls.ints++;
+	v86_calls.last_int = intnum;
+	v86_calls.int_cs = context->SegCs;
+	v86_calls.int_ip = context->Eip;
+	context->Eax = (context->Eax & ~0xffff) | (WORD)(context->Eax * 3 + intnum);
+}
+
+static void fake_vm_debug_get_entry_point(char *module, char *func, WORD *ordinal)
+{
+}
+
+static void fake_vm86_send_queued_events(CONTEXT *context)
+{
+	v86_calls.events++;
+	v86_send_queued_events(context);
+}
+
+static HMODULE LoadLibraryA(const char *name)
+{
+	return strcmp(name, "krnl386.exe16") ? NULL : (HMODULE)&v86_calls;
+}
+
+static void *GetProcAddress(HMODULE module, const char *name)
+{
+	static const struct { const char *name; void *address; } exports[] = {
+		{ "getGdiTebBatch", (void *)fake_getGdiTebBatch },
+		{ "__wine_call_int_handler", (void *)fake_wine_call_int_handler },
+		{ "vm_debug_get_entry_point", (void *)fake_vm_debug_get_entry_point },
+		{ "vm86_send_queued_events", (void *)fake_vm86_send_queued_events },
+	};
+
+	v86_calls.lookups++;
+	for (size_t i = 0; module && i < ARRAY_LENGTH(exports); i++)
+	{
+		if (!strcmp(exports[i].name, name))
+			return exports[i].address;
+	}
+	return NULL;
+}
+
+static void *NtCurrentTeb()
+{
+	return v86_teb;
+}
+
+#include "vm86ctx.cpp"
+
+typedef INT32 LONG;
+#define InterlockedOr(p, v) __atomic_fetch_or(p, v, __ATOMIC_SEQ_CST)
+
+#include "vm86trap.cpp"
+
+/* the linear address of the thunk v86_run intercepts, if any */
+static UINT32 v86_thunk;
+
+/*
+	Guest code for the IRQ tests: BX times over, a loop of CX steps adds
+	to the words at DS:100..8FF, and the handler of IRQ 0 counts the IRQs
+	at DS:10 and acknowledges them.  With IRQs or without it must leave
+	the same registers and words behind.
+*/
+static const UINT8 v86_irq_code[] = {
+	0xb9, 0x00, 0x10,       // 00 mov cx,1000h
+	0x31, 0xff,             // 03 xor di,di
+	0x89, 0xc8,             // 05 mov ax,cx
+	0x01, 0xf8,             // 07 add ax,di
+	0x35, 0x5a, 0x5a,       // 09 xor ax,5a5ah
+	0x01, 0x85, 0x00, 0x01, // 0c add [di+100],ax
+	0x83, 0xc7, 0x02,       // 10 add di,2
+	0x81, 0xe7, 0xfe, 0x07, // 13 and di,7feh
+	0xe2, 0xec,             // 17 loop 05
+	0x4b,                   // 19 dec bx
+	0x75, 0xe4,             // 1a jnz 00
+	0xf4,                   // 1c hlt
+	0x90, 0x90, 0x90,
+	0xff, 0x06, 0x10, 0x00, // 20 inc word [10]
+	0xcd, V86_EOI,          // 24 int V86_EOI
+	0xcf,                   // 26 iret
+};
+
+#define V86_IRQ_HANDLER 0x20
+#define V86_IRQ_COUNT   0x10
+
+static void v86_irq_setup(UINT16 loops)
+{
+	resolve_krnl386_exports();
+	cpu_setup(MODE_V86, v86_irq_code, sizeof(v86_irq_code));
+	// vector 8, IRQ 0
+	*(WORD *)(mem + 8 * 4) = V86_IRQ_HANDLER;
+	*(WORD *)(mem + 8 * 4 + 2) = CODE_BASE >> 4;
+	REG16(BX) = loops;
+	set_flags(get_flags() | 0x200);
+	v86_teb_info.vm86_pending = 0;
+	v86_events_reset();
+}
+
+/* Run V86 code the way vm86main does, until a hlt or 'limit' instructions */
+static UINT64 v86_run(bool blocks, UINT64 limit = 1000000000)
+{
+	WINE_VM86_TEB_INFO *teb_info = dynamic_getGdiTebBatch();
+	UINT64 start = m_insn_count;
+
+	m_count_insns = true;
+	i386_block_set_event(vm86_block_event);
+	CHANGE_PC(m_eip);
+	while (!m_halted && m_insn_count - start < limit)
+	{
+		if (V8086_MODE)
+		{
+			if (teb_info->vm86_pending & 0x100000)
+				vm86_merge_pending(teb_info);
+			if (vm86_intercept_int())
+				continue;
+		}
+		if (vm86_is_trap(m_pc) && m_pc == v86_thunk)
+		{
+			// the retf of a from16 thunk
+			v86_calls.thunks++;
+			m_eip = POP16();
+			load_segment(CS, POP16());
+			CHANGE_PC(m_eip);
+			continue;
+		}
+		if (blocks)
+		{
+			vm86_block_teb = teb_info;
+			i386_block_execute();
+		}
+		else
+		{
+			m_cycles = 1;
+			CPU_EXECUTE_CALL(i386);
+		}
+	}
+	i386_block_set_event(NULL);
+	return m_insn_count - start;
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*
+	Guest throughput and interrupt latency under synthetic IRQs
+
+	vm86irq [-b] [-r rate] [-t seconds]
+
+	Runs the guest of v86.h under the vm86main stand-in, stepping or with
+	-b through the block cache, for 'seconds' (1 by default) without IRQs
+	and then for as long again while another thread queues IRQ 0 'rate'
+	times a second (1000 by default) the way DOSVM_QueueEvent does.
+	Prints the instructions per second of both runs and the time from
+	queueing an IRQ to its handler, and exits with 1 if one was lost.
+*/
+
+#include "core.h"
+#include "v86.h"
+
+static double irq_seconds()
+{
+	LARGE_INTEGER now, frequency;
+
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&frequency);
+	return (double)now.QuadPart / frequency.QuadPart;
+}
+
+static struct
+{
+	double rate, seconds;
+	volatile bool done;
+} producer;
+
+static void *irq_producer(void *arg)
+{
+	struct timespec next;
+	long interval = (long)(1e9 / producer.rate);
+	double end = irq_seconds() + producer.seconds;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (irq_seconds() < end)
+	{
+		next.tv_nsec += interval;
+		next.tv_sec += next.tv_nsec / 1000000000;
+		next.tv_nsec %= 1000000000;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		v86_queue_irq(0);
+	}
+	producer.done = true;
+	return NULL;
+}
+
+/* Runs the guest until it halts, 'seconds' are over or the producer is done and every IRQ handled */
+static UINT64 irq_run(bool blocks, double seconds, bool irqs)
+{
+	double end = irq_seconds() + seconds;
+	UINT64 insns = 0;
+
+	while (!m_halted)
+	{
+		if (irqs)
+		{
+			pthread_mutex_lock(&v86_events.lock);
+			bool done = producer.done && v86_events.acknowledged == v86_events.queued;
+			pthread_mutex_unlock(&v86_events.lock);
+			if (done)
+				break;
+		}
+		else if (irq_seconds() >= end)
+			break;
+		insns += v86_run(blocks, 100000);
+	}
+	return insns;
+}
+
+int main(int argc, char **argv)
+{
+	bool blocks = false;
+	pthread_t thread;
+
+	producer.rate = 1000;
+	producer.seconds = 1;
+	freopen("/dev/null", "w", stderr);
+	for (; argc > 1 && argv[1][0] == '-'; argc--, argv++)
+	{
+		if (!strcmp(argv[1], "-b"))
+			blocks = true;
+		else if (!strcmp(argv[1], "-r") && argc > 2 && (producer.rate = atof(argv[2])) > 0)
+			argc--, argv++;
+		else if (!strcmp(argv[1], "-t") && argc > 2 && (producer.seconds = atof(argv[2])) > 0)
+			argc--, argv++;
+		else
+			break;
+	}
+	if (argc > 1)
+	{
+		printf("usage: vm86irq [-b] [-r rate] [-t seconds]\n");
+		return 2;
+	}
+
+	// BX 0 runs the loop 65536 times, longer than anyone waits
+	v86_irq_setup(0);
+	double start = irq_seconds();
+	UINT64 insns = irq_run(blocks, producer.seconds, false);
+	double base = insns / (irq_seconds() - start) / 1e6;
+	printf("%s, no IRQs:     %12llu insns  %7.1f M/s\n", blocks ? "block" : "step", insns, base);
+
+	v86_irq_setup(0);
+	start = irq_seconds();
+	pthread_create(&thread, NULL, irq_producer, NULL);
+	insns = irq_run(blocks, 0, true);
+	double rate = insns / (irq_seconds() - start) / 1e6;
+	pthread_join(thread, NULL);
+
+	WORD handled = *(WORD *)(mem + DATA_BASE + V86_IRQ_COUNT);
+	printf("%s, %g IRQ/s: %12llu insns  %7.1f M/s (%+.1f%%)\n", blocks ? "block" : "step", producer.rate, insns, rate,
+		base > 0 ? (rate / base - 1) * 100 : 0);
+	printf("%llu IRQs, latency mean %.1f us, max %.1f us\n", v86_events.delivered,
+		v86_events.delivered ? v86_events.latency / v86_events.delivered * 1e6 : 0, v86_events.max_latency * 1e6);
+	if (v86_events.delivered != v86_events.queued || v86_events.acknowledged != v86_events.queued ||
+		handled != (WORD)v86_events.queued)
+	{
+		printf("FAILED: %llu IRQs queued, %llu delivered, %llu acknowledged, %d handled\n", v86_events.queued,
+			v86_events.delivered, v86_events.acknowledged, handled);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,49 @@
+/*
+	Headless replay of a vm86 recording
+
+	vm86replay [-b] log
+
+	Runs the 16-bit instruction stream of a log written with Record in
+	otvdm.ini on the core, stepping or with -b through the block cache,
+	and checks it against every hand-off in the log (see replay.h).
+	Prints the instructions run and their rate, and exits with 1 on the
+	first difference.
+*/
+
+#include "core.h"
+#include "replay.h"
+
+int main(int argc, char **argv)
+{
+	bool blocks = argc > 1 && !strcmp(argv[1], "-b");
+	LARGE_INTEGER start, end, frequency;
+	REPLAY_STATS stats;
+	double seconds;
+	FILE *fp;
+	bool ok;
+
+	if (blocks)
+	{
+		argc--;
+		argv++;
+	}
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: vm86replay [-b] log\n");
+		return 2;
+	}
+	if (!(fp = fopen(argv[1], "rb")))
+	{
+		fprintf(stderr, "cannot open %s\n", argv[1]);
+		return 2;
+	}
+	QueryPerformanceCounter(&start);
+	ok = replay_log(fp, blocks, &stats);
+	QueryPerformanceCounter(&end);
+	QueryPerformanceFrequency(&frequency);
+	fclose(fp);
+	seconds = (double)(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+	printf("%s: %u records, %u hand-offs, %llu instructions in %.3f s, %.1f M/s%s\n", argv[1], stats.records,
+		stats.handoffs, stats.insns, seconds, seconds > 0 ? stats.insns / seconds / 1e6 : 0.0, ok ? "" : ", FAILED");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+/*
+	Segment access windows
+
+	Random descriptors (data and code, expand-up and expand-down, byte
+	and page granular, 16 and 32-bit) are loaded into ES and SS in
+	16-bit protected mode, and i386_translate is called for offsets
+	around their limits and at random, reading and writing, with the
+	window the load computed and with it cleared, which takes the full
+	validity, limit and type checks.  Both must give the same address or
+	the same fault.
+*/
+
+#define SEL_WINDOW 0x40
+
+/* The address, or the fault code and error code thrown with 1 << 63 set */
+static UINT64 window_translate(int sreg, UINT32 ip, int rwn)
+{
+	try
+	{
+		return i386_translate(sreg, ip, rwn);
+	}
+	catch (UINT64 e)
+	{
+		return e | U64(0x8000000000000000);
+	}
+}
+
+static UINT32 window_offset(UINT32 *seed, UINT32 limit)
+{
+	UINT32 r = random32(seed);
+
+	switch (r % 6)
+	{
+	case 0: return limit + (r >> 8) % 8 - 4;
+	case 1: return (r >> 8) % 8;
+	case 2: return 0xffff + (r >> 8) % 8 - 4;
+	case 3: return 0xffffffff - (r >> 8) % 4;
+	case 4: return random32(seed) % 0x20000;
+	default: return random32(seed);
+	}
+}
+
+static void test_window()
+{
+	static const UINT32 limits[] = { 0, 0xfff, 0xfffe, 0xffff, 0x10000, 0xfffff, 0xffffffff };
+	UINT32 seed = 0x5e9a11ce, hits = 0;
+	int shown = 0;
+
+	cpu_setup(MODE_PM16, NULL, 0);
+	for (int n = 0; n < 20000 && shown < 10; n++)
+	{
+		UINT32 r = random32(&seed);
+		UINT32 limit = r & 1 ? limits[(r >> 1) % ARRAY_LENGTH(limits)] : random32(&seed) % 0x20000;
+		UINT8 access = 0x90 | ((r >> 4) & 0x0f);    // present, DPL 0, any data or code type
+		UINT8 flags = (r >> 8) & 1 ? 0x04 : 0;      // D/B
+		int sreg = (r >> 9) & 1 ? SS : ES;
+
+		set_descriptor(SEL_WINDOW, 0x123000, limit, access, flags);
+		// the null selector now and then, which leaves the register invalid
+		load_segment(sreg, (r >> 10) % 32 ? SEL_WINDOW : 0);
+
+		for (int i = 0; i < 32; i++)
+		{
+			const I386_SREG *seg = &m_sreg[sreg];
+			UINT32 ip = window_offset(&seed, seg->limit);
+			int rwn = random32(&seed) & 1;
+			I386_SREG saved = *seg;
+			UINT64 res[2];
+
+			res[0] = window_translate(sreg, ip, rwn);
+			if (ip - seg->win_lo <= seg->win_span && (seg->win_rw & (1 << rwn)))
+				hits++;
+			m_sreg[sreg].win_rw = 0;
+			res[1] = window_translate(sreg, ip, rwn);
+			m_sreg[sreg] = saved;
+			if (res[0] == res[1])
+				continue;
+			fail("%s access %02x flags %x limit %08x %s %08x: window %llx, full checks %llx\n", sreg == SS ? "ss" : "es",
+				access, flags, seg->limit, rwn ? "write" : "read", ip, res[0], res[1]);
+			shown++;
+			break;
+		}
+	}
+	// about a fifth of the offsets are inside the limit and of a type the segment allows
+	if (hits < 100000)
+		fail("only %u accesses inside the window\n", hits);
+}
@@ -0,0 +1,105 @@
+/*
+	The host FPU fast path (FastFPU) against SoftFloat
+
+	x87_add, x87_sub, x87_mul and x87_div are called with and without
+	m_x87_fast on random operands, under every precision and rounding
+	control; the results and the SoftFloat exception flags must be the
+	same.  Most operands are exact doubles in the range the fast path
+	takes, the others are at its edges or outside it: longer than 53
+	bits, zeros, denormals, unnormals, infinities and NaNs.  Then the
+	fpu16 kernel, which runs in extended and in double precision, must
+	leave the same state either way.
+*/
+
+static floatx80 x87_random_operand(UINT32 *seed)
+{
+	floatx80 fx;
+	UINT32 r = random32(seed);
+	int exp = 16383 + (int)(random32(seed) % 64) - 32;
+
+	fx.low = (UINT64)random32(seed) << 32 | random32(seed);
+	fx.low |= U64(0x8000000000000000);
+	switch (r % 16)
+	{
+	case 0: exp = 16383 + (random32(seed) & 1 ? 240 : -240) + (int)(random32(seed) % 3) - 1; break;  // edges of the range
+	case 1: exp = random32(seed) % 0x7fff; break;
+	case 2: fx.low = 0; exp = 0; break;                             // zero
+	case 3: fx.low &= ~U64(0x8000000000000000); exp = 0; break;     // denormal
+	case 4: fx.low &= ~U64(0x8000000000000000); break;              // unnormal
+	case 5: exp = 0x7fff; if (r & 0x100) fx.low = U64(0x8000000000000000); break;  // infinity or NaN
+	case 6: break;                                                  // longer than 53 bits
+	default: fx.low &= ~U64(0x7ff); break;                          // exact double
+	}
+	// small integers too, for exact results
+	if (r % 16 == 7 && (r & 0x200))
+	{
+		fx.low = (UINT64)(random32(seed) | 1) << 32;
+		exp = 16383 + 31;
+	}
+	fx.high = exp | (r & 0x80000000 ? 0x8000 : 0);
+	return fx;
+}
+
+static floatx80 x87_op(int op, floatx80 a, floatx80 b)
+{
+	switch (op)
+	{
+	case X87_HOST_ADD: return x87_add(a, b);
+	case X87_HOST_SUB: return x87_sub(a, b);
+	case X87_HOST_MUL: return x87_mul(a, b);
+	default: return x87_div(a, b);
+	}
+}
+
+static void test_x87()
+{
+	static const char *const op_name[] = { "add", "sub", "mul", "div" };
+	UINT32 seed = 0x0f10a7e5, fast = 0;
+	int shown = 0;
+
+	cpu_setup(MODE_REAL, NULL, 0);
+	for (int n = 0; n < 2000000 && shown < 10; n++)
+	{
+		UINT16 cw = 0x037f & ~0x0f00;
+		floatx80 a = x87_random_operand(&seed), b = x87_random_operand(&seed), res[2];
+		int op = random32(&seed) % 4, flags[2];
+
+		// mostly double precision rounding to nearest, where the fast path works
+		cw |= random32(&seed) % 4 ? X87_CW_PC_DOUBLE << X87_CW_PC_SHIFT : (random32(&seed) % 4) << X87_CW_PC_SHIFT;
+		cw |= random32(&seed) % 4 ? 0 : (random32(&seed) % 4) << X87_CW_RC_SHIFT;
+		x87_write_cw(cw);
+		for (int i = 0; i < 2; i++)
+		{
+			m_x87_fast = i != 0;
+			float_exception_flags = 0;
+			res[i] = x87_op(op, a, b);
+			flags[i] = float_exception_flags;
+		}
+		m_x87_fast = false;
+		if (x87_host_arith(op, a, b, &res[1]))
+			fast++;
+		if (res[0].high == res[1].high && res[0].low == res[1].low && flags[0] == flags[1])
+			continue;
+		fail("cw %04x %04x:%016llx %s %04x:%016llx: fast %04x:%016llx flags %02x, softfloat %04x:%016llx flags %02x\n",
+			cw, a.high, a.low, op_name[op], b.high, b.low, res[1].high, res[1].low, flags[1], res[0].high, res[0].low, flags[0]);
+		shown++;
+	}
+	// about a quarter of the cases are double precision, to nearest, with two exact doubles
+	if (fast < 400000)
+		fail("the fast path took only %u cases\n", fast);
+
+	UINT32 size, hash[2];
+	UINT8 *code = load_kernel("fpu16", &size);
+
+	for (int i = 0; i < 2; i++)
+	{
+		cpu_setup(MODE_REAL, code, size);
+		m_x87_fast = i != 0;
+		cpu_run(true);
+		hash[i] = cpu_hash();
+	}
+	m_x87_fast = false;
+	if (hash[0] != hash[1])
+		fail("fpu16: hash %08x with the fast path, %08x without\n", hash[1], hash[0]);
+	free(code);
+}
@@ -0,0 +1,142 @@
+/*
+	WOW handle16 mapping (krnl386/wow_handle.c)
+
+	Random conversions and releases of a pool of 32-bit handles, checked
+	against a model of the mapping: a live handle32 always converts to the
+	same handle16 and back, no two live ones share a handle16, released
+	slots are handed out again only after the never used ones, oldest
+	first, no slot is one of the reserved values and conversions fail
+	once every slot is in use.
+*/
+
+#include "win32.h"
+
+/* wownt32.h and winuser.h, for GetWindowHMenu16 */
+#define WOW_TYPE_HMENU 1
+
+static HANDLE GetMenu(HANDLE hwnd) { return NULL; }
+static WORD WOWHandle16(HANDLE handle, int type) { return 0; }
+
+#include "../../krnl386/wow_handle.c"
+
+#define POOL_SIZE 100000
+#define SLOTS     65536
+
+static HANDLE pool[POOL_SIZE];
+static WORD model_h16[POOL_SIZE];   /* 0 if not mapped */
+static int model_owner[SLOTS];      /* pool index + 1, 0 if free */
+static WORD model_free[SLOTS];
+static DWORD model_free_head, model_free_tail;
+static DWORD model_next_unused = HANDLE_RESERVED;
+static int live;
+
+static WORD model_alloc(void)
+{
+	if (model_next_unused < HANDLE_SLOTS_END)
+		return model_next_unused++;
+	if (model_free_head != model_free_tail)
+		return model_free[model_free_head++ & 0xffff];
+	return 0;
+}
+
+static int check_convert(int i)
+{
+	WORD expected = model_h16[i] ? model_h16[i] : model_alloc();
+	WORD h16 = K32WOWHandle16HWND(pool[i]);
+
+	if (h16 != expected)
+	{
+		fail("handle32 %p: handle16 %04x, expected %04x\n", pool[i], h16, expected);
+		return 0;
+	}
+	if (!h16)
+		return 1;
+	if (K32WOWHandle32HWND(h16) != pool[i])
+		fail("handle16 %04x: handle32 %p, expected %p\n", h16, K32WOWHandle32HWND(h16), pool[i]);
+	if (!model_h16[i])
+	{
+		model_h16[i] = h16;
+		model_owner[h16] = i + 1;
+		live++;
+	}
+	return 1;
+}
+
+static void release(int i)
+{
+	WORD h16 = model_h16[i];
+
+	K32WOWHandle16Release(pool[i]);
+	model_h16[i] = 0;
+	model_owner[h16] = 0;
+	model_free[model_free_tail++ & 0xffff] = h16;
+	live--;
+	/* a released handle16 converts to itself until it is reused */
+	if (K32WOWHandle32HWND(h16) != (HANDLE)(ULONG_PTR)h16)
+		fail("released handle16 %04x: handle32 %p\n", h16, K32WOWHandle32HWND(h16));
+}
+
+static void churn(DWORD *seed, int ops, int cap)
+{
+	for (int n = 0; n < ops; n++)
+	{
+		int i = random32(seed) % POOL_SIZE;
+
+		if (model_h16[i] && (random32(seed) & 1))
+			release(i);
+		else if (model_h16[i] || live < cap)
+		{
+			if (!check_convert(i))
+				return;
+		}
+	}
+}
+
+static void check_all(void)
+{
+	for (int i = 0; i < POOL_SIZE; i++)
+		if (model_h16[i] && K32WOWHandle16HWND(pool[i]) != model_h16[i])
+		{
+			fail("handle32 %p lost its handle16 %04x\n", pool[i], model_h16[i]);
+			return;
+		}
+}
+
+static void test_handles(void)
+{
+	DWORD seed = 0x1234abcd;
+	int i;
+
+	for (i = 0; i < POOL_SIZE; i++)
+	{
+		/* packed like window handles, and spread out */
+		DWORD h = i & 1 ? 0x10000 + i * 2 : 0x80000000 + i * 0x1002;
+		pool[i] = (HANDLE)(ULONG_PTR)h;
+	}
+	/* small values map to themselves, both ways */
+	if (K32WOWHandle16HWND((HANDLE)5) != 5 || K32WOWHandle32HWND(0xfffe) != (HANDLE)(SSIZE_T)-2)
+		fail("reserved handles are not mapped to themselves\n");
+
+	churn(&seed, 1000000, 20000);
+	check_all();
+	/* use up every slot, then wrap the free list a few times */
+	churn(&seed, 2000000, HANDLE_SLOTS_END - HANDLE_RESERVED);
+	check_all();
+	for (i = 0; i < POOL_SIZE && live < HANDLE_SLOTS_END - HANDLE_RESERVED; i++)
+		if (!model_h16[i])
+			check_convert(i);
+	for (; i < POOL_SIZE; i++)
+		if (!model_h16[i])
+		{
+			check_convert(i);
+			break;
+		}
+	check_all();
+	churn(&seed, 1000000, 1000);
+	check_all();
+}
+
+int main(int argc, char **argv)
+{
+	return run_test(argc, argv, "handles", test_handles);
+}
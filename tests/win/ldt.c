@@ -0,0 +1,234 @@
+/*
+	LDT allocation (wine/ldt2.c)
+
+	Random allocations, frees (whole blocks and parts of them) and
+	reallocations, growing and shrinking, checked against a plain array
+	of allocated entries: allocations take the lowest run of free entries
+	that is long enough, growing keeps the selector when the entries after
+	the block are free, shrinking frees the end of the block, and the
+	allocation bitmap, the ALLOCATED flags and the used count agree with
+	the model.
+*/
+
+#include "win32.h"
+
+/* winnt.h, and what wine/library.h takes from windef.h and winbase.h */
+typedef unsigned short WCHAR;
+typedef struct _IMAGE_NT_HEADERS IMAGE_NT_HEADERS;
+#define _declspec(x)
+#define DECLSPEC_NORETURN __attribute__((noreturn))
+#define FORCEINLINE inline __attribute__((always_inline))
+
+typedef struct _LDT_ENTRY {
+	WORD LimitLow;
+	WORD BaseLow;
+	union {
+		struct {
+			BYTE BaseMid;
+			BYTE Flags1;
+			BYTE Flags2;
+			BYTE BaseHi;
+		} Bytes;
+		struct {
+			unsigned BaseMid : 8;
+			unsigned Type : 5;
+			unsigned Dpl : 2;
+			unsigned Pres : 1;
+			unsigned LimitHi : 4;
+			unsigned Sys : 1;
+			unsigned Reserved_0 : 1;
+			unsigned Default_Big : 1;
+			unsigned Granularity : 1;
+			unsigned BaseHi : 8;
+		} Bits;
+	} HighWord;
+} LDT_ENTRY;
+
+/* the LDT part of wine/library.h is for i386 only */
+#define __i386__
+#include "../../wine/ldt2.c"
+#undef __i386__
+
+#define MAX_BLOCKS 4096
+
+static unsigned char model[LDT_SIZE];
+static struct { int index, count; } blocks[MAX_BLOCKS];
+static int block_count, model_used;
+
+static int model_find_free(int count)
+{
+	int i, run = 0;
+
+	for (i = LDT_FIRST_ENTRY; i < LDT_SIZE; i++)
+	{
+		run = model[i] ? 0 : run + 1;
+		if (run == count)
+			return i - count + 1;
+	}
+	return -1;
+}
+
+static void model_mark(int index, int count, int used)
+{
+	for (int i = index; i < index + count; i++)
+	{
+		model_used += used - model[i];
+		model[i] = used;
+	}
+}
+
+static int random_count(DWORD *seed)
+{
+	switch (random32(seed) % 8)
+	{
+	case 0: return 1 + random32(seed) % 600;
+	case 1: return 1 + random32(seed) % 64;
+	default: return 1 + random32(seed) % 8;
+	}
+}
+
+static int check_alloc(int count)
+{
+	int expected = model_find_free(count);
+	unsigned short sel = wine_ldt_alloc_entries(count);
+
+	if (expected < 0 ? sel != 0 : sel != ((expected << 3) | 7))
+	{
+		fail("alloc %d: selector %04x, expected %04x\n", count, sel, expected < 0 ? 0 : (expected << 3) | 7);
+		return 0;
+	}
+	if (expected >= 0)
+	{
+		model_mark(expected, count, 1);
+		blocks[block_count].index = expected;
+		blocks[block_count].count = count;
+		block_count++;
+	}
+	return 1;
+}
+
+static void remove_block(int b)
+{
+	blocks[b] = blocks[--block_count];
+}
+
+static int check_realloc(int b, int count)
+{
+	int index = blocks[b].index, old = blocks[b].count, expected = index, i;
+	unsigned short sel;
+
+	if (count > old)
+	{
+		for (i = old; i < count && index + i < LDT_SIZE; i++)
+			if (model[index + i])
+				break;
+		if (i < count)
+		{
+			model_mark(index, old, 0);
+			expected = model_find_free(count);
+			index = expected;
+		}
+		if (expected >= 0)
+			model_mark(index, count, 1);
+	}
+	else
+		model_mark(index + count, old - count, 0);
+
+	sel = wine_ldt_realloc_entries((blocks[b].index << 3) | 7, old, count);
+	if (expected < 0 ? sel != 0 : sel != ((expected << 3) | 7))
+	{
+		fail("realloc %04x from %d to %d: selector %04x, expected %04x\n", (blocks[b].index << 3) | 7, old, count, sel,
+			expected < 0 ? 0 : (expected << 3) | 7);
+		return 0;
+	}
+	if (expected < 0)
+		remove_block(b);
+	else
+	{
+		blocks[b].index = expected;
+		blocks[b].count = count;
+	}
+	return 1;
+}
+
+/* Free a whole block or its start, middle or end */
+static void free_part(DWORD *seed, int b)
+{
+	int index = blocks[b].index, count = blocks[b].count;
+	int first = random32(seed) % 3 ? 0 : random32(seed) % count;
+	int n = random32(seed) % 3 ? count - first : 1 + random32(seed) % (count - first);
+
+	wine_ldt_free_entries((index + first) << 3 | 7, n);
+	model_mark(index + first, n, 0);
+	if (first + n < count && block_count < MAX_BLOCKS)
+	{
+		blocks[block_count].index = index + first + n;
+		blocks[block_count].count = count - first - n;
+		block_count++;
+	}
+	if (first)
+		blocks[b].count = first;
+	else
+		remove_block(b);
+}
+
+static int check_state(void)
+{
+	for (int i = LDT_FIRST_ENTRY; i < LDT_SIZE; i++)
+	{
+		int bit = (ldt_used[i >> 5] >> (i & 31)) & 1;
+		int flag = (wine_ldt_copy.flags[i] & WINE_LDT_FLAGS_ALLOCATED) != 0;
+
+		if (bit != model[i] || flag != model[i])
+		{
+			fail("entry %d: bitmap %d, flag %d, expected %d\n", i, bit, flag, model[i]);
+			return 0;
+		}
+	}
+	for (int w = 0; w < LDT_SIZE / 32; w++)
+	{
+		int full = (ldt_full[w >> 5] >> (w & 31)) & 1;
+		if (full != (ldt_used[w] == ~0u))
+		{
+			fail("bitmap word %d: full bit %d, word %08x\n", w, full, ldt_used[w]);
+			return 0;
+		}
+	}
+	if (ldt_stats.used != model_used)
+	{
+		fail("%d entries used, expected %d\n", ldt_stats.used, model_used);
+		return 0;
+	}
+	return 1;
+}
+
+static void test_ldt(void)
+{
+	DWORD seed = 0x0badf00d;
+
+	for (int n = 0; n < 1000000; n++)
+	{
+		int op = random32(&seed) % 8, ok = 1;
+
+		/* fill up to about 80% most of the time, and to full now and then */
+		if (!block_count || (op < 3 && (model_used < (LDT_SIZE - LDT_FIRST_ENTRY) * 4 / 5 || (n >> 16) % 4 == 3)))
+			ok = block_count < MAX_BLOCKS ? check_alloc(random_count(&seed)) : 1;
+		else if (op < 6)
+			free_part(&seed, random32(&seed) % block_count);
+		else
+		{
+			int b = random32(&seed) % block_count;
+			int count = op == 6 ? blocks[b].count + random_count(&seed) : 1 + random32(&seed) % blocks[b].count;
+			ok = check_realloc(b, count);
+		}
+		if (!ok || ((n & 0xffff) == 0 && !check_state()))
+			return;
+	}
+	if (check_state() && !ldt_stats.failures)
+		fail("the LDT never filled up\n");
+}
+
+int main(int argc, char **argv)
+{
+	return run_test(argc, argv, "ldt", test_ldt);
+}
@@ -0,0 +1,368 @@
+/*
+	Local heap (krnl386/local.c)
+
+	Random LocalAlloc16, LocalReAlloc16, LocalFree16 and LocalCompact16
+	calls on fixed, moveable and discardable blocks in one data segment,
+	which grows to 64K once the heap is full.  After each call the arena
+	list and the free list must agree, every block must keep its contents,
+	the largest free block the size-class index allows must be at least
+	the real one, and LOCAL_FindFreeBlock must find a free block of a
+	random size exactly when there is one.
+*/
+
+#include "win32.h"
+
+/* kernel16_private.h and winbase.h */
+#pragma pack(push, 1)
+typedef struct
+{
+	WORD null;
+	DWORD old_ss_sp;
+	WORD heap;
+	WORD atomtable;
+	WORD stacktop;
+	WORD stackmin;
+	WORD stackbottom;
+} INSTANCEDATA;
+#pragma pack(pop)
+
+#define LMEM_FIXED       0x0000
+#define LMEM_MOVEABLE    0x0002
+#define LMEM_NOCOMPACT   0x0010
+#define LMEM_NODISCARD   0x0020
+#define LMEM_ZEROINIT    0x0040
+#define LMEM_MODIFY      0x0080
+#define LMEM_DISCARDABLE 0x0f00
+#define LMEM_DISCARDED   0x4000
+#define GMEM_FIXED       0x0000
+#define WCB16_PASCAL     0
+
+/* One data segment, DS, that GlobalReAlloc16 grows in place */
+#define DS 0x1007
+
+static char segment[0x10000];
+static DWORD segment_size;
+static struct { DWORD ecx; } stack16;
+static WORD current_ds = DS;
+
+#define CURRENT_DS current_ds
+#define CURRENT_STACK16 (&stack16)
+#define MAKESEGPTR(seg, off) ((SEGPTR)MAKELONG(off, seg))
+#define MapSL(segptr) ((void *)(segment + LOWORD(segptr)))
+#define IsBadReadPtr16(segptr, size) FALSE
+#define GetProcessHeap() NULL
+#define HeapAlloc(heap, flags, size) malloc(size)
+
+static BOOL HeapFree(HANDLE heap, DWORD flags, void *p) { free(p); return TRUE; }
+static DWORD GlobalSize16(HGLOBAL16 handle) { return segment_size; }
+static HGLOBAL16 GlobalHandle16(WORD sel) { return sel; }
+static HGLOBAL16 GlobalReAlloc16(HGLOBAL16 handle, DWORD size, UINT16 flags) { segment_size = size; return handle; }
+static BOOL16 GlobalUnlock16(HGLOBAL16 handle) { return FALSE; }
+static WORD GlobalHandleToSel16(HGLOBAL16 handle) { return handle; }
+static HANDLE16 LoadLibrary16(LPCSTR name) { return 0; }
+static void FreeLibrary16(HANDLE16 handle) { }
+static BOOL WOWCallback16Ex(DWORD proc, DWORD flags, DWORD size, LPVOID args, DWORD *ret) { return FALSE; }
+SEGPTR WINAPI K32WOWGlobalLock16(HGLOBAL16 handle) { return 0; }
+
+/* GetHeapSpaces16 and the Local32 heap, which the test does not call */
+typedef void VOID;
+typedef DWORD *LPDWORD;
+typedef WORD *LPWORD;
+typedef unsigned int ULONG;
+typedef HANDLE16 HMODULE16;
+typedef struct { WORD ne_autodata; } NE_MODULE;
+typedef struct { HGLOBAL16 hSeg; } SEGTABLEENTRY;
+typedef struct
+{
+	void *lpData;
+	DWORD cbData;
+	BYTE cbOverhead;
+	BYTE iRegionIndex;
+	WORD wFlags;
+	union { struct { DWORD dwCommittedSize, dwUnCommittedSize; void *lpFirstBlock, *lpLastBlock; } Region; } u;
+} PROCESS_HEAP_ENTRY;
+
+#define __AHSHIFT 3
+#define WINE_LDT_FLAGS_DATA 0x13
+#define HEAP_ZERO_MEMORY 8
+#define MEM_COMMIT 0x1000
+#define MEM_RESERVE 0x2000
+#define MEM_DECOMMIT 0x4000
+#define MEM_RELEASE 0x8000
+#define PAGE_READWRITE 4
+#define PROCESS_HEAP_REGION 1
+#define PROCESS_HEAP_ENTRY_BUSY 4
+#define NE_SEG_TABLE(module) ((SEGTABLEENTRY *)NULL)
+
+static NE_MODULE *NE_GetPtr(HMODULE16 module) { return NULL; }
+static WORD GetSelectorLimit16(WORD sel) { return 0; }
+static DWORD GetSelectorBase(WORD sel) { return 0; }
+static WORD SELECTOR_AllocBlock(const void *base, DWORD size, unsigned char flags) { return 0; }
+static void SELECTOR_FreeBlock(WORD sel) { }
+static BOOL GLOBAL_MoveBlock(HGLOBAL16 handle, void *ptr, DWORD size) { return FALSE; }
+static void *VirtualAlloc(void *addr, size_t size, DWORD type, DWORD protect) { return NULL; }
+static BOOL VirtualFree(void *addr, size_t size, DWORD type) { return FALSE; }
+static HANDLE RtlCreateHeap(ULONG flags, void *base, size_t reserve, size_t commit, void *lock, void *params) { return NULL; }
+static BOOL HeapDestroy(HANDLE heap) { return FALSE; }
+static void *HeapReAlloc(HANDLE heap, DWORD flags, void *p, size_t size) { return NULL; }
+static size_t HeapSize(HANDLE heap, DWORD flags, const void *p) { return 0; }
+static BOOL HeapWalk(HANDLE heap, PROCESS_HEAP_ENTRY *entry) { return FALSE; }
+
+#include "../../krnl386/local.c"
+
+#define MAX_BLOCKS 2000
+
+static struct
+{
+	HLOCAL16 handle;
+	WORD size;
+	WORD flags;
+	BYTE fill;
+	BOOL discarded;
+} blocks[MAX_BLOCKS];
+static int block_count;
+
+static char *block_data(int b)
+{
+	WORD addr = HANDLE_MOVEABLE(blocks[b].handle) ? *(WORD *)(segment + blocks[b].handle) : blocks[b].handle;
+	return addr ? segment + addr : NULL;
+}
+
+static void block_fill(int b, DWORD *seed)
+{
+	blocks[b].fill = random32(seed);
+	for (int i = 0; i < blocks[b].size; i++)
+		block_data(b)[i] = blocks[b].fill + i;
+}
+
+/* The first 'size' bytes, or all of them */
+static int block_check(int b, int size)
+{
+	char *data = block_data(b);
+
+	if (size > blocks[b].size)
+		size = blocks[b].size;
+	for (int i = 0; i < size; i++)
+		if ((BYTE)data[i] != (BYTE)(blocks[b].fill + i))
+		{
+			fail("block %04x: byte %d is %02x, expected %02x\n", blocks[b].handle, i, (BYTE)data[i], (BYTE)(blocks[b].fill + i));
+			return 0;
+		}
+	return 1;
+}
+
+/* Compaction discards unlocked discardable blocks */
+static void update_discarded(int b)
+{
+	if (blocks[b].flags & LMEM_DISCARDABLE)
+		blocks[b].discarded = (LocalFlags16(blocks[b].handle) & LMEM_DISCARDED) != 0;
+}
+
+static void remove_block(int b)
+{
+	blocks[b] = blocks[--block_count];
+}
+
+/* Walk the heap and return the size of the largest free block, -1 if the heap is broken */
+static int check_arenas(void)
+{
+	LOCALHEAPINFO *pInfo = LOCAL_GetHeap(DS);
+	WORD arena = pInfo->first, free_arena = pInfo->first, items = 1;
+	int largest = 0;
+
+	for (;;)
+	{
+		LOCALARENA *pArena = ARENA_PTR(segment, arena);
+
+		if (arena == pInfo->last)
+			break;
+		if (pArena->next <= arena || ARENA_PREV(segment, pArena->next) != arena)
+		{
+			fail("arena %04x: next %04x links back to %04x\n", arena, pArena->next, ARENA_PREV(segment, pArena->next));
+			return -1;
+		}
+		if (arena != pInfo->first && (pArena->prev & 3) == LOCAL_ARENA_FREE)
+		{
+			if (ARENA_PTR(segment, free_arena)->free_next != arena || pArena->free_prev != free_arena)
+			{
+				fail("free arena %04x is not linked after %04x\n", arena, free_arena);
+				return -1;
+			}
+			if (pArena->size != pArena->next - arena)
+			{
+				fail("free arena %04x: size %04x, expected %04x\n", arena, pArena->size, pArena->next - arena);
+				return -1;
+			}
+			if (pArena->next != pInfo->last && (ARENA_PTR(segment, pArena->next)->prev & 3) == LOCAL_ARENA_FREE)
+			{
+				fail("free arenas %04x and %04x are not merged\n", arena, pArena->next);
+				return -1;
+			}
+			if (pArena->size > largest)
+				largest = pArena->size;
+			free_arena = arena;
+		}
+		arena = pArena->next;
+		items++;
+	}
+	if (ARENA_PTR(segment, free_arena)->free_next != pInfo->last)
+	{
+		fail("free list goes on from %04x to %04x\n", free_arena, ARENA_PTR(segment, free_arena)->free_next);
+		return -1;
+	}
+	if (items != pInfo->items)
+	{
+		fail("%d arenas, %d items\n", items, pInfo->items);
+		return -1;
+	}
+	return largest;
+}
+
+/* Contents too if 'contents' is set */
+static int check_heap(DWORD *seed, BOOL contents)
+{
+	LOCALFREEINDEX *index = &local_free_index[DS >> 3];
+	int largest = check_arenas();
+	WORD size, arena;
+
+	if (largest < 0)
+		return 0;
+	if (index->heap == ((INSTANCEDATA *)segment)->heap && index->max_free < largest)
+	{
+		fail("free index: largest free block %04x, real one %04x\n", index->max_free, largest);
+		return 0;
+	}
+	for (int b = 0; b < block_count && contents; b++)
+	{
+		update_discarded(b);
+		if (!blocks[b].discarded && !block_check(b, blocks[b].size))
+			return 0;
+	}
+
+	size = LALIGN(8 + (random32(seed) % 4 ? random32(seed) % 0x100 : random32(seed) % 0x4000));
+	arena = LOCAL_FindFreeBlock(DS, size);
+	if (!arena != (size > largest))
+	{
+		fail("find %04x: arena %04x, largest free block %04x\n", size, arena, largest);
+		return 0;
+	}
+	if (arena && ((ARENA_PTR(segment, arena)->prev & 3) != LOCAL_ARENA_FREE || ARENA_PTR(segment, arena)->size < size))
+	{
+		fail("find %04x: arena %04x is not a free block that large\n", size, arena);
+		return 0;
+	}
+	return 1;
+}
+
+static WORD random_size(DWORD *seed)
+{
+	switch (random32(seed) % 8)
+	{
+	case 0: return random32(seed) % 0x1000;
+	case 1: return random32(seed) % 0x200;
+	default: return 1 + random32(seed) % 0x40;
+	}
+}
+
+static void check_alloc(DWORD *seed)
+{
+	static const WORD flags[] = { LMEM_FIXED, LMEM_MOVEABLE, LMEM_MOVEABLE | LMEM_DISCARDABLE, LMEM_FIXED | LMEM_ZEROINIT };
+	int b = block_count;
+
+	blocks[b].size = random_size(seed);
+	blocks[b].flags = flags[random32(seed) % 4];
+	blocks[b].discarded = FALSE;
+	blocks[b].handle = LocalAlloc16(blocks[b].flags, blocks[b].size);
+	if (!blocks[b].handle)
+		return;
+	block_count++;
+	if (!blocks[b].size)
+	{
+		blocks[b].discarded = TRUE;
+		return;
+	}
+	if (LocalSize16(blocks[b].handle) < blocks[b].size)
+		fail("block %04x: %d bytes, asked for %d\n", blocks[b].handle, LocalSize16(blocks[b].handle), blocks[b].size);
+	block_fill(b, seed);
+}
+
+static void check_realloc(DWORD *seed, int b)
+{
+	WORD size = random_size(seed) + 1, old = blocks[b].size;
+	BOOL moveable = HANDLE_MOVEABLE(blocks[b].handle);
+	HLOCAL16 handle;
+
+	update_discarded(b);
+	/* Fixed blocks only in place, LocalReAlloc16 loses them if moving
+	   fails, and discardable ones locked, or the compaction it starts
+	   could discard them */
+	if ((blocks[b].flags & LMEM_DISCARDABLE) && !blocks[b].discarded)
+		LocalLock16(blocks[b].handle);
+	handle = LocalReAlloc16(blocks[b].handle, size, moveable ? LMEM_MOVEABLE : 0);
+	if ((blocks[b].flags & LMEM_DISCARDABLE) && !blocks[b].discarded)
+		LocalUnlock16(blocks[b].handle);
+	if (!handle)
+	{
+		if (!moveable && LocalSize16(blocks[b].handle) >= size)
+			fail("block %04x: not resized in place from %d to %d bytes\n", blocks[b].handle, old, size);
+		/* a moveable block that could not be moved is put back */
+		if (!blocks[b].discarded)
+			block_check(b, old);
+		return;
+	}
+	if (blocks[b].discarded)
+	{
+		blocks[b].discarded = FALSE;
+		blocks[b].size = size;
+		block_fill(b, seed);
+		return;
+	}
+	if (handle != blocks[b].handle)
+		fail("block %04x: reallocated to %04x\n", blocks[b].handle, handle);
+	if (LocalSize16(handle) < size)
+		fail("block %04x: %d bytes, asked for %d\n", handle, LocalSize16(handle), size);
+	block_check(b, size);
+	blocks[b].size = size;
+	block_fill(b, seed);
+}
+
+static void test_local(void)
+{
+	DWORD seed = 0x10ca1ea9;
+
+	/* a 8K segment with the heap in the last 6K */
+	segment_size = 0x2000;
+	if (!LocalInit16(DS, 0, 0x1800))
+	{
+		fail("LocalInit16 failed\n");
+		return;
+	}
+	for (int n = 0; n < 150000; n++)
+	{
+		int op = random32(&seed) % 16;
+
+		if (!block_count || (op < 6 && block_count < MAX_BLOCKS))
+			check_alloc(&seed);
+		else if (op < 11)
+		{
+			int b = random32(&seed) % block_count;
+
+			if (LocalFree16(blocks[b].handle))
+				fail("block %04x: not freed\n", blocks[b].handle);
+			remove_block(b);
+		}
+		else if (op < 15)
+			check_realloc(&seed, random32(&seed) % block_count);
+		else
+			LocalCompact16(random32(&seed) % 0x2000);
+		if (failures || !check_heap(&seed, (n & 31) == 0))
+			return;
+	}
+	if (segment_size != 0x10000)
+		fail("the heap never grew\n");
+}
+
+int main(int argc, char **argv)
+{
+	return run_test(argc, argv, "local", test_local);
+}
@@ -0,0 +1,146 @@
+/*
+	The interpreted 16-bit relay (krnl386/relay.c), for cpu/relay16.cpp
+
+	relay16_reference() converts the arguments of a call the way
+	relay_call_from_16_no_debug does, for the CALLFROM16 entry a
+	STACK16FRAME in the memory of the core returns through, and returns
+	the arguments it would pass to the 32-bit entry point.  Selectors map
+	through the same copy of the LDT the generated relays read.
+*/
+
+#include "win32.h"
+
+#define __WINE_DOSEXE_H
+#define __WINE_WINE_UNICODE_H
+#define __WINE_WINE_LIBRARY_H
+
+/* winnt.h, wine/winbase16.h and kernel16_private.h, with the 32-bit layout of the guest */
+typedef uint16_t WCHAR;
+typedef struct { DWORD EFlags, Eax, Ebx, Ecx, Edx, Esi, Edi, Ebp, Eip, Esp, SegCs, SegDs, SegEs, SegSs; } CONTEXT;
+typedef void (*DOSRELAY)(CONTEXT *, void *);
+
+#pragma pack(push, 1)
+typedef struct
+{
+	DWORD frame32;
+	DWORD edx, ecx, ebp;
+	WORD ds, es, fs, gs;
+	DWORD callfrom_ip, module_cs, relay;
+	WORD entry_ip;
+	DWORD entry_point;
+	WORD bp, ip, cs;
+} STACK16FRAME;
+
+typedef struct
+{
+	BYTE pushl;
+	DWORD relay;
+	BYTE lcall;
+	DWORD glue;
+	WORD flatcs;
+	WORD ret[5];
+	WORD movl;
+	DWORD arg_types[2];
+} CALLFROM16;
+#pragma pack(pop)
+
+enum arg_types { ARG_NONE, ARG_WORD, ARG_SWORD, ARG_LONG, ARG_PTR, ARG_STR, ARG_SEGSTR, ARG_VARARG };
+
+#define MAKESEGPTR(seg, off) ((SEGPTR)MAKELONG(off, seg))
+#define FIELD_OFFSET(type, field) offsetof(type, field)
+#define __ASM_GLOBAL_FUNC(name, code)
+#define SYSLEVEL_CheckNotLevel(level)
+
+/* the selector bases of the LDT copy in the memory of the core; pointers passed on are linear addresses in it */
+static const DWORD *relay16_ldt;
+
+static void *MapSL(SEGPTR segptr)
+{
+	return (void *)(uintptr_t)(relay16_ldt[HIWORD(segptr) >> 3] + LOWORD(segptr));
+}
+
+/* only relay_call_from_16_no_debug is called: the rest of relay.c needs no more than to compile */
+typedef struct { WORD ne_enttab, ne_restab; } NE_MODULE;
+typedef struct { WORD first, last, next; } ET_BUNDLE;
+typedef struct { BYTE type, flags, segnum; WORD offs; } ET_ENTRY;
+typedef struct tagRELAY_STATS RELAY_STATS;
+typedef struct { WORD relay_code_sel, relay_data_sel; } DOSVM_TABLE;
+typedef struct { const WCHAR *Buffer; } UNICODE_STRING;
+typedef struct { DWORD Length; HANDLE RootDirectory; UNICODE_STRING *ObjectName; DWORD Attributes;
+	void *SecurityDescriptor, *SecurityQualityOfService; } OBJECT_ATTRIBUTES;
+typedef struct { BYTE Data[1]; } KEY_VALUE_PARTIAL_INFORMATION;
+
+#define DOSVM_RELAY_DATA_SIZE 4096
+#define CURRENT_STACK16 ((STACK16FRAME *)NULL)
+#define KEY_READ 0
+#define KeyValuePartialInformation 0
+#define GetProcessHeap() NULL
+#define RtlAllocateHeap(heap, flags, size) malloc(size)
+#define toupperW(c) ((c) >= 'a' && (c) <= 'z' ? (c) - 0x20 : (c))
+#define DPRINTF(...) do { } while (0)
+#define debugstr_a(s) ""
+#define PUSH_WORD16(context, w) ((void)(w))
+#define wine_get_cs() 0
+#define __stdcall
+
+static DOSVM_TABLE *DOSVM_dpmi_segments;
+static void __wine_call_from_16_regs(void) {}
+static WCHAR *strchrW(const WCHAR *str, WCHAR ch) { for (; *str; str++) if (*str == ch) return (WCHAR *)str; return NULL; }
+static WCHAR *strrchrW(const WCHAR *str, WCHAR ch) { WCHAR *p = NULL; for (; *str; str++) if (*str == ch) p = (WCHAR *)str; return p; }
+static size_t strlenW(const WCHAR *str) { size_t n = 0; while (str[n]) n++; return n; }
+static void strcpyW(WCHAR *dst, const WCHAR *src) { while ((*dst++ = *src++)); }
+static void RtlOpenCurrentUser(DWORD access, HANDLE *key) { *key = NULL; }
+static void RtlInitUnicodeString(UNICODE_STRING *name, const WCHAR *str) { name->Buffer = str; }
+static DWORD NtOpenKey(HANDLE *key, DWORD access, OBJECT_ATTRIBUTES *attr) { return 1; }
+static DWORD NtQueryValueKey(HANDLE key, UNICODE_STRING *name, int class, void *info, DWORD size, DWORD *count) { return 1; }
+static void NtClose(HANDLE key) {}
+static NE_MODULE *NE_GetPtr(HANDLE16 module) { return NULL; }
+static HANDLE16 GlobalHandle16(WORD sel) { return 0; }
+static HANDLE16 FarGetOwner16(HANDLE16 handle) { return 0; }
+static BOOL RELAY16_StatsEnabled(void) { return FALSE; }
+static BOOL RELAY16_TraceEnabled(void) { return FALSE; }
+static RELAY_STATS *RELAY16_GetStats(SEGPTR key) { return NULL; }
+static RELAY_STATS *RELAY16_AddStats(SEGPTR key, const char *module, WORD ordinal, const char *func) { return NULL; }
+static LONGLONG RELAY16_StatsTime(void) { return 0; }
+static void RELAY16_AddCall(RELAY_STATS *stats, LONGLONG start) {}
+static void RELAY16_TraceEntry(SEGPTR key, const char *module, WORD ordinal, const char *func,
+	const CALLFROM16 *call) {}
+static void RELAY16_TraceCall(SEGPTR key, const CALLFROM16 *call, const void *args, const STACK16FRAME *frame) {}
+static void RELAY16_TraceReturn(SEGPTR key, const CALLFROM16 *call, int ret, const CONTEXT *context) {}
+
+#include "../../krnl386/relay.c"
+
+/* what relay_call_from_16_no_debug passes to the entry point */
+static int *relay16_args;
+static int relay16_nb_args;
+
+int call_entry_point(void *func, int nb_args, const int *args)
+{
+	memcpy(relay16_args, args, nb_args * sizeof(*args));
+	relay16_nb_args = nb_args;
+	return 0;
+}
+
+/*
+	The arguments relay_call_from_16_no_debug passes for a call through
+	the STACK16FRAME at linear 'frame', the arguments following it, or -1
+	if it calls nothing.  The start of the varargs, which it passes as a
+	pointer to the host copy of the stack, is made linear again.
+*/
+int relay16_reference(BYTE *mem, const DWORD *ldt, DWORD frame, DWORD context, int *args)
+{
+	STACK16FRAME *f = (STACK16FRAME *)(mem + frame);
+	const CALLFROM16 *call;
+
+	relay16_ldt = ldt;
+	relay16_args = args;
+	relay16_nb_args = -1;
+	call = (const CALLFROM16 *)(mem + (uintptr_t)MapSL(MAKESEGPTR(f->module_cs, f->callfrom_ip)) -
+		FIELD_OFFSET(CALLFROM16, ret));
+	relay_call_from_16_no_debug((void *)(uintptr_t)f->entry_point, (BYTE *)(f + 1),
+		(CONTEXT *)(uintptr_t)context, call);
+	for (int i = 0; i < relay16_nb_args && i < 20; i++)
+		if ((call->arg_types[i / 10] >> (3 * (i % 10)) & 7) == ARG_VARARG)
+			args[i] -= (int)(intptr_t)mem;
+	return relay16_nb_args;
+}
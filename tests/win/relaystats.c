@@ -0,0 +1,291 @@
+/*
+	Relay call statistics (krnl386/relaystats.c)
+
+	Eight threads count 200000 calls each into the same 64 entry points,
+	all of them adding the entry points as they first call them, on a
+	clock of their own that the calls advance by a random number of
+	microseconds.  The calls, total and maximum time and histogram of
+	every entry point must then be exactly what the threads counted.
+	Next the threads add more entry points than the table takes: each
+	must be in the table under its own name or counted in "(table full)",
+	and the table must hold no more than half its slots.  Last the CSV
+	written by RELAY16_DumpStats must have every call, the entry points
+	taking the most time first.
+*/
+
+#include "win32.h"
+#include <pthread.h>
+#include <unistd.h>
+
+/* winbase.h and kernel16_private.h */
+typedef union { LONGLONG QuadPart; } LARGE_INTEGER;
+typedef pthread_mutex_t CRITICAL_SECTION;
+typedef struct tagRELAY_STATS RELAY_STATS;
+
+#define HEAP_ZERO_MEMORY 8
+#define MAKESEGPTR(seg, off) ((SEGPTR)MAKELONG(off, seg))
+#define GetProcessHeap() NULL
+#define HeapAlloc(heap, flags, size) ((flags) & HEAP_ZERO_MEMORY ? calloc(1, size) : malloc(size))
+#define HeapFree(heap, flags, p) free(p)
+#define InitializeCriticalSection(cs) pthread_mutex_init(cs, NULL)
+#define EnterCriticalSection(cs) pthread_mutex_lock(cs)
+#define LeaveCriticalSection(cs) pthread_mutex_unlock(cs)
+#define InterlockedExchange(p, v) __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST)
+#define InterlockedIncrement(p) __atomic_add_fetch(p, 1, __ATOMIC_SEQ_CST)
+#define InterlockedIncrement64(p) __atomic_add_fetch(p, 1, __ATOMIC_SEQ_CST)
+#define InterlockedExchangeAdd64(p, v) __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST)
+#define InterlockedCompareExchange64(p, v, cmp) __sync_val_compare_and_swap(p, cmp, v)
+#define WaitForSingleObject(handle, timeout) (-1)
+#define WAIT_OBJECT_0 0
+#define INFINITE (-1)
+
+static char *lstrcpynA(char *dst, const char *src, int n)
+{
+	snprintf(dst, n, "%s", src);
+	return dst;
+}
+
+/* RELAY16_StatsEnabled is not called: the test dumps the statistics itself */
+static HANDLE CreateEventA(void *attr, BOOL manual, BOOL initial, LPCSTR name) { return NULL; }
+static HANDLE CreateThread(void *attr, size_t stack, DWORD (WINAPI *start)(LPVOID), LPVOID arg, DWORD flags,
+	DWORD *id) { return NULL; }
+static BOOL CloseHandle(HANDLE handle) { return TRUE; }
+
+/* a clock for each thread, in microseconds */
+static __thread LONGLONG test_clock;
+
+static BOOL QueryPerformanceCounter(LARGE_INTEGER *counter)
+{
+	counter->QuadPart = test_clock;
+	return TRUE;
+}
+
+static BOOL QueryPerformanceFrequency(LARGE_INTEGER *frequency)
+{
+	frequency->QuadPart = 1000000;
+	return TRUE;
+}
+
+/* msvcrt's %I64d is %lld here */
+static int test_fprintf(FILE *file, const char *format, ...)
+{
+	char copy[256], *p;
+	va_list arg;
+	int ret;
+
+	snprintf(copy, sizeof(copy), "%s", format);
+	while ((p = strstr(copy, "I64")))
+		memmove(p, p + 1, strlen(p)), p[0] = 'l', p[1] = 'l';
+	va_start(arg, format);
+	ret = vfprintf(file, copy, arg);
+	va_end(arg);
+	return ret;
+}
+#define fprintf test_fprintf
+
+#include "../../krnl386/relaystats.c"
+
+#undef fprintf
+
+DWORD WINAPI krnl386_get_config_string(LPCSTR appname, LPCSTR keyname, LPCSTR def, LPSTR ret, DWORD size)
+{
+	return snprintf(ret, size, "%s", def);
+}
+
+DWORD WINAPI krnl386_get_config_int(LPCSTR appname, LPCSTR keyname, INT def)
+{
+	return def;
+}
+
+#define THREADS     8
+#define CALLS       200000
+#define ENTRIES     64
+#define MORE        1000    /* entry points each thread adds to fill the table */
+
+static struct
+{
+	int thread;
+	LONGLONG calls[ENTRIES], total[ENTRIES], max[ENTRIES];
+	LONG histogram[ENTRIES][RELAY_STATS_BUCKETS];
+	int in_table;
+} counted[THREADS];
+
+static pthread_barrier_t start;
+
+static SEGPTR entry_key(int thread, int n)
+{
+	/* CALLFROM16 entries are 0x1a bytes apart in the code segments of the modules */
+	return MAKESEGPTR(0x1000 + (n % 16) * 8 + thread * 0x100, 0x20 + (n / 16) * 0x1a);
+}
+
+static void entry_name(int thread, int n, char *module, char *func, WORD *ordinal)
+{
+	sprintf(module, "MOD%d", thread * 0x100 + n % 16);
+	sprintf(func, "Func%d_%d", thread, n);
+	*ordinal = n + 1;
+}
+
+static RELAY_STATS *entry_stats(int thread, int n)
+{
+	char module[10], func[64];
+	RELAY_STATS *stats;
+	WORD ordinal;
+
+	if ((stats = RELAY16_GetStats(entry_key(thread, n))))
+		return stats;
+	entry_name(thread, n, module, func, &ordinal);
+	return RELAY16_AddStats(entry_key(thread, n), module, ordinal, func);
+}
+
+static BOOL entry_check(RELAY_STATS *stats, int thread, int n)
+{
+	char module[10], func[64];
+	WORD ordinal;
+
+	entry_name(thread, n, module, func, &ordinal);
+	return stats->key == entry_key(thread, n) && !strcmp(stats->module, module) && !strcmp(stats->func, func) &&
+		stats->ordinal == ordinal;
+}
+
+static void *test_thread(void *arg)
+{
+	int t = *(int *)arg;
+	DWORD seed = 0x5747a75 + t * 0x9e3779b9;
+
+	pthread_barrier_wait(&start);
+	for (int i = 0; i < CALLS; i++)
+	{
+		int n = random32(&seed) % ENTRIES, bucket = 0;
+		LONGLONG us = random32(&seed) & ((1u << random32(&seed) % 26) - 1);
+		RELAY_STATS *stats = entry_stats(0, n);
+		LONGLONG start = RELAY16_StatsTime();
+
+		test_clock += us;
+		RELAY16_AddCall(stats, start);
+		counted[t].calls[n]++;
+		counted[t].total[n] += us;
+		counted[t].max[n] = max(counted[t].max[n], us);
+		while (us && bucket < RELAY_STATS_BUCKETS - 1)
+			us >>= 1, bucket++;
+		counted[t].histogram[n][bucket]++;
+	}
+
+	/* then more entry points than fit */
+	pthread_barrier_wait(&start);
+	for (int n = 0; n < MORE; n++)
+	{
+		RELAY_STATS *stats = entry_stats(t + 1, n);
+
+		RELAY16_AddCall(stats, RELAY16_StatsTime());
+		counted[t].in_table += stats != &relay_stats_other;
+	}
+	return NULL;
+}
+
+static void test_relaystats(void)
+{
+	pthread_t threads[THREADS];
+	LONGLONG all = 0, previous = -1;
+	int in_table = 0, rows = 0;
+	char line[1024];
+	FILE *file;
+
+	if (!RELAY16_InitStats())
+	{
+		fail("RELAY16_InitStats failed\n");
+		return;
+	}
+	pthread_barrier_init(&start, NULL, THREADS);
+	for (int t = 0; t < THREADS; t++)
+	{
+		counted[t].thread = t;
+		pthread_create(&threads[t], NULL, test_thread, &counted[t].thread);
+	}
+	for (int t = 0; t < THREADS; t++)
+		pthread_join(threads[t], NULL);
+
+	for (int n = 0; n < ENTRIES; n++)
+	{
+		RELAY_STATS *stats = RELAY16_GetStats(entry_key(0, n));
+		LONGLONG calls = 0, total = 0, max = 0;
+		LONG histogram[RELAY_STATS_BUCKETS] = { 0 };
+
+		if (!stats || !entry_check(stats, 0, n))
+		{
+			fail("entry %d: missing or named wrong\n", n);
+			continue;
+		}
+		for (int t = 0; t < THREADS; t++)
+		{
+			calls += counted[t].calls[n];
+			total += counted[t].total[n];
+			max = max(max, counted[t].max[n]);
+			for (int b = 0; b < RELAY_STATS_BUCKETS; b++)
+				histogram[b] += counted[t].histogram[n][b];
+		}
+		all += calls;
+		if (stats->calls != calls || stats->total != total || stats->max != max)
+			fail("entry %d: %lld calls, %lld us, max %lld us, expected %lld, %lld, %lld\n", n, stats->calls,
+				stats->total, stats->max, calls, total, max);
+		if (memcmp(stats->histogram, histogram, sizeof(histogram)))
+			fail("entry %d: wrong histogram\n", n);
+	}
+	if (all != (LONGLONG)THREADS * CALLS)
+		fail("%lld calls counted, expected %d\n", all, THREADS * CALLS);
+
+	for (int t = 0; t < THREADS; t++)
+	{
+		in_table += counted[t].in_table;
+		for (int n = 0; n < MORE; n++)
+		{
+			RELAY_STATS *stats = RELAY16_GetStats(entry_key(t + 1, n));
+
+			if (stats && !entry_check(stats, t + 1, n))
+				fail("thread %d entry %d: named wrong\n", t, n);
+		}
+	}
+	if (relay_stats_count != RELAY_STATS_SIZE / 2 || in_table != RELAY_STATS_SIZE / 2 - ENTRIES ||
+		relay_stats_other.calls != THREADS * MORE - in_table)
+		fail("%d entry points in the table, %d added by the threads, %lld calls in \"(table full)\"\n",
+			relay_stats_count, in_table, relay_stats_other.calls);
+
+	sprintf(relay_stats_file, "/tmp/relaystats.%d.csv", (int)getpid());
+	RELAY16_DumpStats();
+	if (!(file = fopen(relay_stats_file, "r")))
+	{
+		fail("no %s\n", relay_stats_file);
+		return;
+	}
+	all = 0;
+	fgets(line, sizeof(line), file);
+	if (strncmp(line, "module,ordinal,function,calls,total_us,", 39))
+		fail("header %s", line);
+	while (fgets(line, sizeof(line), file))
+	{
+		char module[10], func[64];
+		unsigned ordinal;
+		long long calls;
+		double total;
+
+		if (sscanf(line, "%9[^,],%u,%63[^,],%lld,%lf", module, &ordinal, func, &calls, &total) != 5 &&
+			sscanf(line, ",%u,%63[^,],%lld,%lf", &ordinal, func, &calls, &total) != 4)
+		{
+			fail("row %d: %s", rows, line);
+			break;
+		}
+		if (previous >= 0 && total > previous)
+			fail("row %d: %.1f us after %lld us\n", rows, total, previous);
+		previous = (LONGLONG)total;
+		all += calls;
+		rows++;
+	}
+	fclose(file);
+	unlink(relay_stats_file);
+	if (rows != relay_stats_count + 1 || all != (LONGLONG)THREADS * (CALLS + MORE))
+		fail("%d rows with %lld calls, expected %d with %d\n", rows, all, relay_stats_count + 1, THREADS * (CALLS + MORE));
+}
+
+int main(int argc, char **argv)
+{
+	return run_test(argc, argv, "relaystats", test_relaystats);
+}
@@ -0,0 +1,175 @@
+/*
+	Binary relay trace (krnl386/relaytrace.c and relaytrace/main.c)
+
+	Calls into a pascal entry point returning a word, a cdecl one with
+	varargs called from it, a register function and a pascal entry point
+	with more arguments than a record holds are written to a trace on a
+	fake clock.  Nothing may reach the file before RelayTraceFlush has
+	passed, and everything written must be there once it has, before the
+	trace is closed.  The decoder must then print the calls, arguments,
+	return values and times that were written, and sum them up with -s.
+*/
+
+#include "win32.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../../krnl386/relaytrace.h"
+
+/* winbase.h, wine/winbase16.h and kernel16_private.h, the fields the writer uses */
+typedef union { LONGLONG QuadPart; } LARGE_INTEGER;
+typedef struct { DWORD Eax; } CONTEXT;
+typedef struct { WORD ds, ip, cs; } STACK16FRAME;
+typedef struct { WORD ret[5]; WORD movl; DWORD arg_types[2]; } CALLFROM16;
+
+enum arg_types { ARG_NONE, ARG_WORD, ARG_SWORD, ARG_LONG, ARG_PTR, ARG_STR, ARG_SEGSTR, ARG_VARARG };
+
+static char trace_path[MAX_PATH];
+static LONGLONG test_clock;     /* microseconds */
+
+static char *lstrcpynA(char *dst, const char *src, int n)
+{
+	snprintf(dst, n, "%s", src);
+	return dst;
+}
+
+static BOOL QueryPerformanceCounter(LARGE_INTEGER *counter)
+{
+	counter->QuadPart = test_clock;
+	return TRUE;
+}
+
+static BOOL QueryPerformanceFrequency(LARGE_INTEGER *frequency)
+{
+	frequency->QuadPart = 1000000;
+	return TRUE;
+}
+
+static DWORD GetCurrentThreadId(void) { return 0x2a; }
+static BOOL RELAY16_InitStats(void) { return TRUE; }
+
+#include "../../krnl386/relaytrace.c"
+
+DWORD WINAPI krnl386_get_config_string(LPCSTR appname, LPCSTR keyname, LPCSTR def, LPSTR ret, DWORD size)
+{
+	return snprintf(ret, size, "%s", strcmp(keyname, "RelayTrace") ? def : trace_path);
+}
+
+DWORD WINAPI krnl386_get_config_int(LPCSTR appname, LPCSTR keyname, INT def)
+{
+	return def;
+}
+
+/* the entry points: a pascal function returning a word, cdecl with varargs, register, pascal with 15 longs */
+static const CALLFROM16 message_box = { { 0x9090, 0xca66, 12 },
+	0, { ARG_WORD | ARG_SEGSTR << 3 | ARG_SEGSTR << 6 | ARG_WORD << 9 } };
+static const CALLFROM16 wsprintf = { { 0x9090, 0xcb66 }, 0, { ARG_PTR | ARG_SEGSTR << 3 | ARG_VARARG << 6 } };
+static const CALLFROM16 dos3call = { { 0xca66, 0 } };
+static const CALLFROM16 many = { { 0x9090, 0x9090, 0xca66, 60 }, 0,
+	{ 011111111111u * ARG_LONG, 011111 * ARG_LONG } };
+
+#define KEY_MESSAGE_BOX 0x00570010
+#define KEY_WSPRINTF    0x005f0020
+#define KEY_DOS3CALL    0x00170030
+#define KEY_MANY        0x00170040
+
+static const char expected[] =
+	"         0.000 002a:Call USER.1: MESSAGEBOX(1234,1117:0004,1117:0010,0030) ret=1107:0200 ds=1117\n"
+	"        10.000 002a:Call USER.420: WSPRINTF(1117:0100,1117:0020,...) ret=1107:0300 ds=1117\n"
+	"        35.000 002a:Ret  USER.420: WSPRINTF() retval=0007 time=25.0us\n"
+	"       135.000 002a:Ret  USER.1: MESSAGEBOX() retval=0001 time=135.0us\n"
+	"   1000135.000 002a:Call KERNEL.102: DOS3CALL() ret=1107:0400 ds=1117\n"
+	"   1000137.000 002a:Ret  KERNEL.102: DOS3CALL() retval=none AX=4c00 time=2.0us\n"
+	"   1000137.000 002a:Call KERNEL.999: MANY(00000001,00000002,00000003,00000004,00000005,00000006,00000007,"
+	"00000008,00000009,0000000a,0000000b,0000000c,0000000d,?) ret=1107:0500 ds=1117\n"
+	"   1000140.000 002a:Ret  KERNEL.999: MANY() retval=ffffffff time=3.0us\n";
+
+static const char expected_summary[] =
+	"       calls      total(us)     mean(us)      max(us)  function\n"
+	"           1          135.0       135.00        135.0  USER.1: MESSAGEBOX\n"
+	"           1           25.0        25.00         25.0  USER.420: WSPRINTF\n";
+
+static long trace_size(void)
+{
+	struct stat st;
+
+	return stat(trace_path, &st) ? -1 : (long)st.st_size;
+}
+
+static void call(SEGPTR key, const CALLFROM16 *entry, const char *module, WORD ordinal, const char *func,
+	const void *args, WORD ip)
+{
+	STACK16FRAME frame = { 0x1117, ip, 0x1107 };
+
+	RELAY16_TraceEntry(key, module, ordinal, func, entry);
+	RELAY16_TraceCall(key, entry, args, &frame);
+}
+
+static void check_output(const char *options, const char *wanted)
+{
+	char command[2 * MAX_PATH], output[4096];
+	size_t size;
+	FILE *pipe;
+
+	snprintf(command, sizeof(command), "%s %s %s", RELAYTRACE, options, trace_path);
+	if (!(pipe = popen(command, "r")))
+	{
+		fail("cannot run %s\n", command);
+		return;
+	}
+	size = fread(output, 1, sizeof(output) - 1, pipe);
+	output[size] = 0;
+	if (pclose(pipe) || strcmp(output, wanted))
+		fail("relaytrace %s printed\n%sexpected\n%s", options, output, wanted);
+}
+
+static void test_relaytrace(void)
+{
+	/* pascal: the first argument is last on the stack */
+	static const BYTE message_box_args[] = { 0x30, 0x00, 0x10, 0x00, 0x17, 0x11, 0x04, 0x00, 0x17, 0x11, 0x34, 0x12 };
+	static const BYTE wsprintf_args[] = { 0x00, 0x01, 0x17, 0x11, 0x20, 0x00, 0x17, 0x11, 0x05, 0x00 };
+	DWORD many_args[15];
+	CONTEXT context = { 0x4c00 };
+	long header = sizeof(RELAYTRACE_FILE), record = sizeof(RELAYTRACE_RECORD);
+
+	for (int i = 0; i < 15; i++)
+		many_args[i] = 15 - i;
+	sprintf(trace_path, "/tmp/relaytrace.%d.trc", (int)getpid());
+	if (!RELAY16_TraceEnabled())
+	{
+		fail("cannot write %s\n", trace_path);
+		return;
+	}
+
+	call(KEY_MESSAGE_BOX, &message_box, "USER", 1, "MESSAGEBOX", message_box_args, 0x200);
+	test_clock += 10;
+	call(KEY_WSPRINTF, &wsprintf, "USER", 420, "WSPRINTF", wsprintf_args, 0x300);
+	test_clock += 25;
+	RELAY16_TraceReturn(KEY_WSPRINTF, &wsprintf, 7, &context);
+	test_clock += 100;
+	RELAY16_TraceReturn(KEY_MESSAGE_BOX, &message_box, 1, &context);
+	if (trace_size() != 0)
+		fail("%ld bytes written before a second passed\n", trace_size());
+
+	/* a second later, the next record flushes the trace */
+	test_clock += 1000000;
+	call(KEY_DOS3CALL, &dos3call, "KERNEL", 102, "DOS3CALL", NULL, 0x400);
+	if (trace_size() != header + 7 * record)
+		fail("%ld bytes written after a second, expected %ld\n", trace_size(), header + 7 * record);
+	test_clock += 2;
+	RELAY16_TraceReturn(KEY_DOS3CALL, &dos3call, 0, &context);
+	call(KEY_MANY, &many, "KERNEL", 999, "MANY", many_args, 0x500);
+	test_clock += 3;
+	RELAY16_TraceReturn(KEY_MANY, &many, -1, &context);
+	relay_trace_close();
+	if (trace_size() != header + 12 * record)
+		fail("%ld bytes in the trace, expected %ld\n", trace_size(), header + 12 * record);
+
+	check_output("", expected);
+	check_output("-s -m user", expected_summary);
+	unlink(trace_path);
+}
+
+int main(int argc, char **argv)
+{
+	return run_test(argc, argv, "relaytrace", test_relaytrace);
+}
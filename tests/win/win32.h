@@ -0,0 +1,123 @@
+/*
+	Host environment for testing parts of krnl386 and libwine on Linux
+
+	Each test includes the source file it tests, whole, after this header,
+	which stands in for the Windows and Wine headers the source includes:
+	their include guards are defined here, so the #include lines of the
+	source find them already done.  Only what the tested code needs is
+	here; a test adds what only its source uses.
+
+	fail() counts a failure; the tests exit with the number of them.
+*/
+
+#ifndef WIN32_H
+#define WIN32_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+#define __WINE_CONFIG_H
+#define __WINE_WINE_PORT_H
+#define __WINE_WINDOWS_H
+#define _WINDEF_
+#define __WINE_WINBASE_H
+#define __WINE_WINERROR_H
+#define __WINE_WINTERNL_H
+#define __WINE_EXCPT_H
+#define _WOWNT32_H_
+#define __WINE_WINE_WINBASE16_H
+#define __WINE_WINE_EXCEPTION_H
+#define __WINE_WINE_DEBUG_H
+#define __WINE_KERNEL16_PRIVATE_H
+
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG;
+typedef int16_t INT16;
+typedef int INT;
+typedef unsigned int UINT;
+typedef int BOOL;
+typedef char CHAR;
+typedef uintptr_t ULONG_PTR;
+typedef intptr_t SSIZE_T;
+typedef void *HANDLE;
+typedef WORD HANDLE16;
+typedef WORD UINT16;
+typedef WORD BOOL16;
+typedef WORD HLOCAL16;
+typedef WORD HGLOBAL16;
+typedef WORD HINSTANCE16;
+typedef WORD HMENU16;
+typedef DWORD SEGPTR;
+typedef DWORD FARPROC16;
+typedef BYTE *LPBYTE;
+typedef const char *LPCSTR;
+typedef char *LPSTR;
+typedef void *LPVOID;
+
+#define TRUE 1
+#define FALSE 0
+#define WINAPI
+#define __declspec(x)
+#define MAX_PATH 260
+
+#define LOWORD(l) ((WORD)((DWORD)(l) & 0xffff))
+#define HIWORD(l) ((WORD)((DWORD)(l) >> 16))
+#define MAKELONG(low, high) ((LONG)(((WORD)(low)) | (((DWORD)((WORD)(high))) << 16)))
+
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+/* wine/debug.h: only errors are shown, and only with -v */
+extern int verbose;
+#define WINE_DEFAULT_DEBUG_CHANNEL(ch)
+#define TRACE_ON(ch) 0
+#define WARN_ON(ch) 0
+#define TRACE(...) do { } while (0)
+#define WARN(...) do { } while (0)
+#define FIXME(...) do { } while (0)
+#define ERR(...) do { if (verbose) fprintf(stderr, __VA_ARGS__); } while (0)
+
+int verbose;
+static int failures;
+
+static void fail(const char *format, ...)
+{
+	va_list arg;
+
+	va_start(arg, format);
+	vprintf(format, arg);
+	va_end(arg);
+	failures++;
+}
+
+/* Parses -v and returns the failures, for main() to return */
+static int run_test(int argc, char **argv, const char *name, void (*test)(void))
+{
+	verbose = argc > 1 && !strcmp(argv[1], "-v");
+	test();
+	printf("%s: %s\n", name, failures ? "FAILED" : "ok");
+	return failures;
+}
+
+/* xorshift32, for tests that generate their cases */
+static inline DWORD random32(DWORD *seed)
+{
+	DWORD x = *seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *seed = x;
+}
+
+#endif
@@ -1084,7 +1084,10 @@ HMENU16 WINAPI CreateMenu16(void)
  */
 BOOL16 WINAPI DestroyMenu16( HMENU16 hMenu )
 {
-    return DestroyMenu( HMENU_32(hMenu) );
+    HMENU hmenu32 = HMENU_32(hMenu);
+    BOOL ret = DestroyMenu( hmenu32 );
+    if (ret && !IsMenu( hmenu32 )) K32WOWHandle16Release( hmenu32 );
+    return ret;
 }
 
 
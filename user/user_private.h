@@ -257,6 +257,7 @@ extern PUserRegisterWowHandlers UserRegisterWowHandlers;
 #define strncasecmp _strnicmp
 __declspec(dllimport) void SetWndProc16(WORD hWnd16, DWORD WndProc);
 __declspec(dllimport) DWORD GetWndProc16(WORD hWnd16);
+__declspec(dllimport) void K32WOWHandle16Release(HANDLE handle);
 #define STR_ATOM_MIN MAXINTATOM
 #define STR_ATOM_MAX 0xFFFF
 #define STR_ATOM_SIZE STR_ATOM_MAX - STR_ATOM_MIN
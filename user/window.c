@@ -547,7 +547,10 @@ HWND16 WINAPI FindWindow16( LPCSTR className, LPCSTR title )
  */
 BOOL16 WINAPI DestroyWindow16( HWND16 hwnd )
 {
-    return DestroyWindow( WIN_Handle32(hwnd) );
+    HWND hwnd32 = WIN_Handle32(hwnd);
+    BOOL ret = DestroyWindow( hwnd32 );
+    if (ret && !IsWindow( hwnd32 )) K32WOWHandle16Release( hwnd32 );
+    return ret;
 }
 
 
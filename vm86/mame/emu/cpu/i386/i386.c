@@ -57,6 +57,7 @@ static UINT32 i386_load_protected_mode_segment(I386_SREG *seg, UINT64 *desc )
 		seg->limit = 0;
 		seg->d = 0;
 		seg->valid = false;
+		i386_sreg_window(seg);
 		return 0;
 	}
 
@@ -83,6 +84,7 @@ static UINT32 i386_load_protected_mode_segment(I386_SREG *seg, UINT64 *desc )
 		seg->limit = (seg->limit << 12) | 0xfff;
 	seg->d = (seg->flags & 0x4000) ? 1 : 0;
 	seg->valid = true;
+	i386_sreg_window(seg);
 
 	if(desc)
 		*desc = ((UINT64)v2<<32)|v1;
@@ -159,6 +161,7 @@ static void i386_load_segment_descriptor(int segment )
 			m_sreg[segment].flags = (segment == CS) ? 0x00fb : 0x00f3;
 			m_sreg[segment].d = 0;
 			m_sreg[segment].valid = true;
+			i386_sreg_window(&m_sreg[segment]);
 		}
 	}
 	else
@@ -172,6 +175,7 @@ static void i386_load_segment_descriptor(int segment )
 
 		if( segment == CS && !m_performed_intersegment_jump )
 			m_sreg[segment].base |= 0xfff00000;
+		i386_sreg_window(&m_sreg[segment]);
 	}
 }
 
@@ -209,8 +213,8 @@ static UINT32 get_flags()
 {
 	UINT32 f = 0x2;
 	f |= m_CF;
-	f |= m_PF << 2;
-	f |= m_AF << 4;
+	f |= GetPF() << 2;
+	f |= GetAF() << 4;
 	f |= m_ZF << 6;
 	f |= m_SF << 7;
 	f |= m_TF << 8;
@@ -232,8 +236,8 @@ static UINT32 get_flags()
 static void set_flags(UINT32 f )
 {
 	m_CF = (f & 0x1) ? 1 : 0;
-	m_PF = (f & 0x4) ? 1 : 0;
-	m_AF = (f & 0x10) ? 1 : 0;
+	ForcePF(f & 0x4);
+	ForceAF(f & 0x10);
 	m_ZF = (f & 0x40) ? 1 : 0;
 	m_SF = (f & 0x80) ? 1 : 0;
 	m_TF = (f & 0x100) ? 1 : 0;
@@ -1001,6 +1005,24 @@ static void i386_trap(int irq, int irq_gate, int trap_level)
 
 }
 
+/* Deliver an exception raised with FAULT_THROW/PF_THROW.  Faults are
+   still C++ exceptions: the memory accessors and handlers return no
+   status, and the dispatcher catches them in a try/catch once per
+   instruction (CPU_EXECUTE) or once per block (i386_block_execute).
+   Only #GP, #SS and #PF are raised this way; they are faults, which
+   restart the instruction, so EIP is put back to its first byte,
+   prefixes included, before the trap.  Traps (the vectors i386_trap
+   pushes m_eip for) would return after the instruction. */
+static void i386_fault(UINT64 fault)
+{
+	int irq = fault & 0xffffffff;
+
+	if(irq != 3 && irq != 4 && irq != 9)
+		m_eip = m_prev_eip;
+	m_ext = 1;
+	i386_trap_with_error(irq, 0, 0, fault >> 32);
+}
+
 static void i386_trap_with_error(int irq, int irq_gate, int trap_level, UINT32 error)
 {
 	i386_trap(irq,irq_gate,trap_level);
@@ -2839,6 +2861,7 @@ static void I386OP(decode_opcode)()
 static void I386OP(decode_two_byte)()
 {
 	m_opcode = FETCH();
+	m_profile_escape = 1;
 
 	if(m_lock && !m_lock_table[1][m_opcode])
 		return I386OP(invalid)();
@@ -2993,6 +3016,7 @@ static void i386_common_init(int tlbsize)
 	}
 
 	m_vtlb = vtlb_alloc(AS_PROGRAM, 0, tlbsize);
+	code_page_register(i386_block_write);
 	m_smi = false;
 	m_lock = false;
 
@@ -3122,8 +3146,8 @@ static void zero_state()
 	m_SF = 0;
 	m_OF = 0;
 	m_ZF = 0;
-	m_PF = 0;
-	m_AF = 0;
+	ForcePF(0);
+	ForceAF(0);
 	m_IF = 0;
 	m_TF = 0;
 	m_IOP1 = 0;
@@ -3312,6 +3336,8 @@ static void pentium_smi()
 	m_sreg[CS].limit = 0xffffffff;
 	m_sreg[CS].flags = 0x809b;
 	m_sreg[CS].valid = true;
+	for(int i = 0; i < 6; i++)
+		i386_sreg_window(&m_sreg[i]);
 	m_cr[4] = 0;
 	m_dr[7] = 0x400;
 	m_eip = 0x8000;
@@ -3402,7 +3428,9 @@ static CPU_EXECUTE( i386 )
 #endif
 		try
 		{
+			m_profile_escape = 0;
 			I386OP(decode_opcode)();
+			i386_profile_insn(m_profile_escape);
 			if(m_TF && old_tf)
 			{
 				m_prev_eip = m_eip;
@@ -3414,8 +3442,7 @@ static CPU_EXECUTE( i386 )
 		}
 		catch(UINT64 e)
 		{
-			m_ext = 1;
-			i386_trap_with_error(e&0xffffffff,0,0,e>>32);
+			i386_fault(e);
 		}
 //	}
 #ifdef SUPPORT_RDTSC
@@ -3423,6 +3450,9 @@ static CPU_EXECUTE( i386 )
 #endif
 }
 
+#include "i386blk.c"
+#include "i386prof.c"
+
 /*************************************************************************/
 
 static CPU_TRANSLATE( i386 )
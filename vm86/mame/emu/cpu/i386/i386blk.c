@@ -0,0 +1,504 @@
+// Basic-block cache for the i386 core (not part of MAME)
+/***************************************************************************
+
+    Basic-block cache
+
+    CPU_EXECUTE runs one instruction per call and every instruction pays
+    for a FETCH of its opcode byte and an indirect jump through the
+    opcode table, plus the per-instruction checks done by the caller.
+
+    The block cache records straight-line runs of instructions the first
+    time they are executed: for each instruction the offset from the
+    block start, the first opcode byte and the handler it dispatched to.
+    Later executions replay the run without fetching and decoding the
+    opcode byte again.  Operand size, address size and segment override
+    prefixes and the 0f escape are resolved when recording, so replay
+    calls the handler of the final opcode directly instead of going
+    through the prefix handlers.  Handlers still fetch their own ModRM and
+    immediate bytes, so only the instruction boundaries, the prefixes and
+    the dispatch are cached.
+
+    A block is keyed on (linear pc, eip, CS operand size, PM/V86 mode).
+    Replay stops as soon as an instruction does not continue at the next
+    recorded instruction (taken branch, far transfer, fault, interrupt),
+    so branches never have to be predicted.
+
+    Two cases common in tight loops of DOS and Win16 code are handled in
+    the block itself.  A jcc rel8 following another instruction has its
+    displacement cached and its condition tested inline, so a compare or
+    dec and its branch cost one handler call.  A block that branches back
+    to its own start (a loop whose body is a single block) is replayed
+    again by i386_block_execute, up to I386_BLOCK_MAX_CHAIN times, instead
+    of returning to the caller for every iteration.  Pending interrupts are
+    still taken between iterations, and the chain ends as soon as the
+    callback set with i386_block_set_event() reports an event the caller
+    handles itself, such as a queued V86 interrupt or a trap address.
+
+    The pages blocks are recorded from are marked in the write tracking of
+    vm86cpu.cpp (code_page_mark), and every valid block is on a list for
+    each page it has code on.  A write to a marked page walks that list
+    and invalidates only the blocks whose bytes it overlaps, including the
+    one running, which stops after the writing instruction.  Data written
+    next to code on the same page therefore leaves the code cached, and
+    the page stays marked as long as a block on it is valid.  A block
+    whose own code is written I386_BLOCK_MAX_REWRITES times is stepped
+    instead of recorded every time it runs, and recorded again after a
+    while.  All blocks are dropped with i386_block_flush() whenever 32-bit
+    code may have touched 16-bit memory.
+
+    BlockCache=0 in otvdm.ini makes vm86main run one instruction at a time
+    instead.  tests/cpu/block.cpp runs its kernels both ways and compares
+    the results, and tests/cpu/prefix.cpp does the same with random runs
+    of prefixed instructions.  tests/cpu/smc.cpp checks which blocks a
+    write invalidates.
+
+***************************************************************************/
+
+#define I386_BLOCK_CACHE_SIZE   2048
+#define I386_BLOCK_MAX_INSNS    32
+#define I386_BLOCK_MAX_CHAIN    64      // loop iterations run per i386_block_execute call
+#define I386_BLOCK_PAGE_HASH    1024    // lists of the blocks on a page, by page number
+#define I386_BLOCK_MAX_REWRITES 8       // times a block is recorded again after its code is written
+
+#define I386_BLOCK_MODE_PM      0x02
+#define I386_BLOCK_MODE_V86     0x04
+
+#define I386_BLOCK_PREFIX_OPERAND   0x01
+#define I386_BLOCK_PREFIX_ADDRESS   0x02
+#define I386_BLOCK_PREFIX_SEGMENT   0x04
+#define I386_BLOCK_PREFIX_ESCAPE    0x08    // 0f escape, only used by the profiler
+
+struct I386_BLOCK_INSN {
+	void (*handler)();
+	UINT16 offset;      // eip offset from the block start
+	UINT8 opcode;       // opcode byte seen by the handler
+	UINT8 length;       // prefix and escape bytes before the opcode
+	UINT8 prefix;       // I386_BLOCK_PREFIX_*
+	UINT8 segment;      // segment override
+	UINT8 seg_prefixes; // CS/DS/ES/SS prefixes in bits 0-3, FS/GS in bits 4-7
+	UINT8 jcc;          // jcc rel8 run by i386_block_jcc
+	INT8 disp;          // its displacement
+};
+
+struct I386_BLOCK;
+
+// a block on the list of one of its pages
+struct I386_BLOCK_LINK {
+	I386_BLOCK_LINK *next;
+	I386_BLOCK_LINK **prev;     // the pointer to this link
+	I386_BLOCK *block;
+};
+
+struct I386_BLOCK {
+	UINT32 generation;  // valid while equal to m_block_generation, 0 once its code is written
+	UINT32 pc;
+	UINT32 eip;
+	UINT32 end;         // last byte its instructions may take
+	UINT8 mode;
+	UINT8 count;
+	UINT8 rewrites;     // times its code was written, then the steps taken instead of recording it
+	I386_BLOCK_LINK link[2];    // on the lists of pc and end, which are the same or adjacent pages
+	I386_BLOCK_INSN insn[I386_BLOCK_MAX_INSNS];
+};
+
+static I386_BLOCK m_block_cache[I386_BLOCK_CACHE_SIZE];
+static UINT32 m_block_generation = 1;
+// valid blocks only: a flush empties the lists, a write takes its blocks off them
+static I386_BLOCK_LINK *m_block_page[I386_BLOCK_PAGE_HASH];
+static bool (*m_block_event)(UINT32 pc);
+
+INLINE UINT8 i386_block_mode()
+{
+	UINT8 mode = m_sreg[CS].d ? 1 : 0;
+	if (PROTECTED_MODE)
+		mode |= I386_BLOCK_MODE_PM;
+	if (V8086_MODE)
+		mode |= I386_BLOCK_MODE_V86;
+	return mode;
+}
+
+/* Called before each chained iteration with the linear pc, true ends the chain */
+static void i386_block_set_event(bool (*event)(UINT32 pc))
+{
+	m_block_event = event;
+}
+
+static void i386_block_flush()
+{
+	m_block_generation++;
+	memset(m_block_page, 0, sizeof(m_block_page));
+}
+
+static void i386_block_link(I386_BLOCK_LINK *link, I386_BLOCK *block, UINT32 page)
+{
+	I386_BLOCK_LINK **head = &m_block_page[page & (I386_BLOCK_PAGE_HASH - 1)];
+
+	link->block = block;
+	link->next = *head;
+	link->prev = head;
+	if (*head)
+		(*head)->prev = &link->next;
+	*head = link;
+}
+
+static void i386_block_unlink(I386_BLOCK_LINK *link)
+{
+	*link->prev = link->next;
+	if (link->next)
+		link->next->prev = link->prev;
+}
+
+/* Take a valid block off its lists before it is recorded again or its code is written */
+static void i386_block_invalidate(I386_BLOCK *block)
+{
+	i386_block_unlink(&block->link[0]);
+	if ((block->end >> 12) != (block->pc >> 12))
+		i386_block_unlink(&block->link[1]);
+	block->generation = 0;
+}
+
+/*
+    Write tracking callback, registered by i386_common_init: drop the
+    blocks on the page whose bytes overlap start-end, and return whether
+    blocks are left on the page.
+*/
+static bool i386_block_write(UINT32 page, UINT32 start, UINT32 end)
+{
+	I386_BLOCK_LINK *link, *next;
+	I386_BLOCK *block;
+	bool left = false;
+
+	for (link = m_block_page[page & (I386_BLOCK_PAGE_HASH - 1)]; link; link = next)
+	{
+		next = link->next;
+		block = link->block;
+		if ((block->pc >> 12) != page && (block->end >> 12) != page)
+			continue;
+		if (start <= block->end && end >= block->pc)
+		{
+			i386_block_invalidate(block);
+			block->rewrites++;
+		}
+		else
+			left = true;
+	}
+	return left;
+}
+
+/* Per-instruction state reset, the same as done by CPU_EXECUTE */
+INLINE void i386_block_prolog()
+{
+	m_operand_size = m_sreg[CS].d;
+	m_xmm_operand_size = 0;
+	m_address_size = m_sreg[CS].d;
+	m_operand_prefix = 0;
+	m_address_prefix = 0;
+
+	m_ext = 1;
+
+	m_segment_prefix = 0;
+	m_prev_eip = m_eip;
+
+	if(m_delayed_interrupt_enable != 0)
+	{
+		m_IF = 1;
+		m_delayed_interrupt_enable = 0;
+	}
+}
+
+/* Apply the prefixes of an instruction, the same as done by their handlers */
+INLINE void i386_block_prefix(const I386_BLOCK_INSN *insn)
+{
+	int i;
+
+	if (insn->prefix & I386_BLOCK_PREFIX_OPERAND)
+	{
+		m_operand_size ^= 1;
+		m_xmm_operand_size ^= 1;
+		m_operand_prefix = 1;
+	}
+	if (insn->prefix & I386_BLOCK_PREFIX_ADDRESS)
+	{
+		m_address_size ^= 1;
+		m_address_prefix = 1;
+	}
+	if (insn->prefix & I386_BLOCK_PREFIX_SEGMENT)
+	{
+		m_segment_prefix = 1;
+		m_segment_override = insn->segment;
+		for (i = insn->seg_prefixes & 15; i; i--)
+			CYCLES(0);
+		for (i = insn->seg_prefixes >> 4; i; i--)
+			CYCLES(1);
+	}
+}
+
+/*
+    Consume the prefixes of the instruction whose first byte is in
+    m_opcode and a 0f escape after them, and return the handler of the
+    opcode they lead to.  This follows the prefix handlers: 66 0f goes to
+    the 66 0f xx table, f0/f2/f3 and all other opcodes end the decoding.
+*/
+static void (*i386_block_decode(I386_BLOCK_INSN *insn))()
+{
+	bool operand_prefix = false;
+	bool after_66 = false;
+	int seg;
+
+	insn->length = 0;
+	insn->prefix = 0;
+	insn->segment = 0;
+	insn->seg_prefixes = 0;
+	// 15 bytes at most, the last one is left to its own handler; after
+	// f0 f0 the lock is still on and the first prefix is an invalid opcode
+	while (insn->length < 14 && !m_lock)
+	{
+		seg = -1;
+		switch (m_opcode)
+		{
+			case 0x66:
+				operand_prefix = true;
+				break;
+			case 0x67:
+				insn->prefix |= I386_BLOCK_PREFIX_ADDRESS;
+				break;
+			case 0x26: seg = ES; break;
+			case 0x2e: seg = CS; break;
+			case 0x36: seg = SS; break;
+			case 0x3e: seg = DS; break;
+			case 0x64: seg = FS; break;
+			case 0x65: seg = GS; break;
+			default:
+				goto done;
+		}
+		if (seg >= 0)
+		{
+			insn->prefix |= I386_BLOCK_PREFIX_SEGMENT;
+			insn->segment = seg;
+			insn->seg_prefixes += (seg == FS || seg == GS) ? 0x10 : 0x01;
+		}
+		after_66 = m_opcode == 0x66;
+		m_opcode = FETCH();
+		insn->length++;
+	}
+done:
+	if (operand_prefix)
+		insn->prefix |= I386_BLOCK_PREFIX_OPERAND;
+	i386_block_prefix(insn);
+	if (m_opcode == 0x0f && after_66)
+		return I386OP(decode_three_byte66);
+	if (m_opcode == 0x0f && !m_lock)
+	{
+		m_opcode = FETCH();
+		insn->length++;
+		insn->prefix |= I386_BLOCK_PREFIX_ESCAPE;
+		return m_operand_size ? m_opcode_table2_32[m_opcode] : m_opcode_table2_16[m_opcode];
+	}
+	return m_operand_size ? m_opcode_table1_32[m_opcode] : m_opcode_table1_16[m_opcode];
+}
+
+/* Counted after the handler, like CPU_EXECUTE, so faulting instructions are not; a lock
+   prefix decodes the rest itself, and decode_two_byte sets m_profile_escape if it reaches 0f */
+INLINE void i386_block_dispatch(void (*handler)(), int escape)
+{
+	m_profile_escape = escape;
+	if(m_lock && !m_lock_table[0][m_opcode])
+		I386OP(invalid)();
+	else
+		handler();
+	i386_profile_insn(m_profile_escape);
+	if(m_lock && (m_opcode != 0xf0))
+		m_lock = false;
+}
+
+/* The condition of jcc rel8 opcode 70-7f, the same as tested by its handler */
+INLINE bool i386_block_condition(UINT8 opcode)
+{
+	bool taken;
+
+	switch ((opcode >> 1) & 7)
+	{
+		case 0: taken = m_OF != 0; break;
+		case 1: taken = m_CF != 0; break;
+		case 2: taken = m_ZF != 0; break;
+		case 3: taken = m_CF != 0 || m_ZF != 0; break;
+		case 4: taken = m_SF != 0; break;
+		case 5: taken = GetPF() != 0; break;
+		case 6: taken = m_SF != m_OF; break;
+		default: taken = m_ZF != 0 || (m_SF != m_OF); break;
+	}
+	return (opcode & 1) ? !taken : taken;
+}
+
+/* Run a cached jcc rel8 without fetching it or calling its handler */
+INLINE void i386_block_jcc(const I386_BLOCK_INSN *insn)
+{
+	m_opcode = insn->opcode;
+	m_eip += 2;
+	m_pc += 2;
+	if (i386_block_condition(insn->opcode))
+	{
+		NEAR_BRANCH(insn->disp);
+		CYCLES(CYCLES_JCC_DISP8);
+	}
+	else
+	{
+		CYCLES(CYCLES_JCC_DISP8_NOBRANCH);
+	}
+	i386_profile_insn(0);
+}
+
+static void i386_block_record(I386_BLOCK *block)
+{
+	UINT32 start_eip;
+	void (*handler)();
+	I386_BLOCK_INSN *insn;
+
+	block->count = 0;
+	block->generation = m_block_generation;
+	block->end = block->pc;
+	i386_block_link(&block->link[0], block, block->pc >> 12);
+	do
+	{
+		start_eip = m_eip;
+		i386_block_prolog();
+		m_opcode = FETCH();
+		// software interrupts are intercepted by vm86main before they reach the core
+		if (block->count && V8086_MODE && (m_opcode == 0xcd || m_opcode == 0xcc))
+		{
+			m_eip = start_eip;
+			CHANGE_PC(m_eip);
+			break;
+		}
+		insn = &block->insn[block->count];
+		insn->offset = start_eip - block->eip;
+		// the longest instruction it may be, as its operands are not decoded yet
+		code_page_mark(block->pc + insn->offset, block->pc + insn->offset + 14);
+		if (((block->pc + insn->offset + 14) >> 12) != (block->end >> 12))
+			i386_block_link(&block->link[1], block, (block->pc + insn->offset + 14) >> 12);
+		block->end = block->pc + insn->offset + 14;
+		// a fault while fetching the prefixes must not leave a partial entry
+		handler = i386_block_decode(insn);
+		insn->handler = handler;
+		insn->opcode = m_opcode;
+		insn->jcc = block->count && !insn->length && (m_opcode & 0xf0) == 0x70 && !m_lock;
+		if (insn->jcc)
+		{
+			// i386_block_jcc steps over the opcode and displacement itself
+			insn->disp = FETCH();
+			m_eip -= 2;
+			m_pc -= 2;
+		}
+		block->count++;
+		if (insn->jcc)
+			i386_block_jcc(insn);
+		else
+			i386_block_dispatch(handler, (insn->prefix & I386_BLOCK_PREFIX_ESCAPE) ? 1 : 0);
+		// only keep recording while execution falls through to the next instruction
+		if (m_eip <= start_eip || m_eip - start_eip > 15 || m_pc != block->pc + (m_eip - block->eip))
+			break;
+		if (m_halted || m_TF || (m_eip - block->eip) > 0xff00 || block->generation != m_block_generation)
+			break;
+	} while (block->count < I386_BLOCK_MAX_INSNS);
+}
+
+static void i386_block_replay(I386_BLOCK *block)
+{
+	int i;
+	const I386_BLOCK_INSN *insn = block->insn;
+
+	for (i = 0; i < block->count; i++, insn++)
+	{
+		if (m_eip != block->eip + insn->offset || m_pc != block->pc + insn->offset)
+			break;
+		i386_block_prolog();
+		if (insn->jcc)
+		{
+			i386_block_jcc(insn);
+			continue;
+		}
+		if (m_lock && insn->length)
+		{
+			// recorded without the lock, run its first prefix byte alone as decode_opcode does
+			m_opcode = FETCH();
+			i386_block_dispatch(m_operand_size ? m_opcode_table1_32[m_opcode] : m_opcode_table1_16[m_opcode], 0);
+			break;
+		}
+		i386_block_prefix(insn);
+		m_opcode = insn->opcode;
+		m_eip += insn->length + 1;
+		m_pc += insn->length + 1;
+		i386_block_dispatch(insn->handler, (insn->prefix & I386_BLOCK_PREFIX_ESCAPE) ? 1 : 0);
+		if (m_halted || m_TF || block->generation != m_block_generation)
+			break;
+	}
+}
+
+/* True if execution is back at the start of the block it just ran, with the block still valid */
+INLINE bool i386_block_loops(const I386_BLOCK *block)
+{
+	return m_pc == block->pc && m_eip == block->eip && block->generation == m_block_generation &&
+		!m_halted && !m_TF && i386_block_mode() == block->mode;
+}
+
+/* Execute at least one instruction, and as many as the cached block allows */
+static void i386_block_execute()
+{
+	UINT32 pc;
+	UINT8 mode;
+	I386_BLOCK *block;
+	int chain;
+
+	CHANGE_PC(m_eip);
+	if (m_TF)
+	{
+		// single-step traps are raised by CPU_EXECUTE
+		m_cycles = 1;
+		CPU_EXECUTE_CALL(i386);
+		return;
+	}
+	i386_check_irq_line();
+
+	pc = m_pc;
+	mode = i386_block_mode();
+	block = &m_block_cache[(pc ^ (pc >> 11)) & (I386_BLOCK_CACHE_SIZE - 1)];
+	if (block->rewrites >= I386_BLOCK_MAX_REWRITES && block->pc == pc && block->eip == m_eip && block->mode == mode)
+	{
+		// code that keeps being written is stepped, until rewrites wraps around and it is recorded again
+		block->rewrites++;
+		m_cycles = 1;
+		CPU_EXECUTE_CALL(i386);
+		return;
+	}
+	try
+	{
+		if (block->generation == m_block_generation && block->pc == pc && block->eip == m_eip && block->mode == mode)
+		{
+			i386_block_replay(block);
+		}
+		else
+		{
+			if (block->generation == m_block_generation)
+				i386_block_invalidate(block);
+			if (block->pc != pc || block->eip != m_eip || block->mode != mode)
+				block->rewrites = 0;
+			block->pc = pc;
+			block->eip = m_eip;
+			block->mode = mode;
+			i386_block_record(block);
+		}
+		for (chain = 1; chain < I386_BLOCK_MAX_CHAIN && i386_block_loops(block); chain++)
+		{
+			if (m_block_event && m_block_event(pc))
+				break;
+			i386_check_irq_line();
+			if (m_pc != pc)
+				break;
+			i386_block_replay(block);
+		}
+	}
+	catch(UINT64 e)
+	{
+		i386_fault(e);
+	}
+}
@@ -448,13 +448,13 @@ static const I386_OPCODE i386_opcode_table2[256] =
 		"???\0"
 		"???",              MODRM|VAR_NAME4,PARAM_XMMM,          PARAM_XMM,         0               },
 	{"group0F18",       GROUP,          0,                  0,                  0               },
-	{"nop_hint",        0,              PARAM_RMPTR8,               0,                  0               },
-	{"nop_hint",        0,              PARAM_RMPTR8,               0,                  0               },
-	{"nop_hint",        0,              PARAM_RMPTR8,               0,                  0               },
-	{"nop_hint",        0,              PARAM_RMPTR8,               0,                  0               },
-	{"nop_hint",        0,              PARAM_RMPTR8,               0,                  0               },
-	{"nop_hint",        0,              PARAM_RMPTR8,               0,                  0               },
-	{"nop_hint",        0,              PARAM_RMPTR8,               0,                  0               },
+	{"nop_hint",        MODRM,          PARAM_RMPTR8,               0,                  0               },
+	{"nop_hint",        MODRM,          PARAM_RMPTR8,               0,                  0               },
+	{"nop_hint",        MODRM,          PARAM_RMPTR8,               0,                  0               },
+	{"nop_hint",        MODRM,          PARAM_RMPTR8,               0,                  0               },
+	{"nop_hint",        MODRM,          PARAM_RMPTR8,               0,                  0               },
+	{"nop_hint",        MODRM,          PARAM_RMPTR8,               0,                  0               },
+	{"nop_hint",        MODRM,          PARAM_RMPTR8,               0,                  0               },
 	// 0x20
 	{"mov",             MODRM,          PARAM_REG2_32,      PARAM_CREG,         0               },
 	{"mov",             MODRM,          PARAM_REG2_32,      PARAM_DREG,         0               },
@@ -983,7 +983,7 @@ static void I386OP(jno_rel16)()         // Opcode 0x0f 81
 static void I386OP(jnp_rel16)()         // Opcode 0x0f 8b
 {
 	INT16 disp = FETCH16();
-	if( m_PF == 0 ) {
+	if( GetPF() == 0 ) {
 		if (m_sreg[CS].d)
 		{
 			m_eip += disp;
@@ -1059,7 +1059,7 @@ static void I386OP(jo_rel16)()          // Opcode 0x0f 80
 static void I386OP(jp_rel16)()          // Opcode 0x0f 8a
 {
 	INT16 disp = FETCH16();
-	if( m_PF != 0 ) {
+	if( GetPF() != 0 ) {
 		if (m_sreg[CS].d)
 		{
 			m_eip += disp;
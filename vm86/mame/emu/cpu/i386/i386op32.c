@@ -888,7 +888,7 @@ static void I386OP(jno_rel32)()         // Opcode 0x0f 81
 static void I386OP(jnp_rel32)()         // Opcode 0x0f 8b
 {
 	INT32 disp = FETCH32();
-	if( m_PF == 0 ) {
+	if( GetPF() == 0 ) {
 		m_eip += disp;
 		CHANGE_PC(m_eip);
 		CYCLES(CYCLES_JCC_FULL_DISP);      /* TODO: Timing = 7 + m */
@@ -936,7 +936,7 @@ static void I386OP(jo_rel32)()          // Opcode 0x0f 80
 static void I386OP(jp_rel32)()          // Opcode 0x0f 8a
 {
 	INT32 disp = FETCH32();
-	if( m_PF != 0 ) {
+	if( GetPF() != 0 ) {
 		m_eip += disp;
 		CHANGE_PC(m_eip);
 		CYCLES(CYCLES_JCC_FULL_DISP);      /* TODO: Timing = 7 + m */
@@ -504,7 +504,7 @@ static void I386OP(jno_rel8)()          // Opcode 0x71
 static void I386OP(jnp_rel8)()          // Opcode 0x7b
 {
 	INT8 disp = FETCH();
-	if( m_PF == 0 ) {
+	if( GetPF() == 0 ) {
 		NEAR_BRANCH(disp);
 		CYCLES(CYCLES_JCC_DISP8);      /* TODO: Timing = 7 + m */
 	} else {
@@ -548,7 +548,7 @@ static void I386OP(jo_rel8)()           // Opcode 0x70
 static void I386OP(jp_rel8)()           // Opcode 0x7a
 {
 	INT8 disp = FETCH();
-	if( m_PF != 0 ) {
+	if( GetPF() != 0 ) {
 		NEAR_BRANCH(disp);
 		CYCLES(CYCLES_JCC_DISP8);      /* TODO: Timing = 7 + m */
 	} else {
@@ -1085,13 +1085,256 @@ static void I386OP(outsd)()             // Opcode 0x6f
 	I386OP(outs_generic)(4);
 }
 
+/* Number of string elements, up to count, that start inside the segment
+   limit and do not wrap the offset, beginning at offset off.  Returns 0
+   when i386_translate would fault, so the caller takes the slow path. */
+static UINT32 i386_rep_span(int seg, UINT32 off, int size, int rwn, UINT32 count)
+{
+	UINT32 limit = m_address_size ? 0xffffffff : 0xffff;
+	UINT32 last;
+
+	if(count == 0)
+		return 0;
+	if(PROTECTED_MODE && !V8086_MODE)
+	{
+		if(!(m_sreg[seg].valid))
+			return 0;
+		if((m_sreg[seg].flags & 0x0018) == 0x0010 && m_sreg[seg].flags & 0x0004) // expand-down
+			return 0;
+		if((rwn == 0) && ((m_sreg[seg].flags & 8) && !(m_sreg[seg].flags & 2)))
+			return 0;
+		if((rwn == 1) && ((m_sreg[seg].flags & 8) || !(m_sreg[seg].flags & 2)))
+			return 0;
+		if(m_sreg[seg].limit < limit)
+			limit = m_sreg[seg].limit;
+	}
+	if(off > limit)
+		return 0;
+	last = m_DF ? off / size : (limit - off) / size;
+	return (last >= count - 1) ? count : last + 1;
+}
+
+/* Lowest linear address touched by n elements starting at off */
+INLINE UINT32 i386_rep_base(int seg, UINT32 off, int size, UINT32 n)
+{
+	UINT32 linear = m_sreg[seg].base + off;
+	return m_DF ? linear - (n - 1) * size : linear;
+}
+
+INLINE UINT32 i386_rep_element(const UINT8 *p, int size)
+{
+	switch(size)
+	{
+	case 1: return *p;
+	case 2: return *(UINT16 *)p;
+	default: return *(UINT32 *)p;
+	}
+}
+
+/* Run as many elements of REP MOVS/STOS/LODS/SCAS/CMPS as possible with
+   host loops, and update ECX/ESI/EDI for them.  The segments are checked
+   once for the whole run; elements past a limit or offset wrap, and the
+   last element of LODS/SCAS/CMPS (which sets AL/AX/EAX or the flags) are
+   left to the per-element loop in I386OP(repeat).  Faults are raised by
+   that loop as well, at the element that causes them.  Returns the
+   number of elements run. */
+static UINT32 i386_rep_fast(UINT8 opcode, int invert_flag)
+{
+	int size = (opcode & 1) ? (m_operand_size ? 4 : 2) : 1;
+	INT32 step = m_DF ? -size : size;
+	int src_seg = m_segment_prefix ? m_segment_override : DS;
+	UINT32 si = m_address_size ? REG32(ESI) : REG16(SI);
+	UINT32 di = m_address_size ? REG32(EDI) : REG16(DI);
+	UINT32 count = m_address_size ? REG32(ECX) : REG16(CX);
+	UINT32 n = count, done = 0, i, lo_s, lo_d;
+	UINT8 *src, *dst;
+	UINT32 mask, value, other;
+
+	// paging and the A20 gate are never used here; keep the generic path for them
+	if((m_cr[0] & 0x80000000) || m_a20_mask != ~0u)
+		return 0;
+
+	switch(opcode)
+	{
+	case 0xa4: case 0xa5: // MOVS
+	case 0xa6: case 0xa7: // CMPS
+		n = i386_rep_span(src_seg, si, size, 0, n);
+		n = i386_rep_span(ES, di, size, (opcode < 0xa6) ? 1 : 0, n);
+		break;
+	case 0xac: case 0xad: // LODS
+		n = i386_rep_span(src_seg, si, size, 0, n);
+		break;
+	case 0xaa: case 0xab: // STOS
+		n = i386_rep_span(ES, di, size, 1, n);
+		break;
+	case 0xae: case 0xaf: // SCAS
+		n = i386_rep_span(ES, di, size, 0, n);
+		break;
+	default:
+		return 0;
+	}
+	if(n == 0)
+		return 0;
+
+	// read_byte() and friends return 0 past MAX_MEM; leave that to them
+	lo_s = i386_rep_base(src_seg, si, size, n);
+	lo_d = i386_rep_base(ES, di, size, n);
+	if(opcode != 0xaa && opcode != 0xab && opcode != 0xae && opcode != 0xaf)
+	{
+		if(lo_s + n * size < lo_s || lo_s + n * size >= MAX_MEM - 3)
+			return 0;
+	}
+	if(opcode != 0xac && opcode != 0xad)
+	{
+		if(lo_d + n * size < lo_d || lo_d + n * size >= MAX_MEM - 3)
+			return 0;
+	}
+	src = mem + (m_sreg[src_seg].base + si);
+	dst = mem + (m_sreg[ES].base + di);
+	mask = (size == 4) ? 0xffffffff : (size == 2) ? 0xffff : 0xff;
+
+	switch(opcode)
+	{
+	case 0xa4: case 0xa5:
+		// memmove matches the element order unless the destination overlaps
+		// the part of the source that is still to be read
+		if(m_DF ? (lo_d >= lo_s || lo_d + n * size <= lo_s) : (lo_d <= lo_s || lo_d >= lo_s + n * size))
+			memmove(mem + lo_d, mem + lo_s, n * size);
+		else
+			for(i = 0; i < n; i++)
+				memmove(dst + (INT32)i * step, src + (INT32)i * step, size);
+		done = n;
+		break;
+
+	case 0xaa: case 0xab:
+		if(size == 1)
+			memset(mem + lo_d, REG8(AL), n);
+		else
+			for(i = 0; i < n; i++)
+			{
+				if(size == 2)
+					*(UINT16 *)(mem + lo_d + i * 2) = REG16(AX);
+				else
+					*(UINT32 *)(mem + lo_d + i * 4) = REG32(EAX);
+			}
+		done = n;
+		break;
+
+	case 0xac: case 0xad:
+		// only the last element loaded is visible
+		done = (n == count) ? n - 1 : n;
+		break;
+
+	case 0xae: case 0xaf:
+		// skip the elements that would not stop the scan
+		value = REG32(EAX) & mask;
+		if(n == count)
+			n--;
+		for(done = 0; done < n; done++)
+		{
+			if((i386_rep_element(dst + (INT32)done * step, size) == value) == (invert_flag != 0))
+				break;
+		}
+		break;
+
+	case 0xa6: case 0xa7:
+		if(n == count)
+			n--;
+		for(done = 0; done < n; done++)
+		{
+			if((i386_rep_element(src + (INT32)done * step, size) == i386_rep_element(dst + (INT32)done * step, size)) == (invert_flag != 0))
+				break;
+		}
+		break;
+	}
+	if(done == 0)
+		return 0;
+
+	// AL/AX/EAX (LODS) and the flags (SCAS/CMPS) are left as the last
+	// element run here sets them, for a fault in the element after it
+	switch(opcode)
+	{
+	case 0xac: case 0xad:
+		value = i386_rep_element(src + (INT32)(done - 1) * step, size);
+		if(size == 1)
+			REG8(AL) = value;
+		else if(size == 2)
+			REG16(AX) = value;
+		else
+			REG32(EAX) = value;
+		break;
+	case 0xae: case 0xaf:
+		value = i386_rep_element(dst + (INT32)(done - 1) * step, size);
+		if(size == 1)
+			SUB8(REG8(AL), value);
+		else if(size == 2)
+			SUB16(REG16(AX), value);
+		else
+			SUB32(REG32(EAX), value);
+		break;
+	case 0xa6: case 0xa7:
+		value = i386_rep_element(src + (INT32)(done - 1) * step, size);
+		other = i386_rep_element(dst + (INT32)(done - 1) * step, size);
+		if(size == 1)
+			SUB8(value, other);
+		else if(size == 2)
+			SUB16(value, other);
+		else
+			SUB32(value, other);
+		break;
+	}
+
+	if(opcode <= 0xab && opcode != 0xa6 && opcode != 0xa7)
+	{
+		// MOVS/STOS: drop cached blocks recorded from the written bytes
+		lo_d = i386_rep_base(ES, di, size, done);
+		code_page_check_write(lo_d, done * size);
+	}
+	if(m_address_size)
+	{
+		REG32(ECX) -= done;
+		if(opcode != 0xaa && opcode != 0xab && opcode != 0xae && opcode != 0xaf)
+			REG32(ESI) += done * step;
+		if(opcode != 0xac && opcode != 0xad)
+			REG32(EDI) += done * step;
+	}
+	else
+	{
+		REG16(CX) -= done;
+		if(opcode != 0xaa && opcode != 0xab && opcode != 0xae && opcode != 0xaf)
+			REG16(SI) += done * step;
+		if(opcode != 0xac && opcode != 0xad)
+			REG16(DI) += done * step;
+	}
+	return done;
+}
+
+/* The cycles the per-element loop of I386OP(repeat) charges for n elements:
+   those of the element instruction and the adjustment, for each */
+INLINE void i386_rep_cycles(UINT8 opcode, UINT32 n, INT32 cycle_adjustment)
+{
+#ifdef SUPPORT_RDTSC
+	int x;
+
+	switch(opcode)
+	{
+	case 0xa4: case 0xa5: x = CYCLES_MOVS; break;
+	case 0xa6: case 0xa7: x = CYCLES_CMPS; break;
+	case 0xaa: case 0xab: x = CYCLES_STOS; break;
+	case 0xac: case 0xad: x = CYCLES_LODS; break;
+	default:              x = CYCLES_SCAS; break;
+	}
+	CYCLES_NUM(((PROTECTED_MODE ? m_cycle_table_pm[x] : m_cycle_table_rm[x]) + cycle_adjustment) * (INT32)n);
+#endif
+}
+
 static void I386OP(repeat)(int invert_flag)
 {
 	UINT32 repeated_eip = m_eip;
 	UINT32 repeated_pc = m_pc;
 	UINT8 opcode; // = FETCH();
 //  UINT32 eas, ead;
-	UINT32 count;
+	UINT32 count, done;
 	INT32 cycle_base = 0, cycle_adjustment = 0;
 	UINT8 prefix_flag=1;
 	UINT8 *flag = NULL;
@@ -1236,21 +1479,25 @@ static void I386OP(repeat)(int invert_flag)
 			return;
 	}
 
-	/* now actually perform the repeat */
+	/* do the bulk of the run with host loops, then finish it one element at a time */
 	CYCLES_NUM(cycle_base);
+	done = i386_rep_fast(opcode, invert_flag);
+	i386_rep_cycles(opcode, done, cycle_adjustment);
+	if( m_address_size ) {
+		if( REG32(ECX) == 0 )
+			return;
+	} else {
+		if( REG16(CX) == 0 )
+			return;
+	}
+
+	/* now actually perform the repeat */
 	do
 	{
 		m_eip = repeated_eip;
 		m_pc = repeated_pc;
-		try
-		{
-			I386OP(decode_opcode)();
-		}
-		catch (UINT64 e)
-		{
-			m_eip = m_prev_eip;
-			throw e;
-		}
+		// a fault restarts the whole instruction at m_prev_eip, see i386_fault()
+		I386OP(decode_opcode)();
 
 		CYCLES_NUM(cycle_adjustment);
 
@@ -1520,7 +1767,7 @@ static void I386OP(setnp_rm8)()         // Opcode 0x0f 9b
 {
 	UINT8 modrm = FETCH();
 	UINT8 value = 0;
-	if( m_PF == 0 ) {
+	if( GetPF() == 0 ) {
 		value = 1;
 	}
 	if( modrm >= 0xc0 ) {
@@ -1588,7 +1835,7 @@ static void I386OP(setp_rm8)()          // Opcode 0x0f 9a
 {
 	UINT8 modrm = FETCH();
 	UINT8 value = 0;
-	if( m_PF != 0 ) {
+	if( GetPF() != 0 ) {
 		value = 1;
 	}
 	if( modrm >= 0xc0 ) {
@@ -2375,11 +2622,11 @@ static void I386OP(decimal_adjust)(int direction)
 	UINT8 tmpAL = REG8(AL);
 	UINT8 tmpCF = m_CF;
 
-	if (m_AF || ((REG8(AL) & 0xf) > 9))
+	if (GetAF() || ((REG8(AL) & 0xf) > 9))
 	{
 		UINT16 t= (UINT16)REG8(AL) + (direction * 0x06);
 		REG8(AL) = (UINT8)t&0xff;
-		m_AF = 1;
+		ForceAF(1);
 		if (t & 0x100)
 			m_CF = 1;
 		if (direction > 0)
@@ -2409,13 +2656,13 @@ static void I386OP(das)()               // Opcode 0x2f
 
 static void I386OP(aaa)()               // Opcode 0x37
 {
-	if( ( (REG8(AL) & 0x0f) > 9) || (m_AF != 0) ) {
+	if( ( (REG8(AL) & 0x0f) > 9) || (GetAF() != 0) ) {
 		REG16(AX) = REG16(AX) + 6;
 		REG8(AH) = REG8(AH) + 1;
-		m_AF = 1;
+		ForceAF(1);
 		m_CF = 1;
 	} else {
-		m_AF = 0;
+		ForceAF(0);
 		m_CF = 0;
 	}
 	REG8(AL) = REG8(AL) & 0x0f;
@@ -2424,16 +2671,16 @@ static void I386OP(aaa)()               // Opcode 0x37
 
 static void I386OP(aas)()               // Opcode 0x3f
 {
-	if (m_AF || ((REG8(AL) & 0xf) > 9))
+	if (GetAF() || ((REG8(AL) & 0xf) > 9))
 	{
 		REG16(AX) -= 6;
 		REG8(AH) -= 1;
-		m_AF = 1;
+		ForceAF(1);
 		m_CF = 1;
 	}
 	else
 	{
-		m_AF = 0;
+		ForceAF(0);
 		m_CF = 0;
 	}
 	REG8(AL) &= 0x0f;
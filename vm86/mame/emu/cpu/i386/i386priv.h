@@ -286,6 +286,11 @@ struct I386_SREG {
 	UINT32 limit;
 	int d;      // Operand size
 	bool valid;
+	// offsets win_lo..win_lo+win_span pass the limit check, win_rw bit 0/1
+	// allows reads/writes; all zero sends i386_translate to the full checks
+	UINT32 win_lo;
+	UINT32 win_span;
+	UINT8 win_rw;
 };
 
 struct I386_CALL_GATE
@@ -483,6 +488,29 @@ union XMM_REG {
 #endif
 //};
 
+// do x87 arithmetic with the host FPU when possible (x87ops.c)
+bool m_x87_fast;
+
+// instructions retired while m_count_insns is set, for the profiler
+// (i386prof.c) and the recorder (vm86rec.cpp)
+bool m_count_insns;
+UINT64 m_insn_count;
+
+// execution profiler counters (i386prof.c)
+bool m_profile;
+UINT64 m_profile_opcode[2][256];    // one-byte and 0f xx opcodes
+UINT8 m_profile_escape;             // set by decode_two_byte, the table CPU_EXECUTE counts in
+
+INLINE void i386_profile_insn(int escape)
+{
+	if(m_count_insns)
+	{
+		m_insn_count++;
+		if(m_profile)
+			m_profile_opcode[escape][m_opcode]++;
+	}
+}
+
 extern int i386_parity_table[256];
 static int i386_limit_check(int seg, UINT32 offset);
 
@@ -509,12 +537,19 @@ static int i386_limit_check(int seg, UINT32 offset);
 
 #define SetSF(x)            (m_SF = (x))
 #define SetZF(x)            (m_ZF = (x))
-#define SetAF(x,y,z)        (m_AF = (((x) ^ ((y) ^ (z))) & 0x10) ? 1 : 0)
-#define SetPF(x)            (m_PF = i386_parity_table[(x) & 0xFF])
-
-#define SetSZPF8(x)         {m_ZF = ((UINT8)(x)==0);  m_SF = ((x)&0x80) ? 1 : 0; m_PF = i386_parity_table[x & 0xFF]; }
-#define SetSZPF16(x)        {m_ZF = ((UINT16)(x)==0);  m_SF = ((x)&0x8000) ? 1 : 0; m_PF = i386_parity_table[x & 0xFF]; }
-#define SetSZPF32(x)        {m_ZF = ((UINT32)(x)==0);  m_SF = ((x)&0x80000000) ? 1 : 0; m_PF = i386_parity_table[x & 0xFF]; }
+/* PF and AF are evaluated lazily: m_PF keeps the low byte of the last
+   result and m_AF the carry vector (res ^ src ^ dst), bit 4 being AF.
+   Few instructions read them, so the parity lookup happens there. */
+#define SetAF(x,y,z)        (m_AF = (UINT8)((x) ^ ((y) ^ (z))))
+#define SetPF(x)            (m_PF = (UINT8)(x))
+#define GetAF()             ((m_AF >> 4) & 1)
+#define GetPF()             (i386_parity_table[m_PF])
+#define ForceAF(x)          (m_AF = (x) ? 0x10 : 0)
+#define ForcePF(x)          (m_PF = (x) ? 0 : 1)
+
+#define SetSZPF8(x)         {m_ZF = ((UINT8)(x)==0);  m_SF = ((x)&0x80) ? 1 : 0; m_PF = (UINT8)(x); }
+#define SetSZPF16(x)        {m_ZF = ((UINT16)(x)==0);  m_SF = ((x)&0x8000) ? 1 : 0; m_PF = (UINT8)(x); }
+#define SetSZPF32(x)        {m_ZF = ((UINT32)(x)==0);  m_SF = ((x)&0x80000000) ? 1 : 0; m_PF = (UINT8)(x); }
 
 #define MMX(n)              (*((MMX_REG *)(&m_x87_reg[(n)].low)))
 #define XMM(n)              m_sse_reg[(n)]
@@ -561,11 +596,39 @@ extern MODRM_TABLE i386_MODRM_table[256];
 //
 UINT get_segment_descriptor_wine(int sreg);
 //
+/* Compute the access window used by i386_translate from the cached descriptor */
+INLINE void i386_sreg_window(I386_SREG *seg)
+{
+	UINT32 lo = 0, hi = seg->limit;
+
+	seg->win_lo = seg->win_span = 0;
+	seg->win_rw = 0;
+	if(!seg->valid)
+		return;
+	if((seg->flags & 0x0018) == 0x0010 && seg->flags & 0x0004) // expand-down data segment
+	{
+		hi = seg->d ? 0xffffffff : 0xffff;
+		if(seg->limit >= hi)
+			return;
+		lo = seg->limit + 1;
+	}
+	seg->win_lo = lo;
+	seg->win_span = hi - lo;
+	if(!((seg->flags & 8) && !(seg->flags & 2)))
+		seg->win_rw |= 1;
+	if(!((seg->flags & 8) || !(seg->flags & 2)))
+		seg->win_rw |= 2;
+}
+
 INLINE UINT32 i386_translate(int segment, UINT32 ip, int rwn)
 {
 	// TODO: segment limit access size, execution permission, handle exception thrown from exception handler
 	if(PROTECTED_MODE && !V8086_MODE && (rwn != -1))
 	{
+		const I386_SREG *seg = &m_sreg[segment];
+		// accesses inside the window pass all the checks below
+		if(ip - seg->win_lo <= seg->win_span && (seg->win_rw & (1 << rwn)))
+			return seg->base + ip;
 		if(!(m_sreg[segment].valid))
 			FAULT_THROW((segment==SS)?FAULT_SS:FAULT_GP, 0);
 		if(i386_limit_check(segment, ip))
@@ -913,6 +976,8 @@ INLINE UINT32 READ32PL0(UINT32 ea)
 	return value;
 }
 
+static bool i386_block_write(UINT32 page, UINT32 start, UINT32 end);
+
 INLINE void WRITE_TEST(UINT32 ea)
 {
 	UINT32 address = ea, error;
@@ -0,0 +1,240 @@
+// Execution profiler for the i386 core (not part of MAME)
+/***************************************************************************
+
+    Execution profiler
+
+    When enabled the core counts every instruction it dispatches, split by
+    opcode (one-byte and 0f xx tables, see i386_profile_insn).  The caller
+    of the execute functions reports how many instructions were run from
+    each CS:IP it started at, which gives a hot-spot histogram keyed by
+    the NE module and segment of the code selector.  Transitions from
+    16-bit code into built-in functions and interrupt handlers are counted
+    per target.
+
+    The counts are exact, not sampled.  When disabled the only cost is a
+    test of m_profile per instruction.
+
+    Wall-clock time is split between 16-bit code (the core and vm86main)
+    and the 32-bit side (built-in functions and interrupt handlers) at
+    the same transitions, which gives the instructions per second of the
+    core on a real workload.  Running the same session, or a recorded one,
+    before and after a change to the core gives a comparable figure.
+
+    i386_profile_dump() writes two files:
+      <name>.folded   hot spots in collapsed-stack format
+                      (module;segment;cs:ip instructions), which
+                      flamegraph.pl, speedscope and pprof converters read
+      <name>.txt      instruction total, time split, opcode and
+                      transition counts
+
+***************************************************************************/
+
+#define I386_PROFILE_SPOT_SIZE  0x10000
+#define I386_PROFILE_THUNK_SIZE 0x1000
+
+struct I386_PROFILE_SPOT {
+	UINT64 count;       // instructions run from here, 0 for a free slot
+	UINT32 eip;
+	UINT16 cs;
+	UINT16 segnum;      // NE segment number, 0 if not found
+	bool pm;
+	char module[16];
+};
+
+struct I386_PROFILE_THUNK {
+	UINT64 count;
+	UINT32 key;
+	char name[128];
+};
+
+static I386_PROFILE_SPOT *m_profile_spot;
+static UINT32 m_profile_spot_used;
+static UINT64 m_profile_spot_other;     // instructions that did not fit in the table
+static I386_PROFILE_THUNK *m_profile_thunk;
+static UINT32 m_profile_thunk_used;
+static UINT64 m_profile_thunk_other;
+static UINT64 m_profile_time[2];        // ticks spent on the 32-bit side and in 16-bit code
+static UINT64 m_profile_mark;
+static bool m_profile_in16;
+static char m_profile_path[256];
+static BOOL (*m_profile_segment_name)(WORD sel, char *module, int size, WORD *segnum);
+
+INLINE UINT64 i386_profile_ticks()
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+/* Control passes between 16-bit code and the 32-bit side */
+static void i386_profile_switch(bool in16)
+{
+	UINT64 now = i386_profile_ticks();
+	m_profile_time[m_profile_in16] += now - m_profile_mark;
+	m_profile_mark = now;
+	m_profile_in16 = in16;
+}
+
+static void i386_profile_init(const char *path, BOOL (*segment_name)(WORD, char *, int, WORD *))
+{
+	m_profile_spot = (I386_PROFILE_SPOT *)calloc(I386_PROFILE_SPOT_SIZE, sizeof(I386_PROFILE_SPOT));
+	m_profile_thunk = (I386_PROFILE_THUNK *)calloc(I386_PROFILE_THUNK_SIZE, sizeof(I386_PROFILE_THUNK));
+	if (!m_profile_spot || !m_profile_thunk)
+		return;
+	strncpy(m_profile_path, path, sizeof(m_profile_path) - 1);
+	m_profile_segment_name = segment_name;
+	m_profile_mark = i386_profile_ticks();
+	m_profile = true;
+	m_count_insns = true;
+}
+
+/* Add the instructions run from cs:eip */
+static void i386_profile_block(UINT16 cs, UINT32 eip, bool pm, UINT64 insns)
+{
+	UINT32 hash = (cs * 0x9e3779b1) ^ eip ^ (eip >> 16);
+	I386_PROFILE_SPOT *spot;
+
+	if (!insns)
+		return;
+	for (;;)
+	{
+		spot = &m_profile_spot[hash & (I386_PROFILE_SPOT_SIZE - 1)];
+		if (!spot->count)
+			break;
+		if (spot->cs == cs && spot->eip == eip && spot->pm == pm)
+		{
+			spot->count += insns;
+			return;
+		}
+		hash++;
+	}
+	// keep the table at most 3/4 full so the probing stays short
+	if (m_profile_spot_used >= I386_PROFILE_SPOT_SIZE / 4 * 3)
+	{
+		m_profile_spot_other += insns;
+		return;
+	}
+	m_profile_spot_used++;
+	spot->count = insns;
+	spot->cs = cs;
+	spot->eip = eip;
+	spot->pm = pm;
+	// resolve the name now, the module may be gone when the profile is dumped
+	if (!pm)
+		strcpy(spot->module, "[real]");
+	else if (!m_profile_segment_name || !m_profile_segment_name(cs, spot->module, sizeof(spot->module), &spot->segnum))
+		strcpy(spot->module, "[unknown]");
+}
+
+/* Count a transition to key; a new entry has an empty name for the caller to fill in */
+static I386_PROFILE_THUNK *i386_profile_thunk(UINT32 key)
+{
+	static I386_PROFILE_THUNK other;
+	UINT32 hash = key ^ (key >> 12);
+	I386_PROFILE_THUNK *thunk;
+
+	for (;;)
+	{
+		thunk = &m_profile_thunk[hash & (I386_PROFILE_THUNK_SIZE - 1)];
+		if (!thunk->count || thunk->key == key)
+			break;
+		hash++;
+	}
+	if (!thunk->count)
+	{
+		if (m_profile_thunk_used >= I386_PROFILE_THUNK_SIZE / 4 * 3)
+		{
+			m_profile_thunk_other++;
+			other.name[0] = '?';
+			return &other;
+		}
+		m_profile_thunk_used++;
+		thunk->key = key;
+	}
+	thunk->count++;
+	return thunk;
+}
+
+static int i386_profile_compare_spot(const void *a, const void *b)
+{
+	UINT64 ca = (*(const I386_PROFILE_SPOT **)a)->count, cb = (*(const I386_PROFILE_SPOT **)b)->count;
+	return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+static int i386_profile_compare_thunk(const void *a, const void *b)
+{
+	UINT64 ca = (*(const I386_PROFILE_THUNK **)a)->count, cb = (*(const I386_PROFILE_THUNK **)b)->count;
+	return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+static int i386_profile_compare_opcode(const void *a, const void *b)
+{
+	const UINT64 *counts = &m_profile_opcode[0][0];
+	UINT64 ca = counts[*(const int *)a], cb = counts[*(const int *)b];
+	return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+static void i386_profile_dump()
+{
+	char path[256 + 16];
+	FILE *fp;
+	UINT32 i, n;
+	const UINT64 *counts = &m_profile_opcode[0][0];
+
+	if (!m_profile)
+		return;
+	i386_profile_switch(m_profile_in16);
+	m_profile = false;
+
+	I386_PROFILE_SPOT **spots = (I386_PROFILE_SPOT **)malloc(sizeof(*spots) * (m_profile_spot_used + 1));
+	for (i = n = 0; i < I386_PROFILE_SPOT_SIZE; i++)
+		if (m_profile_spot[i].count)
+			spots[n++] = &m_profile_spot[i];
+	qsort(spots, n, sizeof(*spots), i386_profile_compare_spot);
+	sprintf(path, "%s.folded", m_profile_path);
+	if ((fp = fopen(path, "w")) != NULL)
+	{
+		for (i = 0; i < n; i++)
+		{
+			if (spots[i]->segnum)
+				fprintf(fp, "%s;seg%d;%04x:%04x %llu\n", spots[i]->module, spots[i]->segnum, spots[i]->cs, spots[i]->eip, spots[i]->count);
+			else
+				fprintf(fp, "%s;%04x;%04x:%04x %llu\n", spots[i]->module, spots[i]->cs, spots[i]->cs, spots[i]->eip, spots[i]->count);
+		}
+		if (m_profile_spot_other)
+			fprintf(fp, "[other] %llu\n", m_profile_spot_other);
+		fclose(fp);
+	}
+	free(spots);
+
+	sprintf(path, "%s.txt", m_profile_path);
+	if ((fp = fopen(path, "w")) == NULL)
+		return;
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	double time16 = (double)m_profile_time[1] / frequency.QuadPart;
+	fprintf(fp, "instructions %llu\n", m_insn_count);
+	fprintf(fp, "16-bit time %.3f s, %.0f instructions/s\n", time16, time16 > 0 ? m_insn_count / time16 : 0.0);
+	fprintf(fp, "32-bit time %.3f s\n", (double)m_profile_time[0] / frequency.QuadPart);
+	fprintf(fp, "\nopcode\tcount\n");
+	// both tables sorted as one list, 0f xx entries are 256..511
+	int order[512];
+	for (i = 0; i < 512; i++)
+		order[i] = i;
+	qsort(order, 512, sizeof(order[0]), i386_profile_compare_opcode);
+	for (i = 0; i < 512 && counts[order[i]]; i++)
+		fprintf(fp, order[i] < 256 ? "%02x\t%llu\n" : "0f %02x\t%llu\n", order[i] & 0xff, counts[order[i]]);
+
+	I386_PROFILE_THUNK **thunks = (I386_PROFILE_THUNK **)malloc(sizeof(*thunks) * (m_profile_thunk_used + 1));
+	for (i = n = 0; i < I386_PROFILE_THUNK_SIZE; i++)
+		if (m_profile_thunk[i].count)
+			thunks[n++] = &m_profile_thunk[i];
+	qsort(thunks, n, sizeof(*thunks), i386_profile_compare_thunk);
+	fprintf(fp, "\ntransition\tcount\n");
+	for (i = 0; i < n; i++)
+		fprintf(fp, "%s\t%llu\n", thunks[i]->name, thunks[i]->count);
+	if (m_profile_thunk_other)
+		fprintf(fp, "[other]\t%llu\n", m_profile_thunk_other);
+	free(thunks);
+	fclose(fp);
+}
@@ -0,0 +1,182 @@
+/*
+    Saturation helpers and MMX lane operations, included by pentops.c
+    (no include guard: tests/cpu/mmx.cpp includes it once for each path)
+*/
+
+INLINE INT8 SaturatedSignedWordToSignedByte(INT16 word)
+{
+	if (word > 127)
+		return 127;
+	if (word < -128)
+		return -128;
+	return (INT8)word;
+}
+
+INLINE UINT8 SaturatedSignedWordToUnsignedByte(INT16 word)
+{
+	if (word > 255)
+		return 255;
+	if (word < 0)
+		return 0;
+	return (UINT8)word;
+}
+
+INLINE INT16 SaturatedSignedDwordToSignedWord(INT32 dword)
+{
+	if (dword > 32767)
+		return 32767;
+	if (dword < -32768)
+		return -32768;
+	return (INT16)dword;
+}
+
+INLINE UINT16 SaturatedSignedDwordToUnsignedWord(INT32 dword)
+{
+	if (dword > 65535)
+		return 65535;
+	if (dword < 0)
+		return 0;
+	return (UINT16)dword;
+}
+
+/*
+    MMX lane operations
+
+    Each takes the destination and source operands as 64-bit values and
+    returns the result.  When the host has SSE2 they run on the low half
+    of an XMM register, one or two instructions per operation; otherwise
+    the lanes are done one by one through MMX_REG.  Shift counts follow
+    the MMX rules: a count larger than the lane width clears the lanes
+    (fills them with the sign for psraw/psrad).  MMX_NO_SSE2 forces the
+    lanes; tests/cpu/mmx.cpp builds both and compares them.
+*/
+
+#if !defined(MMX_NO_SSE2) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define MMX_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef MMX_SSE2
+INLINE __m128i mmx_to_xmm(UINT64 a)
+{
+	return _mm_loadl_epi64((const __m128i *)&a);
+}
+
+INLINE UINT64 mmx_from_xmm(__m128i v)
+{
+	UINT64 r;
+	_mm_storel_epi64((__m128i *)&r, v);
+	return r;
+}
+
+#define MMX_LANE_OP(name, expr) \
+INLINE UINT64 name(UINT64 a, UINT64 b) \
+{ \
+	__m128i d = mmx_to_xmm(a), s = mmx_to_xmm(b); \
+	return mmx_from_xmm(expr); \
+}
+
+MMX_LANE_OP(mmx_paddb, _mm_add_epi8(d, s))
+MMX_LANE_OP(mmx_paddw, _mm_add_epi16(d, s))
+MMX_LANE_OP(mmx_paddd, _mm_add_epi32(d, s))
+MMX_LANE_OP(mmx_psubb, _mm_sub_epi8(d, s))
+MMX_LANE_OP(mmx_psubw, _mm_sub_epi16(d, s))
+MMX_LANE_OP(mmx_psubd, _mm_sub_epi32(d, s))
+MMX_LANE_OP(mmx_paddsb, _mm_adds_epi8(d, s))
+MMX_LANE_OP(mmx_paddsw, _mm_adds_epi16(d, s))
+MMX_LANE_OP(mmx_paddusb, _mm_adds_epu8(d, s))
+MMX_LANE_OP(mmx_paddusw, _mm_adds_epu16(d, s))
+MMX_LANE_OP(mmx_psubsb, _mm_subs_epi8(d, s))
+MMX_LANE_OP(mmx_psubsw, _mm_subs_epi16(d, s))
+MMX_LANE_OP(mmx_psubusb, _mm_subs_epu8(d, s))
+MMX_LANE_OP(mmx_psubusw, _mm_subs_epu16(d, s))
+MMX_LANE_OP(mmx_pmullw, _mm_mullo_epi16(d, s))
+MMX_LANE_OP(mmx_pmulhw, _mm_mulhi_epi16(d, s))
+MMX_LANE_OP(mmx_pmaddwd, _mm_madd_epi16(d, s))
+MMX_LANE_OP(mmx_pcmpeqb, _mm_cmpeq_epi8(d, s))
+MMX_LANE_OP(mmx_pcmpeqw, _mm_cmpeq_epi16(d, s))
+MMX_LANE_OP(mmx_pcmpeqd, _mm_cmpeq_epi32(d, s))
+MMX_LANE_OP(mmx_pcmpgtb, _mm_cmpgt_epi8(d, s))
+MMX_LANE_OP(mmx_pcmpgtw, _mm_cmpgt_epi16(d, s))
+MMX_LANE_OP(mmx_pcmpgtd, _mm_cmpgt_epi32(d, s))
+// the packs see the destination in the low and the source in the high quadword
+MMX_LANE_OP(mmx_packsswb, _mm_packs_epi16(_mm_unpacklo_epi64(d, s), d))
+MMX_LANE_OP(mmx_packssdw, _mm_packs_epi32(_mm_unpacklo_epi64(d, s), d))
+MMX_LANE_OP(mmx_packuswb, _mm_packus_epi16(_mm_unpacklo_epi64(d, s), d))
+MMX_LANE_OP(mmx_punpcklbw, _mm_unpacklo_epi8(d, s))
+MMX_LANE_OP(mmx_punpcklwd, _mm_unpacklo_epi16(d, s))
+MMX_LANE_OP(mmx_punpckldq, _mm_unpacklo_epi32(d, s))
+MMX_LANE_OP(mmx_punpckhbw, _mm_srli_si128(_mm_unpacklo_epi8(d, s), 8))
+MMX_LANE_OP(mmx_punpckhwd, _mm_srli_si128(_mm_unpacklo_epi16(d, s), 8))
+MMX_LANE_OP(mmx_punpckhdq, _mm_srli_si128(_mm_unpacklo_epi32(d, s), 8))
+// b is the shift count
+MMX_LANE_OP(mmx_psllw, _mm_sll_epi16(d, s))
+MMX_LANE_OP(mmx_pslld, _mm_sll_epi32(d, s))
+MMX_LANE_OP(mmx_psllq, _mm_sll_epi64(d, s))
+MMX_LANE_OP(mmx_psrlw, _mm_srl_epi16(d, s))
+MMX_LANE_OP(mmx_psrld, _mm_srl_epi32(d, s))
+MMX_LANE_OP(mmx_psrlq, _mm_srl_epi64(d, s))
+MMX_LANE_OP(mmx_psraw, _mm_sra_epi16(d, s))
+MMX_LANE_OP(mmx_psrad, _mm_sra_epi32(d, s))
+#else
+#define MMX_LANE_OP(name, lane, count, expr) \
+INLINE UINT64 name(UINT64 a, UINT64 b) \
+{ \
+	MMX_REG d, s, r; \
+	d.q = a; \
+	s.q = b; \
+	for (int n = 0; n < count; n++) \
+		r.lane[n] = expr; \
+	return r.q; \
+}
+
+MMX_LANE_OP(mmx_paddb, b, 8, d.b[n] + s.b[n])
+MMX_LANE_OP(mmx_paddw, w, 4, d.w[n] + s.w[n])
+MMX_LANE_OP(mmx_paddd, d, 2, d.d[n] + s.d[n])
+MMX_LANE_OP(mmx_psubb, b, 8, d.b[n] - s.b[n])
+MMX_LANE_OP(mmx_psubw, w, 4, d.w[n] - s.w[n])
+MMX_LANE_OP(mmx_psubd, d, 2, d.d[n] - s.d[n])
+MMX_LANE_OP(mmx_paddsb, c, 8, SaturatedSignedWordToSignedByte((INT16)d.c[n] + (INT16)s.c[n]))
+MMX_LANE_OP(mmx_paddsw, s, 4, SaturatedSignedDwordToSignedWord((INT32)d.s[n] + (INT32)s.s[n]))
+MMX_LANE_OP(mmx_paddusb, b, 8, d.b[n] > (0xff - s.b[n]) ? 0xff : d.b[n] + s.b[n])
+MMX_LANE_OP(mmx_paddusw, w, 4, d.w[n] > (0xffff - s.w[n]) ? 0xffff : d.w[n] + s.w[n])
+MMX_LANE_OP(mmx_psubsb, c, 8, SaturatedSignedWordToSignedByte((INT16)d.c[n] - (INT16)s.c[n]))
+MMX_LANE_OP(mmx_psubsw, s, 4, SaturatedSignedDwordToSignedWord((INT32)d.s[n] - (INT32)s.s[n]))
+MMX_LANE_OP(mmx_psubusb, b, 8, d.b[n] < s.b[n] ? 0 : d.b[n] - s.b[n])
+MMX_LANE_OP(mmx_psubusw, w, 4, d.w[n] < s.w[n] ? 0 : d.w[n] - s.w[n])
+MMX_LANE_OP(mmx_pmullw, w, 4, (UINT32)((INT32)d.s[n] * (INT32)s.s[n]) & 0xffff)
+MMX_LANE_OP(mmx_pmulhw, w, 4, (UINT32)((INT32)d.s[n] * (INT32)s.s[n]) >> 16)
+MMX_LANE_OP(mmx_pmaddwd, d, 2, (UINT32)((INT32)d.s[n * 2] * (INT32)s.s[n * 2]) + (UINT32)((INT32)d.s[n * 2 + 1] * (INT32)s.s[n * 2 + 1]))
+MMX_LANE_OP(mmx_pcmpeqb, b, 8, d.b[n] == s.b[n] ? 0xff : 0)
+MMX_LANE_OP(mmx_pcmpeqw, w, 4, d.w[n] == s.w[n] ? 0xffff : 0)
+MMX_LANE_OP(mmx_pcmpeqd, d, 2, d.d[n] == s.d[n] ? 0xffffffff : 0)
+MMX_LANE_OP(mmx_pcmpgtb, b, 8, d.c[n] > s.c[n] ? 0xff : 0)
+MMX_LANE_OP(mmx_pcmpgtw, w, 4, d.s[n] > s.s[n] ? 0xffff : 0)
+MMX_LANE_OP(mmx_pcmpgtd, d, 2, d.i[n] > s.i[n] ? 0xffffffff : 0)
+MMX_LANE_OP(mmx_packsswb, c, 8, SaturatedSignedWordToSignedByte(n < 4 ? d.s[n] : s.s[n - 4]))
+MMX_LANE_OP(mmx_packssdw, s, 4, SaturatedSignedDwordToSignedWord(n < 2 ? d.i[n] : s.i[n - 2]))
+MMX_LANE_OP(mmx_packuswb, b, 8, SaturatedSignedWordToUnsignedByte(n < 4 ? d.s[n] : s.s[n - 4]))
+MMX_LANE_OP(mmx_punpcklbw, b, 8, n & 1 ? s.b[n / 2] : d.b[n / 2])
+MMX_LANE_OP(mmx_punpcklwd, w, 4, n & 1 ? s.w[n / 2] : d.w[n / 2])
+MMX_LANE_OP(mmx_punpckldq, d, 2, n & 1 ? s.d[n / 2] : d.d[n / 2])
+MMX_LANE_OP(mmx_punpckhbw, b, 8, n & 1 ? s.b[4 + n / 2] : d.b[4 + n / 2])
+MMX_LANE_OP(mmx_punpckhwd, w, 4, n & 1 ? s.w[2 + n / 2] : d.w[2 + n / 2])
+MMX_LANE_OP(mmx_punpckhdq, d, 2, n & 1 ? s.d[1] : d.d[1])
+// s.q is the shift count
+MMX_LANE_OP(mmx_psllw, w, 4, s.q > 15 ? 0 : d.w[n] << s.q)
+MMX_LANE_OP(mmx_pslld, d, 2, s.q > 31 ? 0 : d.d[n] << s.q)
+MMX_LANE_OP(mmx_psrlw, w, 4, s.q > 15 ? 0 : d.w[n] >> s.q)
+MMX_LANE_OP(mmx_psrld, d, 2, s.q > 31 ? 0 : d.d[n] >> s.q)
+MMX_LANE_OP(mmx_psraw, s, 4, d.s[n] >> (s.q > 15 ? 15 : s.q))
+MMX_LANE_OP(mmx_psrad, i, 2, d.i[n] >> (s.q > 31 ? 31 : s.q))
+
+INLINE UINT64 mmx_psllq(UINT64 a, UINT64 b)
+{
+	return b > 63 ? 0 : a << b;
+}
+
+INLINE UINT64 mmx_psrlq(UINT64 a, UINT64 b)
+{
+	return b > 63 ? 0 : a >> b;
+}
+#endif
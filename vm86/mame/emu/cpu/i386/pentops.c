@@ -175,6 +175,7 @@ static void PENTIUMOP(rsm)()
 		}
 		else
 			m_sreg[i].valid = true;
+		i386_sreg_window(&m_sreg[i]);
 	}
 
 //	if(!m_smiact.isnull())
@@ -729,7 +730,7 @@ static void PENTIUMOP(cmovp_r16_rm16)()    // Opcode 0x0f 4a
 
 	if( modrm >= 0xc0 )
 	{
-		if (m_PF == 1)
+		if (GetPF() == 1)
 		{
 			src = LOAD_RM16(modrm);
 			STORE_REG16(modrm, src);
@@ -739,7 +740,7 @@ static void PENTIUMOP(cmovp_r16_rm16)()    // Opcode 0x0f 4a
 	else
 	{
 		UINT32 ea = GetEA(modrm,0);
-		if (m_PF == 1)
+		if (GetPF() == 1)
 		{
 			src = READ16(ea);
 			STORE_REG16(modrm, src);
@@ -755,7 +756,7 @@ static void PENTIUMOP(cmovp_r32_rm32)()    // Opcode 0x0f 4a
 
 	if( modrm >= 0xc0 )
 	{
-		if (m_PF == 1)
+		if (GetPF() == 1)
 		{
 			src = LOAD_RM32(modrm);
 			STORE_REG32(modrm, src);
@@ -765,7 +766,7 @@ static void PENTIUMOP(cmovp_r32_rm32)()    // Opcode 0x0f 4a
 	else
 	{
 		UINT32 ea = GetEA(modrm,0);
-		if (m_PF == 1)
+		if (GetPF() == 1)
 		{
 			src = READ32(ea);
 			STORE_REG32(modrm, src);
@@ -781,7 +782,7 @@ static void PENTIUMOP(cmovnp_r16_rm16)()    // Opcode 0x0f 4b
 
 	if( modrm >= 0xc0 )
 	{
-		if (m_PF == 0)
+		if (GetPF() == 0)
 		{
 			src = LOAD_RM16(modrm);
 			STORE_REG16(modrm, src);
@@ -791,7 +792,7 @@ static void PENTIUMOP(cmovnp_r16_rm16)()    // Opcode 0x0f 4b
 	else
 	{
 		UINT32 ea = GetEA(modrm,0);
-		if (m_PF == 0)
+		if (GetPF() == 0)
 		{
 			src = READ16(ea);
 			STORE_REG16(modrm, src);
@@ -807,7 +808,7 @@ static void PENTIUMOP(cmovnp_r32_rm32)()    // Opcode 0x0f 4b
 
 	if( modrm >= 0xc0 )
 	{
-		if (m_PF == 0)
+		if (GetPF() == 0)
 		{
 			src = LOAD_RM32(modrm);
 			STORE_REG32(modrm, src);
@@ -817,7 +818,7 @@ static void PENTIUMOP(cmovnp_r32_rm32)()    // Opcode 0x0f 4b
 	else
 	{
 		UINT32 ea = GetEA(modrm,0);
-		if (m_PF == 0)
+		if (GetPF() == 0)
 		{
 			src = READ32(ea);
 			STORE_REG32(modrm, src);
@@ -1200,40 +1201,34 @@ static void PENTIUMOP(tzcnt_r32_rm32)()
 	// TODO: actually implement TZCNT
 }
 
-INLINE INT8 SaturatedSignedWordToSignedByte(INT16 word)
-{
-	if (word > 127)
-		return 127;
-	if (word < -128)
-		return -128;
-	return (INT8)word;
-}
+#include "mmxlanes.h"
 
-INLINE UINT8 SaturatedSignedWordToUnsignedByte(INT16 word)
+/* Fetch the modrm byte and read the 64-bit source operand */
+INLINE UINT8 MMXFETCHRM64(MMX_REG &s)
 {
-	if (word > 255)
-		return 255;
-	if (word < 0)
-		return 0;
-	return (UINT8)word;
-}
-
-INLINE INT16 SaturatedSignedDwordToSignedWord(INT32 dword)
-{
-	if (dword > 32767)
-		return 32767;
-	if (dword < -32768)
-		return -32768;
-	return (INT16)dword;
+	MMXPROLOG();
+	UINT8 modrm = FETCH();
+	if( modrm >= 0xc0 ) {
+		s.q = MMX(modrm & 7).q;
+	} else {
+		UINT32 ea = GetEA(modrm, 0);
+		READMMX(ea, s);
+	}
+	return modrm;
 }
 
-INLINE UINT16 SaturatedSignedDwordToUnsignedWord(INT32 dword)
+/* Same for the punpckl forms, which only read 32 bits from memory */
+INLINE UINT8 MMXFETCHRM32(MMX_REG &s)
 {
-	if (dword > 65535)
-		return 65535;
-	if (dword < 0)
-		return 0;
-	return (UINT16)dword;
+	MMXPROLOG();
+	UINT8 modrm = FETCH();
+	if( modrm >= 0xc0 ) {
+		s.q = MMX(modrm & 7).q;
+	} else {
+		UINT32 ea = GetEA(modrm, 0);
+		s.q = READ32(ea);
+	}
+	return modrm;
 }
 
 static void MMXOP(group_0f71)()  // Opcode 0f 71
@@ -1245,22 +1240,13 @@ static void MMXOP(group_0f71)()  // Opcode 0f 71
 		switch ( (modm & 0x38) >> 3 )
 		{
 			case 2: // psrlw
-				MMX(modm & 7).w[0]=MMX(modm & 7).w[0] >> imm8;
-				MMX(modm & 7).w[1]=MMX(modm & 7).w[1] >> imm8;
-				MMX(modm & 7).w[2]=MMX(modm & 7).w[2] >> imm8;
-				MMX(modm & 7).w[3]=MMX(modm & 7).w[3] >> imm8;
+				MMX(modm & 7).q=mmx_psrlw(MMX(modm & 7).q, imm8);
 				break;
 			case 4: // psraw
-				MMX(modm & 7).s[0]=MMX(modm & 7).s[0] >> imm8;
-				MMX(modm & 7).s[1]=MMX(modm & 7).s[1] >> imm8;
-				MMX(modm & 7).s[2]=MMX(modm & 7).s[2] >> imm8;
-				MMX(modm & 7).s[3]=MMX(modm & 7).s[3] >> imm8;
+				MMX(modm & 7).q=mmx_psraw(MMX(modm & 7).q, imm8);
 				break;
 			case 6: // psllw
-				MMX(modm & 7).w[0]=MMX(modm & 7).w[0] << imm8;
-				MMX(modm & 7).w[1]=MMX(modm & 7).w[1] << imm8;
-				MMX(modm & 7).w[2]=MMX(modm & 7).w[2] << imm8;
-				MMX(modm & 7).w[3]=MMX(modm & 7).w[3] << imm8;
+				MMX(modm & 7).q=mmx_psllw(MMX(modm & 7).q, imm8);
 				break;
 			default:
 				report_invalid_modrm("mmx_group0f71", modm);
@@ -1302,16 +1288,13 @@ static void MMXOP(group_0f72)()  // Opcode 0f 72
 		switch ( (modm & 0x38) >> 3 )
 		{
 			case 2: // psrld
-				MMX(modm & 7).d[0]=MMX(modm & 7).d[0] >> imm8;
-				MMX(modm & 7).d[1]=MMX(modm & 7).d[1] >> imm8;
+				MMX(modm & 7).q=mmx_psrld(MMX(modm & 7).q, imm8);
 				break;
 			case 4: // psrad
-				MMX(modm & 7).i[0]=MMX(modm & 7).i[0] >> imm8;
-				MMX(modm & 7).i[1]=MMX(modm & 7).i[1] >> imm8;
+				MMX(modm & 7).q=mmx_psrad(MMX(modm & 7).q, imm8);
 				break;
 			case 6: // pslld
-				MMX(modm & 7).d[0]=MMX(modm & 7).d[0] << imm8;
-				MMX(modm & 7).d[1]=MMX(modm & 7).d[1] << imm8;
+				MMX(modm & 7).q=mmx_pslld(MMX(modm & 7).q, imm8);
 				break;
 			default:
 				report_invalid_modrm("mmx_group0f72", modm);
@@ -1353,10 +1336,10 @@ static void MMXOP(group_0f73)()  // Opcode 0f 73
 		switch ( (modm & 0x38) >> 3 )
 		{
 			case 2: // psrlq
-				MMX(modm & 7).q = imm8 > 63 ? 0 : MMX(modm & 7).q >> imm8;
+				MMX(modm & 7).q=mmx_psrlq(MMX(modm & 7).q, imm8);
 				break;
 			case 6: // psllq
-				MMX(modm & 7).q = imm8 > 63 ? 0 : MMX(modm & 7).q << imm8;
+				MMX(modm & 7).q=mmx_psllq(MMX(modm & 7).q, imm8);
 				break;
 			default:
 				report_invalid_modrm("mmx_group0f73", modm);
@@ -1427,60 +1410,25 @@ static void SSEOP(group_660f73)()  // Opcode 66 0f 73
 
 static void MMXOP(psrlw_r64_rm64)()  // Opcode 0f d1
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int count=(int)MMX(modrm & 7).q;
-		MMX((modrm >> 3) & 0x7).w[0]=MMX((modrm >> 3) & 0x7).w[0] >> count;
-		MMX((modrm >> 3) & 0x7).w[1]=MMX((modrm >> 3) & 0x7).w[1] >> count;
-		MMX((modrm >> 3) & 0x7).w[2]=MMX((modrm >> 3) & 0x7).w[2] >> count;
-		MMX((modrm >> 3) & 0x7).w[3]=MMX((modrm >> 3) & 0x7).w[3] >> count;
-	} else {
-		MMX_REG src;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, src);
-		int count=(int)src.q;
-		MMX((modrm >> 3) & 0x7).w[0]=MMX((modrm >> 3) & 0x7).w[0] >> count;
-		MMX((modrm >> 3) & 0x7).w[1]=MMX((modrm >> 3) & 0x7).w[1] >> count;
-		MMX((modrm >> 3) & 0x7).w[2]=MMX((modrm >> 3) & 0x7).w[2] >> count;
-		MMX((modrm >> 3) & 0x7).w[3]=MMX((modrm >> 3) & 0x7).w[3] >> count;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_psrlw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(psrld_r64_rm64)()  // Opcode 0f d2
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int count=(int)MMX(modrm & 7).q;
-		MMX((modrm >> 3) & 0x7).d[0]=MMX((modrm >> 3) & 0x7).d[0] >> count;
-		MMX((modrm >> 3) & 0x7).d[1]=MMX((modrm >> 3) & 0x7).d[1] >> count;
-	} else {
-		MMX_REG src;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, src);
-		int count=(int)src.q;
-		MMX((modrm >> 3) & 0x7).d[0]=MMX((modrm >> 3) & 0x7).d[0] >> count;
-		MMX((modrm >> 3) & 0x7).d[1]=MMX((modrm >> 3) & 0x7).d[1] >> count;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_psrld(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(psrlq_r64_rm64)()  // Opcode 0f d3
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int count=(int)MMX(modrm & 7).q;
-		MMX((modrm >> 3) & 0x7).q=MMX((modrm >> 3) & 0x7).q >> count;
-	} else {
-		MMX_REG src;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, src);
-		int count=(int)src.q;
-		MMX((modrm >> 3) & 0x7).q=MMX((modrm >> 3) & 0x7).q >> count;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_psrlq(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
@@ -1501,58 +1449,25 @@ static void MMXOP(paddq_r64_rm64)()  // Opcode 0f d4
 
 static void MMXOP(pmullw_r64_rm64)()  // Opcode 0f d5
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		MMX((modrm >> 3) & 0x7).w[0]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[0]*(INT32)MMX(modrm & 7).s[0]) & 0xffff;
-		MMX((modrm >> 3) & 0x7).w[1]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[1]*(INT32)MMX(modrm & 7).s[1]) & 0xffff;
-		MMX((modrm >> 3) & 0x7).w[2]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[2]*(INT32)MMX(modrm & 7).s[2]) & 0xffff;
-		MMX((modrm >> 3) & 0x7).w[3]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[3]*(INT32)MMX(modrm & 7).s[3]) & 0xffff;
-	} else {
-		MMX_REG src;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, src);
-		MMX((modrm >> 3) & 0x7).w[0]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[0]*(INT32)src.s[0]) & 0xffff;
-		MMX((modrm >> 3) & 0x7).w[1]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[1]*(INT32)src.s[1]) & 0xffff;
-		MMX((modrm >> 3) & 0x7).w[2]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[2]*(INT32)src.s[2]) & 0xffff;
-		MMX((modrm >> 3) & 0x7).w[3]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[3]*(INT32)src.s[3]) & 0xffff;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_pmullw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(psubusb_r64_rm64)()  // Opcode 0f d8
 {
-	int n;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		for (n=0;n < 8;n++)
-			MMX((modrm >> 3) & 0x7).b[n]=MMX((modrm >> 3) & 0x7).b[n] < MMX(modrm & 7).b[n] ? 0 : MMX((modrm >> 3) & 0x7).b[n]-MMX(modrm & 7).b[n];
-	} else {
-		MMX_REG src;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, src);
-		for (n=0;n < 8;n++)
-			MMX((modrm >> 3) & 0x7).b[n]=MMX((modrm >> 3) & 0x7).b[n] < src.b[n] ? 0 : MMX((modrm >> 3) & 0x7).b[n]-src.b[n];
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_psubusb(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(psubusw_r64_rm64)()  // Opcode 0f d9
 {
-	int n;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		for (n=0;n < 4;n++)
-			MMX((modrm >> 3) & 0x7).w[n]=MMX((modrm >> 3) & 0x7).w[n] < MMX(modrm & 7).w[n] ? 0 : MMX((modrm >> 3) & 0x7).w[n]-MMX(modrm & 7).w[n];
-	} else {
-		MMX_REG src;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, src);
-		for (n=0;n < 4;n++)
-			MMX((modrm >> 3) & 0x7).w[n]=MMX((modrm >> 3) & 0x7).w[n] < src.w[n] ? 0 : MMX((modrm >> 3) & 0x7).w[n]-src.w[n];
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_psubusw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
@@ -1573,37 +1488,17 @@ static void MMXOP(pand_r64_rm64)()  // Opcode 0f db
 
 static void MMXOP(paddusb_r64_rm64)()  // Opcode 0f dc
 {
-	int n;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		for (n=0;n < 8;n++)
-			MMX((modrm >> 3) & 0x7).b[n]=MMX((modrm >> 3) & 0x7).b[n] > (0xff-MMX(modrm & 7).b[n]) ? 0xff : MMX((modrm >> 3) & 0x7).b[n]+MMX(modrm & 7).b[n];
-	} else {
-		MMX_REG src;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, src);
-		for (n=0;n < 8;n++)
-			MMX((modrm >> 3) & 0x7).b[n]=MMX((modrm >> 3) & 0x7).b[n] > (0xff-src.b[n]) ? 0xff : MMX((modrm >> 3) & 0x7).b[n]+src.b[n];
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_paddusb(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(paddusw_r64_rm64)()  // Opcode 0f dd
 {
-	int n;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		for (n=0;n < 4;n++)
-			MMX((modrm >> 3) & 0x7).w[n]=MMX((modrm >> 3) & 0x7).w[n] > (0xffff-MMX(modrm & 7).w[n]) ? 0xffff : MMX((modrm >> 3) & 0x7).w[n]+MMX(modrm & 7).w[n];
-	} else {
-		MMX_REG src;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, src);
-		for (n=0;n < 4;n++)
-			MMX((modrm >> 3) & 0x7).w[n]=MMX((modrm >> 3) & 0x7).w[n] > (0xffff-src.w[n]) ? 0xffff : MMX((modrm >> 3) & 0x7).w[n]+src.w[n];
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_paddusw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
@@ -1624,100 +1519,41 @@ static void MMXOP(pandn_r64_rm64)()  // Opcode 0f df
 
 static void MMXOP(psraw_r64_rm64)()  // Opcode 0f e1
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int count=(int)MMX(modrm & 7).q;
-		MMX((modrm >> 3) & 0x7).s[0]=MMX((modrm >> 3) & 0x7).s[0] >> count;
-		MMX((modrm >> 3) & 0x7).s[1]=MMX((modrm >> 3) & 0x7).s[1] >> count;
-		MMX((modrm >> 3) & 0x7).s[2]=MMX((modrm >> 3) & 0x7).s[2] >> count;
-		MMX((modrm >> 3) & 0x7).s[3]=MMX((modrm >> 3) & 0x7).s[3] >> count;
-	} else {
-		MMX_REG src;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, src);
-		int count=(int)src.q;
-		MMX((modrm >> 3) & 0x7).s[0]=MMX((modrm >> 3) & 0x7).s[0] >> count;
-		MMX((modrm >> 3) & 0x7).s[1]=MMX((modrm >> 3) & 0x7).s[1] >> count;
-		MMX((modrm >> 3) & 0x7).s[2]=MMX((modrm >> 3) & 0x7).s[2] >> count;
-		MMX((modrm >> 3) & 0x7).s[3]=MMX((modrm >> 3) & 0x7).s[3] >> count;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_psraw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(psrad_r64_rm64)()  // Opcode 0f e2
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int count=(int)MMX(modrm & 7).q;
-		MMX((modrm >> 3) & 0x7).i[0]=MMX((modrm >> 3) & 0x7).i[0] >> count;
-		MMX((modrm >> 3) & 0x7).i[1]=MMX((modrm >> 3) & 0x7).i[1] >> count;
-	} else {
-		MMX_REG src;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, src);
-		int count=(int)src.q;
-		MMX((modrm >> 3) & 0x7).i[0]=MMX((modrm >> 3) & 0x7).i[0] >> count;
-		MMX((modrm >> 3) & 0x7).i[1]=MMX((modrm >> 3) & 0x7).i[1] >> count;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_psrad(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(pmulhw_r64_rm64)()  // Opcode 0f e5
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		MMX((modrm >> 3) & 0x7).w[0]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[0]*(INT32)MMX(modrm & 7).s[0]) >> 16;
-		MMX((modrm >> 3) & 0x7).w[1]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[1]*(INT32)MMX(modrm & 7).s[1]) >> 16;
-		MMX((modrm >> 3) & 0x7).w[2]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[2]*(INT32)MMX(modrm & 7).s[2]) >> 16;
-		MMX((modrm >> 3) & 0x7).w[3]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[3]*(INT32)MMX(modrm & 7).s[3]) >> 16;
-	} else {
-		MMX_REG src;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, src);
-		MMX((modrm >> 3) & 0x7).w[0]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[0]*(INT32)src.s[0]) >> 16;
-		MMX((modrm >> 3) & 0x7).w[1]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[1]*(INT32)src.s[1]) >> 16;
-		MMX((modrm >> 3) & 0x7).w[2]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[2]*(INT32)src.s[2]) >> 16;
-		MMX((modrm >> 3) & 0x7).w[3]=(UINT32)((INT32)MMX((modrm >> 3) & 0x7).s[3]*(INT32)src.s[3]) >> 16;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_pmulhw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(psubsb_r64_rm64)()  // Opcode 0f e8
 {
-	int n;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		for (n=0;n < 8;n++)
-			MMX((modrm >> 3) & 0x7).c[n]=SaturatedSignedWordToSignedByte((INT16)MMX((modrm >> 3) & 0x7).c[n] - (INT16)MMX(modrm & 7).c[n]);
-	} else {
-		MMX_REG s;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		for (n=0;n < 8;n++)
-			MMX((modrm >> 3) & 0x7).c[n]=SaturatedSignedWordToSignedByte((INT16)MMX((modrm >> 3) & 0x7).c[n] - (INT16)s.c[n]);
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_psubsb(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(psubsw_r64_rm64)()  // Opcode 0f e9
 {
-	int n;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		for (n=0;n < 4;n++)
-			MMX((modrm >> 3) & 0x7).s[n]=SaturatedSignedDwordToSignedWord((INT32)MMX((modrm >> 3) & 0x7).s[n] - (INT32)MMX(modrm & 7).s[n]);
-	} else {
-		MMX_REG s;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		for (n=0;n < 4;n++)
-			MMX((modrm >> 3) & 0x7).s[n]=SaturatedSignedDwordToSignedWord((INT32)MMX((modrm >> 3) & 0x7).s[n] - (INT32)s.s[n]);
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_psubsw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
@@ -1738,37 +1574,17 @@ static void MMXOP(por_r64_rm64)()  // Opcode 0f eb
 
 static void MMXOP(paddsb_r64_rm64)()  // Opcode 0f ec
 {
-	int n;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		for (n=0;n < 8;n++)
-			MMX((modrm >> 3) & 0x7).c[n]=SaturatedSignedWordToSignedByte((INT16)MMX((modrm >> 3) & 0x7).c[n] + (INT16)MMX(modrm & 7).c[n]);
-	} else {
-		MMX_REG s;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		for (n=0;n < 8;n++)
-			MMX((modrm >> 3) & 0x7).c[n]=SaturatedSignedWordToSignedByte((INT16)MMX((modrm >> 3) & 0x7).c[n] + (INT16)s.c[n]);
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_paddsb(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(paddsw_r64_rm64)()  // Opcode 0f ed
 {
-	int n;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		for (n=0;n < 4;n++)
-			MMX((modrm >> 3) & 0x7).s[n]=SaturatedSignedDwordToSignedWord((INT32)MMX((modrm >> 3) & 0x7).s[n] + (INT32)MMX(modrm & 7).s[n]);
-	} else {
-		MMX_REG s;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		for (n=0;n < 4;n++)
-			MMX((modrm >> 3) & 0x7).s[n]=SaturatedSignedDwordToSignedWord((INT32)MMX((modrm >> 3) & 0x7).s[n] + (INT32)s.s[n]);
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_paddsw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
@@ -1789,189 +1605,81 @@ static void MMXOP(pxor_r64_rm64)()  // Opcode 0f ef
 
 static void MMXOP(psllw_r64_rm64)()  // Opcode 0f f1
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int count=(int)MMX(modrm & 7).q;
-		MMX((modrm >> 3) & 0x7).w[0]=MMX((modrm >> 3) & 0x7).w[0] << count;
-		MMX((modrm >> 3) & 0x7).w[1]=MMX((modrm >> 3) & 0x7).w[1] << count;
-		MMX((modrm >> 3) & 0x7).w[2]=MMX((modrm >> 3) & 0x7).w[2] << count;
-		MMX((modrm >> 3) & 0x7).w[3]=MMX((modrm >> 3) & 0x7).w[3] << count;
-	} else {
-		MMX_REG s;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		int count=(int)s.q;
-		MMX((modrm >> 3) & 0x7).w[0]=MMX((modrm >> 3) & 0x7).w[0] << count;
-		MMX((modrm >> 3) & 0x7).w[1]=MMX((modrm >> 3) & 0x7).w[1] << count;
-		MMX((modrm >> 3) & 0x7).w[2]=MMX((modrm >> 3) & 0x7).w[2] << count;
-		MMX((modrm >> 3) & 0x7).w[3]=MMX((modrm >> 3) & 0x7).w[3] << count;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_psllw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(pslld_r64_rm64)()  // Opcode 0f f2
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int count=(int)MMX(modrm & 7).q;
-		MMX((modrm >> 3) & 0x7).d[0]=MMX((modrm >> 3) & 0x7).d[0] << count;
-		MMX((modrm >> 3) & 0x7).d[1]=MMX((modrm >> 3) & 0x7).d[1] << count;
-	} else {
-		MMX_REG s;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		int count=(int)s.q;
-		MMX((modrm >> 3) & 0x7).d[0]=MMX((modrm >> 3) & 0x7).d[0] << count;
-		MMX((modrm >> 3) & 0x7).d[1]=MMX((modrm >> 3) & 0x7).d[1] << count;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_pslld(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(psllq_r64_rm64)()  // Opcode 0f f3
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int count=(int)MMX(modrm & 7).q;
-		MMX((modrm >> 3) & 0x7).q=MMX((modrm >> 3) & 0x7).q << count;
-	} else {
-		MMX_REG s;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		int count=(int)s.q;
-		MMX((modrm >> 3) & 0x7).q=MMX((modrm >> 3) & 0x7).q << count;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_psllq(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(pmaddwd_r64_rm64)()  // Opcode 0f f5
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		MMX((modrm >> 3) & 0x7).i[0]=(INT32)MMX((modrm >> 3) & 0x7).s[0]*(INT32)MMX(modrm & 7).s[0]+
-										(INT32)MMX((modrm >> 3) & 0x7).s[1]*(INT32)MMX(modrm & 7).s[1];
-		MMX((modrm >> 3) & 0x7).i[1]=(INT32)MMX((modrm >> 3) & 0x7).s[2]*(INT32)MMX(modrm & 7).s[2]+
-										(INT32)MMX((modrm >> 3) & 0x7).s[3]*(INT32)MMX(modrm & 7).s[3];
-	} else {
-		MMX_REG s;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		MMX((modrm >> 3) & 0x7).i[0]=(INT32)MMX((modrm >> 3) & 0x7).s[0]*(INT32)s.s[0]+
-										(INT32)MMX((modrm >> 3) & 0x7).s[1]*(INT32)s.s[1];
-		MMX((modrm >> 3) & 0x7).i[1]=(INT32)MMX((modrm >> 3) & 0x7).s[2]*(INT32)s.s[2]+
-										(INT32)MMX((modrm >> 3) & 0x7).s[3]*(INT32)s.s[3];
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_pmaddwd(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(psubb_r64_rm64)()  // Opcode 0f f8
 {
-	int n;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		for (n=0;n < 8;n++)
-			MMX((modrm >> 3) & 0x7).b[n]=MMX((modrm >> 3) & 0x7).b[n] - MMX(modrm & 7).b[n];
-	} else {
-		MMX_REG s;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		for (n=0;n < 8;n++)
-			MMX((modrm >> 3) & 0x7).b[n]=MMX((modrm >> 3) & 0x7).b[n] - s.b[n];
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_psubb(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(psubw_r64_rm64)()  // Opcode 0f f9
 {
-	int n;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		for (n=0;n < 4;n++)
-			MMX((modrm >> 3) & 0x7).w[n]=MMX((modrm >> 3) & 0x7).w[n] - MMX(modrm & 7).w[n];
-	} else {
-		MMX_REG s;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		for (n=0;n < 4;n++)
-			MMX((modrm >> 3) & 0x7).w[n]=MMX((modrm >> 3) & 0x7).w[n] - s.w[n];
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_psubw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(psubd_r64_rm64)()  // Opcode 0f fa
 {
-	int n;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		for (n=0;n < 2;n++)
-			MMX((modrm >> 3) & 0x7).d[n]=MMX((modrm >> 3) & 0x7).d[n] - MMX(modrm & 7).d[n];
-	} else {
-		MMX_REG s;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		for (n=0;n < 2;n++)
-			MMX((modrm >> 3) & 0x7).d[n]=MMX((modrm >> 3) & 0x7).d[n] - s.d[n];
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_psubd(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(paddb_r64_rm64)()  // Opcode 0f fc
 {
-	int n;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		for (n=0;n < 8;n++)
-			MMX((modrm >> 3) & 0x7).b[n]=MMX((modrm >> 3) & 0x7).b[n] + MMX(modrm & 7).b[n];
-	} else {
-		MMX_REG s;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		for (n=0;n < 8;n++)
-			MMX((modrm >> 3) & 0x7).b[n]=MMX((modrm >> 3) & 0x7).b[n] + s.b[n];
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_paddb(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(paddw_r64_rm64)()  // Opcode 0f fd
 {
-	int n;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		for (n=0;n < 4;n++)
-			MMX((modrm >> 3) & 0x7).w[n]=MMX((modrm >> 3) & 0x7).w[n] + MMX(modrm & 7).w[n];
-	} else {
-		MMX_REG s;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		for (n=0;n < 4;n++)
-			MMX((modrm >> 3) & 0x7).w[n]=MMX((modrm >> 3) & 0x7).w[n] + s.w[n];
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_paddw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(paddd_r64_rm64)()  // Opcode 0f fe
 {
-	int n;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		for (n=0;n < 2;n++)
-			MMX((modrm >> 3) & 0x7).d[n]=MMX((modrm >> 3) & 0x7).d[n] + MMX(modrm & 7).d[n];
-	} else {
-		MMX_REG s;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		for (n=0;n < 2;n++)
-			MMX((modrm >> 3) & 0x7).d[n]=MMX((modrm >> 3) & 0x7).d[n] + s.d[n];
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_paddd(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
@@ -2107,6 +1815,7 @@ static void I386OP(cyrix_rsdc)() // Opcode 0f 79
 		m_sreg[index].flags = flags;
 		m_sreg[index].base = base;
 		m_sreg[index].limit = limit;
+		i386_sreg_window(&m_sreg[index]);
 	} else {
 		i386_trap(6, 0, 0);
 	}
@@ -2293,69 +2002,25 @@ static void MMXOP(movq_rm64_r64)() // Opcode 0f 7f
 
 static void MMXOP(pcmpeqb_r64_rm64)() // Opcode 0f 74
 {
-	int c;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int s,d;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		for (c=0;c <= 7;c++)
-			MMX(d).b[c]=(MMX(d).b[c] == MMX(s).b[c]) ? 0xff : 0;
-	} else {
-		MMX_REG s;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		for (c=0;c <= 7;c++)
-			MMX(d).b[c]=(MMX(d).b[c] == s.b[c]) ? 0xff : 0;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_pcmpeqb(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(pcmpeqw_r64_rm64)() // Opcode 0f 75
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int s,d;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		MMX(d).w[0]=(MMX(d).w[0] == MMX(s).w[0]) ? 0xffff : 0;
-		MMX(d).w[1]=(MMX(d).w[1] == MMX(s).w[1]) ? 0xffff : 0;
-		MMX(d).w[2]=(MMX(d).w[2] == MMX(s).w[2]) ? 0xffff : 0;
-		MMX(d).w[3]=(MMX(d).w[3] == MMX(s).w[3]) ? 0xffff : 0;
-	} else {
-		MMX_REG s;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		MMX(d).w[0]=(MMX(d).w[0] == s.w[0]) ? 0xffff : 0;
-		MMX(d).w[1]=(MMX(d).w[1] == s.w[1]) ? 0xffff : 0;
-		MMX(d).w[2]=(MMX(d).w[2] == s.w[2]) ? 0xffff : 0;
-		MMX(d).w[3]=(MMX(d).w[3] == s.w[3]) ? 0xffff : 0;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_pcmpeqw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(pcmpeqd_r64_rm64)() // Opcode 0f 76
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int s,d;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		MMX(d).d[0]=(MMX(d).d[0] == MMX(s).d[0]) ? 0xffffffff : 0;
-		MMX(d).d[1]=(MMX(d).d[1] == MMX(s).d[1]) ? 0xffffffff : 0;
-	} else {
-		MMX_REG s;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		MMX(d).d[0]=(MMX(d).d[0] == s.d[0]) ? 0xffffffff : 0;
-		MMX(d).d[1]=(MMX(d).d[1] == s.d[1]) ? 0xffffffff : 0;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_pcmpeqd(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
@@ -2514,336 +2179,97 @@ static void SSEOP(punpcklqdq_r128_rm128)()
 
 static void MMXOP(punpcklbw_r64_r64m32)() // Opcode 0f 60
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		UINT32 t;
-		int s,d;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		t=MMX(d).d[0];
-		MMX(d).b[0]=t & 0xff;
-		MMX(d).b[1]=MMX(s).b[0];
-		MMX(d).b[2]=(t >> 8) & 0xff;
-		MMX(d).b[3]=MMX(s).b[1];
-		MMX(d).b[4]=(t >> 16) & 0xff;
-		MMX(d).b[5]=MMX(s).b[2];
-		MMX(d).b[6]=(t >> 24) & 0xff;
-		MMX(d).b[7]=MMX(s).b[3];
-	} else {
-		UINT32 s,t;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		s = READ32(ea);
-		t=MMX(d).d[0];
-		MMX(d).b[0]=t & 0xff;
-		MMX(d).b[1]=s & 0xff;
-		MMX(d).b[2]=(t >> 8) & 0xff;
-		MMX(d).b[3]=(s >> 8) & 0xff;
-		MMX(d).b[4]=(t >> 16) & 0xff;
-		MMX(d).b[5]=(s >> 16) & 0xff;
-		MMX(d).b[6]=(t >> 24) & 0xff;
-		MMX(d).b[7]=(s >> 24) & 0xff;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM32(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_punpcklbw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(punpcklwd_r64_r64m32)() // Opcode 0f 61
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		UINT16 t;
-		int s,d;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		t=MMX(d).w[1];
-		MMX(d).w[0]=MMX(d).w[0];
-		MMX(d).w[1]=MMX(s).w[0];
-		MMX(d).w[2]=t;
-		MMX(d).w[3]=MMX(s).w[1];
-	} else {
-		UINT32 s;
-		UINT16 t;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		s = READ32(ea);
-		t=MMX(d).w[1];
-		MMX(d).w[0]=MMX(d).w[0];
-		MMX(d).w[1]=s & 0xffff;
-		MMX(d).w[2]=t;
-		MMX(d).w[3]=(s >> 16) & 0xffff;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM32(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_punpcklwd(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(punpckldq_r64_r64m32)() // Opcode 0f 62
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int s,d;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		MMX(d).d[0]=MMX(d).d[0];
-		MMX(d).d[1]=MMX(s).d[0];
-	} else {
-		UINT32 s;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		s = READ32(ea);
-		MMX(d).d[0]=MMX(d).d[0];
-		MMX(d).d[1]=s;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM32(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_punpckldq(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(packsswb_r64_rm64)() // Opcode 0f 63
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int s,d;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		MMX(d).c[0]=SaturatedSignedWordToSignedByte(MMX(d).s[0]);
-		MMX(d).c[1]=SaturatedSignedWordToSignedByte(MMX(d).s[1]);
-		MMX(d).c[2]=SaturatedSignedWordToSignedByte(MMX(d).s[2]);
-		MMX(d).c[3]=SaturatedSignedWordToSignedByte(MMX(d).s[3]);
-		MMX(d).c[4]=SaturatedSignedWordToSignedByte(MMX(s).s[0]);
-		MMX(d).c[5]=SaturatedSignedWordToSignedByte(MMX(s).s[1]);
-		MMX(d).c[6]=SaturatedSignedWordToSignedByte(MMX(s).s[2]);
-		MMX(d).c[7]=SaturatedSignedWordToSignedByte(MMX(s).s[3]);
-	} else {
-		MMX_REG s;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		MMX(d).c[0]=SaturatedSignedWordToSignedByte(MMX(d).s[0]);
-		MMX(d).c[1]=SaturatedSignedWordToSignedByte(MMX(d).s[1]);
-		MMX(d).c[2]=SaturatedSignedWordToSignedByte(MMX(d).s[2]);
-		MMX(d).c[3]=SaturatedSignedWordToSignedByte(MMX(d).s[3]);
-		MMX(d).c[4]=SaturatedSignedWordToSignedByte(s.s[0]);
-		MMX(d).c[5]=SaturatedSignedWordToSignedByte(s.s[1]);
-		MMX(d).c[6]=SaturatedSignedWordToSignedByte(s.s[2]);
-		MMX(d).c[7]=SaturatedSignedWordToSignedByte(s.s[3]);
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_packsswb(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(pcmpgtb_r64_rm64)() // Opcode 0f 64
 {
-	int c;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int s,d;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		for (c=0;c <= 7;c++)
-			MMX(d).b[c]=(MMX(d).c[c] > MMX(s).c[c]) ? 0xff : 0;
-	} else {
-		MMX_REG s;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		for (c=0;c <= 7;c++)
-			MMX(d).b[c]=(MMX(d).c[c] > s.c[c]) ? 0xff : 0;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_pcmpgtb(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(pcmpgtw_r64_rm64)() // Opcode 0f 65
 {
-	int c;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int s,d;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		for (c=0;c <= 3;c++)
-			MMX(d).w[c]=(MMX(d).s[c] > MMX(s).s[c]) ? 0xffff : 0;
-	} else {
-		MMX_REG s;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		for (c=0;c <= 3;c++)
-			MMX(d).w[c]=(MMX(d).s[c] > s.s[c]) ? 0xffff : 0;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_pcmpgtw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(pcmpgtd_r64_rm64)() // Opcode 0f 66
 {
-	int c;
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int s,d;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		for (c=0;c <= 1;c++)
-			MMX(d).d[c]=(MMX(d).i[c] > MMX(s).i[c]) ? 0xffffffff : 0;
-	} else {
-		MMX_REG s;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		for (c=0;c <= 1;c++)
-			MMX(d).d[c]=(MMX(d).i[c] > s.i[c]) ? 0xffffffff : 0;
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_pcmpgtd(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(packuswb_r64_rm64)() // Opcode 0f 67
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		MMX_REG ds, sd;
-		int s,d;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		ds.q = MMX(d).q;
-		sd.q = MMX(s).q;
-		MMX(d).b[0]=SaturatedSignedWordToUnsignedByte(ds.s[0]);
-		MMX(d).b[1]=SaturatedSignedWordToUnsignedByte(ds.s[1]);
-		MMX(d).b[2]=SaturatedSignedWordToUnsignedByte(ds.s[2]);
-		MMX(d).b[3]=SaturatedSignedWordToUnsignedByte(ds.s[3]);
-		MMX(d).b[4]=SaturatedSignedWordToUnsignedByte(sd.s[0]);
-		MMX(d).b[5]=SaturatedSignedWordToUnsignedByte(sd.s[1]);
-		MMX(d).b[6]=SaturatedSignedWordToUnsignedByte(sd.s[2]);
-		MMX(d).b[7]=SaturatedSignedWordToUnsignedByte(sd.s[3]);
-	} else {
-		MMX_REG s,t;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		t.q = MMX(d).q;
-		MMX(d).b[0]=SaturatedSignedWordToUnsignedByte(t.s[0]);
-		MMX(d).b[1]=SaturatedSignedWordToUnsignedByte(t.s[1]);
-		MMX(d).b[2]=SaturatedSignedWordToUnsignedByte(t.s[2]);
-		MMX(d).b[3]=SaturatedSignedWordToUnsignedByte(t.s[3]);
-		MMX(d).b[4]=SaturatedSignedWordToUnsignedByte(s.s[0]);
-		MMX(d).b[5]=SaturatedSignedWordToUnsignedByte(s.s[1]);
-		MMX(d).b[6]=SaturatedSignedWordToUnsignedByte(s.s[2]);
-		MMX(d).b[7]=SaturatedSignedWordToUnsignedByte(s.s[3]);
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_packuswb(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(punpckhbw_r64_rm64)() // Opcode 0f 68
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int s,d;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		MMX(d).b[0]=MMX(d).b[4];
-		MMX(d).b[1]=MMX(s).b[4];
-		MMX(d).b[2]=MMX(d).b[5];
-		MMX(d).b[3]=MMX(s).b[5];
-		MMX(d).b[4]=MMX(d).b[6];
-		MMX(d).b[5]=MMX(s).b[6];
-		MMX(d).b[6]=MMX(d).b[7];
-		MMX(d).b[7]=MMX(s).b[7];
-	} else {
-		MMX_REG s;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		MMX(d).b[0]=MMX(d).b[4];
-		MMX(d).b[1]=s.b[4];
-		MMX(d).b[2]=MMX(d).b[5];
-		MMX(d).b[3]=s.b[5];
-		MMX(d).b[4]=MMX(d).b[6];
-		MMX(d).b[5]=s.b[6];
-		MMX(d).b[6]=MMX(d).b[7];
-		MMX(d).b[7]=s.b[7];
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_punpckhbw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(punpckhwd_r64_rm64)() // Opcode 0f 69
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int s,d;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		MMX(d).w[0]=MMX(d).w[2];
-		MMX(d).w[1]=MMX(s).w[2];
-		MMX(d).w[2]=MMX(d).w[3];
-		MMX(d).w[3]=MMX(s).w[3];
-	} else {
-		MMX_REG s;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		MMX(d).w[0]=MMX(d).w[2];
-		MMX(d).w[1]=s.w[2];
-		MMX(d).w[2]=MMX(d).w[3];
-		MMX(d).w[3]=s.w[3];
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_punpckhwd(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(punpckhdq_r64_rm64)() // Opcode 0f 6a
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int s,d;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		MMX(d).d[0]=MMX(d).d[1];
-		MMX(d).d[1]=MMX(s).d[1];
-	} else {
-		MMX_REG s;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		MMX(d).d[0]=MMX(d).d[1];
-		MMX(d).d[1]=s.d[1];
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_punpckhdq(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
 static void MMXOP(packssdw_r64_rm64)() // Opcode 0f 6b
 {
-	MMXPROLOG();
-	UINT8 modrm = FETCH();
-	if( modrm >= 0xc0 ) {
-		int s,d;
-		INT32 t1, t2, t3, t4;
-		s=modrm & 0x7;
-		d=(modrm >> 3) & 0x7;
-		t1 = MMX(d).i[0];
-		t2 = MMX(d).i[1];
-		t3 = MMX(s).i[0];
-		t4 = MMX(s).i[1];
-		MMX(d).s[0] = SaturatedSignedDwordToSignedWord(t1);
-		MMX(d).s[1] = SaturatedSignedDwordToSignedWord(t2);
-		MMX(d).s[2] = SaturatedSignedDwordToSignedWord(t3);
-		MMX(d).s[3] = SaturatedSignedDwordToSignedWord(t4);
-	}
-	else {
-		MMX_REG s;
-		INT32 t1, t2;
-		int d=(modrm >> 3) & 0x7;
-		UINT32 ea = GetEA(modrm, 0);
-		READMMX(ea, s);
-		t1 = MMX(d).i[0];
-		t2 = MMX(d).i[1];
-		MMX(d).s[0] = SaturatedSignedDwordToSignedWord(t1);
-		MMX(d).s[1] = SaturatedSignedDwordToSignedWord(t2);
-		MMX(d).s[2] = SaturatedSignedDwordToSignedWord(s.i[0]);
-		MMX(d).s[3] = SaturatedSignedDwordToSignedWord(s.i[1]);
-	}
+	MMX_REG s;
+	UINT8 modrm = MMXFETCHRM64(s);
+	MMX((modrm >> 3) & 0x7).q=mmx_packssdw(MMX((modrm >> 3) & 0x7).q, s.q);
 	CYCLES(1);     // TODO: correct cycle count
 }
 
@@ -4040,17 +3466,17 @@ static void SSEOP(comiss_r128_r128m32)() // Opcode 0f 2f
 	}
 	m_OF=0;
 	m_SF=0;
-	m_AF=0;
+	ForceAF(0);
 	if (float32_is_nan(a) || float32_is_nan(b))
 	{
 		m_ZF = 1;
-		m_PF = 1;
+		ForcePF(1);
 		m_CF = 1;
 	}
 	else
 	{
 		m_ZF = 0;
-		m_PF = 0;
+		ForcePF(0);
 		m_CF = 0;
 		if (float32_eq(a, b))
 			m_ZF = 1;
@@ -4077,17 +3503,17 @@ static void SSEOP(comisd_r128_r128m64)() // Opcode 66 0f 2f
 	}
 	m_OF=0;
 	m_SF=0;
-	m_AF=0;
+	ForceAF(0);
 	if (float64_is_nan(a) || float64_is_nan(b))
 	{
 		m_ZF = 1;
-		m_PF = 1;
+		ForcePF(1);
 		m_CF = 1;
 	}
 	else
 	{
 		m_ZF = 0;
-		m_PF = 0;
+		ForcePF(0);
 		m_CF = 0;
 		if (float64_eq(a, b))
 			m_ZF = 1;
@@ -4114,17 +3540,17 @@ static void SSEOP(ucomiss_r128_r128m32)() // Opcode 0f 2e
 	}
 	m_OF=0;
 	m_SF=0;
-	m_AF=0;
+	ForceAF(0);
 	if (float32_is_nan(a) || float32_is_nan(b))
 	{
 		m_ZF = 1;
-		m_PF = 1;
+		ForcePF(1);
 		m_CF = 1;
 	}
 	else
 	{
 		m_ZF = 0;
-		m_PF = 0;
+		ForcePF(0);
 		m_CF = 0;
 		if (float32_eq(a, b))
 			m_ZF = 1;
@@ -4151,17 +3577,17 @@ static void SSEOP(ucomisd_r128_r128m64)() // Opcode 66 0f 2e
 	}
 	m_OF=0;
 	m_SF=0;
-	m_AF=0;
+	ForceAF(0);
 	if (float64_is_nan(a) || float64_is_nan(b))
 	{
 		m_ZF = 1;
-		m_PF = 1;
+		ForcePF(1);
 		m_CF = 1;
 	}
 	else
 	{
 		m_ZF = 0;
-		m_PF = 0;
+		ForcePF(0);
 		m_CF = 0;
 		if (float64_eq(a, b))
 			m_ZF = 1;
@@ -344,6 +344,121 @@ void x87_reset()
 }
 
 
+/*************************************
+ *
+ * Host FPU fast path
+ *
+ * With m_x87_fast set, FADD/FSUB/FMUL/FDIV are done with host double
+ * arithmetic while rounding to nearest in double precision, where the
+ * SoftFloat path rounds the operands to float64 and uses float64
+ * arithmetic. Operands must be zero or normal, between 2^-240 and 2^240
+ * and exact in 53 bits; anything else (denormals, infinities, NaNs,
+ * huge, tiny or longer values) goes through SoftFloat. Inside that range
+ * nothing can overflow or underflow, and the precision exception is found
+ * exactly with the error free transformations below, so the result and
+ * the flags are the same as SoftFloat's.
+ * FSQRT is not done here: SoftFloat computes it in extended precision
+ * whatever the precision control is.
+ *
+ *************************************/
+
+#define X87_HOST_ADD            0
+#define X87_HOST_SUB            1
+#define X87_HOST_MUL            2
+#define X87_HOST_DIV            3
+
+#define X87_HOST_EXP_RANGE      240
+
+INLINE int x87_host_operand(floatx80 fx, double *d)
+{
+	int exp = fx.high & 0x7fff;
+	UINT64 bits = (UINT64)(fx.high & 0x8000) << 48;
+
+	if (exp || fx.low)
+	{
+		if (!(fx.low & U64(0x8000000000000000)) || (fx.low & 0x7ff) || exp < 16383 - X87_HOST_EXP_RANGE || exp > 16383 + X87_HOST_EXP_RANGE)
+			return 0;
+		bits |= ((UINT64)(exp - 16383 + 1023) << 52) | ((fx.low >> 11) & U64(0x000fffffffffffff));
+	}
+	memcpy(d, &bits, sizeof(*d));
+	return 1;
+}
+
+// split a into two halves of 26 bits for the exact product below
+INLINE void x87_host_split(double a, double *hi, double *lo)
+{
+	double t = a * 134217729.0; // 2^27 + 1
+	*hi = t - (t - a);
+	*lo = a - *hi;
+}
+
+// rounding error of p = a * b, exact as long as nothing underflows
+INLINE double x87_host_mul_error(double a, double b, double p)
+{
+	double ah, al, bh, bl;
+
+	x87_host_split(a, &ah, &al);
+	x87_host_split(b, &bh, &bl);
+	return ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+}
+
+static int x87_host_arith(int op, floatx80 a, floatx80 b, floatx80 *result)
+{
+	double x, y, r, t;
+	int inexact = 0;
+	UINT64 bits;
+	int exp;
+
+	if (float_rounding_mode != float_round_nearest_even)
+		return 0;
+	if (((m_x87_cw >> X87_CW_PC_SHIFT) & X87_CW_PC_MASK) != X87_CW_PC_DOUBLE)
+		return 0;
+	if (!x87_host_operand(a, &x) || !x87_host_operand(b, &y))
+		return 0;
+
+	switch (op)
+	{
+		case X87_HOST_ADD:
+		case X87_HOST_SUB:
+			if (op == X87_HOST_SUB)
+				y = -y;
+			r = x + y;
+			t = r - x;
+			inexact |= ((x - (r - t)) + (y - t)) != 0;
+			break;
+		case X87_HOST_MUL:
+			r = x * y;
+			inexact |= x87_host_mul_error(x, y, r) != 0;
+			break;
+		case X87_HOST_DIV:
+			if (y == 0)
+				return 0;
+			r = x / y;
+			t = r * y;
+			inexact |= t != x || x87_host_mul_error(r, y, t) != 0;
+			break;
+		default:
+			return 0;
+	}
+
+	bits = *(UINT64*)&r;
+	exp = (bits >> 52) & 0x7ff;
+	result->high = (bits >> 48) & 0x8000;
+	if ((bits << 1) == 0)
+	{
+		result->low = 0;
+	}
+	else
+	{
+		result->high |= exp - 1023 + 16383;
+		result->low = U64(0x8000000000000000) | (bits << 11);
+	}
+	if (inexact)
+		float_exception_flags |= float_flag_inexact;
+	return 1;
+}
+
+
 /*************************************
  *
  * Core arithmetic
@@ -354,6 +469,9 @@ static floatx80 x87_add(floatx80 a, floatx80 b)
 {
 	floatx80 result = { 0 };
 
+	if (m_x87_fast && x87_host_arith(X87_HOST_ADD, a, b, &result))
+		return result;
+
 	switch ((m_x87_cw >> X87_CW_PC_SHIFT) & X87_CW_PC_MASK)
 	{
 		case X87_CW_PC_SINGLE:
@@ -384,6 +502,9 @@ static floatx80 x87_sub(floatx80 a, floatx80 b)
 {
 	floatx80 result = { 0 };
 
+	if (m_x87_fast && x87_host_arith(X87_HOST_SUB, a, b, &result))
+		return result;
+
 	switch ((m_x87_cw >> X87_CW_PC_SHIFT) & X87_CW_PC_MASK)
 	{
 		case X87_CW_PC_SINGLE:
@@ -414,6 +535,9 @@ static floatx80 x87_mul(floatx80 a, floatx80 b)
 {
 	floatx80 val = { 0 };
 
+	if (m_x87_fast && x87_host_arith(X87_HOST_MUL, a, b, &val))
+		return val;
+
 	switch ((m_x87_cw >> X87_CW_PC_SHIFT) & X87_CW_PC_MASK)
 	{
 		case X87_CW_PC_SINGLE:
@@ -445,6 +569,9 @@ static floatx80 x87_div(floatx80 a, floatx80 b)
 {
 	floatx80 val = { 0 };
 
+	if (m_x87_fast && x87_host_arith(X87_HOST_DIV, a, b, &val))
+		return val;
+
 	switch ((m_x87_cw >> X87_CW_PC_SHIFT) & X87_CW_PC_MASK)
 	{
 		case X87_CW_PC_SINGLE:
@@ -2056,7 +2183,7 @@ void x87_fcmovu_sti(UINT8 modrm)
 	floatx80 result;
 	int i = modrm & 7;
 
-	if (m_PF == 1)
+	if (GetPF() == 1)
 	{
 		if (X87_IS_ST_EMPTY(i))
 		{
@@ -2152,7 +2279,7 @@ void x87_fcmovnu_sti(UINT8 modrm)
 	floatx80 result;
 	int i = modrm & 7;
 
-	if (m_PF == 0)
+	if (GetPF() == 0)
 	{
 		if (X87_IS_ST_EMPTY(i))
 		{
@@ -4013,7 +4140,7 @@ void x87_fcomi_sti(UINT8 modrm)
 	{
 		x87_set_stack_underflow();
 		m_ZF = 1;
-		m_PF = 1;
+		ForcePF(1);
 		m_CF = 1;
 	}
 	else
@@ -4026,14 +4153,14 @@ void x87_fcomi_sti(UINT8 modrm)
 		if (floatx80_is_nan(a) || floatx80_is_nan(b))
 		{
 			m_ZF = 1;
-			m_PF = 1;
+			ForcePF(1);
 			m_CF = 1;
 			m_x87_sw |= X87_SW_IE;
 		}
 		else
 		{
 			m_ZF = 0;
-			m_PF = 0;
+			ForcePF(0);
 			m_CF = 0;
 
 			if (floatx80_eq(a, b))
@@ -4057,7 +4184,7 @@ void x87_fcomip_sti(UINT8 modrm)
 	{
 		x87_set_stack_underflow();
 		m_ZF = 1;
-		m_PF = 1;
+		ForcePF(1);
 		m_CF = 1;
 	}
 	else
@@ -4070,14 +4197,14 @@ void x87_fcomip_sti(UINT8 modrm)
 		if (floatx80_is_nan(a) || floatx80_is_nan(b))
 		{
 			m_ZF = 1;
-			m_PF = 1;
+			ForcePF(1);
 			m_CF = 1;
 			m_x87_sw |= X87_SW_IE;
 		}
 		else
 		{
 			m_ZF = 0;
-			m_PF = 0;
+			ForcePF(0);
 			m_CF = 0;
 
 			if (floatx80_eq(a, b))
@@ -4102,7 +4229,7 @@ void x87_fucomi_sti(UINT8 modrm)
 	{
 		x87_set_stack_underflow();
 		m_ZF = 1;
-		m_PF = 1;
+		ForcePF(1);
 		m_CF = 1;
 	}
 	else
@@ -4115,20 +4242,20 @@ void x87_fucomi_sti(UINT8 modrm)
 		if (floatx80_is_quiet_nan(a) || floatx80_is_quiet_nan(b))
 		{
 			m_ZF = 1;
-			m_PF = 1;
+			ForcePF(1);
 			m_CF = 1;
 		}
 		else if (floatx80_is_nan(a) || floatx80_is_nan(b))
 		{
 			m_ZF = 1;
-			m_PF = 1;
+			ForcePF(1);
 			m_CF = 1;
 			m_x87_sw |= X87_SW_IE;
 		}
 		else
 		{
 			m_ZF = 0;
-			m_PF = 0;
+			ForcePF(0);
 			m_CF = 0;
 
 			if (floatx80_eq(a, b))
@@ -4152,7 +4279,7 @@ void x87_fucomip_sti(UINT8 modrm)
 	{
 		x87_set_stack_underflow();
 		m_ZF = 1;
-		m_PF = 1;
+		ForcePF(1);
 		m_CF = 1;
 	}
 	else
@@ -4165,20 +4292,20 @@ void x87_fucomip_sti(UINT8 modrm)
 		if (floatx80_is_quiet_nan(a) || floatx80_is_quiet_nan(b))
 		{
 			m_ZF = 1;
-			m_PF = 1;
+			ForcePF(1);
 			m_CF = 1;
 		}
 		else if (floatx80_is_nan(a) || floatx80_is_nan(b))
 		{
 			m_ZF = 1;
-			m_PF = 1;
+			ForcePF(1);
 			m_CF = 1;
 			m_x87_sw |= X87_SW_IE;
 		}
 		else
 		{
 			m_ZF = 0;
-			m_PF = 0;
+			ForcePF(0);
 			m_CF = 0;
 
 			if (floatx80_eq(a, b))
@@ -4487,7 +4614,7 @@ extern "C"
 	}
     __declspec(dllexport) void fsave(char *ptr)
     {
-        UINT32 ea = (UINT32)ptr;
+        UINT32 ea = (UINT32)(size_t)ptr;
         *(UINT16*)(ptr + 0) = m_x87_cw;
         *(UINT16*)(ptr + 2) = m_x87_sw;
         *(UINT16*)(ptr + 4) = m_x87_tw;
@@ -4496,7 +4623,7 @@ extern "C"
     }
     __declspec(dllexport) void frstor(const char *ptr)
     {
-        UINT32 ea = (UINT32)ptr;
+        UINT32 ea = (UINT32)(size_t)ptr;
         x87_write_cw(READ16(ea));
         m_x87_sw = READ16(ea + 2);
         m_x87_tw = READ16(ea + 4);
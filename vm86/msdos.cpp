@@ -37,405 +37,7 @@ void change_console_size_to_80x25();
 	MAME i86/i386
 ---------------------------------------------------------------------------- */
 
-#define SUPPORT_DISASSEMBLER
-
-#if defined(HAS_I86)
-	#define CPU_MODEL i8086
-#elif defined(HAS_I186)
-	#define CPU_MODEL i80186
-#elif defined(HAS_I286)
-	#define CPU_MODEL i80286
-#elif defined(HAS_I386)
-	#define CPU_MODEL i386
-#else
-	#if defined(HAS_I386SX)
-		#define CPU_MODEL i386SX
-	#else
-		#if defined(HAS_I486)
-			#define CPU_MODEL i486
-		#else
-			#if defined(HAS_PENTIUM)
-				#define CPU_MODEL pentium
-			#elif defined(HAS_MEDIAGX)
-				#define CPU_MODEL mediagx
-			#elif defined(HAS_PENTIUM_PRO)
-				#define CPU_MODEL pentium_pro
-			#elif defined(HAS_PENTIUM_MMX)
-				#define CPU_MODEL pentium_mmx
-			#elif defined(HAS_PENTIUM2)
-				#define CPU_MODEL pentium2
-			#elif defined(HAS_PENTIUM3)
-				#define CPU_MODEL pentium3
-			#elif defined(HAS_PENTIUM4)
-				#define CPU_MODEL pentium4
-			#endif
-			#define SUPPORT_RDTSC
-		#endif
-		#define SUPPORT_FPU
-	#endif
-	#define HAS_I386
-#endif
-
-#ifndef __BIG_ENDIAN__
-#define LSB_FIRST
-#endif
-
-#ifndef INLINE
-#define INLINE inline
-#endif
-#define U64(v) UINT64(v)
-
-//#ifdef _DEBUG
-void logerror(const char *format, ...)
-{
-	va_list arg;
-
-	va_start(arg, format);
-	vfprintf(stderr, format, arg);
-	va_end(arg);
-}
-//#else
-//#define logerror(...)
-//#endif
-//#define logerror(...) fprintf(stderr, __VA_ARGS__)
-//#define logerror(...)
-//#define popmessage(...) fprintf(stderr, __VA_ARGS__)
-#define popmessage(...)
-
-/*****************************************************************************/
-/* src/emu/devcpu.h */
-
-// CPU interface functions
-#define CPU_INIT_NAME(name)			cpu_init_##name
-#define CPU_INIT(name)				void CPU_INIT_NAME(name)()
-#define CPU_INIT_CALL(name)			CPU_INIT_NAME(name)()
-
-#define CPU_RESET_NAME(name)			cpu_reset_##name
-#define CPU_RESET(name)				void CPU_RESET_NAME(name)()
-#define CPU_RESET_CALL(name)			CPU_RESET_NAME(name)()
-
-#define CPU_EXECUTE_NAME(name)			cpu_execute_##name
-#define CPU_EXECUTE(name)			void CPU_EXECUTE_NAME(name)()
-#define CPU_EXECUTE_CALL(name)			CPU_EXECUTE_NAME(name)()
-
-#define CPU_TRANSLATE_NAME(name)		cpu_translate_##name
-#define CPU_TRANSLATE(name)			int CPU_TRANSLATE_NAME(name)(address_spacenum space, int intention, offs_t *address)
-#define CPU_TRANSLATE_CALL(name)		CPU_TRANSLATE_NAME(name)(space, intention, address)
-
-#define CPU_DISASSEMBLE_NAME(name)		cpu_disassemble_##name
-#define CPU_DISASSEMBLE(name)			int CPU_DISASSEMBLE_NAME(name)(char *buffer, offs_t eip, const UINT8 *oprom)
-#define CPU_DISASSEMBLE_CALL(name)		CPU_DISASSEMBLE_NAME(name)(buffer, eip, oprom)
-
-/*****************************************************************************/
-/* src/emu/didisasm.h */
-
-// Disassembler constants
-const UINT32 DASMFLAG_SUPPORTED     = 0x80000000;   // are disassembly flags supported?
-const UINT32 DASMFLAG_STEP_OUT      = 0x40000000;   // this instruction should be the end of a step out sequence
-const UINT32 DASMFLAG_STEP_OVER     = 0x20000000;   // this instruction should be stepped over by setting a breakpoint afterwards
-const UINT32 DASMFLAG_OVERINSTMASK  = 0x18000000;   // number of extra instructions to skip when stepping over
-const UINT32 DASMFLAG_OVERINSTSHIFT = 27;           // bits to shift after masking to get the value
-const UINT32 DASMFLAG_LENGTHMASK    = 0x0000ffff;   // the low 16-bits contain the actual length
-
-/*****************************************************************************/
-/* src/emu/diexec.h */
-
-// I/O line states
-enum line_state
-{
-	CLEAR_LINE = 0,				// clear (a fired or held) line
-	ASSERT_LINE,				// assert an interrupt immediately
-	HOLD_LINE,				// hold interrupt line until acknowledged
-	PULSE_LINE				// pulse interrupt line instantaneously (only for NMI, RESET)
-};
-
-// I/O line definitions
-enum
-{
-	INPUT_LINE_IRQ = 0,
-	INPUT_LINE_NMI
-};
-
-/*****************************************************************************/
-/* src/emu/dimemory.h */
-
-// Translation intentions
-const int TRANSLATE_TYPE_MASK       = 0x03;     // read write or fetch
-const int TRANSLATE_USER_MASK       = 0x04;     // user mode or fully privileged
-const int TRANSLATE_DEBUG_MASK      = 0x08;     // debug mode (no side effects)
-
-const int TRANSLATE_READ            = 0;        // translate for read
-const int TRANSLATE_WRITE           = 1;        // translate for write
-const int TRANSLATE_FETCH           = 2;        // translate for instruction fetch
-const int TRANSLATE_READ_USER       = (TRANSLATE_READ | TRANSLATE_USER_MASK);
-const int TRANSLATE_WRITE_USER      = (TRANSLATE_WRITE | TRANSLATE_USER_MASK);
-const int TRANSLATE_FETCH_USER      = (TRANSLATE_FETCH | TRANSLATE_USER_MASK);
-const int TRANSLATE_READ_DEBUG      = (TRANSLATE_READ | TRANSLATE_DEBUG_MASK);
-const int TRANSLATE_WRITE_DEBUG     = (TRANSLATE_WRITE | TRANSLATE_DEBUG_MASK);
-const int TRANSLATE_FETCH_DEBUG     = (TRANSLATE_FETCH | TRANSLATE_DEBUG_MASK);
-
-/*****************************************************************************/
-/* src/emu/emucore.h */
-
-// constants for expression endianness
-enum endianness_t
-{
-	ENDIANNESS_LITTLE,
-	ENDIANNESS_BIG
-};
-
-// declare native endianness to be one or the other
-#ifdef LSB_FIRST
-const endianness_t ENDIANNESS_NATIVE = ENDIANNESS_LITTLE;
-#else
-const endianness_t ENDIANNESS_NATIVE = ENDIANNESS_BIG;
-#endif
-
-// endian-based value: first value is if 'endian' is little-endian, second is if 'endian' is big-endian
-#define ENDIAN_VALUE_LE_BE(endian,leval,beval)	(((endian) == ENDIANNESS_LITTLE) ? (leval) : (beval))
-
-// endian-based value: first value is if native endianness is little-endian, second is if native is big-endian
-#define NATIVE_ENDIAN_VALUE_LE_BE(leval,beval)	ENDIAN_VALUE_LE_BE(ENDIANNESS_NATIVE, leval, beval)
-
-// endian-based value: first value is if 'endian' matches native, second is if 'endian' doesn't match native
-#define ENDIAN_VALUE_NE_NNE(endian,leval,beval)	(((endian) == ENDIANNESS_NATIVE) ? (neval) : (nneval))
-
-/*****************************************************************************/
-/* src/emu/memory.h */
-
-// address spaces
-enum address_spacenum
-{
-	AS_0,                           // first address space
-	AS_1,                           // second address space
-	AS_2,                           // third address space
-	AS_3,                           // fourth address space
-	ADDRESS_SPACES,                 // maximum number of address spaces
-
-	// alternate address space names for common use
-	AS_PROGRAM = AS_0,              // program address space
-	AS_DATA = AS_1,                 // data address space
-	AS_IO = AS_2                    // I/O address space
-};
-
-// offsets and addresses are 32-bit (for now...)
-typedef UINT32	offs_t;
-extern "C" void *wine_ldt_get_ptr(unsigned short sel, unsigned long offset);
-void *read_ptr(offs_t byteaddress)
-{
-	return nullptr;
-}
-// read accessors
-UINT8 read_byte(offs_t byteaddress)
-{
-#if defined(HAS_I386)
-	if(byteaddress < MAX_MEM) {
-		return mem[byteaddress];
-//	} else if((byteaddress & 0xfffffff0) == 0xfffffff0) {
-//		return read_byte(byteaddress & 0xfffff);
-	}
-	return 0;
-#else
-	return mem[byteaddress];
-#endif
-}
-
-UINT16 read_word(offs_t byteaddress)
-{
-#if defined(HAS_I386)
-	if(byteaddress < MAX_MEM - 1) {
-		return *(UINT16 *)(mem + byteaddress);
-//	} else if((byteaddress & 0xfffffff0) == 0xfffffff0) {
-//		return read_word(byteaddress & 0xfffff);
-	}
-	return 0;
-#else
-	return *(UINT16 *)(mem + byteaddress);
-#endif
-}
-
-UINT32 read_dword(offs_t byteaddress)
-{
-#if defined(HAS_I386)
-	if(byteaddress < MAX_MEM - 3) {
-		return *(UINT32 *)(mem + byteaddress);
-//	} else if((byteaddress & 0xfffffff0) == 0xfffffff0) {
-//		return read_dword(byteaddress & 0xfffff);
-	}
-	return 0;
-#else
-	return *(UINT32 *)(mem + byteaddress);
-#endif
-}
-
-void write_byte(offs_t byteaddress, UINT8 data)
-{
-	/*
-	if(byteaddress < MEMORY_END) {
-		mem[byteaddress] = data;
-	} else if(byteaddress >= text_vram_top_address && byteaddress < text_vram_end_address) {
-		if(!restore_console_on_exit && (scr_width != 80 || scr_height != 25)) {
-			change_console_size_to_80x25();
-			restore_console_on_exit = true;
-		}
-		write_text_vram_byte(byteaddress - text_vram_top_address, data);
-		mem[byteaddress] = data;
-	} else if(byteaddress >= shadow_buffer_top_address && byteaddress < shadow_buffer_end_address) {
-		if(int_10h_feh_called && !int_10h_ffh_called) {
-			write_text_vram_byte(byteaddress - shadow_buffer_top_address, data);
-		}
-		mem[byteaddress] = data;
-#if defined(HAS_I386)
-	} else if(byteaddress < MAX_MEM) {
-#else
-	} else {
-#endif
-		mem[byteaddress] = data;
-	}
-	*/
-	mem[byteaddress] = data;
-}
-
-void write_word(offs_t byteaddress, UINT16 data)
-{
-	*(UINT16 *)(mem + byteaddress) = data;
-	/*
-	if(byteaddress < MEMORY_END) {
-		*(UINT16 *)(mem + byteaddress) = data;
-	} else if(byteaddress >= text_vram_top_address && byteaddress < text_vram_end_address) {
-		if(!restore_console_on_exit && (scr_width != 80 || scr_height != 25)) {
-			change_console_size_to_80x25();
-			restore_console_on_exit = true;
-		}
-		write_text_vram_word(byteaddress - text_vram_top_address, data);
-		*(UINT16 *)(mem + byteaddress) = data;
-	} else if(byteaddress >= shadow_buffer_top_address && byteaddress < shadow_buffer_end_address) {
-		if(int_10h_feh_called && !int_10h_ffh_called) {
-			write_text_vram_word(byteaddress - shadow_buffer_top_address, data);
-		}
-		*(UINT16 *)(mem + byteaddress) = data;
-#if defined(HAS_I386)
-	} else if(byteaddress < MAX_MEM - 1) {
-#else
-	} else {
-#endif
-		*(UINT16 *)(mem + byteaddress) = data;
-	}*/
-}
-
-void write_dword(offs_t byteaddress, UINT32 data)
-{
-	*(UINT32 *)(mem + byteaddress) = data;
-	/*
-	if(byteaddress < MEMORY_END) {
-		*(UINT32 *)(mem + byteaddress) = data;
-	} else if(byteaddress >= text_vram_top_address && byteaddress < text_vram_end_address) {
-		if(!restore_console_on_exit && (scr_width != 80 || scr_height != 25)) {
-			change_console_size_to_80x25();
-			restore_console_on_exit = true;
-		}
-		write_text_vram_dword(byteaddress - text_vram_top_address, data);
-		*(UINT32 *)(mem + byteaddress) = data;
-	} else if(byteaddress >= shadow_buffer_top_address && byteaddress < shadow_buffer_end_address) {
-		if(int_10h_feh_called && !int_10h_ffh_called) {
-			write_text_vram_dword(byteaddress - shadow_buffer_top_address, data);
-		}
-		*(UINT32 *)(mem + byteaddress) = data;
-#if defined(HAS_I386)
-	} else if(byteaddress < MAX_MEM - 3) {
-#else
-	} else {
-#endif
-		*(UINT32 *)(mem + byteaddress) = data;
-	}
-	*/
-}
-
-#define read_decrypted_byte read_byte
-#define read_decrypted_word read_word
-#define read_decrypted_dword read_dword
-
-#define read_raw_byte read_byte
-#define write_raw_byte write_byte
-
-#define read_word_unaligned read_word
-#define write_word_unaligned write_word
-
-#define read_io_word_unaligned read_io_word
-#define write_io_word_unaligned write_io_word
-
-UINT8 read_io_byte(offs_t byteaddress);
-UINT16 read_io_word(offs_t byteaddress);
-UINT32 read_io_dword(offs_t byteaddress);
-
-void write_io_byte(offs_t byteaddress, UINT8 data);
-void write_io_word(offs_t byteaddress, UINT16 data);
-void write_io_dword(offs_t byteaddress, UINT32 data);
-
-/*****************************************************************************/
-/* src/osd/osdcomm.h */
-
-/* Highly useful macro for compile-time knowledge of an array size */
-#define ARRAY_LENGTH(x)     (sizeof(x) / sizeof(x[0]))
-
-#if defined(HAS_I386)
-	static CPU_TRANSLATE(i386);
-	#include "mame/lib/softfloat/softfloat.c"
-	#include "mame/emu/cpu/i386/i386.c"
-	#include "mame/emu/cpu/vtlb.c"
-#elif defined(HAS_I286)
-	#include "mame/emu/cpu/i86/i286.c"
-#else
-	#include "mame/emu/cpu/i86/i86.c"
-#endif
-#ifdef SUPPORT_DISASSEMBLER
-	#include "mame/emu/cpu/i386/i386dasm.c"
-	bool dasm = false;
-#endif
-
-#if defined(HAS_I386)
-	#define SREG(x)				m_sreg[x].selector
-	#define SREG_BASE(x)			m_sreg[x].base
-
-	int cpu_type, cpu_step;
-#else
-	#define REG8(x)				m_regs.b[x]
-	#define REG16(x)			m_regs.w[x]
-	#define SREG(x)				m_sregs[x]
-	#define SREG_BASE(x)			m_base[x]
-	#define m_CF				m_CarryVal
-	#define m_a20_mask			AMASK
-	//#define i386_load_segment_descriptor(x)	m_base[x] = SegBase(x)
-	void load_segment_descriptor_wine(int sreg);
-#define i386_load_segment_descriptor(x) load_segment_descriptor_wine(x)
-	#if defined(HAS_I286)
-		#define i386_set_a20_line(x)	i80286_set_a20_line(x)
-	#else
-		#define i386_set_a20_line(x)
-	#endif
-	#define i386_set_irq_line(x, y)		set_irq_line(x, y)
-#endif
-
-void i386_jmp_far(UINT16 selector, UINT32 address)
-{
-#if defined(HAS_I386)
-	if(PROTECTED_MODE && !V8086_MODE) {
-		i386_protected_mode_jump(selector, address, 1, m_operand_size);
-	} else {
-		SREG(CS) = selector;
-		m_performed_intersegment_jump = 1;
-		i386_load_segment_descriptor(CS);
-		m_eip = address;
-		CHANGE_PC(m_eip);
-	}
-#elif defined(HAS_I286)
-	i80286_code_descriptor(selector, address, 1);
-#else
-	SREG(CS) = selector;
-	i386_load_segment_descriptor(CS);
-	m_pc = (SREG_BASE(CS) + address) & m_a20_mask;
-#endif
-}
+#include "vm86cpu.cpp"
 
 /* ----------------------------------------------------------------------------
 MS-DOS virtual machine
@@ -524,47 +126,6 @@ extern "C"
 #define EXCEPTION_PROTECTED_MODE       0x80020100
     //kenel16_private.h
 #include "../krnl386/kernel16_private.h"
-#define KRNL386 "krnl386.exe16"
-	PVOID dynamic_setWOW32Reserved(PVOID w)
-	{
-		static PVOID(*setWOW32Reserved)(PVOID);
-		if (!setWOW32Reserved)
-		{
-			HMODULE krnl386 = LoadLibraryA(KRNL386);
-			setWOW32Reserved = (PVOID(*)(PVOID))GetProcAddress(krnl386, "setWOW32Reserved");
-		}
-		return setWOW32Reserved(w);
-	}
-	PVOID dynamic_getWOW32Reserved()
-	{
-		static PVOID(*getWOW32Reserved)();
-		if (!getWOW32Reserved)
-		{
-			HMODULE krnl386 = LoadLibraryA(KRNL386);
-			getWOW32Reserved = (PVOID(*)())GetProcAddress(krnl386, "getWOW32Reserved");
-		}
-		return getWOW32Reserved();
-	}
-    WINE_VM86_TEB_INFO *dynamic_getGdiTebBatch()
-    {
-        static WINE_VM86_TEB_INFO*(*getGdiTebBatch)();
-        if (!getGdiTebBatch)
-        {
-            HMODULE krnl386 = LoadLibraryA(KRNL386);
-            getGdiTebBatch = (WINE_VM86_TEB_INFO*(*)())GetProcAddress(krnl386, "getGdiTebBatch");
-        }
-        return getGdiTebBatch();
-    }
-	void dynamic__wine_call_int_handler(CONTEXT *context, BYTE intnum)
-	{
-		static void(*__wine_call_int_handler)(CONTEXT *context, BYTE intnum);
-		if (!__wine_call_int_handler)
-		{
-			HMODULE krnl386 = LoadLibraryA(KRNL386);
-			__wine_call_int_handler = (void(*)(CONTEXT *context, BYTE intnum))GetProcAddress(krnl386, "__wine_call_int_handler");
-		}
-		__wine_call_int_handler(context, intnum);
-	}
     _declspec(dllimport) LDT_ENTRY wine_ldt[8192];
 	/***********************************************************************
 	*           SELECTOR_SetEntries
@@ -609,57 +170,12 @@ extern "C"
 		}
 		return sel;
 	}
-	void save_context(CONTEXT *context)
-	{
-		context->Eax = REG32(EAX);
-		context->Ecx = REG32(ECX);
-		context->Edx = REG32(EDX);
-		context->Ebx = REG32(EBX);
-		context->Esp = REG32(ESP);
-		context->Ebp = REG32(EBP);
-		context->Esi = REG32(ESI);
-		context->Edi = REG32(EDI);
-		context->Ebp = REG32(EBP);
-		context->Eip = m_eip;
-		context->SegEs = SREG(ES);
-		context->SegCs = SREG(CS);
-		context->SegSs = SREG(SS);
-		context->SegDs = SREG(DS);
-		context->SegFs = SREG(FS);
-		context->SegGs = SREG(GS);
-        context->EFlags = m_eflags;// &~0x20000;
-		dynamic_setWOW32Reserved((PVOID)(SREG(SS) << 16 | REG16(SP)));
-	}
-	void load_context(CONTEXT *context)
-	{
-		REG32(EAX) = (DWORD)context->Eax;
-		REG32(ECX) = (DWORD)context->Ecx;
-		REG32(EDX) = (DWORD)context->Edx;
-		REG32(EBX) = (DWORD)context->Ebx;
-		REG32(ESP) = (DWORD)context->Esp;
-		REG32(EBP) = (DWORD)context->Ebp;
-		REG32(ESI) = (DWORD)context->Esi;
-		REG32(EDI) = (DWORD)context->Edi;
-		REG32(EBP) = (DWORD)context->Ebp;
-		SREG(ES) = (WORD)context->SegEs;
-		SREG(CS) = (WORD)context->SegCs;
-		SREG(SS) = (WORD)context->SegSs;
-		SREG(DS) = (WORD)context->SegDs;//ES, CS, SS, DS
-		//ES, CS, SS, DS, FS, GS
-		SREG(FS) = (WORD)context->SegFs;
-		SREG(GS) = (WORD)context->SegGs;
-		i386_load_segment_descriptor(ES);
-		i386_load_segment_descriptor(SS);
-		i386_load_segment_descriptor(DS);
-		i386_load_segment_descriptor(FS);
-		i386_load_segment_descriptor(GS);
-		m_eip = context->Eip;
-		i386_jmp_far(SREG(CS), context->Eip);
-		set_flags(context->EFlags);
-	}
+#include "vm86ctx.cpp"
+#include "vm86seg.cpp"
 	void WINAPI DOSVM_Int21Handler(CONTEXT *context);
 	unsigned char table[256 * 4 + 2 + 0x8 * 256] = { 0xcf };
 	unsigned char iret[256] = { 0xcf };
+#include "vm86trap.cpp"
 	WORD SELECTOR_AllocBlock(const void *base, DWORD size, unsigned char flags);
 #include <imagehlp.h>
 
@@ -707,8 +223,14 @@ extern "C"
 		capture_stack_trace();
 		return EXCEPTION_CONTINUE_SEARCH;
 	}
+#include "vm86rec.cpp"
+	//run the core through its block cache (i386blk.c), else one instruction at a time
+	bool block_cache = true;
+	//call the argument conversion functions generated by convspec instead of relay_call_from_16
+	bool direct_relay = false;
 	__declspec(dllexport) BOOL init_vm86(BOOL is_vm86)
 	{
+		resolve_krnl386_exports();
 		AddVectoredExceptionHandler(TRUE, vm86_vectored_exception_handler);
 		WORD sel = SELECTOR_AllocBlock(iret, 256, WINE_LDT_FLAGS_CODE);
 		CPU_INIT_CALL(CPU_MODEL);
@@ -716,6 +238,30 @@ extern "C"
 		build_x87_opcode_table();
 		build_opcode_table(OP_I386 | OP_FPU);
 		CPU_RESET_CALL(CPU_MODEL);
+		i386_block_set_event(vm86_block_event);
+		{
+			typedef DWORD(WINAPI *krnl386_get_config_int_t)(LPCSTR appname, LPCSTR keyname, INT def);
+			krnl386_get_config_int_t krnl386_get_config_int = (krnl386_get_config_int_t)GetProcAddress(LoadLibraryA(KRNL386), "krnl386_get_config_int");
+			typedef DWORD(WINAPI *krnl386_get_config_string_t)(LPCSTR appname, LPCSTR keyname, LPCSTR def, LPSTR ret, DWORD size);
+			krnl386_get_config_string_t krnl386_get_config_string = (krnl386_get_config_string_t)GetProcAddress(LoadLibraryA(KRNL386), "krnl386_get_config_string");
+			m_x87_fast = krnl386_get_config_int && krnl386_get_config_int("otvdm", "FastFPU", FALSE);
+			block_cache = !krnl386_get_config_int || krnl386_get_config_int("otvdm", "BlockCache", TRUE);
+			direct_relay = krnl386_get_config_int && krnl386_get_config_int("otvdm", "DirectRelay", FALSE);
+			if (krnl386_get_config_int && krnl386_get_config_int("otvdm", "Profile", FALSE))
+			{
+				char path[MAX_PATH] = "otvdm_profile";
+				if (krnl386_get_config_string)
+					krnl386_get_config_string("otvdm", "ProfileFile", "otvdm_profile", path, sizeof(path));
+				i386_profile_init(path, (BOOL(*)(WORD, char *, int, WORD *))GetProcAddress(LoadLibraryA(KRNL386), "vm_debug_get_segment_name"));
+				atexit(i386_profile_dump);
+			}
+			char record[MAX_PATH] = "";
+			if (krnl386_get_config_string)
+				krnl386_get_config_string("otvdm", "Record", "", record, sizeof(record));
+			//only protected mode is recorded
+			if (record[0] && !is_vm86)
+				vm86_record_init(record);
+		}
         UINT8 *base = 0;//mem;
 		m_idtr.base = (UINT32)(table - base);
         m_ldtr.limit = 65535;
@@ -732,6 +278,8 @@ extern "C"
         wine_ldt[4].HighWord.Bits.Granularity = 1;
         wine_ldt[4].HighWord.Bits.Dpl = m_CPL;
 		memset(iret, 0xcf, 256);
+		vm86_set_trap((UINT32)iret);
+		vm86_set_trap((UINT32)iret + 255);
 		for (int i = 0; i < 256; i++)
 		{
 			*(WORD*)&table[i * 4 + 2] = sel;
@@ -876,33 +424,7 @@ extern "C"
 		return context.Eax | context.Edx << 16;
 	}
 	UINT old_eip = 0;
-	struct dasm_buffer
-	{
-		size_t index;
-		size_t current_size = 0;
-		const size_t size = 1000;
-		std::vector<char[1000]> buffer;
-		dasm_buffer(size_t cap) : buffer(cap), size(cap)
-		{
-
-		}
-		char *get_current()
-		{
-			char *buf = buffer[index];
-			buf[0] = '\0';
-			current_size++;
-			index = (index + 1) % size;
-			return buf;
-		}
-		void dump()
-		{
-			size_t base = current_size < size ? 0 : (index + size) % size;
-			for (int i = 0; i < current_size && i < size; i++)
-			{
-				fprintf(stderr, "%s", buffer[(base + i) % size]);
-			}
-		}
-	};
+#include "vm86trace.cpp"
 	struct dasm_buffer dasm_buffer(8000);
 	//for debug
 	__declspec(dllexport) void dasm_buffer_dump()
@@ -941,6 +463,7 @@ extern "C"
         WORD cs = POP16();
         WORD flags = POP16();
         DWORD ret = pih(num);
+        i386_block_flush();
         if (ret)
         {
             //TODO:arguments?
@@ -1041,6 +564,11 @@ extern "C"
 			m_IOP1 = 1;
 			m_IOP2 = 1;
 			m_eflags |= 0x3000;
+			i386_block_flush();
+			if (vm86_record_file)
+				vm86_record_resume(VM86REC_ENTER);
+			if (m_profile)
+				i386_profile_switch(true);
 			DWORD ret_addr = 0;
 			//IOPL = 3;
 			if (cbArgs >= 2)
@@ -1048,20 +576,33 @@ extern "C"
 				unsigned char *stack = (unsigned char*)i386_translate(SS, REG16(SP), 0);
 				ret_addr = *(DWORD*)stack;
 			}
+			//the same two thunks on every call
+			vm86_set_trap((UINT32)from16_reg);
+			vm86_set_trap((UINT32)__wine_call_from_16);
             bool isVM86mode = false;
+            //per-thread, so it stays valid for the whole call
+            WINE_VM86_TEB_INFO *teb_info = dynamic_getGdiTebBatch();
 			//dasm = true;
 			while (!m_halted) {
 				if ((m_eip & 0xFFFF) == (ret_addr & 0xFFFF) && SREG(CS) == ret_addr >> 16)
 				{
 					break;//return VM
 				}
+				//the iret stubs and the from16 thunks live on trap pages
+				bool trap = vm86_is_trap(m_pc);
 				bool reg = false;
-				if (m_pc >= (UINT)iret && m_pc <= (UINT)iret + 255)
+				if (trap && m_pc >= (UINT)iret && m_pc <= (UINT)iret + 255)
 				{
 					CONTEXT context;
                     {
                         int num = m_pc - (UINT)iret;
                         const char *name = NULL;
+                        if (m_profile)
+                        {
+                            I386_PROFILE_THUNK *thunk = i386_profile_thunk(num);
+                            if (!thunk->name[0])
+                                sprintf(thunk->name, "int %02Xh", num);
+                        }
                         //win16 handle int 2/4/6/7
                         switch (num)
                         {
@@ -1078,9 +619,17 @@ extern "C"
                         case FAULT_PF:name = "#PF"; break;
                         case FAULT_MF:name = "#MF"; break;
                         }
+                        if (vm86_record_file)
+                            vm86_record_int(num);
+                        if (m_profile)
+                            i386_profile_switch(false);
                         if (name && num != FAULT_MF)
                         {
                             protected_mode_exception_handler(num, name, pih);
+                            if (vm86_record_file)
+                                vm86_record_resume(VM86REC_RETURN);
+                            if (m_profile)
+                                i386_profile_switch(true);
                             continue;
                         }
                         WORD ip = POP16();
@@ -1105,13 +654,17 @@ extern "C"
                         PUSH16((WORD)context.EFlags);
                         PUSH16(cs3);
                         PUSH16(ip3);
+                        if (vm86_record_file)
+                            vm86_record_resume(VM86REC_RETURN);
+                        if (m_profile)
+                            i386_profile_switch(true);
                     }
 				}
-				if ((void(*)(void))m_eip == from16_reg)
+				if (trap && (void(*)(void))m_eip == from16_reg)
 				{
 					reg = true;
 				}
-				if ((LONG(*)(void))m_eip == __wine_call_from_16 || reg)
+				if (trap && ((LONG(*)(void))m_eip == __wine_call_from_16 || reg))
 				{
 					unsigned char *stack1 = (unsigned char*)i386_translate(SS, REG16(SP), 0);
 					unsigned char *stack = stack1;
@@ -1184,31 +737,44 @@ extern "C"
 						PUSH32(REG32(EDX));
 						PUSH32(osp);
 						save_context(&context);
+						segment_snapshot segments;
+						save_segments(&segments);
                         STACK16FRAME *oa = (STACK16FRAME*)wine_ldt_get_ptr(context.SegSs, context.Esp);
 						DWORD ooo = (WORD)context.Esp;
 						int fret;
                         if (dasm_buffering)
                         {
                             char *dbuf = dasm_buffer.get_current();
-
-                           // __declspec(dllexport) void vm_debug_get_entry_point(char *module, char *func, WORD *ordinal)
-                            typedef void(*vm_debug_get_entry_point_t)(char *module, char *func, WORD *ordinal);
-                            static vm_debug_get_entry_point_t vm_debug_get_entry_point;
-                            if (!vm_debug_get_entry_point)
-                            {
-                                vm_debug_get_entry_point = (vm_debug_get_entry_point_t)GetProcAddress(LoadLibraryA(KRNL386), "vm_debug_get_entry_point");
-                            }
                             char module[100], func[100];
                             WORD ordinal = 0;
-                            vm_debug_get_entry_point(module, func, &ordinal);
+                            dynamic_vm_debug_get_entry_point(module, func, &ordinal);
                             sprintf(dbuf, "call built-in func %p %s.%d: %s\n", entry, module, ordinal, func);
                         }
-						if (relay != (UINT)relay_call_from_16)
+                        if (m_profile)
+                        {
+                            I386_PROFILE_THUNK *thunk = i386_profile_thunk(entry);
+                            if (!thunk->name[0])
+                            {
+                                char module[100], func[100];
+                                WORD ordinal = 0;
+                                dynamic_vm_debug_get_entry_point(module, func, &ordinal);
+                                _snprintf(thunk->name, sizeof(thunk->name) - 1, "%s.%d: %s", module, ordinal, func);
+                            }
+                        }
+						if (vm86_record_file)
+							vm86_record_call(entry, (WORD)cs, (WORD)ip);
+						if (m_profile)
+							i386_profile_switch(false);
+						//relay is the argument conversion function generated by convspec for this signature,
+						//or relay_call_from_16 when relay debugging is on.  The generated ones skip the
+						//SYSLEVEL_CheckNotLevel(2) of relay_call_from_16, so they are only used with DirectRelay=1
+						if (relay != (UINT)relay_call_from_16 && !direct_relay)
 						{
 							fret = relay_call_from_16((void*)entry, (unsigned char*)args, &context);
 						}
 						else
 							fret = ((int(*)(void *, unsigned char *, CONTEXT *))relay)((void*)entry, (unsigned char*)args, &context);
+						i386_block_flush();
 						//int fret = relay_call_from_16((void*)entry, (unsigned char*)args, &context);
 						if (!reg)
 						{
@@ -1239,108 +805,20 @@ extern "C"
 						REG16(SP) -= (ooo - context.Esp);
 						REG16(BP) = bp;
 						set_flags(context.EFlags);
-						i386_load_segment_descriptor(ES);
-						i386_load_segment_descriptor(SS);
-						i386_load_segment_descriptor(DS);
-						i386_load_segment_descriptor(FS);
-						i386_load_segment_descriptor(GS);
-						m_eip = context.Eip;
-						i386_jmp_far(SREG(CS), context.Eip);
+						reload_segments(&segments, context.Eip);
+						if (vm86_record_file)
+							vm86_record_resume(VM86REC_RETURN);
+						if (m_profile)
+							i386_profile_switch(true);
 					}
 				}
                 //merge_vm86_pending_flags
                 if (V8086_MODE)
                 {
-                    if (dynamic_getGdiTebBatch()->vm86_pending & 0x100000)//VIP flag
-                    {
-                        //dlls/ntdll/signal_i386.c merge_vm86_pending_flags
-                        BOOL check_pending = TRUE;
-                        /*
-                        * In order to prevent a race when SIGUSR2 occurs while
-                        * we are returning from exception handler, pending events
-                        * will be rechecked after each raised exception.
-                        */
-                        while (check_pending && dynamic_getGdiTebBatch()->vm86_pending)
-                        {
-                            check_pending = FALSE;
-
-                            //x86_thread_data()->vm86_ptr = NULL;
-
-                            /*
-                            * If VIF is set, throw exception.
-                            * Note that SIGUSR2 may turn VIF flag off so
-                            * VIF check must occur only when TEB.vm86_ptr is NULL.
-                            */
-                            if (1 || m_VIF)
-                            {
-                                CONTEXT vcontext = {};
-                                save_context(&vcontext);
-
-                                EXCEPTION_RECORD reca, *rec = &reca;
-                                rec->ExceptionCode = 0x80000111;
-                                rec->ExceptionFlags = 0;
-                                rec->ExceptionRecord = NULL;
-                                rec->NumberParameters = 0;
-                                rec->ExceptionAddress = (LPVOID)vcontext.Eip;
-
-                                vcontext.EFlags &= ~0x100000;
-                                dynamic_getGdiTebBatch()->vm86_pending = 0;
-                                //dosvm.c exception_handler
-                                CONTEXT *ppcontext = &vcontext;
-                                ULONG exception_args[1 + sizeof(CONTEXT*) / sizeof(ULONG)] = {};
-                                *(CONTEXT**)(&exception_args[1]) = ppcontext;
-                                RaiseException(0x80000111, 0, sizeof(exception_args) / sizeof(ULONG), (ULONG_PTR*)exception_args);
-                                //NTSTATUS a = NtRaiseException(rec, &vcontext, TRUE);
-
-                                load_context(&vcontext);
-                                check_pending = TRUE;
-                            }
-
-                            //x86_thread_data()->vm86_ptr = vm86;
-                        }
-
-                        /*
-                        * Merge VIP flags in a signal safe way. This requires
-                        * that the following operation compiles into atomic
-                        * instruction.
-                        */
-                        set_flags(get_flags() | dynamic_getGdiTebBatch()->vm86_pending);
-                    }
-                    UINT8 *op = mem + SREG_BASE(CS) + m_eip;
-                    UINT8 vec;
-                    if (*op == 0xCD)//INT imm8
-                    {
-
-                        vec = *(op + 1);
-
-                        CONTEXT context;
-                        WORD ip = m_eip;
-                        WORD cs = SREG(CS);
-                        PUSH16(cs);
-                        PUSH16(ip);
-                        save_context(&context);
-                        DWORD cs2 = context.SegCs;
-                        DWORD eip2 = context.Eip;
-                        context.Eip = ip;
-                        context.SegCs = cs;
-                        //Sometimes wine_int_handler modifies CS:IP
-                        dynamic__wine_call_int_handler(&context, vec);
-                        WORD ip3 = context.Eip;
-                        WORD cs3 = context.SegCs;
-                        context.SegCs = cs2;
-                        context.Eip = eip2;
-                        load_context(&context);
-                        WORD a = POP16();
-                        WORD b = POP16();
-                        m_eip += 2;
+                    if (teb_info->vm86_pending & 0x100000)//VIP flag
+                        vm86_merge_pending(teb_info);
+                    if (vm86_intercept_int())
                         continue;
-                    }
-                    else if (*op == 0xCC)
-                    {
-                        vec = 0x03;
-                        m_eip += 1;
-                        continue;
-                    }
                 }
 #ifdef SUPPORT_DISASSEMBLER
 				if (dasm) {
@@ -1352,7 +830,6 @@ extern "C"
 #endif
 					UINT8 *oprom = mem + SREG_BASE(CS) + eip;
 
-					char *dbuf = NULL;
                     if (dasm_nest && dasm_nest < 8)
                         if (dasm_nest_sp_table[dasm_nest - 1] <= SREG_BASE(SS) + REG16(SP))
                         {
@@ -1362,10 +839,11 @@ extern "C"
                     {
                         dasm_nest = 7;
                     }
+					// from the bytes, the text of a call can start with rep, repne or lock
+					bool call = dasm_is_call(oprom);
 					if (dasm_buffering)
 					{
-						dbuf = dasm_buffer.get_current();
-						dbuf += sprintf(dbuf, "%04x:%04x", SREG(CS), (unsigned)eip);
+						dasm_buffer.add_insn(SREG(CS), (UINT32)eip, m_operand_size != 0, oprom, m_sreg[CS].limit - (UINT32)eip + 1);
 					}
 					else
 					{
@@ -1373,34 +851,21 @@ extern "C"
                         nest_max[min(dasm_nest, sizeof(nest_max) - 1)] = 0;
 						fprintf(stderr, "%s%d %04x:%04x", nest_max, dasm_nest, SREG(CS), (unsigned)eip);
 						fflush(stderr);
-					}
-					int result;
 #if defined(HAS_I386)
-					if (m_operand_size) {
-                        result = CPU_DISASSEMBLE_CALL(x86_32);
-					}
-					else
+						if (m_operand_size) {
+							CPU_DISASSEMBLE_CALL(x86_32);
+						}
+						else
 #endif
-                        result = i386_dasm_one_ex(buffer, m_eip, oprom, 16);//CPU_DISASSEMBLE_CALL(x86_16);
-                    if (!memcmp(buffer, "call", 4))
+							i386_dasm_one_ex(buffer, m_eip, oprom, 16);//CPU_DISASSEMBLE_CALL(x86_16);
+						fprintf(stderr, "\t%s\n", buffer);
+					}
+                    if (call)
                     {
                         if (dasm_nest < 8)
                             dasm_nest_sp_table[dasm_nest] = SREG_BASE(SS) + REG16(SP);
                         dasm_nest++;
                     }
-                    int opsize = result & 0xFF;
-                    /*while (opsize--)
-                    {
-						if (dasm_buffering)
-							dbuf += sprintf(dbuf, "%02X", *oprom);
-						else
-	                        fprintf(stderr, "%02X", *oprom);
-                        oprom++;
-                    }*/
-					if (dasm_buffering)
-						dbuf += sprintf(dbuf, "\t%s\n", buffer);
-					else
-						fprintf(stderr, "\t%s\n", buffer);
 #if defined(TRACE_REGS)
                     fprintf(stderr,
                         "\
@@ -1415,13 +880,32 @@ SREG(ES), SREG(CS), SREG(SS), SREG(DS), m_eip, m_pc, m_eflags);
 #endif
 				}
 #endif
+				//the profiler counts the instructions run from each CS:IP the core is entered at
+				UINT64 profile_insns = m_insn_count;
+				UINT16 profile_cs = SREG(CS);
+				UINT32 profile_eip = m_eip;
+				bool profile_pm = PROTECTED_MODE && !V8086_MODE;
 #if defined(HAS_I386)
-				m_cycles = 1;
-				CPU_EXECUTE_CALL(i386);
+				if (dasm || !block_cache)
+				{
+					m_cycles = 1;
+					CPU_EXECUTE_CALL(i386);
+				}
+				else
+				{
+					vm86_block_teb = teb_info;
+					i386_block_execute();
+				}
 #else
 				CPU_EXECUTE_CALL(CPU_MODEL);
 #endif
+				if (m_profile)
+					i386_profile_block(profile_cs, profile_eip, profile_pm, m_insn_count - profile_insns);
 			}
+			if (vm86_record_file)
+				vm86_record_leave();
+			if (m_profile)
+				i386_profile_switch(false);
 			save_context(context);
 		}
 		__except (catch_exception(GetExceptionInformation(), (PEXCEPTION_ROUTINE)handler))
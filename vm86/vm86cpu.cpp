@@ -0,0 +1,470 @@
+/*
+	MAME i386 core and the glue it needs from the rest of the vm86 DLL:
+	memory accessors, write tracking for the block cache, the CPU
+	interface macros of MAME, included by msdos.cpp.
+
+	Nothing here calls Windows, so the Linux tests in tests/cpu build the
+	core from this file with cpu/host.h standing in for msdos.h.
+*/
+
+#define SUPPORT_DISASSEMBLER
+
+#if defined(HAS_I86)
+	#define CPU_MODEL i8086
+#elif defined(HAS_I186)
+	#define CPU_MODEL i80186
+#elif defined(HAS_I286)
+	#define CPU_MODEL i80286
+#elif defined(HAS_I386)
+	#define CPU_MODEL i386
+#else
+	#if defined(HAS_I386SX)
+		#define CPU_MODEL i386SX
+	#else
+		#if defined(HAS_I486)
+			#define CPU_MODEL i486
+		#else
+			#if defined(HAS_PENTIUM)
+				#define CPU_MODEL pentium
+			#elif defined(HAS_MEDIAGX)
+				#define CPU_MODEL mediagx
+			#elif defined(HAS_PENTIUM_PRO)
+				#define CPU_MODEL pentium_pro
+			#elif defined(HAS_PENTIUM_MMX)
+				#define CPU_MODEL pentium_mmx
+			#elif defined(HAS_PENTIUM2)
+				#define CPU_MODEL pentium2
+			#elif defined(HAS_PENTIUM3)
+				#define CPU_MODEL pentium3
+			#elif defined(HAS_PENTIUM4)
+				#define CPU_MODEL pentium4
+			#endif
+			#define SUPPORT_RDTSC
+		#endif
+		#define SUPPORT_FPU
+	#endif
+	#define HAS_I386
+#endif
+
+#ifndef __BIG_ENDIAN__
+#define LSB_FIRST
+#endif
+
+#ifndef INLINE
+#define INLINE inline
+#endif
+#define U64(v) UINT64(v)
+
+//#ifdef _DEBUG
+void logerror(const char *format, ...)
+{
+	va_list arg;
+
+	va_start(arg, format);
+	vfprintf(stderr, format, arg);
+	va_end(arg);
+}
+//#else
+//#define logerror(...)
+//#endif
+//#define logerror(...) fprintf(stderr, __VA_ARGS__)
+//#define logerror(...)
+//#define popmessage(...) fprintf(stderr, __VA_ARGS__)
+#define popmessage(...)
+
+/*****************************************************************************/
+/* src/emu/devcpu.h */
+
+// CPU interface functions
+#define CPU_INIT_NAME(name)			cpu_init_##name
+#define CPU_INIT(name)				void CPU_INIT_NAME(name)()
+#define CPU_INIT_CALL(name)			CPU_INIT_NAME(name)()
+
+#define CPU_RESET_NAME(name)			cpu_reset_##name
+#define CPU_RESET(name)				void CPU_RESET_NAME(name)()
+#define CPU_RESET_CALL(name)			CPU_RESET_NAME(name)()
+
+#define CPU_EXECUTE_NAME(name)			cpu_execute_##name
+#define CPU_EXECUTE(name)			void CPU_EXECUTE_NAME(name)()
+#define CPU_EXECUTE_CALL(name)			CPU_EXECUTE_NAME(name)()
+
+#define CPU_TRANSLATE_NAME(name)		cpu_translate_##name
+#define CPU_TRANSLATE(name)			int CPU_TRANSLATE_NAME(name)(address_spacenum space, int intention, offs_t *address)
+#define CPU_TRANSLATE_CALL(name)		CPU_TRANSLATE_NAME(name)(space, intention, address)
+
+#define CPU_DISASSEMBLE_NAME(name)		cpu_disassemble_##name
+#define CPU_DISASSEMBLE(name)			int CPU_DISASSEMBLE_NAME(name)(char *buffer, offs_t pc, const UINT8 *oprom)
+#define CPU_DISASSEMBLE_CALL(name)		CPU_DISASSEMBLE_NAME(name)(buffer, eip, oprom)
+
+/*****************************************************************************/
+/* src/emu/didisasm.h */
+
+// Disassembler constants
+const UINT32 DASMFLAG_SUPPORTED     = 0x80000000;   // are disassembly flags supported?
+const UINT32 DASMFLAG_STEP_OUT      = 0x40000000;   // this instruction should be the end of a step out sequence
+const UINT32 DASMFLAG_STEP_OVER     = 0x20000000;   // this instruction should be stepped over by setting a breakpoint afterwards
+const UINT32 DASMFLAG_OVERINSTMASK  = 0x18000000;   // number of extra instructions to skip when stepping over
+const UINT32 DASMFLAG_OVERINSTSHIFT = 27;           // bits to shift after masking to get the value
+const UINT32 DASMFLAG_LENGTHMASK    = 0x0000ffff;   // the low 16-bits contain the actual length
+
+/*****************************************************************************/
+/* src/emu/diexec.h */
+
+// I/O line states
+enum line_state
+{
+	CLEAR_LINE = 0,				// clear (a fired or held) line
+	ASSERT_LINE,				// assert an interrupt immediately
+	HOLD_LINE,				// hold interrupt line until acknowledged
+	PULSE_LINE				// pulse interrupt line instantaneously (only for NMI, RESET)
+};
+
+// I/O line definitions
+enum
+{
+	INPUT_LINE_IRQ = 0,
+	INPUT_LINE_NMI
+};
+
+/*****************************************************************************/
+/* src/emu/dimemory.h */
+
+// Translation intentions
+const int TRANSLATE_TYPE_MASK       = 0x03;     // read write or fetch
+const int TRANSLATE_USER_MASK       = 0x04;     // user mode or fully privileged
+const int TRANSLATE_DEBUG_MASK      = 0x08;     // debug mode (no side effects)
+
+const int TRANSLATE_READ            = 0;        // translate for read
+const int TRANSLATE_WRITE           = 1;        // translate for write
+const int TRANSLATE_FETCH           = 2;        // translate for instruction fetch
+const int TRANSLATE_READ_USER       = (TRANSLATE_READ | TRANSLATE_USER_MASK);
+const int TRANSLATE_WRITE_USER      = (TRANSLATE_WRITE | TRANSLATE_USER_MASK);
+const int TRANSLATE_FETCH_USER      = (TRANSLATE_FETCH | TRANSLATE_USER_MASK);
+const int TRANSLATE_READ_DEBUG      = (TRANSLATE_READ | TRANSLATE_DEBUG_MASK);
+const int TRANSLATE_WRITE_DEBUG     = (TRANSLATE_WRITE | TRANSLATE_DEBUG_MASK);
+const int TRANSLATE_FETCH_DEBUG     = (TRANSLATE_FETCH | TRANSLATE_DEBUG_MASK);
+
+/*****************************************************************************/
+/* src/emu/emucore.h */
+
+// constants for expression endianness
+enum endianness_t
+{
+	ENDIANNESS_LITTLE,
+	ENDIANNESS_BIG
+};
+
+// declare native endianness to be one or the other
+#ifdef LSB_FIRST
+const endianness_t ENDIANNESS_NATIVE = ENDIANNESS_LITTLE;
+#else
+const endianness_t ENDIANNESS_NATIVE = ENDIANNESS_BIG;
+#endif
+
+// endian-based value: first value is if 'endian' is little-endian, second is if 'endian' is big-endian
+#define ENDIAN_VALUE_LE_BE(endian,leval,beval)	(((endian) == ENDIANNESS_LITTLE) ? (leval) : (beval))
+
+// endian-based value: first value is if native endianness is little-endian, second is if native is big-endian
+#define NATIVE_ENDIAN_VALUE_LE_BE(leval,beval)	ENDIAN_VALUE_LE_BE(ENDIANNESS_NATIVE, leval, beval)
+
+// endian-based value: first value is if 'endian' matches native, second is if 'endian' doesn't match native
+#define ENDIAN_VALUE_NE_NNE(endian,leval,beval)	(((endian) == ENDIANNESS_NATIVE) ? (neval) : (nneval))
+
+/*****************************************************************************/
+/* src/emu/memory.h */
+
+// address spaces
+enum address_spacenum
+{
+	AS_0,                           // first address space
+	AS_1,                           // second address space
+	AS_2,                           // third address space
+	AS_3,                           // fourth address space
+	ADDRESS_SPACES,                 // maximum number of address spaces
+
+	// alternate address space names for common use
+	AS_PROGRAM = AS_0,              // program address space
+	AS_DATA = AS_1,                 // data address space
+	AS_IO = AS_2                    // I/O address space
+};
+
+// offsets and addresses are 32-bit (for now...)
+typedef UINT32	offs_t;
+extern "C" void *wine_ldt_get_ptr(unsigned short sel, unsigned long offset);
+void *read_ptr(offs_t byteaddress)
+{
+	return nullptr;
+}
+
+/*
+	Write tracking for caches of decoded guest code
+
+	A cache marks the pages it has decoded code from with code_page_mark().
+	A write through write_byte/word/dword to a marked page calls every
+	callback registered with code_page_register() with the bytes written
+	on that page.  The callback drops what was decoded from those bytes
+	and returns whether anything decoded is left on the page; the mark is
+	cleared once nothing is.  Pages are linear, so writes through a data
+	alias of a code selector are caught as well.  32-bit code writes
+	memory directly and is not tracked; callers flush their caches after
+	it may have run.
+*/
+#define CODE_PAGE_MAX_CALLBACKS 4
+
+static UINT32 code_page[0x100000 / 32];
+static bool (*code_page_callback[CODE_PAGE_MAX_CALLBACKS])(UINT32 page, offs_t start, offs_t end);
+static int code_page_callbacks;
+
+void code_page_register(bool (*callback)(UINT32 page, offs_t start, offs_t end))
+{
+	int i;
+	for (i = 0; i < code_page_callbacks; i++)
+	{
+		if (code_page_callback[i] == callback)
+			return;
+	}
+	if (code_page_callbacks < CODE_PAGE_MAX_CALLBACKS)
+		code_page_callback[code_page_callbacks++] = callback;
+}
+
+inline void code_page_mark(offs_t start, offs_t end)
+{
+	UINT32 page;
+	for (page = start >> 12; page <= (end >> 12); page++)
+		code_page[page >> 5] |= 1 << (page & 31);
+}
+
+static void code_page_write_hit(UINT32 page, offs_t start, offs_t end)
+{
+	int i;
+	bool left = false;
+	for (i = 0; i < code_page_callbacks; i++)
+		left |= code_page_callback[i](page, start, end);
+	if (!left)
+		code_page[page >> 5] &= ~(1 << (page & 31));
+}
+
+inline void code_page_check_write(offs_t byteaddress, UINT32 size)
+{
+	UINT32 page = byteaddress >> 12, last = (byteaddress + size - 1) >> 12;
+	for (; page <= last; page++)
+	{
+		if (code_page[page >> 5] & (1 << (page & 31)))
+			code_page_write_hit(page, byteaddress, byteaddress + size - 1);
+	}
+}
+
+// read accessors
+UINT8 read_byte(offs_t byteaddress)
+{
+#if defined(HAS_I386)
+	if(byteaddress < MAX_MEM) {
+		return mem[byteaddress];
+//	} else if((byteaddress & 0xfffffff0) == 0xfffffff0) {
+//		return read_byte(byteaddress & 0xfffff);
+	}
+	return 0;
+#else
+	return mem[byteaddress];
+#endif
+}
+
+UINT16 read_word(offs_t byteaddress)
+{
+#if defined(HAS_I386)
+	if(byteaddress < MAX_MEM - 1) {
+		return *(UINT16 *)(mem + byteaddress);
+//	} else if((byteaddress & 0xfffffff0) == 0xfffffff0) {
+//		return read_word(byteaddress & 0xfffff);
+	}
+	return 0;
+#else
+	return *(UINT16 *)(mem + byteaddress);
+#endif
+}
+
+UINT32 read_dword(offs_t byteaddress)
+{
+#if defined(HAS_I386)
+	if(byteaddress < MAX_MEM - 3) {
+		return *(UINT32 *)(mem + byteaddress);
+//	} else if((byteaddress & 0xfffffff0) == 0xfffffff0) {
+//		return read_dword(byteaddress & 0xfffff);
+	}
+	return 0;
+#else
+	return *(UINT32 *)(mem + byteaddress);
+#endif
+}
+
+void write_byte(offs_t byteaddress, UINT8 data)
+{
+	/*
+	if(byteaddress < MEMORY_END) {
+		mem[byteaddress] = data;
+	} else if(byteaddress >= text_vram_top_address && byteaddress < text_vram_end_address) {
+		if(!restore_console_on_exit && (scr_width != 80 || scr_height != 25)) {
+			change_console_size_to_80x25();
+			restore_console_on_exit = true;
+		}
+		write_text_vram_byte(byteaddress - text_vram_top_address, data);
+		mem[byteaddress] = data;
+	} else if(byteaddress >= shadow_buffer_top_address && byteaddress < shadow_buffer_end_address) {
+		if(int_10h_feh_called && !int_10h_ffh_called) {
+			write_text_vram_byte(byteaddress - shadow_buffer_top_address, data);
+		}
+		mem[byteaddress] = data;
+#if defined(HAS_I386)
+	} else if(byteaddress < MAX_MEM) {
+#else
+	} else {
+#endif
+		mem[byteaddress] = data;
+	}
+	*/
+	code_page_check_write(byteaddress, 1);
+	mem[byteaddress] = data;
+}
+
+void write_word(offs_t byteaddress, UINT16 data)
+{
+	code_page_check_write(byteaddress, 2);
+	*(UINT16 *)(mem + byteaddress) = data;
+	/*
+	if(byteaddress < MEMORY_END) {
+		*(UINT16 *)(mem + byteaddress) = data;
+	} else if(byteaddress >= text_vram_top_address && byteaddress < text_vram_end_address) {
+		if(!restore_console_on_exit && (scr_width != 80 || scr_height != 25)) {
+			change_console_size_to_80x25();
+			restore_console_on_exit = true;
+		}
+		write_text_vram_word(byteaddress - text_vram_top_address, data);
+		*(UINT16 *)(mem + byteaddress) = data;
+	} else if(byteaddress >= shadow_buffer_top_address && byteaddress < shadow_buffer_end_address) {
+		if(int_10h_feh_called && !int_10h_ffh_called) {
+			write_text_vram_word(byteaddress - shadow_buffer_top_address, data);
+		}
+		*(UINT16 *)(mem + byteaddress) = data;
+#if defined(HAS_I386)
+	} else if(byteaddress < MAX_MEM - 1) {
+#else
+	} else {
+#endif
+		*(UINT16 *)(mem + byteaddress) = data;
+	}*/
+}
+
+void write_dword(offs_t byteaddress, UINT32 data)
+{
+	code_page_check_write(byteaddress, 4);
+	*(UINT32 *)(mem + byteaddress) = data;
+	/*
+	if(byteaddress < MEMORY_END) {
+		*(UINT32 *)(mem + byteaddress) = data;
+	} else if(byteaddress >= text_vram_top_address && byteaddress < text_vram_end_address) {
+		if(!restore_console_on_exit && (scr_width != 80 || scr_height != 25)) {
+			change_console_size_to_80x25();
+			restore_console_on_exit = true;
+		}
+		write_text_vram_dword(byteaddress - text_vram_top_address, data);
+		*(UINT32 *)(mem + byteaddress) = data;
+	} else if(byteaddress >= shadow_buffer_top_address && byteaddress < shadow_buffer_end_address) {
+		if(int_10h_feh_called && !int_10h_ffh_called) {
+			write_text_vram_dword(byteaddress - shadow_buffer_top_address, data);
+		}
+		*(UINT32 *)(mem + byteaddress) = data;
+#if defined(HAS_I386)
+	} else if(byteaddress < MAX_MEM - 3) {
+#else
+	} else {
+#endif
+		*(UINT32 *)(mem + byteaddress) = data;
+	}
+	*/
+}
+
+#define read_decrypted_byte read_byte
+#define read_decrypted_word read_word
+#define read_decrypted_dword read_dword
+
+#define read_raw_byte read_byte
+#define write_raw_byte write_byte
+
+#define read_word_unaligned read_word
+#define write_word_unaligned write_word
+
+#define read_io_word_unaligned read_io_word
+#define write_io_word_unaligned write_io_word
+
+UINT8 read_io_byte(offs_t byteaddress);
+UINT16 read_io_word(offs_t byteaddress);
+UINT32 read_io_dword(offs_t byteaddress);
+
+void write_io_byte(offs_t byteaddress, UINT8 data);
+void write_io_word(offs_t byteaddress, UINT16 data);
+void write_io_dword(offs_t byteaddress, UINT32 data);
+
+/*****************************************************************************/
+/* src/osd/osdcomm.h */
+
+/* Highly useful macro for compile-time knowledge of an array size */
+#define ARRAY_LENGTH(x)     (sizeof(x) / sizeof(x[0]))
+
+#if defined(HAS_I386)
+	static CPU_TRANSLATE(i386);
+	#include "mame/lib/softfloat/softfloat.c"
+	#include "mame/emu/cpu/i386/i386.c"
+	#include "mame/emu/cpu/vtlb.c"
+#elif defined(HAS_I286)
+	#include "mame/emu/cpu/i86/i286.c"
+#else
+	#include "mame/emu/cpu/i86/i86.c"
+#endif
+#ifdef SUPPORT_DISASSEMBLER
+	#include "mame/emu/cpu/i386/i386dasm.c"
+	bool dasm = false;
+#endif
+
+#if defined(HAS_I386)
+	#define SREG(x)				m_sreg[x].selector
+	#define SREG_BASE(x)			m_sreg[x].base
+
+	int cpu_type, cpu_step;
+#else
+	#define REG8(x)				m_regs.b[x]
+	#define REG16(x)			m_regs.w[x]
+	#define SREG(x)				m_sregs[x]
+	#define SREG_BASE(x)			m_base[x]
+	#define m_CF				m_CarryVal
+	#define m_a20_mask			AMASK
+	//#define i386_load_segment_descriptor(x)	m_base[x] = SegBase(x)
+	void load_segment_descriptor_wine(int sreg);
+#define i386_load_segment_descriptor(x) load_segment_descriptor_wine(x)
+	#if defined(HAS_I286)
+		#define i386_set_a20_line(x)	i80286_set_a20_line(x)
+	#else
+		#define i386_set_a20_line(x)
+	#endif
+	#define i386_set_irq_line(x, y)		set_irq_line(x, y)
+#endif
+
+void i386_jmp_far(UINT16 selector, UINT32 address)
+{
+#if defined(HAS_I386)
+	if(PROTECTED_MODE && !V8086_MODE) {
+		i386_protected_mode_jump(selector, address, 1, m_operand_size);
+	} else {
+		SREG(CS) = selector;
+		m_performed_intersegment_jump = 1;
+		i386_load_segment_descriptor(CS);
+		m_eip = address;
+		CHANGE_PC(m_eip);
+	}
+#elif defined(HAS_I286)
+	i80286_code_descriptor(selector, address, 1);
+#else
+	SREG(CS) = selector;
+	i386_load_segment_descriptor(CS);
+	m_pc = (SREG_BASE(CS) + address) & m_a20_mask;
+#endif
+}
@@ -0,0 +1,169 @@
+/*
+ * The krnl386 exports vm86main calls and the CONTEXT it hands to them,
+ * included by msdos.cpp inside its extern "C" block.
+ *
+ * save_context and load_context copy the registers between the core and
+ * a CONTEXT, vm86_merge_pending delivers the V86 events krnl386 queued
+ * and vm86_intercept_int passes INT imm8 in V86 mode to krnl386.
+ */
+
+#define KRNL386 "krnl386.exe16"
+//krnl386 exports used while running 16-bit code, resolved once by init_vm86
+static struct
+{
+	WINE_VM86_TEB_INFO *(*getGdiTebBatch)();
+	void (*__wine_call_int_handler)(CONTEXT *context, BYTE intnum);
+	void (*vm_debug_get_entry_point)(char *module, char *func, WORD *ordinal);
+	void (*vm86_send_queued_events)(CONTEXT *context);
+} krnl386_exports;
+void resolve_krnl386_exports()
+{
+	HMODULE krnl386 = LoadLibraryA(KRNL386);
+	krnl386_exports.getGdiTebBatch = (WINE_VM86_TEB_INFO*(*)())GetProcAddress(krnl386, "getGdiTebBatch");
+	krnl386_exports.__wine_call_int_handler = (void(*)(CONTEXT *context, BYTE intnum))GetProcAddress(krnl386, "__wine_call_int_handler");
+	krnl386_exports.vm_debug_get_entry_point = (void(*)(char *module, char *func, WORD *ordinal))GetProcAddress(krnl386, "vm_debug_get_entry_point");
+	krnl386_exports.vm86_send_queued_events = (void(*)(CONTEXT *context))GetProcAddress(krnl386, "vm86_send_queued_events");
+}
+//WOW32Reserved is TLS slot WOW32RESERVED_TLS_INDEX of the TEB (TlsSlots is at 0xe10, see convspec/relay.c).
+//save_context writes it on every call, so it is accessed in place rather than through the krnl386 exports
+inline PVOID *wow32_reserved_slot()
+{
+	return (PVOID *)((BYTE *)NtCurrentTeb() + 0xe10) + WOW32RESERVED_TLS_INDEX;
+}
+PVOID dynamic_setWOW32Reserved(PVOID w)
+{
+	return *wow32_reserved_slot() = w;
+}
+PVOID dynamic_getWOW32Reserved()
+{
+	return *wow32_reserved_slot();
+}
+WINE_VM86_TEB_INFO *dynamic_getGdiTebBatch()
+{
+    return krnl386_exports.getGdiTebBatch();
+}
+void dynamic__wine_call_int_handler(CONTEXT *context, BYTE intnum)
+{
+	krnl386_exports.__wine_call_int_handler(context, intnum);
+}
+void dynamic_vm_debug_get_entry_point(char *module, char *func, WORD *ordinal)
+{
+	krnl386_exports.vm_debug_get_entry_point(module, func, ordinal);
+}
+void save_context(CONTEXT *context)
+{
+	context->Eax = REG32(EAX);
+	context->Ecx = REG32(ECX);
+	context->Edx = REG32(EDX);
+	context->Ebx = REG32(EBX);
+	context->Esp = REG32(ESP);
+	context->Ebp = REG32(EBP);
+	context->Esi = REG32(ESI);
+	context->Edi = REG32(EDI);
+	context->Ebp = REG32(EBP);
+	context->Eip = m_eip;
+	context->SegEs = SREG(ES);
+	context->SegCs = SREG(CS);
+	context->SegSs = SREG(SS);
+	context->SegDs = SREG(DS);
+	context->SegFs = SREG(FS);
+	context->SegGs = SREG(GS);
+    context->EFlags = m_eflags;// &~0x20000;
+	dynamic_setWOW32Reserved((PVOID)(size_t)(SREG(SS) << 16 | REG16(SP)));
+}
+void load_context(CONTEXT *context)
+{
+	REG32(EAX) = (DWORD)context->Eax;
+	REG32(ECX) = (DWORD)context->Ecx;
+	REG32(EDX) = (DWORD)context->Edx;
+	REG32(EBX) = (DWORD)context->Ebx;
+	REG32(ESP) = (DWORD)context->Esp;
+	REG32(EBP) = (DWORD)context->Ebp;
+	REG32(ESI) = (DWORD)context->Esi;
+	REG32(EDI) = (DWORD)context->Edi;
+	REG32(EBP) = (DWORD)context->Ebp;
+	SREG(ES) = (WORD)context->SegEs;
+	SREG(CS) = (WORD)context->SegCs;
+	SREG(SS) = (WORD)context->SegSs;
+	SREG(DS) = (WORD)context->SegDs;//ES, CS, SS, DS
+	//ES, CS, SS, DS, FS, GS
+	SREG(FS) = (WORD)context->SegFs;
+	SREG(GS) = (WORD)context->SegGs;
+	i386_load_segment_descriptor(ES);
+	i386_load_segment_descriptor(SS);
+	i386_load_segment_descriptor(DS);
+	i386_load_segment_descriptor(FS);
+	i386_load_segment_descriptor(GS);
+	m_eip = context->Eip;
+	i386_jmp_far(SREG(CS), context->Eip);
+	set_flags(context->EFlags);
+	//32-bit code may have modified 16-bit code
+	i386_block_flush();
+}
+//dlls/ntdll/signal_i386.c merge_vm86_pending_flags: deliver the events krnl386 queued for
+//this thread (VIP is set in teb_info), then merge what is still pending into the flags
+void vm86_merge_pending(WINE_VM86_TEB_INFO *teb_info)
+{
+	BOOL check_pending = TRUE;
+	/*
+	* In order to prevent a race when SIGUSR2 occurs while
+	* we are returning from exception handler, pending events
+	* will be rechecked after each raised exception.
+	*/
+	while (check_pending && teb_info->vm86_pending)
+	{
+		check_pending = FALSE;
+		CONTEXT vcontext = {};
+		save_context(&vcontext);
+
+		vcontext.EFlags &= ~0x100000;
+		teb_info->vm86_pending = 0;
+		//what dosvm.c exception_handler does for EXCEPTION_VM86_STI (0x80000111),
+		//called directly so that delivering an interrupt does not go through exception dispatch
+		krnl386_exports.vm86_send_queued_events(&vcontext);
+
+		load_context(&vcontext);
+		check_pending = TRUE;
+	}
+	/*
+	* Merge VIP flags in a signal safe way. This requires
+	* that the following operation compiles into atomic
+	* instruction.
+	*/
+	set_flags(get_flags() | teb_info->vm86_pending);
+}
+//INT imm8 in V86 mode goes to the krnl386 interrupt handlers instead of through the IVT, and
+//INT3 is skipped; true if the instruction at CS:IP was one of them
+bool vm86_intercept_int()
+{
+	UINT8 *op = mem + SREG_BASE(CS) + m_eip;
+	if (*op == 0xCD)//INT imm8
+	{
+		BYTE vec = *(op + 1);
+		CONTEXT context;
+		WORD ip = m_eip;
+		WORD cs = SREG(CS);
+		PUSH16(cs);
+		PUSH16(ip);
+		save_context(&context);
+		DWORD cs2 = context.SegCs;
+		DWORD eip2 = context.Eip;
+		context.Eip = ip;
+		context.SegCs = cs;
+		//Sometimes wine_int_handler modifies CS:IP
+		dynamic__wine_call_int_handler(&context, vec);
+		context.SegCs = cs2;
+		context.Eip = eip2;
+		load_context(&context);
+		POP16();
+		POP16();
+		m_eip += 2;
+		return true;
+	}
+	if (*op == 0xCC)
+	{
+		m_eip += 1;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,268 @@
+/*
+ * Recorder for the 16-bit side of vm86main (Record in otvdm.ini),
+ * included by msdos.cpp.  See vm86rec.h for the log format.
+ *
+ * 32-bit code does not go through the core to write 16-bit memory, so its
+ * side effects are found by comparing every page covered by the LDT with
+ * a shadow copy whenever control comes back to 16-bit code.  This makes
+ * recording slow; it is meant for capturing a session, not for normal use.
+ * Only protected mode is recorded.
+ *
+ * Memory is reached through 'mem', which is 0 in protected mode, so the
+ * recorder also runs on the guest memory of the Linux tests.
+ */
+
+#include "vm86rec.h"
+
+#define VM86REC_CHUNK           32          // granularity of memory records
+#define VM86REC_MAX_SEGMENT     0x1000000   // larger (flat) segments are not tracked
+
+static FILE *vm86_record_file;
+static UINT32 *vm86_record_slot;            // page number -> index in vm86_record_pages + 1
+static std::vector<UINT32> vm86_record_pages;
+static std::vector<UINT8 *> vm86_record_shadow;
+static LDT_ENTRY vm86_record_ldt[8192];
+static bool vm86_record_started;            // the descriptor tables are recorded
+
+static void vm86_record_write(UINT8 type, const void *info, UINT32 info_size, const void *data, UINT32 data_size)
+{
+	VM86REC_HEADER header = { 0 };
+	header.type = type;
+	header.size = info_size + data_size;
+	header.position = m_insn_count;
+	fwrite(&header, sizeof(header), 1, vm86_record_file);
+	if (info_size)
+		fwrite(info, info_size, 1, vm86_record_file);
+	if (data_size)
+		fwrite(data, data_size, 1, vm86_record_file);
+}
+
+static void vm86_record_state(UINT8 type)
+{
+	VM86REC_STATE state;
+	state.eax = REG32(EAX);
+	state.ecx = REG32(ECX);
+	state.edx = REG32(EDX);
+	state.ebx = REG32(EBX);
+	state.esp = REG32(ESP);
+	state.ebp = REG32(EBP);
+	state.esi = REG32(ESI);
+	state.edi = REG32(EDI);
+	state.eip = m_eip;
+	state.eflags = get_flags();
+	state.es = SREG(ES);
+	state.cs = SREG(CS);
+	state.ss = SREG(SS);
+	state.ds = SREG(DS);
+	state.fs = SREG(FS);
+	state.gs = SREG(GS);
+	vm86_record_write(type, &state, sizeof(state), NULL, 0);
+}
+
+static void vm86_record_memory(UINT32 address, UINT32 size)
+{
+	VM86REC_MEMORY_INFO info;
+	info.address = address;
+	vm86_record_write(VM86REC_MEMORY, &info, sizeof(info), mem + address, size);
+}
+
+static BOOL vm86_record_readable(UINT32 page)
+{
+	MEMORY_BASIC_INFORMATION mbi;
+	if (!VirtualQuery(mem + (page << 12), &mbi, sizeof(mbi)) || mbi.State != MEM_COMMIT)
+		return FALSE;
+	return !(mbi.Protect & (PAGE_GUARD | PAGE_NOACCESS));
+}
+
+/* Start tracking the pages of a segment and record their contents */
+static void vm86_record_track(const LDT_ENTRY *entry)
+{
+	UINT32 base = (UINT32)(ULONG_PTR)wine_ldt_get_base(entry);
+	UINT32 limit = wine_ldt_get_limit(entry);
+	UINT32 page;
+
+	if (!entry->HighWord.Bits.Pres || limit >= VM86REC_MAX_SEGMENT)
+		return;
+	for (page = base >> 12; page <= (base + limit) >> 12 && page < 0x100000; page++)
+	{
+		if (vm86_record_slot[page] || !vm86_record_readable(page))
+			continue;
+		UINT8 *shadow = (UINT8 *)malloc(0x1000);
+		if (!shadow)
+			return;
+		memcpy(shadow, mem + (page << 12), 0x1000);
+		vm86_record_pages.push_back(page);
+		vm86_record_shadow.push_back(shadow);
+		vm86_record_slot[page] = vm86_record_pages.size();
+		vm86_record_memory(page << 12, 0x1000);
+	}
+}
+
+static void vm86_record_untrack(size_t i)
+{
+	vm86_record_slot[vm86_record_pages[i]] = 0;
+	free(vm86_record_shadow[i]);
+	vm86_record_pages[i] = vm86_record_pages.back();
+	vm86_record_shadow[i] = vm86_record_shadow.back();
+	vm86_record_pages.pop_back();
+	vm86_record_shadow.pop_back();
+	if (i < vm86_record_pages.size())
+		vm86_record_slot[vm86_record_pages[i]] = i + 1;
+}
+
+/* 1 if the page differs from its shadow, -1 if it can no longer be read */
+static int vm86_record_compare(const UINT8 *page, const UINT8 *shadow)
+{
+	__try
+	{
+		return memcmp(page, shadow, 0x1000) ? 1 : 0;
+	}
+	__except (EXCEPTION_EXECUTE_HANDLER)
+	{
+		return -1;
+	}
+}
+
+/* The tables set up by init_vm86, recorded when the core is first entered */
+static void vm86_record_tables()
+{
+	VM86REC_TABLES_INFO info;
+	info.gdt_base = m_gdtr.base;
+	info.idt_base = m_idtr.base;
+	info.ldt_base = m_ldtr.base;
+	info.gdt_limit = m_gdtr.limit;
+	info.idt_limit = m_idtr.limit;
+	info.ldt_limit = m_ldtr.limit;
+	info.cpl = m_CPL;
+	info.cr0 = m_cr[0];
+	vm86_record_write(VM86REC_TABLES, &info, sizeof(info), NULL, 0);
+	vm86_record_memory(m_idtr.base, m_idtr.limit + 1);
+	vm86_record_started = true;
+}
+
+/* Record what the 32-bit side changed in the LDT and in 16-bit memory */
+static void vm86_record_sync()
+{
+	size_t i;
+	UINT32 offset, start;
+
+	if (!vm86_record_started)
+		vm86_record_tables();
+
+	if (memcmp(vm86_record_ldt, wine_ldt, sizeof(vm86_record_ldt)))
+	{
+		for (i = 0; i < 8192; i++)
+		{
+			VM86REC_LDT_INFO info;
+			if (!memcmp(&vm86_record_ldt[i], &wine_ldt[i], sizeof(LDT_ENTRY)))
+				continue;
+			info.index = i;
+			for (info.count = 0; i < 8192 && memcmp(&vm86_record_ldt[i], &wine_ldt[i], sizeof(LDT_ENTRY)); i++, info.count++)
+				vm86_record_ldt[i] = wine_ldt[i];
+			vm86_record_write(VM86REC_LDT, &info, sizeof(info), &wine_ldt[info.index], info.count * sizeof(LDT_ENTRY));
+			while (info.count--)
+				vm86_record_track(&wine_ldt[info.index++]);
+		}
+	}
+	for (i = 0; i < vm86_record_pages.size(); i++)
+	{
+		UINT8 *page = mem + (vm86_record_pages[i] << 12);
+		UINT8 *shadow = vm86_record_shadow[i];
+		int changed = vm86_record_compare(page, shadow);
+		if (changed < 0)
+		{
+			vm86_record_untrack(i--);
+			continue;
+		}
+		if (!changed)
+			continue;
+		for (offset = 0; offset < 0x1000; )
+		{
+			if (!memcmp(page + offset, shadow + offset, VM86REC_CHUNK))
+			{
+				offset += VM86REC_CHUNK;
+				continue;
+			}
+			for (start = offset; offset < 0x1000 && memcmp(page + offset, shadow + offset, VM86REC_CHUNK); offset += VM86REC_CHUNK)
+				;
+			memcpy(shadow + start, page + start, offset - start);
+			vm86_record_memory((vm86_record_pages[i] << 12) + start, offset - start);
+		}
+	}
+}
+
+/* 16-bit code hands control to the 32-bit side: take what it wrote into the
+   shadows, so the next sync records only what the 32-bit side changes and a
+   replay that goes wrong is not put right by the log */
+static void vm86_record_handoff()
+{
+	size_t i;
+
+	for (i = 0; i < vm86_record_pages.size(); i++)
+	{
+		UINT8 *page = mem + (vm86_record_pages[i] << 12);
+		if (vm86_record_compare(page, vm86_record_shadow[i]) > 0)
+			memcpy(vm86_record_shadow[i], page, 0x1000);
+	}
+}
+
+static void vm86_record_call(DWORD entry, WORD cs, WORD ip)
+{
+	VM86REC_CALL_INFO info;
+	vm86_record_handoff();
+	info.entry = entry;
+	info.cs = cs;
+	info.ip = ip;
+	vm86_record_write(VM86REC_CALL, &info, sizeof(info), NULL, 0);
+}
+
+static void vm86_record_int(BYTE num)
+{
+	VM86REC_INT_INFO info;
+	vm86_record_handoff();
+	info.num = num;
+	info.reserved = 0;
+	info.cs = SREG(CS);
+	info.ip = m_eip;
+	vm86_record_write(VM86REC_INT, &info, sizeof(info), NULL, 0);
+}
+
+static void vm86_record_leave()
+{
+	vm86_record_handoff();
+	vm86_record_state(VM86REC_LEAVE);
+}
+
+/* The 32-bit side hands control back to 16-bit code (VM86REC_ENTER or VM86REC_RETURN) */
+static void vm86_record_resume(UINT8 type)
+{
+	vm86_record_sync();
+	vm86_record_state(type);
+}
+
+static void vm86_record_close()
+{
+	if (vm86_record_file)
+		fclose(vm86_record_file);
+	vm86_record_file = NULL;
+}
+
+static void vm86_record_init(const char *path)
+{
+	VM86REC_FILE header = { VM86REC_MAGIC, VM86REC_VERSION, 0 };
+
+	vm86_record_slot = (UINT32 *)calloc(0x100000, sizeof(UINT32));
+	if (!vm86_record_slot || !(vm86_record_file = fopen(path, "wb")))
+	{
+		fprintf(stderr, "vm86: cannot record to %s\n", path);
+		free(vm86_record_slot);
+		vm86_record_slot = NULL;
+		return;
+	}
+	setvbuf(vm86_record_file, NULL, _IOFBF, 0x100000);
+	fwrite(&header, sizeof(header), 1, vm86_record_file);
+	// an empty shadow LDT makes the first sync record the whole LDT and its memory
+	memset(vm86_record_ldt, 0, sizeof(vm86_record_ldt));
+	m_count_insns = true;
+	atexit(vm86_record_close);
+}
@@ -0,0 +1,108 @@
+/*
+ * Log format of the vm86 recorder (Record in otvdm.ini)
+ *
+ * The log holds everything the 16-bit instruction stream gets from the
+ * 32-bit side, so the stream can be executed again without it.  It starts
+ * with a VM86REC_FILE header followed by records, each a VM86REC_HEADER
+ * and 'size' bytes of payload.  All values are little-endian.
+ *
+ * 'position' is the number of instructions the core had retired when the
+ * record was written.  A replayer runs the core until it reaches the
+ * position of the next VM86REC_CALL, VM86REC_INT or VM86REC_LEAVE record;
+ * the core is then at the instruction that hands control to the 32-bit
+ * side.  The VM86REC_LDT and VM86REC_MEMORY records that follow hold what
+ * the 32-bit side changed, and the VM86REC_ENTER or VM86REC_RETURN record
+ * after them the register state the 16-bit code resumes with.
+ *
+ * The first VM86REC_ENTER is preceded by a VM86REC_TABLES record, the
+ * IDT, the whole LDT and the contents of every page a segment in it
+ * covers.  RDTSC reads the core's own cycle counter, so it is reproduced
+ * by the replay and needs no record.
+ *
+ * tests/cpu/vm86replay.cpp is a headless replayer built with the Linux
+ * tests; it checks that the core reaches every hand-off at the recorded
+ * CS:IP and leaves with the recorded registers.
+ */
+
+#ifndef __VM86REC_H__
+#define __VM86REC_H__
+
+#define VM86REC_MAGIC   "VM86REC"
+#define VM86REC_VERSION 2
+
+enum
+{
+	VM86REC_ENTER = 1,  /* vm86main entered from 32-bit code, VM86REC_STATE */
+	VM86REC_LEAVE,      /* vm86main returns to 32-bit code, VM86REC_STATE */
+	VM86REC_CALL,       /* call into a built-in function, VM86REC_CALL_INFO */
+	VM86REC_INT,        /* interrupt or exception handled by 32-bit code, VM86REC_INT_INFO */
+	VM86REC_RETURN,     /* back from a call or interrupt, VM86REC_STATE */
+	VM86REC_LDT,        /* VM86REC_LDT_INFO and 'count' LDT entries */
+	VM86REC_MEMORY,     /* VM86REC_MEMORY_INFO and the bytes at 'address' */
+	VM86REC_TABLES,     /* descriptor tables and CR0, VM86REC_TABLES_INFO */
+};
+
+#include <pshpack1.h>
+typedef struct
+{
+	char magic[8];
+	UINT32 version;
+	UINT32 reserved;
+} VM86REC_FILE;
+
+typedef struct
+{
+	UINT8 type;
+	UINT8 reserved[3];
+	UINT32 size;        /* bytes of payload after the header */
+	UINT64 position;    /* instructions retired */
+} VM86REC_HEADER;
+
+typedef struct
+{
+	UINT32 eax, ecx, edx, ebx, esp, ebp, esi, edi;
+	UINT32 eip;
+	UINT32 eflags;
+	UINT16 es, cs, ss, ds, fs, gs;
+} VM86REC_STATE;
+
+typedef struct
+{
+	UINT32 entry;       /* 32-bit entry point */
+	UINT16 cs;          /* 16-bit entry point */
+	UINT16 ip;
+} VM86REC_CALL_INFO;
+
+typedef struct
+{
+	UINT8 num;
+	UINT8 reserved;
+	UINT16 cs;          /* where the core delivered it */
+	UINT16 ip;
+} VM86REC_INT_INFO;
+
+typedef struct
+{
+	UINT16 index;
+	UINT16 count;
+} VM86REC_LDT_INFO;
+
+typedef struct
+{
+	UINT32 address;     /* linear */
+} VM86REC_MEMORY_INFO;
+
+typedef struct
+{
+	UINT32 gdt_base;    /* linear; the LDT entries are written at ldt_base */
+	UINT32 idt_base;
+	UINT32 ldt_base;
+	UINT16 gdt_limit;
+	UINT16 idt_limit;
+	UINT16 ldt_limit;
+	UINT16 cpl;
+	UINT32 cr0;
+} VM86REC_TABLES_INFO;
+#include <poppack.h>
+
+#endif /* __VM86REC_H__ */
@@ -0,0 +1,48 @@
+/*
+ * Segment registers around a call into 32-bit code, included by
+ * msdos.cpp inside its extern "C" block.  Only the ones the call changed
+ * are loaded again when it returns.
+ */
+
+//segment registers before a call into 32-bit code, with the descriptors they were loaded from
+//(the GDT and the LDT are both wine_ldt)
+struct segment_snapshot
+{
+	I386_SREG sreg[6];
+	LDT_ENTRY entry[6];
+};
+void save_segments(segment_snapshot *snapshot)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		snapshot->sreg[i] = m_sreg[i];
+		snapshot->entry[i] = wine_ldt[SREG(i) >> 3];
+	}
+}
+//true if the segment register has to be reloaded: most API calls change neither the selectors
+//nor their descriptors, and reloading a descriptor is expensive in protected mode
+//a callback into 16-bit code leaves its own descriptors loaded, so those are compared too
+bool segment_changed(const segment_snapshot *snapshot, int sreg)
+{
+	const I386_SREG *old = &snapshot->sreg[sreg];
+	if (!PROTECTED_MODE || V8086_MODE)
+		return true;
+	return SREG(sreg) != old->selector || m_sreg[sreg].base != old->base || m_sreg[sreg].limit != old->limit ||
+		m_sreg[sreg].flags != old->flags || m_sreg[sreg].d != old->d || m_sreg[sreg].valid != old->valid ||
+		memcmp(&snapshot->entry[sreg], &wine_ldt[SREG(sreg) >> 3], sizeof(LDT_ENTRY));
+}
+//load the segment registers a built-in function returned that changed, and continue at eip
+void reload_segments(const segment_snapshot *snapshot, UINT32 eip)
+{
+	static const int order[] = { ES, SS, DS, FS, GS };
+	for (int i = 0; i < 5; i++)
+	{
+		if (segment_changed(snapshot, order[i]))
+			i386_load_segment_descriptor(order[i]);
+	}
+	m_eip = eip;
+	if (segment_changed(snapshot, CS))
+		i386_jmp_far(SREG(CS), eip);
+	else
+		CHANGE_PC(m_eip);
+}
@@ -0,0 +1,93 @@
+/*
+ * Trace ring buffer (dasm == 2), included by msdos.cpp inside its
+ * extern "C" block.  Instructions are kept as their raw bytes and only
+ * disassembled when the buffer is dumped, other entries are text.
+ */
+
+struct dasm_buffer
+{
+	struct record
+	{
+		UINT32 eip;
+		UINT16 cs;
+		bool text;
+		bool op32;              // disassemble with 32-bit operand size
+		UINT8 length;           // bytes saved, an instruction is 15 bytes at most
+		UINT8 bytes[15];
+	};
+	size_t index = 0;
+	size_t current_size = 0;
+	const size_t size = 1000;
+	std::vector<record> records;
+	std::vector<char[256]> text;
+	dasm_buffer(size_t cap) : size(cap), records(cap), text(cap)
+	{
+
+	}
+	record *next()
+	{
+		record *rec = &records[index];
+		current_size++;
+		index = (index + 1) % size;
+		return rec;
+	}
+	char *get_current()
+	{
+		char *buf = text[index];
+		next()->text = true;
+		buf[0] = '\0';
+		return buf;
+	}
+	void add_insn(UINT16 cs, UINT32 eip, bool op32, const UINT8 *oprom, UINT32 avail)
+	{
+		record *rec = next();
+		rec->eip = eip;
+		rec->cs = cs;
+		rec->text = false;
+		rec->op32 = op32;
+		rec->length = (UINT8)min(avail, sizeof(rec->bytes));
+		memcpy(rec->bytes, oprom, rec->length);
+	}
+	void dump(FILE *fp = stderr)
+	{
+		size_t base = current_size < size ? 0 : (index + size) % size;
+		for (size_t i = 0; i < current_size && i < size; i++)
+		{
+			const record *rec = &records[(base + i) % size];
+			if (rec->text)
+			{
+				fprintf(fp, "%s", text[(base + i) % size]);
+				continue;
+			}
+			char buffer[256];
+			UINT8 oprom[sizeof(rec->bytes) + 1] = { 0 };
+			offs_t eip = rec->eip;
+			memcpy(oprom, rec->bytes, rec->length);
+			if (rec->op32)
+				CPU_DISASSEMBLE_CALL(x86_32);
+			else
+				i386_dasm_one_ex(buffer, eip, oprom, 16);
+			fprintf(fp, "%04x:%04x\t%s\n", rec->cs, (unsigned)rec->eip, buffer);
+		}
+	}
+};
+/* Cheap check for a call instruction, so tracing into the buffer need not disassemble */
+static bool dasm_is_call(const UINT8 *oprom)
+{
+	int i;
+	for (i = 0; i < 14; i++)
+	{
+		switch (oprom[i])
+		{
+		case 0x26: case 0x2e: case 0x36: case 0x3e: case 0x64: case 0x65:
+		case 0x66: case 0x67: case 0xf0: case 0xf2: case 0xf3:
+			continue;
+		case 0xe8: case 0x9a:
+			return true;
+		case 0xff:
+			return ((oprom[i + 1] >> 3) & 7) == 2 || ((oprom[i + 1] >> 3) & 7) == 3;
+		}
+		return false;
+	}
+	return false;
+}
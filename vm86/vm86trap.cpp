@@ -0,0 +1,26 @@
+//Trap pages of vm86main, included by msdos.cpp; tests/cpu/trap.cpp runs them under the V86 stand-in
+//of tests/cpu/v86.h.
+//The pages holding an address vm86main has to intercept (the iret stubs and the from16 thunks) are
+//marked, and vm86main only compares m_pc against those addresses when it lands on one of them.
+//The addresses stay the same for the life of the process, so marks are never cleared; the return
+//address of each call is compared on every instruction instead.
+static UINT32 vm86_trap_page[0x100000 / 32];
+inline void vm86_set_trap(UINT32 addr)
+{
+	UINT32 page = addr >> 12;
+	InterlockedOr((LONG volatile *)&vm86_trap_page[page >> 5], 1 << (page & 31));
+}
+inline bool vm86_is_trap(UINT32 addr)
+{
+	UINT32 page = addr >> 12;
+	return (vm86_trap_page[page >> 5] & (1 << (page & 31))) != 0;
+}
+//the TEB info of the thread running the core; vm86main sets it before each i386_block_execute,
+//as the core runs on whichever thread holds the Win16 lock
+static WINE_VM86_TEB_INFO *vm86_block_teb;
+//i386_block_set_event: a loop the block cache chains stops for what vm86main checks before
+//each instruction, an address on a trap page or an event krnl386 queued for V86 code
+bool vm86_block_event(UINT32 pc)
+{
+	return vm86_is_trap(pc) || (V8086_MODE && (vm86_block_teb->vm86_pending & 0x100000));
+}
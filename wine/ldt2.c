@@ -8,6 +8,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #include "windef.h"
 #include "winbase.h"
@@ -26,6 +29,127 @@ static void(*unlock_ldt)(void) = nop;
 #define LDT_FIRST_ENTRY 512
 #define LDT_SIZE 8192
 
+/* allocation bitmap of the LDT, one bit per entry (set = allocated),
+ * and a summary with one bit per bitmap word (set = word is full) */
+static unsigned int ldt_used[LDT_SIZE / 32];
+static unsigned int ldt_full[LDT_SIZE / 32 / 32];
+
+static struct
+{
+	int used;       /* entries currently allocated */
+	int peak;       /* highest value of used */
+	int allocs;     /* successful wine_ldt_alloc_entries calls */
+	int failures;   /* wine_ldt_alloc_entries calls that found no free run */
+} ldt_stats;
+
+static inline int ldt_ctz(unsigned int x)
+{
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward(&i, x);
+	return i;
+#else
+	return __builtin_ctz(x);
+#endif
+}
+
+static inline int ldt_clz(unsigned int x)
+{
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanReverse(&i, x);
+	return 31 - i;
+#else
+	return __builtin_clz(x);
+#endif
+}
+
+/* mark count entries starting at index as allocated or free */
+static void ldt_mark(int index, int count, int used)
+{
+	while (count > 0)
+	{
+		int word = index >> 5, bit = index & 31;
+		int n = min(32 - bit, count);
+		unsigned int mask = (n == 32) ? ~0u : ((1u << n) - 1) << bit;
+
+		if (used) ldt_used[word] |= mask;
+		else ldt_used[word] &= ~mask;
+		if (ldt_used[word] == ~0u) ldt_full[word >> 5] |= 1u << (word & 31);
+		else ldt_full[word >> 5] &= ~(1u << (word & 31));
+		index += n;
+		count -= n;
+	}
+}
+
+/* return the first index of the lowest run of count free entries, or -1 */
+static int ldt_find_free(int count)
+{
+	int word, run = 0, start = 0;
+
+	for (word = LDT_FIRST_ENTRY / 32; word < LDT_SIZE / 32; word++)
+	{
+		unsigned int avail;
+
+		if (!(word & 31) && ldt_full[word >> 5] == ~0u)
+		{
+			/* 32 full words, nothing to find here */
+			word += 31;
+			run = 0;
+			continue;
+		}
+		avail = ~ldt_used[word];
+		if (!avail)
+		{
+			run = 0;
+			continue;
+		}
+		if (avail == ~0u)
+		{
+			if (!run) start = word * 32;
+			run += 32;
+			if (run >= count) return start;
+			continue;
+		}
+		/* run continued from the previous words */
+		if (run && run + ldt_ctz(~avail) >= count) return start;
+		/* runs inside this word: after x &= x >> k, bit i is set if bits i..i+len-1 are free */
+		if (count <= 32)
+		{
+			unsigned int x = avail;
+			int len = 1;
+			while (x && len < count)
+			{
+				int k = min(len, count - len);
+				x &= x >> k;
+				len += k;
+			}
+			if (x) return word * 32 + ldt_ctz(x);
+		}
+		/* run that continues into the next word */
+		run = ldt_clz(~avail);
+		start = word * 32 + 32 - run;
+	}
+	return -1;
+}
+
+/* number of free entries and length of the longest free run, for diagnostics */
+static void ldt_fragmentation(int *free_count, int *largest)
+{
+	int i, run = 0;
+
+	*free_count = *largest = 0;
+	for (i = LDT_FIRST_ENTRY; i < LDT_SIZE; i++)
+	{
+		if (ldt_used[i >> 5] & (1u << (i & 31))) run = 0;
+		else
+		{
+			(*free_count)++;
+			if (++run > *largest) *largest = run;
+		}
+	}
+}
+
 /***********************************************************************
  *           wine_ldt_get_ptr
  *
@@ -113,7 +237,7 @@ unsigned short sel = 0x1000;
 unsigned short wine_ldt_alloc_entries(int count)
 {
 
-	int i, index, size = 0;
+	int i, index;
 
 	if (count <= 0)
 	{
@@ -121,19 +245,26 @@ unsigned short wine_ldt_alloc_entries(int count)
 		return 0;
 	}
 	lock_ldt();
-	for (i = LDT_FIRST_ENTRY; i < LDT_SIZE; i++)
+	index = count <= LDT_SIZE - LDT_FIRST_ENTRY ? ldt_find_free(count) : -1;
+	if (index >= 0)
 	{
-		if (wine_ldt_copy.flags[i] & WINE_LDT_FLAGS_ALLOCATED) size = 0;
-		else if (++size >= count)  /* found a large enough block */
-		{
-			index = i - size + 1;
-
-			/* mark selectors as allocated */
-			for (i = 0; i < count; i++) wine_ldt_copy.flags[index + i] |= WINE_LDT_FLAGS_ALLOCATED;
-			unlock_ldt();
-			//DPRINTF("NOTIMPL:wine_ldt_alloc_entries(%d) = %d\n", count, (index << 3) | 7);
-			return (index << 3) | 7;
-		}
+		/* mark selectors as allocated */
+		for (i = 0; i < count; i++) wine_ldt_copy.flags[index + i] |= WINE_LDT_FLAGS_ALLOCATED;
+		ldt_mark(index, count, TRUE);
+		ldt_stats.allocs++;
+		ldt_stats.used += count;
+		if (ldt_stats.used > ldt_stats.peak) ldt_stats.peak = ldt_stats.used;
+		unlock_ldt();
+		//DPRINTF("NOTIMPL:wine_ldt_alloc_entries(%d) = %d\n", count, (index << 3) | 7);
+		return (index << 3) | 7;
+	}
+	ldt_stats.failures++;
+	if (WARN_ON(ldt))
+	{
+		int free_count, largest;
+		ldt_fragmentation(&free_count, &largest);
+		WARN("no run of %d free entries: %d used (peak %d), %d free, largest free run %d, %d allocations, %d failures\n",
+		     count, ldt_stats.used, ldt_stats.peak, free_count, largest, ldt_stats.allocs, ldt_stats.failures);
 	}
 	unlock_ldt();
 	TRACE("wine_ldt_alloc_entries(%d) = %d\n", count, 0);
@@ -175,12 +306,15 @@ unsigned short wine_ldt_realloc_entries(unsigned short sel, int oldcount, int ne
 		{
 			for (i = oldcount; i < newcount; i++)
 				wine_ldt_copy.flags[index + i] |= WINE_LDT_FLAGS_ALLOCATED;
+			ldt_mark(index + oldcount, newcount - oldcount, TRUE);
+			ldt_stats.used += newcount - oldcount;
+			if (ldt_stats.used > ldt_stats.peak) ldt_stats.peak = ldt_stats.used;
 		}
 		unlock_ldt();
 	}
 	else if (oldcount > newcount) /* we need to remove selectors */
 	{
-		wine_ldt_free_entries(sel + (newcount << 3), newcount - oldcount);
+		wine_ldt_free_entries(sel + (newcount << 3), oldcount - newcount);
 	}
 	return sel;
 	TRACE("wine_ldt_realloc_entries(0x%04X,%d,%d)\n", sel, oldcount, newcount);
@@ -216,16 +350,20 @@ static int internal_set_entry(unsigned short sel, const LDT_ENTRY *entry)
 */
 void wine_ldt_free_entries(unsigned short sel, int count)
 {
-	int index;
+	int i, index = sel >> 3;
 
+	TRACE("wine_ldt_free_entries(0x%04X,%d)\n", sel, count);
+	if (count <= 0) return;
+	if (count > LDT_SIZE - index) count = LDT_SIZE - index;
 	lock_ldt();
-	for (index = sel >> 3; count > 0; count--, index++)
+	for (i = index; i < index + count; i++)
 	{
-		internal_set_entry(sel, &null_entry);
-		wine_ldt_copy.flags[index] = 0;
+		if (wine_ldt_copy.flags[i] & WINE_LDT_FLAGS_ALLOCATED) ldt_stats.used--;
+		internal_set_entry((i << 3) | (sel & 7), &null_entry);
+		wine_ldt_copy.flags[i] = 0;
 	}
+	ldt_mark(index, count, FALSE);
 	unlock_ldt();
-	TRACE("wine_ldt_free_entries(0x%04X,%d)\n", sel, count);
 }
 /***********************************************************************
 *           wine_ldt_is_system